@@ -38,17 +38,44 @@
 
 #include "app_iostream_usart.h"
 #include "ble_defragment_rxdata.h"
+#include "ble_fragment_txdata.h"
+#include "app_uart_egress.h"
+#include "app_uart_ingress.h"
+#include "app_console.h"
+#include "app_pools.h"
+#include "app_checksum.h"
+#include "app_cycle_stats.h"
+#include "app_trace.h"
+#include "app_scan_filter.h"
+#include "app_adv_status.h"
+#include "app_gatt_cache.h"
+#include "app_bond_store.h"
+#include "app_link_quality.h"
+#include "app_drr.h"
 #include "app_button_pairing_complete.h"
 
 #include "sl_board_control.h"
 #include "dmd.h"
 #include "glib.h"
 
+// Trace site IDs of this file (app_trace.h)
+#define APP_TRACE_FILE_ID             1
+
 // default: define SL_BT_CONFIG_MAX_CONNECTIONS (4)
 #if SL_BT_CONFIG_MAX_CONNECTIONS < 1
   #error At least 1 connection has to be enabled!
 #endif
 
+// Each link has its own RX queue (ble_defragment_rxdata.h), scheduled by app_drr.h,
+// and its own TX queue (ble_fragment_txdata.h)
+#if SL_BT_CONFIG_MAX_CONNECTIONS > DEFRAG_LINKS || SL_BT_CONFIG_MAX_CONNECTIONS > APP_DRR_MAX_FLOWS \
+    || SL_BT_CONFIG_MAX_CONNECTIONS > FRAG_TX_LINKS
+  #error DEFRAG_LINKS, APP_DRR_MAX_FLOWS and FRAG_TX_LINKS must cover SL_BT_CONFIG_MAX_CONNECTIONS
+#endif
+
+// RX bytes a link may process per main loop pass: one full indication
+#define RX_DRR_QUANTUM                20
+
 // Connection parameters
 #define CONN_INTERVAL_MIN             80   // 100ms
 #define CONN_INTERVAL_MAX             100  // 100*10ms
@@ -57,13 +84,35 @@
 #define CONN_MIN_CE_LENGTH            0
 #define CONN_MAX_CE_LENGTH            0xffff
 
+// Link adaptation (app_link_quality.h): strong links get a shorter interval
+// on 2M PHY, weak links Coded PHY and a longer supervision timeout
+#define CONN_INTERVAL_STRONG_MIN      24   // 30ms
+#define CONN_INTERVAL_STRONG_MAX      40   // 50ms
+#define CONN_TIMEOUT_WEAK             1600 // 1600*10ms
+
+// Longest a withheld indication confirmation may wait for RX queue room. The
+// server drops the link if it is not confirmed within the 30 s ATT
+// transaction timeout; the link quality timer wakes the main loop to check.
+#define RX_WITHHOLD_MAX_MS            20000
+
+// Link quality sampler
+#define LINK_QUALITY_PERIOD_MS        1000
+#define LINK_QUALITY_SIGNAL           (1UL << 8)  // External signal, above the pair_state_t values
+
+// Statistics report: pools, console, trace, RX/TX flow and links, printed on
+// this period instead of after every payload, and only after some traffic
+#define STATS_REPORT_PERIOD_MS        10000
+#define STATS_REPORT_SIGNAL           (1UL << 9)  // External signal of the report timer
+
+// Scanner front-end (app_scan_filter.h)
+#define SCAN_RSSI_MIN                 (-90)   // dBm, weaker reports are not parsed
+#define SCAN_IDLE_HOLD_MS             1000    // Peripherals without pending data wait this long after a scanner start
+
 #define CONNECTION_HANDLE_INVALID     ((uint8_t)0xFFu)
 #define SERVICE_HANDLE_INVALID        ((uint32_t)0xFFFFFFFFFFFFFu)
 #define CHARACTERISTIC_HANDLE_INVALID ((uint16_t)0xFFFFu)
 #define TABLE_INDEX_INVALID           ((uint8_t)0xFFu)
 #define TX_POWER_INVALID              ((uint8_t)0x7C)
-#define TX_POWER_CONTROL_ACTIVE       ((uint8_t)0x00)
-#define TX_POWER_CONTROL_INACTIVE     ((uint8_t)0x01)
 #define PRINT_TX_POWER_DEFAULT        (false)
 
 #define TABLE_INDEX_INVALID           ((uint8_t)0xFFu)
@@ -92,6 +141,7 @@ typedef enum
   scanning,
   opening,
   pairing,
+  validate_gatt_cache,
   discover_services,
   discover_characteristics,
   enable_indication,
@@ -99,6 +149,14 @@ typedef enum
   handle_rxdata
 } conn_state_t;
 
+// Filling the GATT cache of a running link (app_gatt_cache.h)
+typedef enum
+{
+  GATT_CACHE_IDLE,
+  GATT_CACHE_FIND_GATT_SERVICE,       // Generic Attribute service of the peer
+  GATT_CACHE_READ_DB_HASH             // Its Database Hash characteristic
+} gatt_cache_step_t;
+
 typedef enum
 {
   IDLE,
@@ -111,26 +169,105 @@ typedef enum
 
 typedef struct {
   uint8_t  connection_handle;
-  int8_t   rssi;
-  bool     power_control_active;
-  int8_t   tx_power;
-  int8_t   remote_tx_power;
+  int8_t   rssi;                                  // Latest sample of the link quality sampler
+  bool     power_control_active;                  // Power reporting enabled on the link
+  int8_t   tx_power;                              // Local TX power, from power reporting
+  int8_t   remote_tx_power;                       // Peer TX power, from power reporting
+  uint8_t  phy;                                   // sl_bt_gap_phy_t of the link
+  app_link_quality_t link_quality;                // RSSI history and class
   uint8_t  server_address[6];
+  uint8_t  server_address_type;
+  uint8_t  bonding;                               // Bonding handle, SL_BT_INVALID_BONDING_HANDLE if none
+  bool     known_peer;                            // Bonded before this connection
+  bool     secured;                               // Encryption started
   uint32_t usart_service_handle;
   uint16_t usartpacket_characteristic_handle;
+  bool     handles_from_cache;                    // Discovery skipped on this link
+  bool     first_data_seen;
+  gatt_cache_step_t gatt_cache_step;
+  uint32_t gatt_service_handle;                   // Generic Attribute service, while caching
+  uint16_t db_hash_handle;
+  uint8_t  db_hash_len;
+  uint8_t  db_hash[APP_GATT_CACHE_HASH_LEN];      // Database Hash read from the peer
+  uint8_t  withheld_len;                          // 0 when no confirmation is withheld
+  uint8_t  withheld_fragment[QUEUE_SLOT_SIZE];    // Fragment waiting for RX queue space
+  uint32_t withheld_at;                           // Sleeptimer tick when the confirmation was withheld
+  uint16_t rx_message_left;                       // Bytes of the Peripheral's message still to come, 0 between messages
+  conn_state_t setup_state;                       // pairing .. running, one per link
+  bool     passkey_pending;                       // Numeric Comparison waiting for the user
+  uint32_t passkey_value;                         // Passkey to confirm
+  uint32_t passkey_order;                         // Arrival order of the request, oldest answered first
+  uint32_t opened_at;                             // Sleeptimer tick of the connection
 } conn_properties_t;
 
+// Counters of the indication flow control
+typedef struct {
+  uint32_t fragments_received;
+  uint32_t confirmations_withheld;  // Fragments parked because the RX queue was full
+  uint32_t fragments_dropped;       // Fragments that could not be queued nor parked
+  uint32_t confirmations_expired;   // Parked fragments dropped to confirm before the ATT timeout
+} rx_flow_stats_t;
+
 // Array for holding properties of multiple (parallel) connections
 conn_properties_t conn_properties[SL_BT_CONFIG_MAX_CONNECTIONS];
 
 // Counter of active connections
 static uint8_t active_connections_num;
 
+// Periodic RSSI sampling of the running links
+static sl_sleeptimer_timer_handle_t link_quality_timer;
+
+// Periodic statistics report, and the traffic since the last one
+static sl_sleeptimer_timer_handle_t stats_report_timer;
+static uint32_t payloads_forwarded = 0;
+static uint32_t fragments_written = 0;
+static uint32_t payloads_reported = 0;
+static uint32_t fragments_reported = 0;
+
+// Slot of each connection handle, TABLE_INDEX_INVALID when the handle is not
+// in use. Slots never move while their connection is open.
+static uint8_t slot_by_handle[256];
+
+// Stack of free slots of conn_properties
+static uint8_t free_slots[SL_BT_CONFIG_MAX_CONNECTIONS];
+static uint8_t free_slot_count;
+
+// Bring-up of a full fleet (SL_BT_CONFIG_MAX_CONNECTIONS links)
+typedef struct {
+  uint32_t start;             // Sleeptimer tick when scanning started without any link
+  bool reported;              // Fleet time printed, until all links are gone
+} fleet_setup_t;
+
+static fleet_setup_t fleet_setup = {0};
+
+static rx_flow_stats_t rx_flow = {0};
+
+// CPU time spent in defrag_process_fragment() per fragment
+static app_cycle_stats_t fragment_cycles = APP_CYCLE_STATS_INIT("per fragment");
+
+// Order in which the RX queues of the links are served
+static app_drr_t rx_drr;
+
+// CPU time spent on each advertising report
+static app_cycle_stats_t scan_report_cycles = APP_CYCLE_STATS_INIT("per scan report");
+
+// Tick of the last scanner start, and reports of idle Peripherals held back
+// since then in favour of ones with pending data (app_adv_status.h)
+static uint32_t scan_started_at;
+static uint32_t scan_idle_deferred = 0;
+
 // This variable holds the connection handle of the current connection
-// serving for evt confirm_passkey
-static uint8_t temp_connec_handle;
+// serving for evt confirm_passkey: the one prompted on the display
+static uint8_t temp_connec_handle = CONNECTION_HANDLE_INVALID;
+
+// Arrival counter of the passkey confirmation requests
+static uint32_t passkey_request_count = 0;
+
+// Handle of the connection request in progress (conn_state == opening)
+static uint8_t pending_connection = CONNECTION_HANDLE_INVALID;
 
-// State of connection under establishment
+// State of the scanner: scanning, opening (one connection request at a time)
+// or running (stopped, no request pending). Each link has its own setup_state.
 conn_state_t conn_state;
 conn_state_t indi_state;
 static volatile pair_state_t state = IDLE;
@@ -145,13 +282,15 @@ static volatile uint32_t passkey = 0;
 // My custom service UUID in gattdb (server)
 // I need AD type 0x07 -> complete list of custom services (128bits)
 // 8935c600-3a0e-4388-92ed-8f6de23f3f5a -> convert Little endian: 5a3f3fe26d8fed9288430e3a00c63589
-static const uint8_t current_time_service[2] = { 0x05, 0x18 };
 static const uint8_t name_service[2] = { 0x00, 0x18 };
 static const uint8_t name_characteristic[2] = { 0x00, 0x2A };
 static const uint8_t usart_service[16] = { 0x40, 0x30, 0x57, 0x13, 0x72, 0xd9, 0x62, 0x83, 
                                            0xdf, 0x4c, 0xb8, 0x80, 0xd9, 0x81, 0x7d, 0x46 };
 static const uint8_t usart_char[16] = { 0xfa, 0x3d, 0x74, 0x7c, 0x09, 0xd3, 0xdf, 0xb1, 
                                         0x07, 0x41, 0xd4, 0xa2, 0xa5, 0x79, 0xba, 0x17 };
+// Generic Attribute service and its Database Hash characteristic (GATT caching)
+static const uint8_t generic_attribute_service[2] = { 0x01, 0x18 };
+static const uint8_t database_hash_char[2] = { 0x2A, 0x2B };
 
 // Init properties
 static void init_properties(void);
@@ -161,13 +300,45 @@ static bd_addr *read_and_cache_bluetooth_address(uint8_t *address_type_out);
 static void printf_bluetooth_address(void);
 
 // Find service
-static sl_status_t find_service_in_advertisement(uint8_t *data, uint8_t len);
+static void scan_filter_init(void);
 
 // Add connection with server
 static uint8_t find_index_by_connection_handle(uint8_t connection);
-static void add_connection(uint8_t connection, uint8_t *address);
+static uint8_t add_connection(uint8_t connection, uint8_t *address, uint8_t address_type);
+static void clear_slot(uint8_t table_index);
 static void remove_connection(uint8_t connection);
 
+// Indication flow control
+static void send_withheld_confirmations(void);
+
+// RX scheduling
+static uint16_t rx_head_len(void *ctx, uint8_t table_index);
+static bool rx_serve_fragment(void *ctx, uint8_t table_index);
+
+// UART input to the Peripherals
+static sl_status_t send_uart_input(uint8_t *line, size_t len, bool is_frame);
+
+// Connection setup pipeline
+static void scanner_resume(void);
+static bool scan_defer_idle(const uint8_t *data, size_t len);
+static void link_setup_failed(uint8_t table_index, const char *reason);
+static void link_ready(uint8_t table_index);
+static bool start_cached_setup(uint8_t table_index);
+static void start_link_setup(uint8_t table_index);
+static void link_secured(uint8_t table_index);
+static void gatt_cache_step_done(uint8_t table_index, uint16_t result);
+static void link_quality_timer_cb(sl_sleeptimer_timer_handle_t *handle, void *data);
+static void link_quality_start(uint8_t table_index);
+static void link_quality_sample(void);
+static void link_quality_changed(uint8_t table_index);
+static void link_quality_log(void);
+static void stats_report_timer_cb(sl_sleeptimer_timer_handle_t *handle, void *data);
+static void stats_report(void);
+
+// Numeric Comparison requests of links pairing in parallel
+static uint8_t oldest_passkey_request(void);
+static void passkey_prompt_next(void);
+
 #if(IO_CAPABILITY != KEYBOARDONLY)
 static uint32_t make_passkey_from_address(bd_addr address);
 #endif
@@ -188,9 +359,25 @@ void button_event_handler(const button_event_t *evt);
 // Application Init.
 void app_init(void)
 {
+  app_console_init();
+  app_cycle_counter_init();
+  app_trace_init();
+#ifdef APP_TRACE_BENCHMARK
+  app_trace_log_benchmark();
+#endif
   app_iostream_usart_init();
+  app_pools_init();
+  app_uart_egress_init();
+  app_uart_ingress_init(NULL);
+#ifdef APP_CHECKSUM_BENCHMARK
+  app_checksum_log_benchmark();
+#endif
   init_properties();
+  scan_filter_init();
+  app_gatt_cache_init();
   defrag_init();
+  frag_tx_init();
+  app_drr_init(&rx_drr, SL_BT_CONFIG_MAX_CONNECTIONS, RX_DRR_QUANTUM);
   graphics_init();
   app_button_pairing_init(button_event_handler);
 }
@@ -198,42 +385,73 @@ void app_init(void)
 // Application Process Action.
 void app_process_action(void)
 {
+  uint8_t *payload;
+  uint16_t payload_len;
+  bool checksum_ok;
+  uint8_t rx_link;
+  uint8_t *line;
+  size_t line_len;
+  bool is_frame;
+
+  // Stage 1: reassemble queued fragments into the next free completion buffer.
+  // One round over the links, each may spend RX_DRR_QUANTUM bytes: a link
+  // streaming fast cannot hold back the others.
   if(indi_state == handle_rxdata)
   {
-    defrag_enum_t rx_data_state = defrag_process_fragment();
-    if(rx_data_state == DEFRAG_COMPLETE)
-    {
-      uint8_t *payload;
-      uint16_t payload_len;
-      bool checksum_ok;
-      
-      if(defrag_get_payload(&payload, &payload_len, &checksum_ok))
-      {
-        if (checksum_ok)
-        {
-          LOG_INFO("->Payload Ready:");
-          LOG_INFO("->Length: %d bytes", (int)payload_len);
-          LOG_INFO("->Data: \"%.*s\" ", (int)payload_len, payload);
-          
-        }
-        else
-        {
-          LOG_INFO("Checksum error");
-        }
-      }
+    app_drr_pass(&rx_drr, rx_head_len, rx_serve_fragment, NULL);
+
+    // Stay in this state while fragments wait (e.g. completion buffers were busy)
+    indi_state = (defrag_queued_fragments() > 0) ? handle_rxdata : running;
+  }
 
-      // Reset for next transmission
-      defrag_reset();
+  // Ring space may have been freed: take parked fragments and let their peers go on
+  send_withheld_confirmations();
+
+  // Stage 2: forward the oldest completed payload. It stays in its completion
+  // buffer until the egress accepts it, while stage 1 keeps reassembling.
+  if(defrag_get_payload(&payload, &payload_len, &checksum_ok, &rx_link))
+  {
+    if(!checksum_ok)
+    {
+      LOG_WARN("Checksum error, link slot %d", (int)rx_link);
+      defrag_release_payload();
     }
-    else if(rx_data_state == DEFRAG_ERROR)
+    else if(app_uart_egress_can_accept(payload_len))
     {
-      LOG_INFO("[ERROR] Defragmentation error");
-      defrag_reset();
+      // The payload may be binary: ble_defragment_rxdata logs its first bytes in hex
+      LOG_DEBUG("->Payload Ready from link slot %d: %d bytes", (int)rx_link, (int)payload_len);
+
+      // Forward to the gateway host, never waits for the UART
+      if(app_uart_egress_write(payload, payload_len) != SL_STATUS_OK)
+      {
+        LOG_WARN("->Egress FULL, payload dropped");
+      }
+      defrag_release_payload();
+      payloads_forwarded++;
     }
+  }
 
-    indi_state = running;
+  // Stage 3: UART input from the host to every Peripheral. Frame what the UART
+  // received since the last pass, never waits for input. A line waits in the
+  // ingress queue while the fragment pool is busy with earlier messages or a
+  // link still has a full TX queue.
+  app_uart_ingress_process();
+  if(app_uart_ingress_get_line(&line, &line_len, &is_frame) && frag_tx_can_accept(line_len)
+     && send_uart_input(line, line_len, is_frame) != SL_STATUS_FULL)
+  {
+    // The TX queue copies the payload, the line can be released
+    app_uart_ingress_release_line();
   }
 
+  // Write queued fragments while the stack has TX buffers
+  fragments_written += frag_tx_process();
+
+  // Hand buffered trace records and log text to the egress, then keep it draining
+  // and report backpressure
+  app_trace_process();
+  app_console_process();
+  app_uart_egress_process();
+
   if (app_is_process_required()) {
 
   }
@@ -251,6 +469,9 @@ void sl_bt_on_event(sl_bt_msg_t *evt)
   uint8_t addr_value[6];
   uint8_t table_index;
   bd_addr address;
+  uint32_t scan_start;
+
+  APP_TRACE("bt event 0x%08lx", (unsigned long)SL_BT_MSG_ID(evt->header));
 
   switch (SL_BT_MSG_ID(evt->header)) {
     // -------------------------------
@@ -286,9 +507,12 @@ void sl_bt_on_event(sl_bt_msg_t *evt)
       app_assert_status(sc);
       LOG_BOOT("Bondings allowed");
 
-      sc = sl_bt_sm_delete_bondings();
+      // Hold BTN1 during reset to revoke every trusted peer
+      if (button_service_get_button_state(BUTTON_ID_1) == SL_SIMPLE_BUTTON_PRESSED) {
+        app_bond_store_revoke(APP_BOND_STORE_ALL);
+      }
+      sc = app_bond_store_init();
       app_assert_status(sc);
-      LOG_BOOT("Old bondings deleted");
 
       // Set the default connection parameters for subsequent connections
       sc = sl_bt_connection_set_default_parameters(CONN_INTERVAL_MIN,
@@ -307,27 +531,50 @@ void sl_bt_on_event(sl_bt_msg_t *evt)
       LOG_SCANN("Started scanning %02lx", sc);
 
       conn_state = scanning;
+      scan_started_at = sl_sleeptimer_get_tick_count();
+      fleet_setup.start = sl_sleeptimer_get_tick_count();
+      fleet_setup.reported = false;
+
+      sc = sl_sleeptimer_start_periodic_timer_ms(&link_quality_timer,
+                                                 LINK_QUALITY_PERIOD_MS,
+                                                 link_quality_timer_cb,
+                                                 NULL, 0, 0);
+      app_assert_status(sc);
+      sc = sl_sleeptimer_start_periodic_timer_ms(&stats_report_timer,
+                                                 STATS_REPORT_PERIOD_MS,
+                                                 stats_report_timer_cb,
+                                                 NULL, 0, 0);
+      app_assert_status(sc);
       break;
 
     // -------------------------------
     // This event indicates that central receive a adv_pack or scan_reponse_pack
     // old sdk: sl_bt_evt_scanner_scan_report
     case sl_bt_evt_scanner_legacy_advertisement_report_id:
+      scan_start = app_cycle_counter_now();
       // Parse the advertisment packets
       // SL_BT_SCANNER_EVENT_FLAG_CONNECTABLE   0x1 -> connectable: peripherals accept connection from centrals
       // SL_BT_SCANNER_EVENT_FLAG_SCANNABLE     0x2 -> scannable: peripherals enable "active scanning" mode
       // SL_BT_SCANNER_EVENT_FLAG_DIRECTED      0x4 -> packet contains infor of a particular device
       // SL_BT_SCANNER_EVENT_FLAG_SCAN_RESPONSE 0x8 -> scan response packet
-      if(evt->data.evt_scanner_legacy_advertisement_report.event_flags 
+      if(conn_state == scanning
+         && evt->data.evt_scanner_legacy_advertisement_report.event_flags
          == (SL_BT_SCANNER_EVENT_FLAG_CONNECTABLE | SL_BT_SCANNER_EVENT_FLAG_SCANNABLE))
       {
-        // find service usart_ser advertisment packet
-        if(find_service_in_advertisement(&(evt->data.evt_scanner_legacy_advertisement_report.data.data[0]),
-                                         evt->data.evt_scanner_legacy_advertisement_report.data.len) == SL_STATUS_OK)
+        // find service usart_ser advertisment packet, weak reports are rejected first
+        if(app_scan_filter_check(evt->data.evt_scanner_legacy_advertisement_report.rssi,
+                                 evt->data.evt_scanner_legacy_advertisement_report.data.data,
+                                 evt->data.evt_scanner_legacy_advertisement_report.data.len)
+           && !scan_defer_idle(evt->data.evt_scanner_legacy_advertisement_report.data.data,
+                               evt->data.evt_scanner_legacy_advertisement_report.data.len))
         {
+          app_cycle_stats_add(&scan_report_cycles, scan_start);
           LOG_SCANN("Discover/find my service in AD structure");
+          app_cycle_stats_log(&scan_report_cycles);
+          app_scan_filter_log_stats();
 
-          // Then stop scanning for a while
+          // Then stop scanning while the connection request is pending, the
+          // scanner resumes as soon as the link is open
           sc = sl_bt_scanner_stop();
           app_assert_status(sc);
           LOG_SCANN("Stopped scanning after finding my service");
@@ -338,14 +585,20 @@ void sl_bt_on_event(sl_bt_msg_t *evt)
             sc = sl_bt_connection_open(evt->data.evt_scanner_legacy_advertisement_report.address,
                                        evt->data.evt_scanner_legacy_advertisement_report.address_type,
                                        sl_bt_gap_phy_1m,
-                                       NULL);
+                                       &pending_connection);
             app_assert_status(sc);
             LOG_CONN("Connection request sent");
 
             conn_state = opening;
           }
+          else
+          {
+            conn_state = running;
+          }
+          break;
         }
       }
+      app_cycle_stats_add(&scan_report_cycles, scan_start);
       break;
 
     // -------------------------------
@@ -369,15 +622,39 @@ void sl_bt_on_event(sl_bt_msg_t *evt)
       // Reserve the address of connected device
       memcpy(addr_value, evt->data.evt_connection_opened.address.addr, 6);
       //  Add connection to the connection_properties array
-      add_connection(evt->data.evt_connection_opened.connection, addr_value);
-      LOG_CONN("Reserved the addr of server device: ");
-      for(int i = 5; i >= 0; i--)
-        printf("%02X : ", addr_value[i]);
-      printf("\r\n");
+      table_index = add_connection(evt->data.evt_connection_opened.connection, addr_value,
+                                   evt->data.evt_connection_opened.address_type);
+      LOG_CONN("Reserved the addr of server device: %02X : %02X : %02X : %02X : %02X : %02X",
+               addr_value[5], addr_value[4], addr_value[3],
+               addr_value[2], addr_value[1], addr_value[0]);
 
-      temp_connec_handle = evt->data.evt_connection_opened.connection;
+      if(table_index == TABLE_INDEX_INVALID)
+      {
+        // No free slot, the scanner only connects when one is free
+        LOG_ERROR("No slot for connection %d", evt->data.evt_connection_opened.connection);
+        sl_bt_connection_close(evt->data.evt_connection_opened.connection);
+      }
+      else
+      {
+        conn_properties[table_index].setup_state = pairing;
+        conn_properties[table_index].opened_at = sl_sleeptimer_get_tick_count();
+        conn_properties[table_index].bonding = evt->data.evt_connection_opened.bonding;
+        conn_properties[table_index].known_peer = (evt->data.evt_connection_opened.bonding != SL_BT_INVALID_BONDING_HANDLE);
+        conn_properties[table_index].secured = false;
+        if(conn_properties[table_index].known_peer)
+        {
+          LOG_BONDING("Known peer, bonding 0x%02x: encrypting with the stored keys",
+                      evt->data.evt_connection_opened.bonding);
+        }
+      }
 
-      conn_state = pairing;
+      // This link pairs and discovers on its own, look for the next one meanwhile
+      if(evt->data.evt_connection_opened.connection == pending_connection)
+      {
+        pending_connection = CONNECTION_HANDLE_INVALID;
+        conn_state = running;
+        scanner_resume();
+      }
       break;
 
     // -------------------------------
@@ -388,7 +665,11 @@ void sl_bt_on_event(sl_bt_msg_t *evt)
       if (table_index != TABLE_INDEX_INVALID) 
       {
         // Save service handle for future reference
-        conn_properties[table_index].usart_service_handle = evt->data.evt_gatt_service.service;
+        if (conn_properties[table_index].gatt_cache_step == GATT_CACHE_FIND_GATT_SERVICE) {
+          conn_properties[table_index].gatt_service_handle = evt->data.evt_gatt_service.service;
+        } else {
+          conn_properties[table_index].usart_service_handle = evt->data.evt_gatt_service.service;
+        }
         LOG_DISC("Service handle was received: %d", (int)evt->data.evt_gatt_service.service);
       }
       break;
@@ -419,74 +700,143 @@ void sl_bt_on_event(sl_bt_msg_t *evt)
         break;
       }
 
-      // The service discovery was completed successfully. Start discovering characteristic
-      if(conn_state == discover_services && conn_properties[table_index].usart_service_handle != SERVICE_HANDLE_INVALID)
+      // A running link may still be filling its GATT cache entry
+      if (conn_properties[table_index].gatt_cache_step != GATT_CACHE_IDLE)
       {
-        sc = sl_bt_gatt_discover_characteristics_by_uuid(evt->data.evt_gatt_procedure_completed.connection,   // connection
-                                                        conn_properties[table_index].usart_service_handle,   // service
-                                                        sizeof(usart_char),                                  // uuid_len
-                                                        (const uint8_t*)usart_char);                         // uuid    
-        app_assert_status(sc);
-        LOG_DISC("Discovering charateristic and success");
-        conn_state = discover_characteristics;
+        gatt_cache_step_done(table_index, evt->data.evt_gatt_procedure_completed.result);
         break;
       }
 
-      // If characteristic discovery was completed successfully or failed with an error
-      // It will be join sl_bt_evt_gatt_characteristic_id event before returning this event
-      // -> enable indications
-      if(conn_state == discover_characteristics && conn_properties[table_index].usartpacket_characteristic_handle != CHARACTERISTIC_HANDLE_INVALID)
+      // Each link walks its own setup: services -> characteristic -> indications
+      switch(conn_properties[table_index].setup_state)
       {
-        LOG_DISC("Characteristic discovery was completed");
-        // stop discovering
-        sl_bt_scanner_stop();
-        sc = sl_bt_gatt_set_characteristic_notification(evt->data.evt_gatt_procedure_completed.connection,
-                                                        conn_properties[table_index].usartpacket_characteristic_handle,
-                                                        sl_bt_gatt_indication);
-        app_assert_status(sc);
-        LOG_DISC("Set indication configuration flag into this characteristic");
-        conn_state = enable_indication;
-        break;                                                        
-      }
+        // The Database Hash was read by its cached handle: enable indications
+        // right away if the remote database did not change, else discover it
+        case validate_gatt_cache:
+          if(evt->data.evt_gatt_procedure_completed.result == SL_STATUS_OK
+             && app_gatt_cache_validate(conn_properties[table_index].server_address,
+                                        conn_properties[table_index].server_address_type,
+                                        conn_properties[table_index].db_hash,
+                                        conn_properties[table_index].db_hash_len))
+          {
+            sc = sl_bt_gatt_set_characteristic_notification(evt->data.evt_gatt_procedure_completed.connection,
+                                                            conn_properties[table_index].usartpacket_characteristic_handle,
+                                                            sl_bt_gatt_indication);
+            app_assert_status(sc);
+            LOG_DISC("Cached handles still valid, discovery skipped");
+            conn_properties[table_index].handles_from_cache = true;
+            conn_properties[table_index].setup_state = enable_indication;
+            break;
+          }
+          // Hash changed or unreadable: forget the peer and discover again
+          app_gatt_cache_forget(conn_properties[table_index].server_address,
+                                conn_properties[table_index].server_address_type);
+          LOG_DISC("Cached handles are stale, full discovery");
+          conn_properties[table_index].usart_service_handle = SERVICE_HANDLE_INVALID;
+          conn_properties[table_index].usartpacket_characteristic_handle = CHARACTERISTIC_HANDLE_INVALID;
+          conn_properties[table_index].db_hash_handle = CHARACTERISTIC_HANDLE_INVALID;
+          sc = sl_bt_gatt_discover_primary_services_by_uuid(evt->data.evt_gatt_procedure_completed.connection,
+                                                            sizeof(usart_service),
+                                                            (const uint8_t *)usart_service);
+          app_assert_status(sc);
+          conn_properties[table_index].setup_state = discover_services;
+          break;
 
-      // If enabling indication finish, connect to other devices
-      if(conn_state == enable_indication)
-      {
-        if(active_connections_num < SL_BT_CONFIG_MAX_CONNECTIONS)
-        {
-          LOG_CONN("Active connection number %d\r\nStart scanning other devices", active_connections_num);
+        // The service discovery was completed. Start discovering characteristic
+        case discover_services:
+          if(conn_properties[table_index].usart_service_handle == SERVICE_HANDLE_INVALID)
+          {
+            link_setup_failed(table_index, "usart service not found");
+            break;
+          }
+          sc = sl_bt_gatt_discover_characteristics_by_uuid(evt->data.evt_gatt_procedure_completed.connection,   // connection
+                                                          conn_properties[table_index].usart_service_handle,   // service
+                                                          sizeof(usart_char),                                  // uuid_len
+                                                          (const uint8_t*)usart_char);                         // uuid
+          app_assert_status(sc);
+          LOG_DISC("Discovering charateristic and success");
+          conn_properties[table_index].setup_state = discover_characteristics;
+          break;
 
-          sc = sl_bt_scanner_start(sl_bt_scanner_scan_phy_1m,
-                                  sl_bt_scanner_discover_generic);
-          app_assert_status_f(sc, ">Failed to start discovery #2" APP_LOG_NL);
-          conn_state = scanning;
-        }
-        else
-        {
-          conn_state = running;
-        }
-        break;
+        // If characteristic discovery was completed successfully or failed with an error
+        // It will be join sl_bt_evt_gatt_characteristic_id event before returning this event
+        // -> enable indications
+        case discover_characteristics:
+          if(conn_properties[table_index].usartpacket_characteristic_handle == CHARACTERISTIC_HANDLE_INVALID)
+          {
+            link_setup_failed(table_index, "usart characteristic not found");
+            break;
+          }
+          LOG_DISC("Characteristic discovery was completed");
+          sc = sl_bt_gatt_set_characteristic_notification(evt->data.evt_gatt_procedure_completed.connection,
+                                                          conn_properties[table_index].usartpacket_characteristic_handle,
+                                                          sl_bt_gatt_indication);
+          app_assert_status(sc);
+          LOG_DISC("Set indication configuration flag into this characteristic");
+          conn_properties[table_index].setup_state = enable_indication;
+          break;
+
+        // Enabling indication finished, the link is up
+        case enable_indication:
+          if(evt->data.evt_gatt_procedure_completed.result != SL_STATUS_OK)
+          {
+            link_setup_failed(table_index, "indications not enabled");
+            break;
+          }
+          conn_properties[table_index].setup_state = running;
+          link_ready(table_index);
+          if(!conn_properties[table_index].handles_from_cache)
+          {
+            // Find the Database Hash now that data flows, for the next connection
+            sc = sl_bt_gatt_discover_primary_services_by_uuid(evt->data.evt_gatt_procedure_completed.connection,
+                                                              sizeof(generic_attribute_service),
+                                                              generic_attribute_service);
+            if(sc == SL_STATUS_OK)
+            {
+              conn_properties[table_index].gatt_service_handle = SERVICE_HANDLE_INVALID;
+              conn_properties[table_index].gatt_cache_step = GATT_CACHE_FIND_GATT_SERVICE;
+            }
+          }
+          break;
+
+        default:
+          break;
       }
       break;
 
     // -------------------------------
     // This event indicates that a connection was closed.
     case sl_bt_evt_connection_closed_id:
-      sc = sl_bt_sm_delete_bondings();
-      app_assert_status(sc);
-      LOG_BONDING("[SECURITY] All bonding deleted\r\n");
+      app_bond_store_on_closed();
 
       // remove connection from active connections
       remove_connection(evt->data.evt_connection_closed.connection);
+      // Its passkey prompt, if shown, will not be answered: show the next one
+      if(state == PROMPT_YESNO && evt->data.evt_connection_closed.connection == temp_connec_handle)
+      {
+        temp_connec_handle = CONNECTION_HANDLE_INVALID;
+        state = IDLE;
+        passkey_prompt_next();
+      }
       LOG_CONN(">Connection is CLOSE. Active connections: %d\r\n", active_connections_num);
-      if (conn_state != scanning) 
+      if(active_connections_num == 0)
+      {
+        fleet_setup.reported = false;
+      }
+      if(evt->data.evt_connection_closed.connection == pending_connection)
       {
-        // start scanning again to find new devices
-        sc = sl_bt_scanner_start(sl_bt_scanner_scan_phy_1m,
-                                 sl_bt_scanner_discover_generic);
-        app_assert_status_f(sc, ">Failed to start discovery #3" APP_LOG_NL);
-        LOG_SCANN(">RESTART scanning\r\n");
-        conn_state = scanning;
+        // The connection request failed
+        pending_connection = CONNECTION_HANDLE_INVALID;
+        conn_state = running;
+      }
+      if (conn_state == running) 
+      {
+        // start scanning again to find new devices, a slot is free
+        scanner_resume();
+        if (conn_state == scanning)
+        {
+          LOG_SCANN(">RESTART scanning\r\n");
+        }
       }
       break;
 
@@ -500,22 +850,98 @@ void sl_bt_on_event(sl_bt_msg_t *evt)
         break;
       }
 
+      // Database Hash read for the GATT cache, not usart data
+      if(evt->data.evt_gatt_characteristic_value.att_opcode == sl_bt_gatt_read_response
+         || evt->data.evt_gatt_characteristic_value.att_opcode == sl_bt_gatt_read_by_type_response)
+      {
+        conn_properties_t *conn = &conn_properties[table_index];
+        uint8_t len = evt->data.evt_gatt_characteristic_value.value.len;
+
+        if(len > APP_GATT_CACHE_HASH_LEN)
+        {
+          len = APP_GATT_CACHE_HASH_LEN;
+        }
+        memcpy(conn->db_hash, evt->data.evt_gatt_characteristic_value.value.data, len);
+        conn->db_hash_len = len;
+        if(evt->data.evt_gatt_characteristic_value.att_opcode == sl_bt_gatt_read_by_type_response)
+        {
+          conn->db_hash_handle = evt->data.evt_gatt_characteristic_value.characteristic;
+        }
+        break;
+      }
+
+      if(!conn_properties[table_index].first_data_seen)
+      {
+        conn_properties[table_index].first_data_seen = true;
+        LOG_STATS("Time to first data: link %d, %lu ms after connection (%s)",
+                  (int)conn_properties[table_index].connection_handle,
+                  (unsigned long)sl_sleeptimer_tick_to_ms(sl_sleeptimer_get_tick_count()
+                                                          - conn_properties[table_index].opened_at),
+                  conn_properties[table_index].handles_from_cache ? "cached handles" : "full discovery");
+        app_gatt_cache_log_stats();
+      }
+
       if(evt->data.evt_gatt_characteristic_value.value.len > 0)
       {
+        conn_properties_t *conn = &conn_properties[table_index];
         uint8_t *data = evt->data.evt_gatt_characteristic_value.value.data;
         uint8_t len = evt->data.evt_gatt_characteristic_value.value.len;
-        
+
+        // Where a first fragment is due, the Peripheral may send a credit frame
+        // instead (ble_defragment_rxdata.h): the writes it can take again
+        if(conn->rx_message_left == 0)
+        {
+          if(len == DEFRAG_CREDIT_LEN && data[0] == DEFRAG_CREDIT_TAG)
+          {
+            frag_tx_add_credits(table_index, data[1]);
+            sc = sl_bt_gatt_send_characteristic_confirmation(evt->data.evt_gatt_characteristic_value.connection);
+            app_assert_status(sc);
+            break;
+          }
+          // [length | payload | checksum] over one or more fragments
+          conn->rx_message_left = (uint16_t)(data[0] + 2);
+        }
+        conn->rx_message_left = (len < conn->rx_message_left) ? (uint16_t)(conn->rx_message_left - len) : 0;
+
+        rx_flow.fragments_received++;
+        APP_TRACE("value conn %u, %u bytes, opcode 0x%02x",
+                  evt->data.evt_gatt_characteristic_value.connection, len,
+                  evt->data.evt_gatt_characteristic_value.att_opcode);
+
         // Print and process Input data
-        if(defrag_push_data(data, len))
+        if(defrag_can_push(table_index) && defrag_push_data(table_index, data, len))
         {
           LOG_CONN("DONE PUSH data");
           indi_state = handle_rxdata;
         }
+        else if(evt->data.evt_gatt_characteristic_value.att_opcode == sl_bt_gatt_handle_value_indication
+                && len <= QUEUE_SLOT_SIZE)
+        {
+          // No room: park the fragment and hold back the confirmation. The server
+          // cannot send its next indication before we confirm, so it slows down
+          // to our pace instead of overrunning its queue.
+          memcpy(conn_properties[table_index].withheld_fragment, data, len);
+          conn_properties[table_index].withheld_len = len;
+          conn_properties[table_index].withheld_at = sl_sleeptimer_get_tick_count();
+          rx_flow.confirmations_withheld++;
+          APP_TRACE("confirmation withheld, conn %u", evt->data.evt_gatt_characteristic_value.connection);
+          LOG_CONN("RX queue of link slot %d full, confirmation withheld", (int)table_index);
+          break;
+        }
+        else
+        {
+          rx_flow.fragments_dropped++;
+          LOG_WARN("Fragment dropped (%lu so far)", (unsigned long)rx_flow.fragments_dropped);
+        }
       }
 
-      sc = sl_bt_gatt_send_characteristic_confirmation(evt->data.evt_gatt_characteristic_value.connection);
-      app_assert_status(sc);
-      LOG_CONN("Send an indication confirmation");
+      // Only indications expect a confirmation
+      if(evt->data.evt_gatt_characteristic_value.att_opcode == sl_bt_gatt_handle_value_indication)
+      {
+        sc = sl_bt_gatt_send_characteristic_confirmation(evt->data.evt_gatt_characteristic_value.connection);
+        app_assert_status(sc);
+        LOG_CONN("Send an indication confirmation");
+      }
       break;
     
     // -------------------------------
@@ -539,6 +965,19 @@ void sl_bt_on_event(sl_bt_msg_t *evt)
         default:
           break;
       }
+
+      // Encryption with stored keys raises no bonded event: a known peer
+      // starts its setup as soon as the link is encrypted
+      table_index = find_index_by_connection_handle(evt->data.evt_connection_parameters.connection);
+      if(table_index != TABLE_INDEX_INVALID
+         && evt->data.evt_connection_parameters.security_mode != sl_bt_connection_mode1_level1)
+      {
+        link_secured(table_index);
+        if(conn_properties[table_index].known_peer)
+        {
+          start_link_setup(table_index);
+        }
+      }
       break;
 
     // -------------------------------
@@ -565,13 +1004,22 @@ void sl_bt_on_event(sl_bt_msg_t *evt)
     // Identifier of the confirm_passkey event
     case sl_bt_evt_sm_confirm_passkey_id:
       LOG_PAIRING("Passkey confirmation event received");
-      passkey = evt->data.evt_sm_confirm_passkey.passkey;  //CORRECT EVENT DATA
-
-      // Enable button service for user input
-      app_button_pairing_enable();
-
-      state = PROMPT_YESNO;
-      refresh_display();
+      table_index = find_index_by_connection_handle(evt->data.evt_sm_confirm_passkey.connection);
+      if (table_index == TABLE_INDEX_INVALID)
+      {
+        break;
+      }
+      // Links pair in parallel: each request waits in its slot and the
+      // button answers them one at a time, oldest first
+      conn_properties[table_index].passkey_value = evt->data.evt_sm_confirm_passkey.passkey;  //CORRECT EVENT DATA
+      conn_properties[table_index].passkey_order = passkey_request_count++;
+      conn_properties[table_index].passkey_pending = true;
+      if (state == PROMPT_YESNO || state == PROMPT_CONFIRM_PASSKEY)
+      {
+        LOG_PAIRING("Passkey of link slot %u queued behind the current prompt", table_index);
+        break;
+      }
+      passkey_prompt_next();
       break;
 
     // -------------------------------
@@ -579,61 +1027,117 @@ void sl_bt_on_event(sl_bt_msg_t *evt)
     case sl_bt_evt_sm_bonded_id:
       LOG_BONDING("Bond success, bonding handle 0x%02x", evt->data.evt_sm_bonded.bonding);
 
-      //  * Discover primary services with the specified UUID in a remote GATT database.
-      //  * This command generates unique gatt_service event for every discovered primary
-      //  * service. Received @ref sl_bt_evt_gatt_procedure_completed event indicates
-      //  * that this GATT procedure was successfully completed or failed with an error.
-      sc = sl_bt_gatt_discover_primary_services_by_uuid(evt->data.evt_sm_bonded.connection,
-                                                        sizeof(usart_service),
-                                                        (const uint8_t *)usart_service);
-      if (sc == SL_STATUS_INVALID_HANDLE) 
-      {       
-        // Not found service with given UUID      
-        // Failed to open connection, restart scanning  
-        LOG_DISC(">Primary service discovery failed with invalid handle, dropping client");
-        sc = sl_bt_connection_close(evt->data.evt_sm_bonded.connection);
-        LOG_DISC("Close connection");
-
-        sc = sl_bt_scanner_start(sl_bt_gap_phy_1m, sl_bt_scanner_discover_generic);
-        app_assert_status(sc);
-        conn_state = scanning;
-        break;
-      } 
-      else 
+      table_index = find_index_by_connection_handle(evt->data.evt_sm_bonded.connection);
+      if (table_index == TABLE_INDEX_INVALID) 
       {
-        app_assert_status(sc);
-        LOG_DISC("-> Confirm the existence of my service in remote GATT database");
-      } 
+        break;
+      }
+      conn_properties[table_index].bonding = evt->data.evt_sm_bonded.bonding;
+      link_secured(table_index);
+      start_link_setup(table_index);
 
       state = BOND_SUCCESS;
-      conn_state = discover_services;
       refresh_display();
+      // Another link may still wait for its confirmation
+      passkey_prompt_next();
       break;
 
     // Bonding failed, not affect the connection and exchange
     case sl_bt_evt_sm_bonding_failed_id:
       LOG_BONDING("Bonding failed, reason 0x%2X",
                 evt->data.evt_sm_bonding_failed.reason);
+      // The peer lost or revoked its keys: forget ours, the next connection pairs again
+      table_index = find_index_by_connection_handle(evt->data.evt_sm_bonding_failed.connection);
+      if(table_index != TABLE_INDEX_INVALID && conn_properties[table_index].known_peer
+         && evt->data.evt_sm_bonding_failed.reason == SL_STATUS_BT_CTRL_PIN_OR_KEY_MISSING)
+      {
+        app_bond_store_revoke(conn_properties[table_index].bonding);
+      }
       sc = sl_bt_connection_close(evt->data.evt_sm_bonding_failed.connection);
       LOG_BONDING("CLOSE connection");
 
       state = BOND_FAILURE;
       refresh_display();
+      passkey_prompt_next();
       break;
 
     case sl_bt_evt_system_external_signal_id:
       // Handle external signals
-      if(evt->data.evt_system_external_signal.extsignals == PROMPT_CONFIRM_PASSKEY)
+      if(evt->data.evt_system_external_signal.extsignals & LINK_QUALITY_SIGNAL)
+      {
+        link_quality_sample();
+      }
+      if(evt->data.evt_system_external_signal.extsignals & STATS_REPORT_SIGNAL)
+      {
+        stats_report();
+      }
+      if((evt->data.evt_system_external_signal.extsignals & ~(LINK_QUALITY_SIGNAL | STATS_REPORT_SIGNAL))
+         == PROMPT_CONFIRM_PASSKEY)
       {
         // Disable button service after user input
         // app_button_pairing_disable();
 
-        LOG_PAIRING("User prompted to enter passkey: %lu", passkey);
-        sc = sl_bt_sm_passkey_confirm(temp_connec_handle, 1);
-        if(sc == SL_STATUS_OK)
+        // The prompted link may have closed meanwhile
+        table_index = find_index_by_connection_handle(temp_connec_handle);
+        if(table_index != TABLE_INDEX_INVALID && conn_properties[table_index].passkey_pending)
         {
-          LOG_PAIRING("Passkey confirmed");
+          LOG_PAIRING("User prompted to enter passkey: %lu", passkey);
+          conn_properties[table_index].passkey_pending = false;
+          sc = sl_bt_sm_passkey_confirm(temp_connec_handle, 1);
+          if(sc == SL_STATUS_OK)
+          {
+            LOG_PAIRING("Passkey confirmed");
+          }
         }
+        temp_connec_handle = CONNECTION_HANDLE_INVALID;
+        state = IDLE;
+        passkey_prompt_next();
+      }
+      break;
+
+    // -------------------------------
+    // Answer of sl_bt_connection_get_rssi(), one per sampled link
+    case sl_bt_evt_connection_rssi_id:
+      table_index = find_index_by_connection_handle(evt->data.evt_connection_rssi.connection);
+      if(table_index == TABLE_INDEX_INVALID || evt->data.evt_connection_rssi.status != 0)
+      {
+        break;
+      }
+      conn_properties[table_index].rssi = evt->data.evt_connection_rssi.rssi;
+      if(app_link_quality_add_sample(&conn_properties[table_index].link_quality,
+                                     evt->data.evt_connection_rssi.rssi))
+      {
+        link_quality_changed(table_index);
+      }
+      break;
+
+    // -------------------------------
+    // LE Power Control reports, enabled per link by link_quality_start()
+    case sl_bt_evt_connection_tx_power_id:
+      table_index = find_index_by_connection_handle(evt->data.evt_connection_tx_power.connection);
+      if(table_index != TABLE_INDEX_INVALID)
+      {
+        conn_properties[table_index].tx_power = evt->data.evt_connection_tx_power.power_level;
+      }
+      break;
+
+    case sl_bt_evt_connection_remote_tx_power_id:
+      table_index = find_index_by_connection_handle(evt->data.evt_connection_remote_tx_power.connection);
+      if(table_index != TABLE_INDEX_INVALID)
+      {
+        conn_properties[table_index].remote_tx_power = evt->data.evt_connection_remote_tx_power.power_level;
+      }
+      break;
+
+    // -------------------------------
+    // The PHY of a link changed, on request of link_quality_changed() or of the peer
+    case sl_bt_evt_connection_phy_status_id:
+      table_index = find_index_by_connection_handle(evt->data.evt_connection_phy_status.connection);
+      if(table_index != TABLE_INDEX_INVALID)
+      {
+        conn_properties[table_index].phy = evt->data.evt_connection_phy_status.phy;
+        LOG_CONN("Link %d on PHY 0x%02x", (int)conn_properties[table_index].connection_handle,
+                 evt->data.evt_connection_phy_status.phy);
       }
       break;
 
@@ -650,24 +1154,47 @@ void sl_bt_on_event(sl_bt_msg_t *evt)
  * This function resets the internal `conn_properties` table to a known
  * default state and sets the active connection count to zero. Each entry is
  * initialized so callers can reliably check for `CONNECTION_HANDLE_INVALID`
- * to find free slots. Call once at startup and after major state resets.
+ * to find free slots, every slot goes to the free list and no handle is
+ * mapped. Call once at startup and after major state resets.
  */
 static void init_properties(void)
 {
   uint8_t i;
   active_connections_num = 0;
 
-  for (i = 0; i < SL_BT_CONFIG_MAX_CONNECTIONS; i++) {
-    conn_properties[i].connection_handle = CONNECTION_HANDLE_INVALID;
-    conn_properties[i].usart_service_handle = SERVICE_HANDLE_INVALID;
-    conn_properties[i].usartpacket_characteristic_handle = CHARACTERISTIC_HANDLE_INVALID;
-    conn_properties[i].rssi = SL_BT_CONNECTION_RSSI_UNAVAILABLE;    // in sl_bt_api.h file          
-    conn_properties[i].power_control_active = TX_POWER_CONTROL_INACTIVE;
-    conn_properties[i].tx_power = TX_POWER_INVALID;
-    conn_properties[i].remote_tx_power = TX_POWER_INVALID;
+  memset(slot_by_handle, TABLE_INDEX_INVALID, sizeof(slot_by_handle));
+  free_slot_count = 0;
+  // Highest slot pushed first, so slot 0 is taken first
+  for (i = SL_BT_CONFIG_MAX_CONNECTIONS; i > 0; i--) {
+    clear_slot(i - 1);
+    free_slots[free_slot_count++] = i - 1;
   }
 }
 
+/**
+ * @brief Reset a slot of the `conn_properties` table to its free state.
+ *
+ * @param[in] table_index Index of the slot in `conn_properties`
+ */
+static void clear_slot(uint8_t table_index)
+{
+  conn_properties_t *conn = &conn_properties[table_index];
+
+  conn->connection_handle = CONNECTION_HANDLE_INVALID;
+  conn->usart_service_handle = SERVICE_HANDLE_INVALID;
+  conn->usartpacket_characteristic_handle = CHARACTERISTIC_HANDLE_INVALID;
+  conn->rssi = SL_BT_CONNECTION_RSSI_UNAVAILABLE;    // in sl_bt_api.h file
+  conn->power_control_active = false;
+  conn->tx_power = TX_POWER_INVALID;
+  conn->remote_tx_power = TX_POWER_INVALID;
+  conn->withheld_len = 0;
+  conn->rx_message_left = 0;
+  conn->passkey_pending = false;
+  conn->setup_state = opening;
+  conn->phy = sl_bt_gap_phy_1m;
+  app_link_quality_reset(&conn->link_quality);
+}
+
 /**
  * @brief Function to Read and Cache Bluetooth Address.
  * 
@@ -722,116 +1249,739 @@ void printf_bluetooth_address(void)
 }
 
 /**
- * @brief Scan an advertisement packet's AD structures for known service UUIDs.
+ * @brief Configure the scanner front-end with the service UUID to connect to.
  *
- * @param[in] data Pointer to the advertisement payload (AD structures)
- * @param[in] len  Length of the advertisement payload in bytes
- * @return `SL_STATUS_OK` if a matching UUID is found, `SL_STATUS_FAIL` otherwise
+ * Only `usart_service` is wanted: the bonded connection is dropped when the
+ * remote GATT database does not have it.
  */
-static sl_status_t find_service_in_advertisement(uint8_t *data, uint8_t len)
-{
-  // Information of advertised data (AD structure)
-  uint8_t ad_field_length;  // length 1Byte
-  uint8_t ad_field_type;    // type 1Byte
-  uint8_t i = 0;
-  // Parse advertisement packet
-  // LOG_INFO("Len adv packet %d", (int)len);
-  while (i < len) 
-  {
-    ad_field_length = data[i];
-    ad_field_type = data[i + 1];
+static void scan_filter_init(void)
+{
+  app_scan_filter_config_t config = {
+    .uuids128 = &usart_service,
+    .uuid128_count = 1,
+    .uuids16 = NULL,
+    .uuid16_count = 0,
+    .rssi_min = SCAN_RSSI_MIN,
+  };
 
-    if(ad_field_type == 0x06 || ad_field_type == 0x07)    //ad_field_type == 0x02 || ad_field_type == 0x03 ||
-    {
-      if(memcmp(&data[i+2], current_time_service, 2) == 0)
-      {
-        return SL_STATUS_OK;
-      }
-      else if (memcmp(&data[i+2], usart_service, 16) == 0)
-      {
-        LOG_SCANN("Found my service's UUID");
-        return SL_STATUS_OK;
-      }
-    }
-    // advance to the next AD struct
-    i = i + ad_field_length + 1;
-    // sl_sleeptimer_delay_millisecond(10);
+  if(!app_scan_filter_init(&config))
+  {
+    LOG_ERROR("Scan filter configuration rejected");
   }
-
-  return SL_STATUS_FAIL;
 }
 
 /**
  * @brief Find the table index for a given connection handle.
  *
- * Searches the active portion of the `conn_properties` table for an entry
- * whose `connection_handle` matches the input. If found, returns the index
- * (0..active_connections_num-1). If no matching entry exists, returns
- * `TABLE_INDEX_INVALID`.
+ * Constant time: the handle indexes `slot_by_handle` directly, whatever
+ * `SL_BT_CONFIG_MAX_CONNECTIONS` is. Called on every GATT event, including
+ * each received indication.
  *
  * @param connection Connection handle to look up
  * @return Index in `conn_properties` if found, otherwise `TABLE_INDEX_INVALID`
  */
 static uint8_t find_index_by_connection_handle(uint8_t connection)
 {
-  // i will be adapt active_connections_num
-  for (uint8_t i = 0; i < active_connections_num; i++) 
-  {
-    if (conn_properties[i].connection_handle == connection) 
-    {
-      return i;
-    }
-  }
-  return TABLE_INDEX_INVALID;
+  return slot_by_handle[connection];
 }
 
 /**
  * @brief Add a new active connection to the `conn_properties` table.
  *
- * Note: The caller must ensure `active_connections_num < SL_BT_CONFIG_MAX_CONNECTIONS`
- * before calling this function. The implementation does not perform bounds
- * checks and will overwrite memory if the caller violates this contract.
+ * Takes a slot from the free list and maps the handle to it. The slot keeps
+ * its index until the connection is removed, so an index held across events
+ * stays valid for the lifetime of the connection.
  *
- * @param[in] connection The connection handle assigned by the stack
- * @param[in] address    Pointer to a 6-byte Bluetooth address (LSB-first ordering)
+ * @param[in] connection   The connection handle assigned by the stack
+ * @param[in] address      Pointer to a 6-byte Bluetooth address (LSB-first ordering)
+ * @param[in] address_type Address type reported with the connection
+ * @return Index of the slot, or `TABLE_INDEX_INVALID` if every slot is used
+ *         or the handle is already mapped
  */
-static void add_connection(uint8_t connection, uint8_t *address)
+static uint8_t add_connection(uint8_t connection, uint8_t *address, uint8_t address_type)
 {
-  conn_properties[active_connections_num].connection_handle = connection;
-  memcpy(conn_properties[active_connections_num].server_address, address, 6);
+  uint8_t table_index;
+  conn_properties_t *conn;
+
+  if (free_slot_count == 0 || slot_by_handle[connection] != TABLE_INDEX_INVALID) {
+    return TABLE_INDEX_INVALID;
+  }
+  table_index = free_slots[--free_slot_count];
+  slot_by_handle[connection] = table_index;
+
+  conn = &conn_properties[table_index];
+  conn->connection_handle = connection;
+  memcpy(conn->server_address, address, 6);
+  conn->server_address_type = address_type;
+  conn->handles_from_cache = false;
+  conn->first_data_seen = false;
+  conn->gatt_cache_step = GATT_CACHE_IDLE;
+  conn->db_hash_handle = CHARACTERISTIC_HANDLE_INVALID;
+  conn->db_hash_len = 0;
   active_connections_num++;
+  return table_index;
 }
 
 /**
- * @brief Remove an active connection and compact the table.
+ * @brief Remove an active connection and return its slot to the free list.
+ *
+ * The other connections keep their slots.
  *
  * @param[in] connection Connection handle to remove
  */
 static void remove_connection(uint8_t connection)
 {
-  uint8_t i;
   uint8_t table_index = find_index_by_connection_handle(connection);
 
-  if (active_connections_num > 0) 
+  // A failed connection request was never added
+  if (table_index == TABLE_INDEX_INVALID) 
   {
-    active_connections_num--;
+    return;
   }
-  // Shift entries after the removed connection toward 0 index
-  for (i = table_index; i < active_connections_num; i++) 
-  {
-    conn_properties[i] = conn_properties[i + 1];
+  slot_by_handle[connection] = TABLE_INDEX_INVALID;
+  // Fragments of the closed link would never complete or be sent
+  defrag_flush_link(table_index);
+  frag_tx_flush_link(table_index);
+  clear_slot(table_index);
+  free_slots[free_slot_count++] = table_index;
+  active_connections_num--;
+}
+
+/**
+ * @brief Queue parked fragments and send the confirmations held back for them.
+ *
+ * A fragment is parked by the characteristic value handler when the RX queue
+ * of its link is full. As soon as that queue has room again the fragment is
+ * pushed and its indication is confirmed, which lets that server send its
+ * next fragment. Each connection has at most one parked fragment.
+ *
+ * The queue only drains while the UART egress can take payloads, so a host
+ * holding CTS stalls it. A confirmation withheld for `RX_WITHHOLD_MAX_MS`
+ * is sent anyway, before the server's ATT transaction timeout closes the
+ * link: its fragment is dropped and counted as expired, and the payload it
+ * belonged to is lost instead of the whole link.
+ */
+static void send_withheld_confirmations(void)
+{
+  sl_status_t sc;
+  uint32_t now = sl_sleeptimer_get_tick_count();
+
+  // Free slots never hold a fragment
+  for (uint8_t i = 0; i < SL_BT_CONFIG_MAX_CONNECTIONS; i++) {
+    conn_properties_t *conn = &conn_properties[i];
+
+    if (conn->withheld_len == 0) {
+      continue;
+    }
+
+    if (defrag_can_push(i)) {
+      if (defrag_push_data(i, conn->withheld_fragment, conn->withheld_len)) {
+        indi_state = handle_rxdata;
+      } else {
+        rx_flow.fragments_dropped++;
+      }
+    } else if (now - conn->withheld_at >= sl_sleeptimer_ms_to_tick(RX_WITHHOLD_MAX_MS)) {
+      rx_flow.confirmations_expired++;
+      rx_flow.fragments_dropped++;
+      LOG_WARN("RX queue of link slot %u stalled %u ms, fragment dropped to confirm (%lu so far)",
+               i, (unsigned int)RX_WITHHOLD_MAX_MS, (unsigned long)rx_flow.confirmations_expired);
+    } else {
+      continue;
+    }
+    conn->withheld_len = 0;
+
+    sc = sl_bt_gatt_send_characteristic_confirmation(conn->connection_handle);
+    app_assert_status(sc);
+    LOG_CONN("Send a withheld indication confirmation");
   }
-  // Clear the slots we've just removed so no junk values appear
-  for (i = active_connections_num; i < SL_BT_CONFIG_MAX_CONNECTIONS; i++) 
-  {
-    conn_properties[i].connection_handle = CONNECTION_HANDLE_INVALID;
-    conn_properties[i].usart_service_handle = SERVICE_HANDLE_INVALID;
-    conn_properties[i].usartpacket_characteristic_handle = CHARACTERISTIC_HANDLE_INVALID;
-    conn_properties[i].rssi = SL_BT_CONNECTION_RSSI_UNAVAILABLE;
-    conn_properties[i].power_control_active = TX_POWER_CONTROL_INACTIVE;
-    conn_properties[i].tx_power = TX_POWER_INVALID;
-    conn_properties[i].remote_tx_power = TX_POWER_INVALID;
+}
+
+/**
+ * @brief Size of the oldest fragment queued for a link (app_drr_head_fn_t).
+ *
+ * @param[in] ctx         Unused
+ * @param[in] table_index Slot of the link in `conn_properties`
+ * @return Fragment length in bytes, 0 if the link's queue is empty
+ */
+static uint16_t rx_head_len(void *ctx, uint8_t table_index)
+{
+  (void)ctx;
+  return defrag_head_len(table_index);
+}
+
+/**
+ * @brief Reassemble the oldest fragment queued for a link (app_drr_serve_fn_t).
+ *
+ * @param[in] ctx         Unused
+ * @param[in] table_index Slot of the link in `conn_properties`
+ * @return false if the fragment stays queued because every completion
+ *         buffer is held, true once it was consumed
+ */
+static bool rx_serve_fragment(void *ctx, uint8_t table_index)
+{
+  uint8_t queued = defrag_link_queued_fragments(table_index);
+  uint32_t start = app_cycle_counter_now();
+  defrag_enum_t rx_data_state = defrag_process_fragment(table_index);
+
+  (void)ctx;
+  if (defrag_link_queued_fragments(table_index) == queued) {
+    return false;
+  }
+  app_cycle_stats_add(&fragment_cycles, start);
+
+  if (rx_data_state == DEFRAG_COMPLETE) {
+    LOG_DEBUG("->Payload completed on link slot %d, reassembly ready for the next message",
+              (int)table_index);
+  } else if (rx_data_state == DEFRAG_ERROR) {
+    LOG_ERROR("Defragmentation error, link slot %d", (int)table_index);
+    defrag_reset(table_index);
+  }
+  return true;
+}
+
+/**
+ * @brief Queue a line or binary frame from the host for the Peripherals.
+ *
+ * The payload is written to the `usart_packet` characteristic of every link
+ * that finished its setup, as write without response fragments
+ * (`ble_fragment_txdata.h`). It is fragmented once and the fragments are
+ * shared by the links, each link sends them at its own pace. Without a
+ * ready link the payload is dropped.
+ *
+ * @param[in] line     Line or binary frame payload
+ * @param[in] len      Its length in bytes
+ * @param[in] is_frame true for a binary frame
+ * @return SL_STATUS_FULL if a link's TX queue is full and the payload should
+ *         be offered again, otherwise the payload was queued or dropped
+ */
+static sl_status_t send_uart_input(uint8_t *line, size_t len, bool is_frame)
+{
+  frag_tx_dest_t dests[SL_BT_CONFIG_MAX_CONNECTIONS];
+  uint8_t dest_count = 0;
+  sl_status_t sc;
+
+  for (uint8_t i = 0; i < SL_BT_CONFIG_MAX_CONNECTIONS; i++) {
+    if (conn_properties[i].setup_state != running) {
+      continue;
+    }
+    dests[dest_count].link = i;
+    dests[dest_count].connection = conn_properties[i].connection_handle;
+    dests[dest_count].characteristic = conn_properties[i].usartpacket_characteristic_handle;
+    dest_count++;
+  }
+  if (dest_count == 0) {
+    LOG_WARN("No Peripheral ready, UART input dropped");
+    return SL_STATUS_NOT_READY;
+  }
+
+  sc = frag_tx_prepare_broadcast(dests, dest_count, line, len);
+  if (sc == SL_STATUS_FULL) {
+    return sc;
+  }
+  if (is_frame) {
+    LOG_INFO("UART input: %u bytes binary frame to %u links", (unsigned int)len, dest_count);
+  } else {
+    LOG_INFO("UART input: %u bytes to %u links: %s", (unsigned int)len, dest_count, (char *)line);
+  }
+  if (sc != SL_STATUS_OK) {
+    LOG_WARN("UART input dropped, 0x%04lx", (unsigned long)sc);
+  }
+  return sc;
+}
+
+/**
+ * @brief Start the scanner again if a connection slot is free.
+ *
+ * Called when a connection request ends (link open or failed) and when a
+ * link closes. Links still pairing or discovering do not hold the scanner:
+ * only the connection request itself is serialized.
+ */
+static void scanner_resume(void)
+{
+  sl_status_t sc;
+
+  if (conn_state != running || active_connections_num >= SL_BT_CONFIG_MAX_CONNECTIONS) {
+    return;
+  }
+
+  if (active_connections_num == 0) {
+    fleet_setup.start = sl_sleeptimer_get_tick_count();
+  }
+  LOG_CONN("Active connection number %d\r\nStart scanning other devices", active_connections_num);
+  sc = sl_bt_scanner_start(sl_bt_scanner_scan_phy_1m,
+                           sl_bt_scanner_discover_generic);
+  app_assert_status_f(sc, ">Failed to start discovery #2" APP_LOG_NL);
+  conn_state = scanning;
+  scan_started_at = sl_sleeptimer_get_tick_count();
+}
+
+/**
+ * @brief Tell whether to hold back a matching Peripheral for now.
+ *
+ * A Peripheral advertising a status without pending data waits until
+ * `SCAN_IDLE_HOLD_MS` after the scanner started, so the connection slots
+ * and the single pending connection request go first to Peripherals that
+ * have data to send. A Peripheral without a status (older firmware) is not
+ * held back.
+ *
+ * @param[in] data Advertising data of the report
+ * @param[in] len  Its length in bytes
+ * @return true to skip this report
+ */
+static bool scan_defer_idle(const uint8_t *data, size_t len)
+{
+  app_adv_status_t status;
+
+  if (!app_adv_status_parse(data, len, &status)) {
+    return false;
+  }
+  LOG_SCANN("Peripheral status: flags 0x%02x, %u bytes queued, battery %u, sequence %u",
+            status.flags, status.queued_bytes, status.battery, status.sequence);
+
+  if ((status.flags & APP_ADV_STATUS_FLAG_PENDING) != 0
+      || sl_sleeptimer_get_tick_count() - scan_started_at
+         >= sl_sleeptimer_ms_to_tick(SCAN_IDLE_HOLD_MS)) {
+    return false;
+  }
+
+  scan_idle_deferred++;
+  LOG_SCANN("Idle Peripheral held back (%lu so far)", (unsigned long)scan_idle_deferred);
+  return true;
+}
+
+/**
+ * @brief Slot of the oldest passkey confirmation request still unanswered.
+ *
+ * @return Index in `conn_properties`, TABLE_INDEX_INVALID if none
+ */
+static uint8_t oldest_passkey_request(void)
+{
+  uint8_t oldest = TABLE_INDEX_INVALID;
+
+  for (uint8_t i = 0; i < SL_BT_CONFIG_MAX_CONNECTIONS; i++) {
+    if (!conn_properties[i].passkey_pending) {
+      continue;
+    }
+    // Signed difference: correct across a wrap of the counter
+    if (oldest == TABLE_INDEX_INVALID
+        || (int32_t)(conn_properties[i].passkey_order - conn_properties[oldest].passkey_order) < 0) {
+      oldest = i;
+    }
+  }
+  return oldest;
+}
+
+/**
+ * @brief Prompt the user for the oldest unanswered passkey.
+ *
+ * Numeric Comparison needs the user, so only one request is on the display
+ * and the buttons at a time; the others wait in their `conn_properties`
+ * slot and are prompted in arrival order once it is answered or its link
+ * closes. The other setup steps of the links keep running meanwhile. Does
+ * nothing while a prompt is shown or no request waits.
+ */
+static void passkey_prompt_next(void)
+{
+  uint8_t table_index;
+  uint8_t waiting = 0;
+
+  if (state == PROMPT_YESNO || state == PROMPT_CONFIRM_PASSKEY) {
+    return;
+  }
+  table_index = oldest_passkey_request();
+  if (table_index == TABLE_INDEX_INVALID) {
+    return;
+  }
+
+  for (uint8_t i = 0; i < SL_BT_CONFIG_MAX_CONNECTIONS; i++) {
+    waiting += conn_properties[i].passkey_pending;
+  }
+  LOG_PAIRING("Passkey of link slot %u to confirm, %u request(s) waiting",
+              table_index, waiting);
+
+  passkey = conn_properties[table_index].passkey_value;
+  temp_connec_handle = conn_properties[table_index].connection_handle;
+
+  // Enable button service for user input
+  app_button_pairing_enable();
+
+  state = PROMPT_YESNO;
+  refresh_display();
+}
+
+/**
+ * @brief Drop a link whose setup cannot complete.
+ *
+ * The closed event frees its slot and resumes the scanner.
+ *
+ * @param[in] table_index Index of the link in `conn_properties`
+ * @param[in] reason      Text for the log
+ */
+static void link_setup_failed(uint8_t table_index, const char *reason)
+{
+  LOG_DISC(">Setup of connection %d failed: %s, dropping client",
+           (int)conn_properties[table_index].connection_handle, reason);
+  sl_bt_connection_close(conn_properties[table_index].connection_handle);
+}
+
+/**
+ * @brief Report a link whose indications are enabled, and the fleet once full.
+ *
+ * The fleet time runs from the scanner start without any link to the moment
+ * the last of the `SL_BT_CONFIG_MAX_CONNECTIONS` links is ready.
+ *
+ * @param[in] table_index Index of the link in `conn_properties`
+ */
+static void link_ready(uint8_t table_index)
+{
+  uint32_t now = sl_sleeptimer_get_tick_count();
+  uint8_t ready = 0;
+
+  // Free slots are in the opening state
+  for (uint8_t i = 0; i < SL_BT_CONFIG_MAX_CONNECTIONS; i++) {
+    ready += (conn_properties[i].setup_state == running);
+  }
+
+  LOG_CONN("Link %d ready %lu ms after connection, %d/%d links ready",
+           (int)conn_properties[table_index].connection_handle,
+           (unsigned long)sl_sleeptimer_tick_to_ms(now - conn_properties[table_index].opened_at),
+           (int)ready, SL_BT_CONFIG_MAX_CONNECTIONS);
+  link_quality_start(table_index);
+
+  if (ready == SL_BT_CONFIG_MAX_CONNECTIONS && !fleet_setup.reported) {
+    fleet_setup.reported = true;
+    LOG_STATS("Fleet bring-up: %d links ready in %lu ms",
+              SL_BT_CONFIG_MAX_CONNECTIONS,
+              (unsigned long)sl_sleeptimer_tick_to_ms(now - fleet_setup.start));
+  }
+}
+
+/**
+ * @brief Record the time a link took to be encrypted, once per connection.
+ *
+ * @param[in] table_index Index of the link in `conn_properties`
+ */
+static void link_secured(uint8_t table_index)
+{
+  conn_properties_t *conn = &conn_properties[table_index];
+  uint32_t ms;
+
+  if (conn->secured) {
+    return;
+  }
+  conn->secured = true;
+  ms = sl_sleeptimer_tick_to_ms(sl_sleeptimer_get_tick_count() - conn->opened_at);
+  app_bond_store_record_secured(conn->known_peer, ms);
+  LOG_BONDING("Link %d encrypted %lu ms after connection (%s)",
+              (int)conn->connection_handle, (unsigned long)ms,
+              conn->known_peer ? "stored keys" : "pairing");
+  app_bond_store_log_stats();
+}
+
+/**
+ * @brief Start the GATT setup of a secured link, once per connection.
+ *
+ * Known handles are validated from the GATT cache, otherwise the usart
+ * service is discovered. A link that cannot start its setup is closed.
+ *
+ * @param[in] table_index Index of the link in `conn_properties`
+ */
+static void start_link_setup(uint8_t table_index)
+{
+  conn_properties_t *conn = &conn_properties[table_index];
+  sl_status_t sc;
+
+  if (conn->setup_state != pairing) {
+    return;
+  }
+
+  // Known peer: one read of its Database Hash instead of the discovery
+  if (start_cached_setup(table_index)) {
+    return;
+  }
+
+  //  * Discover primary services with the specified UUID in a remote GATT database.
+  //  * This command generates unique gatt_service event for every discovered primary
+  //  * service. Received @ref sl_bt_evt_gatt_procedure_completed event indicates
+  //  * that this GATT procedure was successfully completed or failed with an error.
+  sc = sl_bt_gatt_discover_primary_services_by_uuid(conn->connection_handle,
+                                                    sizeof(usart_service),
+                                                    (const uint8_t *)usart_service);
+  if (sc != SL_STATUS_OK) {
+    link_setup_failed(table_index, "primary service discovery not started");
+    return;
+  }
+  LOG_DISC("-> Confirm the existence of my service in remote GATT database");
+  conn->setup_state = discover_services;
+}
+
+/**
+ * @brief Start the setup of a link from its GATT cache entry.
+ *
+ * The cached handles are taken over and the Database Hash is read by its
+ * cached handle; the procedure completed event of that read validates them
+ * (`validate_gatt_cache`).
+ *
+ * @param[in] table_index Index of the link in `conn_properties`
+ * @return true if the read was started, false to run the full discovery
+ */
+static bool start_cached_setup(uint8_t table_index)
+{
+  conn_properties_t *conn = &conn_properties[table_index];
+  app_gatt_cache_handles_t handles;
+  sl_status_t sc;
+
+  if (!app_gatt_cache_lookup(conn->server_address, conn->server_address_type, &handles)) {
+    return false;
+  }
+
+  conn->db_hash_len = 0;
+  sc = sl_bt_gatt_read_characteristic_value(conn->connection_handle, handles.db_hash_handle);
+  if (sc != SL_STATUS_OK) {
+    return false;
+  }
+  conn->usart_service_handle = handles.service_handle;
+  conn->usartpacket_characteristic_handle = handles.characteristic_handle;
+  conn->db_hash_handle = handles.db_hash_handle;
+  conn->setup_state = validate_gatt_cache;
+  LOG_DISC("-> Known peer, validating cached handles");
+  return true;
+}
+
+/**
+ * @brief Advance the GATT cache entry of a running link.
+ *
+ * After the link is ready the Central finds the Generic Attribute service,
+ * reads its Database Hash by UUID and stores the handles with that hash.
+ * Any failure leaves the peer uncached: the next connection discovers again.
+ *
+ * @param[in] table_index Index of the link in `conn_properties`
+ * @param[in] result      Result of the completed GATT procedure
+ */
+static void gatt_cache_step_done(uint8_t table_index, uint16_t result)
+{
+  conn_properties_t *conn = &conn_properties[table_index];
+  app_gatt_cache_handles_t handles;
+  sl_status_t sc;
+
+  switch (conn->gatt_cache_step) {
+    case GATT_CACHE_FIND_GATT_SERVICE:
+      if (result != SL_STATUS_OK || conn->gatt_service_handle == SERVICE_HANDLE_INVALID) {
+        break;
+      }
+      conn->db_hash_len = 0;
+      sc = sl_bt_gatt_read_characteristic_value_by_uuid(conn->connection_handle,
+                                                        conn->gatt_service_handle,
+                                                        sizeof(database_hash_char),
+                                                        database_hash_char);
+      if (sc != SL_STATUS_OK) {
+        break;
+      }
+      conn->gatt_cache_step = GATT_CACHE_READ_DB_HASH;
+      return;
+
+    case GATT_CACHE_READ_DB_HASH:
+      if (result != SL_STATUS_OK || conn->db_hash_len != APP_GATT_CACHE_HASH_LEN
+          || conn->db_hash_handle == CHARACTERISTIC_HANDLE_INVALID) {
+        break;
+      }
+      handles.service_handle = conn->usart_service_handle;
+      handles.characteristic_handle = conn->usartpacket_characteristic_handle;
+      handles.db_hash_handle = conn->db_hash_handle;
+      memcpy(handles.db_hash, conn->db_hash, APP_GATT_CACHE_HASH_LEN);
+      if (app_gatt_cache_store(conn->server_address, conn->server_address_type, &handles) == SL_STATUS_OK) {
+        LOG_DISC("Handles of connection %d cached", (int)conn->connection_handle);
+      }
+      conn->gatt_cache_step = GATT_CACHE_IDLE;
+      return;
+
+    default:
+      break;
+  }
+
+  LOG_DISC("No Database Hash on connection %d, handles not cached", (int)conn->connection_handle);
+  conn->gatt_cache_step = GATT_CACHE_IDLE;
+}
+
+/*******************************************************************************
+ ************************   LINK QUALITY FUNCTIONS   ***************************
+ ******************************************************************************/
+
+// Sleeptimer callback (interrupt context): sample from the event handler
+static void link_quality_timer_cb(sl_sleeptimer_timer_handle_t *handle, void *data)
+{
+  (void)handle;
+  (void)data;
+  sl_bt_external_signal(LINK_QUALITY_SIGNAL);
+}
+
+/**
+ * @brief Enable the power reports of a link that just became ready.
+ *
+ * The stack then raises `sl_bt_evt_connection_tx_power` and
+ * `sl_bt_evt_connection_remote_tx_power` when either side changes its TX
+ * power. Peers without LE Power Control leave the TX power fields invalid.
+ *
+ * @param[in] table_index Index of the link in `conn_properties`
+ */
+static void link_quality_start(uint8_t table_index)
+{
+  conn_properties_t *conn = &conn_properties[table_index];
+  int8_t current_level;
+  int8_t max_level;
+  sl_status_t sc;
+
+  sc = sl_bt_connection_enable_power_reporting(conn->connection_handle,
+                                               sl_bt_connection_power_reporting_enable);
+  conn->power_control_active = (sc == SL_STATUS_OK);
+  if (sl_bt_connection_get_tx_power(conn->connection_handle, conn->phy,
+                                    &current_level, &max_level) == SL_STATUS_OK) {
+    conn->tx_power = current_level;
+  }
+  if (conn->power_control_active) {
+    sl_bt_connection_get_remote_tx_power(conn->connection_handle, conn->phy);
+  }
+}
+
+/**
+ * @brief Request one RSSI sample of every running link.
+ *
+ * Each request is answered by a `sl_bt_evt_connection_rssi` event. Links
+ * still in setup are not sampled: their GATT procedures come first.
+ */
+static void link_quality_sample(void)
+{
+  for (uint8_t i = 0; i < SL_BT_CONFIG_MAX_CONNECTIONS; i++) {
+    if (conn_properties[i].setup_state == running) {
+      sl_bt_connection_get_rssi(conn_properties[i].connection_handle);
+    }
+  }
+}
+
+/**
+ * @brief Adapt a link to its new quality class.
+ *
+ * - weak: Coded PHY preferred (longer range), supervision timeout raised to
+ *   ride out fades.
+ * - normal: 1M PHY and the default parameters.
+ * - strong: 2M PHY and a shorter connection interval for throughput.
+ *
+ * The peer may refuse a PHY; `sl_bt_evt_connection_phy_status` reports the
+ * one in use.
+ *
+ * @param[in] table_index Index of the link in `conn_properties`
+ */
+static void link_quality_changed(uint8_t table_index)
+{
+  conn_properties_t *conn = &conn_properties[table_index];
+  app_link_quality_class_t quality = conn->link_quality.quality;
+  uint8_t phy = sl_bt_gap_phy_1m;
+  uint16_t interval_min = CONN_INTERVAL_MIN;
+  uint16_t interval_max = CONN_INTERVAL_MAX;
+  uint16_t timeout = CONN_TIMEOUT;
+  sl_status_t sc;
+
+  LOG_CONN("Link %d quality %s: RSSI avg %d dBm, min %d dBm",
+           (int)conn->connection_handle, app_link_quality_name(quality),
+           app_link_quality_average(&conn->link_quality),
+           app_link_quality_min(&conn->link_quality));
+
+  if (quality == APP_LINK_QUALITY_WEAK) {
+    phy = sl_bt_gap_phy_coded;
+    timeout = CONN_TIMEOUT_WEAK;
+  } else if (quality == APP_LINK_QUALITY_STRONG) {
+    phy = sl_bt_gap_phy_2m;
+    interval_min = CONN_INTERVAL_STRONG_MIN;
+    interval_max = CONN_INTERVAL_STRONG_MAX;
+  }
+
+  sc = sl_bt_connection_set_preferred_phy(conn->connection_handle, phy, sl_bt_gap_phy_any);
+  if (sc != SL_STATUS_OK) {
+    LOG_WARN("Link %d: PHY request failed 0x%04lx", (int)conn->connection_handle, (unsigned long)sc);
+  }
+  sc = sl_bt_connection_set_parameters(conn->connection_handle,
+                                       interval_min,
+                                       interval_max,
+                                       CONN_RESPONDER_LATENCY,
+                                       timeout,
+                                       CONN_MIN_CE_LENGTH,
+                                       CONN_MAX_CE_LENGTH);
+  if (sc != SL_STATUS_OK) {
+    LOG_WARN("Link %d: parameter request failed 0x%04lx", (int)conn->connection_handle, (unsigned long)sc);
+  }
+}
+
+/**
+ * @brief Print the link quality of every running link.
+ */
+static void link_quality_log(void)
+{
+  for (uint8_t i = 0; i < SL_BT_CONFIG_MAX_CONNECTIONS; i++) {
+    conn_properties_t *conn = &conn_properties[i];
+    int8_t history[APP_LINK_QUALITY_HISTORY];
+    char text[APP_LINK_QUALITY_HISTORY * 5 + 1];   // " -127" per sample
+    size_t pos = 0;
+    uint8_t n;
+
+    if (conn->setup_state != running) {
+      continue;
+    }
+    n = app_link_quality_history(&conn->link_quality, history, APP_LINK_QUALITY_HISTORY);
+    text[0] = '\0';
+    for (uint8_t k = 0; k < n; k++) {
+      pos += (size_t)snprintf(&text[pos], sizeof(text) - pos, " %d", history[k]);
+    }
+    LOG_STATS("Link %d: %s, RSSI%s dBm (avg %d, min %d), TX %d dBm, remote TX %d dBm, PHY 0x%02x",
+              (int)conn->connection_handle,
+              app_link_quality_name(conn->link_quality.quality),
+              text,
+              app_link_quality_average(&conn->link_quality),
+              app_link_quality_min(&conn->link_quality),
+              conn->tx_power,
+              conn->remote_tx_power,
+              conn->phy);
+  }
+}
+
+// Sleeptimer callback (interrupt context): report from the event handler
+static void stats_report_timer_cb(sl_sleeptimer_timer_handle_t *handle, void *data)
+{
+  (void)handle;
+  (void)data;
+  sl_bt_external_signal(STATS_REPORT_SIGNAL);
+}
+
+/**
+ * @brief Print the statistics of the data paths, every STATS_REPORT_PERIOD_MS.
+ *
+ * The blocks used to follow every forwarded payload, which flooded the
+ * console ring at high payload rates. A period without any payload
+ * forwarded or fragment written prints nothing.
+ */
+static void stats_report(void)
+{
+  if (payloads_forwarded == payloads_reported && fragments_written == fragments_reported) {
+    return;
   }
+  LOG_STATS("Report: %lu payloads forwarded, %lu fragments written in the last %u ms",
+            (unsigned long)(payloads_forwarded - payloads_reported),
+            (unsigned long)(fragments_written - fragments_reported),
+            (unsigned int)STATS_REPORT_PERIOD_MS);
+  payloads_reported = payloads_forwarded;
+  fragments_reported = fragments_written;
+
+  app_pools_log_stats();
+  app_console_log_stats();
+  app_cycle_stats_log(&fragment_cycles);
+  app_trace_log_stats();
+  LOG_STATS("RX flow: %lu fragments, %lu confirmations withheld, %lu expired, %lu dropped",
+            (unsigned long)rx_flow.fragments_received,
+            (unsigned long)rx_flow.confirmations_withheld,
+            (unsigned long)rx_flow.confirmations_expired,
+            (unsigned long)rx_flow.fragments_dropped);
+  defrag_log_link_stats();
+  frag_tx_log_link_stats();
+  link_quality_log();
 }
 
 /*******************************************************************************
@@ -0,0 +1,74 @@
+/**
+ * @file app_adv_status.h
+ * @brief Peripheral status in the advertising data, built by the Peripheral
+ *        and parsed by the Central's scanner
+ *
+ * Without it, the Central has to connect, pair and discover a Peripheral
+ * only to learn whether it has anything to send. The Peripheral adds one
+ * manufacturer specific AD structure (type 0xFF) to its advertising data:
+ *
+ *   [length = 9 | 0xFF | company ID u16 LE | version | flags |
+ *    queued bytes u16 LE | battery | sequence]
+ *
+ * - version: `APP_ADV_STATUS_VERSION`, the data protocol of the Peripheral.
+ *   A Central skips a structure with another company ID or version.
+ * - flags: `APP_ADV_STATUS_FLAG_PENDING` while data waits for a Central.
+ * - queued bytes: UART input waiting to be sent, saturated at 0xFFFF.
+ * - battery: percent, `APP_ADV_STATUS_BATTERY_UNKNOWN` if not measured.
+ * - sequence: incremented by the Peripheral each time the status changes,
+ *   so an observer can tell a new status from a repeated one.
+ *
+ * The structure takes `APP_ADV_STATUS_AD_LEN` bytes; with the flags and a
+ * 128-bit service UUID it fills the 31 bytes of legacy advertising data.
+ *
+ * @note This component is designed to be reusable across different projects,
+ *       the Central and the Peripheral use the same copy. It holds no
+ *       Bluetooth state.
+ */
+
+#ifndef APP_ADV_STATUS_H
+#define APP_ADV_STATUS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define APP_ADV_STATUS_COMPANY_ID       0x02FF  // Silicon Laboratories
+#define APP_ADV_STATUS_VERSION          1
+#define APP_ADV_STATUS_AD_LEN           10      // Whole AD structure, length byte included
+
+#define APP_ADV_STATUS_FLAG_PENDING     0x01    // Data waits for a Central
+#define APP_ADV_STATUS_BATTERY_UNKNOWN  0xFF
+
+typedef struct
+{
+    uint8_t version;
+    uint8_t flags;                  // APP_ADV_STATUS_FLAG_*
+    uint16_t queued_bytes;
+    uint8_t battery;                // Percent, APP_ADV_STATUS_BATTERY_UNKNOWN if not measured
+    uint8_t sequence;
+} app_adv_status_t;
+
+/**
+ * @brief Encode a status as a manufacturer specific AD structure.
+ *
+ * @param[in]  status Status to encode, its version is written as is
+ * @param[out] ad     APP_ADV_STATUS_AD_LEN bytes
+ */
+void app_adv_status_encode(const app_adv_status_t *status, uint8_t ad[APP_ADV_STATUS_AD_LEN]);
+
+/**
+ * @brief Find and decode the status in advertising data.
+ *
+ * Walks the AD structures with bounds checks and stops at the first
+ * manufacturer specific structure of `APP_ADV_STATUS_COMPANY_ID` with
+ * version `APP_ADV_STATUS_VERSION`.
+ *
+ * @param[in]  data   Advertising data
+ * @param[in]  len    Its length in bytes
+ * @param[out] status Decoded status
+ * @return true if a status was found
+ */
+bool app_adv_status_parse(const uint8_t *data, size_t len, app_adv_status_t *status);
+
+#endif /* APP_ADV_STATUS_H */
@@ -0,0 +1,119 @@
+/**
+ * @file app_block_pool.h
+ * @brief Fixed-block memory pool allocator (no heap)
+ *
+ * A pool hands out blocks of one fixed size carved from a static array.
+ * Allocation and release are O(1): free blocks are kept in a singly linked
+ * free list stored inside the free blocks themselves. The only per-block
+ * bookkeeping is one in-use bit, in a bitmap of `BLOCK_POOL_MAX_BLOCKS`
+ * bits in the pool control structure.
+ *
+ * Every pool tracks how many blocks are in use, the high-water mark and the
+ * number of failed allocations, so RAM usage can be inspected at runtime
+ * with `block_pool_get_stats()` or `block_pool_log_stats()`.
+ *
+ * Alloc and free run inside a short critical section and are therefore safe
+ * to call from interrupt context (e.g. an LDMA completion callback). A free
+ * that would corrupt the pool is rejected and only counted (`free_errors`),
+ * nothing is logged from there: a pointer outside the pool or not at the
+ * start of a block, and a block whose in-use bit is clear (double free).
+ *
+ * @note This component is designed to be reusable across different projects,
+ *       the pool instances themselves are defined by each application.
+ */
+
+#ifndef APP_BLOCK_POOL_H
+#define APP_BLOCK_POOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Largest pool, sets the size of the in-use bitmap of every pool
+#ifndef BLOCK_POOL_MAX_BLOCKS
+#define BLOCK_POOL_MAX_BLOCKS       64
+#endif
+
+// Blocks are aligned to 4 bytes so any struct can be placed inside
+#define BLOCK_POOL_ALIGN(size)      (((size) + 3u) & ~3u)
+
+/**
+ * @brief Declare the static storage of a pool.
+ *
+ * Example: BLOCK_POOL_STORAGE(msg_storage, 256, 4);
+ */
+#define BLOCK_POOL_STORAGE(name, block_size, block_count) \
+    static uint32_t name[(BLOCK_POOL_ALIGN(block_size) * (block_count)) / sizeof(uint32_t)]
+
+typedef struct
+{
+    const char *name;           // Label used in logs
+    uint8_t *storage;           // Start of the carved array
+    void *free_list;            // First free block
+    uint16_t block_size;        // Aligned block size in bytes
+    uint16_t block_count;       // Total number of blocks
+    uint16_t used;              // Blocks currently allocated
+    uint16_t high_water;        // Highest value of `used` since init
+    uint32_t alloc_failures;    // Allocations refused because the pool was empty
+    uint32_t free_errors;       // Frees rejected: foreign block or double free
+    uint32_t in_use[(BLOCK_POOL_MAX_BLOCKS + 31) / 32];    // Bit per allocated block
+} block_pool_t;
+
+typedef struct
+{
+    uint16_t block_size;
+    uint16_t block_count;
+    uint16_t used;
+    uint16_t high_water;
+    uint32_t alloc_failures;
+    uint32_t free_errors;
+} block_pool_stats_t;
+
+/**
+ * @brief Initialize a pool over a static storage array.
+ *
+ * @param[out] pool        Pool control structure
+ * @param[in]  name        Label for logs (must stay valid)
+ * @param[in]  storage     Storage declared with BLOCK_POOL_STORAGE()
+ * @param[in]  block_size  Requested block size in bytes (rounded up to 4)
+ * @param[in]  block_count Number of blocks in the storage, at most
+ *                         `BLOCK_POOL_MAX_BLOCKS` (the rest is not used)
+ */
+void block_pool_init(block_pool_t *pool, const char *name, void *storage,
+                     uint16_t block_size, uint16_t block_count);
+
+/**
+ * @brief Take one block from the pool.
+ *
+ * @param[in] pool Pool to allocate from
+ * @return Pointer to a block of `pool->block_size` bytes, NULL if the pool is empty
+ */
+void *block_pool_alloc(block_pool_t *pool);
+
+/**
+ * @brief Give a block back to its pool.
+ *
+ * Pointers that are not the start of a block of the pool and blocks
+ * already free are rejected and counted in `free_errors`.
+ *
+ * @param[in] pool  Pool the block was allocated from
+ * @param[in] block Block to release, NULL is ignored
+ */
+void block_pool_free(block_pool_t *pool, void *block);
+
+/**
+ * @brief Number of blocks that can still be allocated.
+ */
+uint16_t block_pool_available(const block_pool_t *pool);
+
+/**
+ * @brief Copy the usage counters of a pool.
+ */
+void block_pool_get_stats(const block_pool_t *pool, block_pool_stats_t *stats);
+
+/**
+ * @brief Print the usage counters of a pool on the log.
+ */
+void block_pool_log_stats(const block_pool_t *pool);
+
+#endif /* APP_BLOCK_POOL_H */
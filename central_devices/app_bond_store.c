@@ -0,0 +1,140 @@
+#include <string.h>
+#include "sl_bt_api.h"
+#include "app_bond_store.h"
+#include "log.h"
+
+#if APP_BOND_STORE_MAX_BONDINGS < 1 || APP_BOND_STORE_MAX_BONDINGS > 32
+#error "APP_BOND_STORE_MAX_BONDINGS must be 1..32"
+#endif
+
+// sl_bt_sm_store_bonding_configuration() policy: a new bonding replaces the
+// one used the longest time ago
+#define BONDING_POLICY_LRU              2
+
+static app_bond_store_stats_t bond_stats;
+
+/*******************************************************************************
+ ***************************   LOCAL FUNCTIONS   *******************************
+ *******************************************************************************/
+
+static void latency_add(app_bond_store_latency_t *l, uint32_t ms)
+{
+    if(l->count == 0 || ms < l->min_ms)
+    {
+        l->min_ms = ms;
+    }
+    if(ms > l->max_ms)
+    {
+        l->max_ms = ms;
+    }
+    l->total_ms += ms;
+    l->count++;
+}
+
+static void latency_log(const char *name, const app_bond_store_latency_t *l)
+{
+    if(l->count == 0)
+    {
+        LOG_STATS("Bond store: %s 0 links", name);
+        return;
+    }
+    LOG_STATS("Bond store: %s %lu links, connection to encryption min %lu ms, avg %lu ms, max %lu ms",
+              name,
+              (unsigned long)l->count,
+              (unsigned long)l->min_ms,
+              (unsigned long)(l->total_ms / l->count),
+              (unsigned long)l->max_ms);
+}
+
+/*******************************************************************************
+ ***************************   GLOBAL FUNCTIONS   ******************************
+ ******************************************************************************/
+
+sl_status_t app_bond_store_init(void)
+{
+    sl_status_t sc;
+
+    memset(&bond_stats, 0, sizeof(bond_stats));
+
+#if APP_BOND_STORE_PERSIST
+    sc = sl_bt_sm_store_bonding_configuration(APP_BOND_STORE_MAX_BONDINGS, BONDING_POLICY_LRU);
+    if(sc != SL_STATUS_OK)
+    {
+        LOG_ERROR("Bond store: configuration failed 0x%04lx", (unsigned long)sc);
+        return sc;
+    }
+    LOG_BOOT("Bondings kept, up to %d peers, least recently used replaced first",
+             APP_BOND_STORE_MAX_BONDINGS);
+#else
+    sc = sl_bt_sm_delete_bondings();
+    if(sc != SL_STATUS_OK)
+    {
+        return sc;
+    }
+    LOG_BOOT("Old bondings deleted");
+#endif
+    return SL_STATUS_OK;
+}
+
+void app_bond_store_on_closed(void)
+{
+#if !APP_BOND_STORE_PERSIST
+    if(sl_bt_sm_delete_bondings() == SL_STATUS_OK)
+    {
+        LOG_BONDING("All bonding deleted");
+    }
+#endif
+}
+
+sl_status_t app_bond_store_revoke(uint8_t bonding)
+{
+    sl_status_t sc;
+
+    if(bonding == APP_BOND_STORE_ALL)
+    {
+        sc = sl_bt_sm_delete_bondings();
+    }
+    else
+    {
+        sc = sl_bt_sm_delete_bonding(bonding);
+    }
+    if(sc != SL_STATUS_OK)
+    {
+        LOG_WARN("Bond store: revoking 0x%02x failed 0x%04lx", bonding, (unsigned long)sc);
+        return sc;
+    }
+
+    bond_stats.revocations++;
+    if(bonding == APP_BOND_STORE_ALL)
+    {
+        LOG_BONDING("All bondings revoked");
+    }
+    else
+    {
+        LOG_BONDING("Bonding 0x%02x revoked", bonding);
+    }
+    return SL_STATUS_OK;
+}
+
+void app_bond_store_record_secured(bool resumed, uint32_t ms)
+{
+    latency_add(resumed ? &bond_stats.resumed : &bond_stats.paired, ms);
+}
+
+void app_bond_store_get_stats(app_bond_store_stats_t *stats)
+{
+    if(stats == NULL)
+    {
+        return;
+    }
+    *stats = bond_stats;
+}
+
+void app_bond_store_log_stats(void)
+{
+    LOG_STATS("Bond store: %s, %lu revocations",
+              APP_BOND_STORE_PERSIST ? "persistent" : "deleted on disconnection",
+              (unsigned long)bond_stats.revocations);
+    latency_log("re-encrypted", &bond_stats.resumed);
+    latency_log("paired", &bond_stats.paired);
+}
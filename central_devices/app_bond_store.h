@@ -0,0 +1,114 @@
+/**
+ * @file app_bond_store.h
+ * @brief Persistent bondings: bounded store of trusted peers, revocation, timing
+ *
+ * Pairing with numeric comparison needs a button press on each side and
+ * several LE Secure Connections exchanges. Once the keys are bonded, a known
+ * peer only has to start encryption with its stored LTK (one LL round trip)
+ * on the next connection. This module keeps the bondings across connections
+ * and resets:
+ *
+ * - `app_bond_store_init()` sets the stack's bonding database to
+ *   `APP_BOND_STORE_MAX_BONDINGS` entries with the "least recently used"
+ *   policy: a new peer replaces the bonding used the longest time ago.
+ *   The keys live in the stack's NVM3 objects.
+ * - `app_bond_store_revoke()` deletes one bonding, or all of them. The
+ *   boards call it when BTN1 is held during reset; the Peripheral also takes
+ *   it as a UART control command (`app_uart_link.h`). A revoked peer pairs
+ *   again on its next connection.
+ * - `app_bond_store_record_secured()` collects the time from connection to
+ *   encryption, split between re-encrypted (known peer) and paired links.
+ *
+ * With `APP_BOND_STORE_PERSIST` defined to 0 the previous behaviour is kept
+ * (all bondings deleted at boot and on every disconnection), so the same
+ * `[STATS] Bond store` line can be compared with and without the store.
+ *
+ * @note Call from the Bluetooth event handler only.
+ * @note This component is designed to be reusable across different projects,
+ *       the Central and the Peripheral use the same copy.
+ */
+
+#ifndef APP_BOND_STORE_H
+#define APP_BOND_STORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sl_status.h"
+
+#ifndef APP_BOND_STORE_PERSIST
+#define APP_BOND_STORE_PERSIST          1
+#endif
+
+// Bondings kept by the stack, 1..32
+#ifndef APP_BOND_STORE_MAX_BONDINGS
+#define APP_BOND_STORE_MAX_BONDINGS     8
+#endif
+
+// Argument of app_bond_store_revoke() deleting every bonding
+#define APP_BOND_STORE_ALL              0xFF
+
+// Connection to encryption times of one kind of link
+typedef struct
+{
+    uint32_t count;
+    uint32_t min_ms;
+    uint32_t max_ms;
+    uint32_t total_ms;
+} app_bond_store_latency_t;
+
+// Counters since app_bond_store_init()
+typedef struct
+{
+    app_bond_store_latency_t resumed;   // Known peers, encrypted with stored keys
+    app_bond_store_latency_t paired;    // New peers, full pairing (user input included)
+    uint32_t revocations;               // Bondings deleted by app_bond_store_revoke()
+} app_bond_store_stats_t;
+
+/**
+ * @brief Configure the stack's bonding database.
+ *
+ * Call from the system boot event, before advertising or scanning.
+ *
+ * @return SL_STATUS_OK, or the error of the stack command
+ */
+sl_status_t app_bond_store_init(void);
+
+/**
+ * @brief Apply the bonding policy to a closed connection.
+ *
+ * Deletes every bonding when `APP_BOND_STORE_PERSIST` is 0, nothing otherwise.
+ */
+void app_bond_store_on_closed(void);
+
+/**
+ * @brief Delete a bonding.
+ *
+ * A connection encrypted with the bonding stays up; the peer pairs again on
+ * its next connection.
+ *
+ * @param[in] bonding Bonding handle, or APP_BOND_STORE_ALL
+ * @return SL_STATUS_OK, or the error of the stack command
+ */
+sl_status_t app_bond_store_revoke(uint8_t bonding);
+
+/**
+ * @brief Record the time a link took from connection to encryption.
+ *
+ * @param[in] resumed true if the stored keys were used, false after pairing
+ * @param[in] ms      Time from the connection opened event
+ */
+void app_bond_store_record_secured(bool resumed, uint32_t ms);
+
+/**
+ * @brief Copy the counters.
+ *
+ * @param[out] stats Destination for the counters
+ */
+void app_bond_store_get_stats(app_bond_store_stats_t *stats);
+
+/**
+ * @brief Print the bonding policy and the connection to encryption times.
+ */
+void app_bond_store_log_stats(void);
+
+#endif /* APP_BOND_STORE_H */
@@ -0,0 +1,77 @@
+/**
+ * @file app_checksum.h
+ * @brief Payload checksum kernels: byte-wise reference and word-parallel paths
+ *
+ * The BLE fragment protocol ends every message with the two's complement of
+ * the byte sum of its payload (`app_checksum_compute()`). The byte sum is
+ * computed by the fastest kernel built for the target:
+ * - Cortex-M33 with the DSP extension: USADA8 adds four bytes per
+ *   instruction into a 32-bit accumulator.
+ * - Other 32-bit targets: SIMD within a register, the bytes of each word are
+ *   split into two 16-bit lane accumulators that are folded every 128 words.
+ * - Host builds (x86): SSE2 PSADBW, or AVX2 when the CPU supports it, used
+ *   by the benchmark in `tools/checksum_bench`.
+ *
+ * All kernels return the byte sum modulo 2^32, so the checksum is
+ * bit-identical to the byte-wise loop for any length and alignment.
+ *
+ * With `APP_CHECKSUM_BENCHMARK` defined, `app_checksum_log_benchmark()`
+ * measures every kernel on the target with the DWT cycle counter
+ * (`app_cycle_stats.h`).
+ *
+ * @note This component is designed to be reusable across different projects,
+ *       the Central and the Peripheral use the same copy.
+ */
+
+#ifndef APP_CHECKSUM_H
+#define APP_CHECKSUM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Byte sum of a buffer, modulo 2^32
+typedef uint32_t (*app_checksum_kernel_t)(const uint8_t *data, size_t len);
+
+typedef struct
+{
+    const char *name;
+    app_checksum_kernel_t sum;
+} app_checksum_kernel_info_t;
+
+/**
+ * @brief Compute the two's complement checksum of a payload.
+ *
+ * @param[in] data Pointer to the payload bytes (any alignment)
+ * @param[in] len  Number of bytes
+ * @return Two's complement of the byte sum, truncated to 8 bits
+ */
+uint8_t app_checksum_compute(const uint8_t *data, size_t len);
+
+/**
+ * @brief Byte sum with the fastest kernel available.
+ *
+ * @param[in] data Pointer to the bytes (any alignment)
+ * @param[in] len  Number of bytes
+ * @return Sum of the bytes modulo 2^32
+ */
+uint32_t app_checksum_sum(const uint8_t *data, size_t len);
+
+/**
+ * @brief List the kernels built for this target, reference first.
+ *
+ * @param[out] kernels Pointer set to the kernel table
+ * @return Number of kernels in the table
+ */
+size_t app_checksum_get_kernels(const app_checksum_kernel_info_t **kernels);
+
+#ifdef APP_CHECKSUM_BENCHMARK
+/**
+ * @brief Time every kernel on the target and print bytes per cycle.
+ *
+ * Lengths from 1 to 4096 bytes, measured with the DWT cycle counter. Blocks
+ * for a few milliseconds, call once from `app_init()`.
+ */
+void app_checksum_log_benchmark(void);
+#endif
+
+#endif /* APP_CHECKSUM_H */
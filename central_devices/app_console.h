@@ -0,0 +1,93 @@
+/**
+ * @file app_console.h
+ * @brief Buffered, asynchronous console output
+ *
+ * The `LOG_*` macros of `log.h` format their message into a fixed RAM ring
+ * instead of writing to the unbuffered stdout, so logging never waits for the
+ * UART, not even inside `sl_bt_on_event()`.
+ *
+ * Implementation notes (see `app_console.c`):
+ * - A message is formatted once (at most `APP_CONSOLE_MESSAGE_MAX` bytes) and
+ *   copied into the ring as a whole, or dropped as a whole when the ring has
+ *   no room. Dropped bytes are counted; the ring never blocks the caller.
+ * - Writing is safe from interrupt context (sleeptimer or button callbacks).
+ * - `app_console_process()` hands the oldest contiguous part of the ring to
+ *   the LDMA UART egress (`app_uart_egress.h`), which sends it in the
+ *   background and releases it when done. Log text is never split by a
+ *   binary egress frame in the middle of a byte sequence, and it yields to
+ *   data frames while the egress is congested.
+ *
+ * @note This component is designed to be reusable across different projects,
+ *       the Central and the Peripheral use the same copy.
+ */
+
+#ifndef APP_CONSOLE_H
+#define APP_CONSOLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Size of the console ring in bytes
+#ifndef APP_CONSOLE_BUFFER_SIZE
+#define APP_CONSOLE_BUFFER_SIZE     2048
+#endif
+
+// Longest message formatted by app_console_printf(), longer ones are truncated
+#ifndef APP_CONSOLE_MESSAGE_MAX
+#define APP_CONSOLE_MESSAGE_MAX     160
+#endif
+
+// Counters describing the console since app_console_init()
+typedef struct
+{
+    uint32_t bytes_written;     // Bytes accepted into the ring
+    uint32_t bytes_dropped;     // Bytes of messages that did not fit
+    uint16_t used;              // Bytes waiting or being sent
+    uint16_t high_water;        // Highest number of used bytes seen
+} app_console_stats_t;
+
+/**
+ * @brief Reset the console ring. Call first in `app_init()`.
+ */
+void app_console_init(void);
+
+/**
+ * @brief Copy a message into the console ring.
+ *
+ * The message is queued completely or dropped completely.
+ *
+ * @param[in] data Pointer to the bytes
+ * @param[in] len  Number of bytes
+ * @return Number of bytes queued (len or 0)
+ */
+size_t app_console_write(const void *data, size_t len);
+
+/**
+ * @brief Format a message into the console ring, like printf().
+ *
+ * @param[in] fmt printf() format string
+ * @return Number of bytes queued (0 if the message was dropped)
+ */
+int app_console_printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+/**
+ * @brief Hand buffered console output to the UART egress.
+ *
+ * Call from `app_process_action()`. Never waits for the UART.
+ */
+void app_console_process(void);
+
+/**
+ * @brief Copy the current console counters.
+ *
+ * @param[out] stats Destination for the counters
+ */
+void app_console_get_stats(app_console_stats_t *stats);
+
+/**
+ * @brief Print the console counters.
+ */
+void app_console_log_stats(void);
+
+#endif /* APP_CONSOLE_H */
@@ -0,0 +1,44 @@
+#include "app_cycle_stats.h"
+#include "log.h"
+
+/*******************************************************************************
+ ***************************   GLOBAL FUNCTIONS   ******************************
+ ******************************************************************************/
+
+void app_cycle_counter_init(void)
+{
+    DCB->DEMCR |= DCB_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+void app_cycle_stats_add(app_cycle_stats_t *stats, uint32_t start)
+{
+    uint32_t cycles = app_cycle_counter_now() - start;
+
+    stats->count++;
+    stats->total += cycles;
+    if(cycles < stats->min)
+    {
+        stats->min = cycles;
+    }
+    if(cycles > stats->max)
+    {
+        stats->max = cycles;
+    }
+}
+
+void app_cycle_stats_log(const app_cycle_stats_t *stats)
+{
+    if(stats->count == 0)
+    {
+        return;
+    }
+
+    LOG_STATS("Cycles %s: %lu runs, min %lu, avg %lu, max %lu",
+              stats->name,
+              (unsigned long)stats->count,
+              (unsigned long)stats->min,
+              (unsigned long)(stats->total / stats->count),
+              (unsigned long)stats->max);
+}
@@ -0,0 +1,57 @@
+#include <string.h>
+#include "app_drr.h"
+
+/*******************************************************************************
+ ***************************   GLOBAL FUNCTIONS   ******************************
+ ******************************************************************************/
+
+bool app_drr_init(app_drr_t *drr, uint8_t flows, uint16_t quantum)
+{
+    if(drr == NULL || flows == 0 || flows > APP_DRR_MAX_FLOWS || quantum == 0)
+    {
+        return false;
+    }
+    memset(drr, 0, sizeof(*drr));
+    drr->flows = flows;
+    drr->quantum = quantum;
+    return true;
+}
+
+uint16_t app_drr_pass(app_drr_t *drr, app_drr_head_fn_t head,
+                      app_drr_serve_fn_t serve, void *ctx)
+{
+    uint16_t served = 0;
+
+    for(uint8_t n = 0; n < drr->flows; n++)
+    {
+        uint8_t flow = drr->next;
+        uint16_t size = head(ctx, flow);
+
+        if(size != 0 && !drr->resume)
+        {
+            drr->deficit[flow] += drr->quantum;
+        }
+        drr->resume = false;
+
+        while(size != 0 && size <= drr->deficit[flow])
+        {
+            if(!serve(ctx, flow))
+            {
+                // Consumer blocked: come back to this queue, credit kept
+                drr->resume = true;
+                return served;
+            }
+            drr->deficit[flow] -= size;
+            served++;
+            size = head(ctx, flow);
+        }
+
+        // An emptied queue does not keep credit
+        if(size == 0)
+        {
+            drr->deficit[flow] = 0;
+        }
+        drr->next = (uint8_t)((flow + 1) % drr->flows);
+    }
+    return served;
+}
@@ -0,0 +1,86 @@
+/**
+ * @file app_drr.h
+ * @brief Deficit round robin over a fixed set of queues
+ *
+ * The Central keeps one RX queue per link (`ble_defragment_rxdata.h`). A
+ * pass of `app_drr_pass()` visits every queue once, in round-robin order,
+ * and lets each one spend a quantum of bytes:
+ *
+ * - a queue with data earns `quantum` bytes of credit (its deficit) and is
+ *   served while its head item fits in the credit;
+ * - credit left over is kept for the next pass, so a queue of large items
+ *   gets the same bytes per pass on average as a queue of small ones;
+ * - an empty queue loses its credit, an idle link cannot save up a burst.
+ *
+ * The work of a pass is therefore bounded by `flows * quantum` bytes plus
+ * one item, whatever the arrival order: a chatty link cannot starve the
+ * others of main-loop time.
+ *
+ * When the consumer cannot take an item (`serve` returns false, e.g. every
+ * completion buffer is held), the pass stops and the next one resumes at
+ * the same queue without granting it a new quantum.
+ *
+ * The module holds no Bluetooth state and builds on the host (see
+ * `tools/rx_sched_sim`).
+ */
+
+#ifndef APP_DRR_H
+#define APP_DRR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Queues one scheduler can serve
+#ifndef APP_DRR_MAX_FLOWS
+#define APP_DRR_MAX_FLOWS               8
+#endif
+
+/**
+ * @brief Size of the head item of a queue.
+ *
+ * @return Size in bytes (the unit of the quantum), 0 if the queue is empty
+ */
+typedef uint16_t (*app_drr_head_fn_t)(void *ctx, uint8_t flow);
+
+/**
+ * @brief Consume the head item of a queue.
+ *
+ * @return true if the item was consumed, false if the consumer is blocked
+ */
+typedef bool (*app_drr_serve_fn_t)(void *ctx, uint8_t flow);
+
+typedef struct
+{
+    uint32_t deficit[APP_DRR_MAX_FLOWS];    // Credit left per queue, bytes
+    uint16_t quantum;                       // Credit granted per pass, bytes
+    uint8_t flows;
+    uint8_t next;                           // Queue visited first by the next pass
+    bool resume;                            // Last pass stopped inside `next`
+} app_drr_t;
+
+/**
+ * @brief Initialize a scheduler.
+ *
+ * A quantum of at least the largest item serves every non-empty queue on
+ * each pass.
+ *
+ * @param[out] drr     Scheduler
+ * @param[in]  flows   Number of queues, 1..APP_DRR_MAX_FLOWS
+ * @param[in]  quantum Credit granted to a queue per pass, bytes
+ * @return true on success, false if an argument is out of range
+ */
+bool app_drr_init(app_drr_t *drr, uint8_t flows, uint16_t quantum);
+
+/**
+ * @brief Run one round over all queues.
+ *
+ * @param[in,out] drr   Scheduler
+ * @param[in]     head  Reports the size of a queue's head item
+ * @param[in]     serve Consumes a queue's head item
+ * @param[in]     ctx   Passed to head and serve
+ * @return Number of items served
+ */
+uint16_t app_drr_pass(app_drr_t *drr, app_drr_head_fn_t head,
+                      app_drr_serve_fn_t serve, void *ctx);
+
+#endif /* APP_DRR_H */
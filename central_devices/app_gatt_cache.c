@@ -0,0 +1,187 @@
+#include <string.h>
+#include "nvm3_default.h"
+#include "app_gatt_cache.h"
+#include "log.h"
+
+// Layout version of the NVM3 objects, an old layout is ignored
+#define GATT_CACHE_VERSION      1
+
+// One entry, stored as is in its NVM3 object
+typedef struct
+{
+    uint8_t version;
+    uint8_t valid;
+    uint8_t address_type;
+    uint8_t address[6];
+    uint8_t reserved[3];
+    uint32_t age;                       // Store counter, the lowest is replaced first
+    app_gatt_cache_handles_t handles;
+} gatt_cache_entry_t;
+
+typedef struct
+{
+    gatt_cache_entry_t entries[APP_GATT_CACHE_ENTRIES];
+    uint32_t next_age;
+    app_gatt_cache_stats_t stats;
+} gatt_cache_context_t;
+
+static gatt_cache_context_t cache_cxt;
+
+/*******************************************************************************
+ ***************************   LOCAL FUNCTIONS   *******************************
+ *******************************************************************************/
+
+static gatt_cache_entry_t *find_entry(const uint8_t *address, uint8_t address_type)
+{
+    for(uint8_t i = 0; i < APP_GATT_CACHE_ENTRIES; i++)
+    {
+        gatt_cache_entry_t *entry = &cache_cxt.entries[i];
+        if(entry->valid && entry->address_type == address_type && memcmp(entry->address, address, 6) == 0)
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static nvm3_ObjectKey_t entry_key(const gatt_cache_entry_t *entry)
+{
+    return APP_GATT_CACHE_NVM3_KEY + (nvm3_ObjectKey_t)(entry - cache_cxt.entries);
+}
+
+static void drop_entry(gatt_cache_entry_t *entry)
+{
+    entry->valid = 0;
+    nvm3_deleteObject(nvm3_defaultHandle, entry_key(entry));
+}
+
+/*******************************************************************************
+ ***************************   GLOBAL FUNCTIONS   ******************************
+ ******************************************************************************/
+
+void app_gatt_cache_init(void)
+{
+    uint8_t loaded = 0;
+
+    memset(&cache_cxt, 0, sizeof(cache_cxt));
+    for(uint8_t i = 0; i < APP_GATT_CACHE_ENTRIES; i++)
+    {
+        gatt_cache_entry_t *entry = &cache_cxt.entries[i];
+
+        if(nvm3_readData(nvm3_defaultHandle, entry_key(entry), entry, sizeof(*entry)) != ECODE_NVM3_OK
+           || entry->version != GATT_CACHE_VERSION)
+        {
+            memset(entry, 0, sizeof(*entry));
+            continue;
+        }
+        if(entry->valid)
+        {
+            loaded++;
+            if(entry->age >= cache_cxt.next_age)
+            {
+                cache_cxt.next_age = entry->age + 1;
+            }
+        }
+    }
+    LOG_INFO("GATT cache: %u of %u entries loaded", loaded, (unsigned int)APP_GATT_CACHE_ENTRIES);
+}
+
+bool app_gatt_cache_lookup(const uint8_t *address, uint8_t address_type,
+                           app_gatt_cache_handles_t *handles)
+{
+    gatt_cache_entry_t *entry = find_entry(address, address_type);
+
+    if(entry == NULL)
+    {
+        cache_cxt.stats.misses++;
+        return false;
+    }
+    *handles = entry->handles;
+    return true;
+}
+
+bool app_gatt_cache_validate(const uint8_t *address, uint8_t address_type,
+                             const uint8_t *db_hash, uint8_t len)
+{
+    gatt_cache_entry_t *entry = find_entry(address, address_type);
+
+    if(entry == NULL)
+    {
+        return false;
+    }
+    if(db_hash == NULL || len != APP_GATT_CACHE_HASH_LEN
+       || memcmp(entry->handles.db_hash, db_hash, APP_GATT_CACHE_HASH_LEN) != 0)
+    {
+        cache_cxt.stats.stale++;
+        drop_entry(entry);
+        return false;
+    }
+    cache_cxt.stats.hits++;
+    return true;
+}
+
+sl_status_t app_gatt_cache_store(const uint8_t *address, uint8_t address_type,
+                                 const app_gatt_cache_handles_t *handles)
+{
+    gatt_cache_entry_t *entry = find_entry(address, address_type);
+
+    // Else a free entry, else the oldest one
+    for(uint8_t i = 0; entry == NULL && i < APP_GATT_CACHE_ENTRIES; i++)
+    {
+        if(!cache_cxt.entries[i].valid)
+        {
+            entry = &cache_cxt.entries[i];
+        }
+    }
+    if(entry == NULL)
+    {
+        entry = &cache_cxt.entries[0];
+        for(uint8_t i = 1; i < APP_GATT_CACHE_ENTRIES; i++)
+        {
+            if(cache_cxt.entries[i].age < entry->age)
+            {
+                entry = &cache_cxt.entries[i];
+            }
+        }
+    }
+
+    memset(entry, 0, sizeof(*entry));
+    entry->version = GATT_CACHE_VERSION;
+    entry->valid = 1;
+    entry->address_type = address_type;
+    memcpy(entry->address, address, 6);
+    entry->age = cache_cxt.next_age++;
+    entry->handles = *handles;
+
+    Ecode_t ec = nvm3_writeData(nvm3_defaultHandle, entry_key(entry), entry, sizeof(*entry));
+    if(ec != ECODE_NVM3_OK)
+    {
+        cache_cxt.stats.store_failures++;
+        LOG_WARN("GATT cache: NVM3 write failed 0x%08lx", (unsigned long)ec);
+        return SL_STATUS_FAIL;
+    }
+    cache_cxt.stats.stores++;
+    return SL_STATUS_OK;
+}
+
+void app_gatt_cache_forget(const uint8_t *address, uint8_t address_type)
+{
+    gatt_cache_entry_t *entry = find_entry(address, address_type);
+
+    if(entry != NULL)
+    {
+        drop_entry(entry);
+    }
+}
+
+void app_gatt_cache_log_stats(void)
+{
+    app_gatt_cache_stats_t *s = &cache_cxt.stats;
+
+    LOG_STATS("GATT cache: %lu hits, %lu misses, %lu stale, %lu stored, %lu store failures",
+              (unsigned long)s->hits,
+              (unsigned long)s->misses,
+              (unsigned long)s->stale,
+              (unsigned long)s->stores,
+              (unsigned long)s->store_failures);
+}
@@ -0,0 +1,121 @@
+/**
+ * @file app_gatt_cache.h
+ * @brief Persistent cache of the remote GATT handles of each Peripheral
+ *
+ * Discovering the usart service and characteristic costs two GATT round
+ * trips (several connection intervals) on every connection, although the
+ * Peripheral's database never changes between firmware updates. This module
+ * keeps, per peer address, the handles the Central needs together with the
+ * peer's Database Hash (characteristic 0x2B2A of the Generic Attribute
+ * service, `gatt_caching="true"` on the Peripheral) in NVM3:
+ *
+ * - First connection: full discovery, indications enabled, then the Central
+ *   finds the Database Hash and stores the entry (`app_gatt_cache_store()`).
+ * - Reconnect: one read of the Database Hash by its cached handle. Equal to
+ *   the stored hash: indications are enabled right away with the cached
+ *   characteristic handle. Different, or the read fails: the entry is
+ *   dropped and the Central falls back to a full discovery.
+ *
+ * Entries live in `APP_GATT_CACHE_ENTRIES` NVM3 objects from
+ * `APP_GATT_CACHE_NVM3_KEY`, mirrored in RAM at init so lookups do not touch
+ * flash. When all are used, the least recently stored entry is replaced.
+ *
+ * @note Call from the Bluetooth event handler only.
+ */
+
+#ifndef APP_GATT_CACHE_H
+#define APP_GATT_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sl_status.h"
+
+#ifndef APP_GATT_CACHE_ENTRIES
+#define APP_GATT_CACHE_ENTRIES          8
+#endif
+
+// First NVM3 key, in the range left to the application (the Bluetooth stack
+// uses 0x40000..0x4FFFF for bondings)
+#ifndef APP_GATT_CACHE_NVM3_KEY
+#define APP_GATT_CACHE_NVM3_KEY         0x0A000u
+#endif
+
+#define APP_GATT_CACHE_HASH_LEN         16
+
+// Remote handles of one Peripheral
+typedef struct
+{
+    uint32_t service_handle;            // usart service
+    uint16_t characteristic_handle;     // usart packet characteristic
+    uint16_t db_hash_handle;            // Database Hash characteristic
+    uint8_t db_hash[APP_GATT_CACHE_HASH_LEN];
+} app_gatt_cache_handles_t;
+
+// Counters since app_gatt_cache_init()
+typedef struct
+{
+    uint32_t hits;              // Reconnects that skipped discovery
+    uint32_t misses;            // Peers without an entry
+    uint32_t stale;             // Entries dropped, Database Hash changed or unreadable
+    uint32_t stores;            // Entries written to NVM3
+    uint32_t store_failures;    // NVM3 writes that failed
+} app_gatt_cache_stats_t;
+
+/**
+ * @brief Load the stored entries from NVM3.
+ *
+ * Call once from `app_init()`, NVM3 is initialized by the platform before.
+ */
+void app_gatt_cache_init(void);
+
+/**
+ * @brief Find the cached handles of a peer.
+ *
+ * @param[in]  address      Peer address (6 bytes)
+ * @param[in]  address_type Peer address type
+ * @param[out] handles      Cached handles, valid when true is returned
+ * @return true if the peer has an entry
+ */
+bool app_gatt_cache_lookup(const uint8_t *address, uint8_t address_type,
+                           app_gatt_cache_handles_t *handles);
+
+/**
+ * @brief Compare a Database Hash read from the peer with its entry.
+ *
+ * A different hash drops the entry (RAM and NVM3).
+ *
+ * @param[in] address      Peer address (6 bytes)
+ * @param[in] address_type Peer address type
+ * @param[in] db_hash      Hash read from the peer
+ * @param[in] len          Length of db_hash, APP_GATT_CACHE_HASH_LEN when valid
+ * @return true if the entry is still valid
+ */
+bool app_gatt_cache_validate(const uint8_t *address, uint8_t address_type,
+                             const uint8_t *db_hash, uint8_t len);
+
+/**
+ * @brief Store or update the handles of a peer.
+ *
+ * @param[in] address      Peer address (6 bytes)
+ * @param[in] address_type Peer address type
+ * @param[in] handles      Handles and Database Hash of the peer
+ * @return SL_STATUS_OK, or SL_STATUS_FAIL if the NVM3 write failed (the RAM
+ *         copy is updated anyway)
+ */
+sl_status_t app_gatt_cache_store(const uint8_t *address, uint8_t address_type,
+                                 const app_gatt_cache_handles_t *handles);
+
+/**
+ * @brief Drop the entry of a peer.
+ *
+ * @param[in] address      Peer address (6 bytes)
+ * @param[in] address_type Peer address type
+ */
+void app_gatt_cache_forget(const uint8_t *address, uint8_t address_type);
+
+/**
+ * @brief Print the cache counters.
+ */
+void app_gatt_cache_log_stats(void);
+
+#endif /* APP_GATT_CACHE_H */
@@ -8,7 +8,9 @@
 void app_iostream_usart_init(void)
 {
   // Prevent buffering of output/input.
-  // close the stdout and stdin buffering and use our instance of USART for I/O
+  // close the stdout and stdin buffering and use our instance of USART for I/O.
+  // Only direct printf calls (e.g. app_assert) still use stdout, the LOG_*
+  // macros go through the buffered console (app_console.h)
 #if !defined(__CROSSWORKS_ARM) && defined(__GNUC__)
   setvbuf(stdout, NULL, _IONBF, 0);   // Set unbuffered mode for stdout (newlib)
   setvbuf(stdin, NULL, _IONBF, 0);    // Set unbuffered mode for stdin (newlib)
@@ -29,16 +31,3 @@ void app_iostream_usart_init(void)
   // need intal IO Stream component and retarget-stdio component if not using printf
   printf("Printf uses the default stream, as long as iostream_retarget_stdio included\r\n");
 }
-
-uint8_t app_iostream_checksum(uint8_t *data, uint8_t data_len)
-{
-  uint32_t sum = 0U;
-  uint8_t checksum;
-  for(int i = 0; i < data_len; i++)
-  {
-    sum += data[i];
-  }
-
-  checksum = sum & 0xFF;
-  return ~checksum + 1;
-}
@@ -15,13 +15,4 @@
  */
 void app_iostream_usart_init(void);
 
-/**
- * @brief Compute two's complement checksum of a payload.
- *
- * @param[in] data Pointer to the payload buffer
- * @param[in] Length of the payload in bytes
- * @return 8-bit checksum computed as two's complement of the sum of bytes
- */
-uint8_t app_iostream_checksum(uint8_t *data, uint8_t len);
-
 #endif 
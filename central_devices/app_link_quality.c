@@ -0,0 +1,141 @@
+#include <string.h>
+#include "app_link_quality.h"
+
+#if (APP_LINK_QUALITY_HISTORY & (APP_LINK_QUALITY_HISTORY - 1)) != 0 || APP_LINK_QUALITY_HISTORY < 2
+#error "APP_LINK_QUALITY_HISTORY must be a power of two, at least 2"
+#endif
+
+#define HISTORY_MASK                    (APP_LINK_QUALITY_HISTORY - 1)
+
+/*******************************************************************************
+ ***************************   LOCAL FUNCTIONS   *******************************
+ *******************************************************************************/
+
+// Class of an average, leaving the current class needs the hysteresis margin
+static app_link_quality_class_t classify(app_link_quality_class_t current, int avg)
+{
+    int weak = APP_LINK_QUALITY_WEAK_DBM;
+    int strong = APP_LINK_QUALITY_STRONG_DBM;
+
+    if(current == APP_LINK_QUALITY_WEAK)
+    {
+        weak += APP_LINK_QUALITY_HYSTERESIS_DB;
+    }
+    else if(current == APP_LINK_QUALITY_STRONG)
+    {
+        strong -= APP_LINK_QUALITY_HYSTERESIS_DB;
+    }
+
+    if(avg < weak)
+    {
+        return APP_LINK_QUALITY_WEAK;
+    }
+    if(avg > strong)
+    {
+        return APP_LINK_QUALITY_STRONG;
+    }
+    return APP_LINK_QUALITY_NORMAL;
+}
+
+/*******************************************************************************
+ ***************************   GLOBAL FUNCTIONS   ******************************
+ ******************************************************************************/
+
+void app_link_quality_reset(app_link_quality_t *lq)
+{
+    memset(lq, 0, sizeof(*lq));
+    lq->quality = APP_LINK_QUALITY_UNKNOWN;
+}
+
+bool app_link_quality_add_sample(app_link_quality_t *lq, int8_t rssi)
+{
+    app_link_quality_class_t quality;
+
+    lq->rssi[lq->head] = rssi;
+    lq->head = (lq->head + 1) & HISTORY_MASK;
+    if(lq->count < APP_LINK_QUALITY_HISTORY)
+    {
+        lq->count++;
+    }
+    if(lq->count < APP_LINK_QUALITY_HISTORY / 2)
+    {
+        return false;
+    }
+
+    quality = classify(lq->quality, app_link_quality_average(lq));
+    if(quality == lq->quality)
+    {
+        return false;
+    }
+    lq->quality = quality;
+    return true;
+}
+
+int8_t app_link_quality_average(const app_link_quality_t *lq)
+{
+    int sum = 0;
+
+    if(lq->count == 0)
+    {
+        return 0;
+    }
+    for(uint8_t i = 0; i < lq->count; i++)
+    {
+        sum += lq->rssi[i];
+    }
+    // Round toward minus infinity, like the thresholds are read
+    if(sum < 0)
+    {
+        return (int8_t)-((-sum + lq->count - 1) / lq->count);
+    }
+    return (int8_t)(sum / lq->count);
+}
+
+int8_t app_link_quality_min(const app_link_quality_t *lq)
+{
+    int8_t min;
+
+    if(lq->count == 0)
+    {
+        return 0;
+    }
+    min = lq->rssi[0];
+    for(uint8_t i = 1; i < lq->count; i++)
+    {
+        if(lq->rssi[i] < min)
+        {
+            min = lq->rssi[i];
+        }
+    }
+    return min;
+}
+
+uint8_t app_link_quality_history(const app_link_quality_t *lq, int8_t *out, uint8_t max)
+{
+    uint8_t n = (lq->count < max) ? lq->count : max;
+    // Oldest sample: at head once the ring is full, else at 0
+    uint8_t first = (lq->count == APP_LINK_QUALITY_HISTORY) ? lq->head : 0;
+
+    // The newest n samples when max is short
+    first = (first + lq->count - n) & HISTORY_MASK;
+    for(uint8_t i = 0; i < n; i++)
+    {
+        out[i] = lq->rssi[(first + i) & HISTORY_MASK];
+    }
+    return n;
+}
+
+const char *app_link_quality_name(app_link_quality_class_t quality)
+{
+    switch(quality)
+    {
+        case APP_LINK_QUALITY_WEAK:
+            return "weak";
+        case APP_LINK_QUALITY_NORMAL:
+            return "normal";
+        case APP_LINK_QUALITY_STRONG:
+            return "strong";
+        default:
+            return "unknown";
+    }
+}
@@ -0,0 +1,111 @@
+/**
+ * @file app_link_quality.h
+ * @brief Per-link RSSI history and link quality class with hysteresis
+ *
+ * The Central samples the RSSI of each running link periodically
+ * (`sl_bt_connection_get_rssi()`, answered by `sl_bt_evt_connection_rssi`)
+ * and feeds every sample to the link's history: a ring of the last
+ * `APP_LINK_QUALITY_HISTORY` values. The class of the link is derived from
+ * the average of the ring:
+ *
+ * - WEAK below `APP_LINK_QUALITY_WEAK_DBM`
+ * - STRONG above `APP_LINK_QUALITY_STRONG_DBM`
+ * - NORMAL in between
+ *
+ * Leaving a class takes `APP_LINK_QUALITY_HYSTERESIS_DB` more than entering
+ * it, and no class is given before the ring is half full, so a link does not
+ * flap between classes on a single fading sample. The application adapts
+ * the link (PHY, connection interval) when `app_link_quality_add_sample()`
+ * reports a new class.
+ *
+ * The module holds no Bluetooth state: one history lives in each
+ * `conn_properties` slot.
+ */
+
+#ifndef APP_LINK_QUALITY_H
+#define APP_LINK_QUALITY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Samples kept per link, power of two
+#ifndef APP_LINK_QUALITY_HISTORY
+#define APP_LINK_QUALITY_HISTORY        8
+#endif
+
+// Class thresholds on the average RSSI, dBm
+#ifndef APP_LINK_QUALITY_WEAK_DBM
+#define APP_LINK_QUALITY_WEAK_DBM       (-80)
+#endif
+#ifndef APP_LINK_QUALITY_STRONG_DBM
+#define APP_LINK_QUALITY_STRONG_DBM     (-60)
+#endif
+#ifndef APP_LINK_QUALITY_HYSTERESIS_DB
+#define APP_LINK_QUALITY_HYSTERESIS_DB  4
+#endif
+
+typedef enum
+{
+    APP_LINK_QUALITY_UNKNOWN,           // Not enough samples yet
+    APP_LINK_QUALITY_WEAK,
+    APP_LINK_QUALITY_NORMAL,
+    APP_LINK_QUALITY_STRONG
+} app_link_quality_class_t;
+
+// RSSI history of one link
+typedef struct
+{
+    int8_t rssi[APP_LINK_QUALITY_HISTORY];
+    uint8_t head;                       // Next sample goes here
+    uint8_t count;                      // Valid samples, up to APP_LINK_QUALITY_HISTORY
+    app_link_quality_class_t quality;
+} app_link_quality_t;
+
+/**
+ * @brief Empty a history, the class goes back to UNKNOWN.
+ *
+ * @param[out] lq History of the link
+ */
+void app_link_quality_reset(app_link_quality_t *lq);
+
+/**
+ * @brief Add an RSSI sample and update the class.
+ *
+ * @param[in,out] lq   History of the link
+ * @param[in]     rssi Sample in dBm
+ * @return true if the class changed
+ */
+bool app_link_quality_add_sample(app_link_quality_t *lq, int8_t rssi);
+
+/**
+ * @brief Average of the samples in the history.
+ *
+ * @param[in] lq History of the link
+ * @return Average RSSI in dBm, rounded down; 0 without samples
+ */
+int8_t app_link_quality_average(const app_link_quality_t *lq);
+
+/**
+ * @brief Weakest sample in the history.
+ *
+ * @param[in] lq History of the link
+ * @return Minimum RSSI in dBm; 0 without samples
+ */
+int8_t app_link_quality_min(const app_link_quality_t *lq);
+
+/**
+ * @brief Copy the samples, oldest first.
+ *
+ * @param[in]  lq  History of the link
+ * @param[out] out Destination
+ * @param[in]  max Capacity of out
+ * @return Number of samples copied
+ */
+uint8_t app_link_quality_history(const app_link_quality_t *lq, int8_t *out, uint8_t max);
+
+/**
+ * @brief Name of a class for the console.
+ */
+const char *app_link_quality_name(app_link_quality_class_t quality);
+
+#endif /* APP_LINK_QUALITY_H */
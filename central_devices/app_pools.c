@@ -0,0 +1,25 @@
+#include "app_pools.h"
+
+#if APP_FRAGMENT_BLOCK_COUNT > BLOCK_POOL_MAX_BLOCKS || APP_MESSAGE_BLOCK_COUNT > BLOCK_POOL_MAX_BLOCKS
+#error "Raise BLOCK_POOL_MAX_BLOCKS for the pool sizes"
+#endif
+
+BLOCK_POOL_STORAGE(fragment_storage, APP_FRAGMENT_BLOCK_SIZE, APP_FRAGMENT_BLOCK_COUNT);
+BLOCK_POOL_STORAGE(message_storage, APP_MESSAGE_BLOCK_SIZE, APP_MESSAGE_BLOCK_COUNT);
+
+block_pool_t app_fragment_pool;
+block_pool_t app_message_pool;
+
+void app_pools_init(void)
+{
+    block_pool_init(&app_fragment_pool, "fragment", fragment_storage,
+                    APP_FRAGMENT_BLOCK_SIZE, APP_FRAGMENT_BLOCK_COUNT);
+    block_pool_init(&app_message_pool, "message", message_storage,
+                    APP_MESSAGE_BLOCK_SIZE, APP_MESSAGE_BLOCK_COUNT);
+}
+
+void app_pools_log_stats(void)
+{
+    block_pool_log_stats(&app_fragment_pool);
+    block_pool_log_stats(&app_message_pool);
+}
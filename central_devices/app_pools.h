@@ -0,0 +1,55 @@
+/**
+ * @file app_pools.h
+ * @brief Memory pools shared by the RX (defragmenter) and UART TX paths
+ *
+ * The Central draws all message buffers from two fixed-block pools instead
+ * of per-module worst-case arrays:
+ * - `app_fragment_pool`: one block per queued BLE fragment, received or to send
+ * - `app_message_pool`: one block per reassembled payload, UART egress frame
+ *   or UART input line
+ *
+ * The same RAM can therefore hold many small in-flight messages or a few
+ * large ones. Usage and high-water marks are visible with `app_pools_log_stats()`.
+ */
+
+#ifndef APP_POOLS_H
+#define APP_POOLS_H
+
+#include "app_block_pool.h"
+
+// A fragment block holds one RX queue slot (see ble_defragment_rxdata.c) or
+// one TX fragment (see ble_fragment_txdata.c).
+// RX rings of every link (DEFRAG_LINKS * DEFRAG_LINK_SLOTS) + a full size TX message
+// (11 fragments + its message block), shared by every link it is sent on
+#ifndef APP_FRAGMENT_BLOCK_SIZE
+#define APP_FRAGMENT_BLOCK_SIZE     32
+#endif
+#ifndef APP_FRAGMENT_BLOCK_COUNT
+#define APP_FRAGMENT_BLOCK_COUNT    28
+#endif
+
+// A message block holds a complete payload, a framed egress message or a UART input line.
+// Worst case in flight: 1 reassembling per link (DEFRAG_LINKS) + DEFRAG_COMPLETE_BUFFERS
+// held + egress frames + 1 input line assembling and 1 waiting
+#ifndef APP_MESSAGE_BLOCK_SIZE
+#define APP_MESSAGE_BLOCK_SIZE      256
+#endif
+#ifndef APP_MESSAGE_BLOCK_COUNT
+#define APP_MESSAGE_BLOCK_COUNT     10
+#endif
+
+extern block_pool_t app_fragment_pool;
+extern block_pool_t app_message_pool;
+
+/**
+ * @brief Initialize all application pools. Call once, before any module
+ *        that allocates from them.
+ */
+void app_pools_init(void);
+
+/**
+ * @brief Print usage and high-water marks of all application pools.
+ */
+void app_pools_log_stats(void);
+
+#endif /* APP_POOLS_H */
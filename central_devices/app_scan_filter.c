@@ -0,0 +1,173 @@
+#include <string.h>
+#include "app_scan_filter.h"
+#include "log.h"
+
+// AD types holding service UUID lists
+#define AD_TYPE_UUID16_INCOMPLETE       0x02
+#define AD_TYPE_UUID16_COMPLETE         0x03
+#define AD_TYPE_UUID128_INCOMPLETE      0x06
+#define AD_TYPE_UUID128_COMPLETE        0x07
+
+// Precompiled comparator
+typedef struct
+{
+    uint32_t key128[APP_SCAN_FILTER_MAX_UUIDS];     // First 4 bytes of each 128-bit UUID
+    uint8_t uuid128[APP_SCAN_FILTER_MAX_UUIDS][16];
+    uint8_t uuid128_count;
+    uint16_t uuid16[APP_SCAN_FILTER_MAX_UUIDS];
+    uint8_t uuid16_count;
+    int8_t rssi_min;
+    app_scan_filter_stats_t stats;
+} scan_filter_context_t;
+
+static scan_filter_context_t filter_cxt;
+
+/*******************************************************************************
+ ***************************   LOCAL FUNCTIONS   *******************************
+ *******************************************************************************/
+
+static uint32_t load_u32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static bool uuid128_wanted(const uint8_t *uuid)
+{
+    uint32_t key = load_u32(uuid);
+
+    for(uint8_t i = 0; i < filter_cxt.uuid128_count; i++)
+    {
+        if(key == filter_cxt.key128[i] && memcmp(uuid + 4, &filter_cxt.uuid128[i][4], 12) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool uuid16_wanted(const uint8_t *uuid)
+{
+    uint16_t value = (uint16_t)(uuid[0] | uuid[1] << 8);
+
+    for(uint8_t i = 0; i < filter_cxt.uuid16_count; i++)
+    {
+        if(value == filter_cxt.uuid16[i])
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Walk the AD structures; a field running past the payload ends the walk
+static bool payload_wanted(const uint8_t *data, uint8_t len)
+{
+    uint16_t i = 0;
+
+    while(i + 1u < len)
+    {
+        uint8_t field_len = data[i];
+        uint8_t type = data[i + 1];
+        const uint8_t *value = &data[i + 2];
+        uint8_t value_len;
+
+        if(field_len == 0 || i + 1u + field_len > len)
+        {
+            break;
+        }
+        value_len = field_len - 1;
+
+        if(type == AD_TYPE_UUID128_INCOMPLETE || type == AD_TYPE_UUID128_COMPLETE)
+        {
+            for(uint8_t k = 0; k + 16u <= value_len; k += 16)
+            {
+                if(uuid128_wanted(&value[k]))
+                {
+                    return true;
+                }
+            }
+        }
+        else if(type == AD_TYPE_UUID16_INCOMPLETE || type == AD_TYPE_UUID16_COMPLETE)
+        {
+            for(uint8_t k = 0; k + 2u <= value_len; k += 2)
+            {
+                if(uuid16_wanted(&value[k]))
+                {
+                    return true;
+                }
+            }
+        }
+        i += 1u + field_len;
+    }
+    return false;
+}
+
+/*******************************************************************************
+ ***************************   GLOBAL FUNCTIONS   ******************************
+ ******************************************************************************/
+
+bool app_scan_filter_init(const app_scan_filter_config_t *config)
+{
+    if(config == NULL
+       || config->uuid128_count > APP_SCAN_FILTER_MAX_UUIDS
+       || config->uuid16_count > APP_SCAN_FILTER_MAX_UUIDS)
+    {
+        return false;
+    }
+
+    memset(&filter_cxt, 0, sizeof(filter_cxt));
+    for(size_t i = 0; i < config->uuid128_count; i++)
+    {
+        memcpy(filter_cxt.uuid128[i], config->uuids128[i], 16);
+        filter_cxt.key128[i] = load_u32(config->uuids128[i]);
+    }
+    for(size_t i = 0; i < config->uuid16_count; i++)
+    {
+        filter_cxt.uuid16[i] = config->uuids16[i];
+    }
+    filter_cxt.uuid128_count = (uint8_t)config->uuid128_count;
+    filter_cxt.uuid16_count = (uint8_t)config->uuid16_count;
+    filter_cxt.rssi_min = config->rssi_min;
+    return true;
+}
+
+bool app_scan_filter_check(int8_t rssi, const uint8_t *data, uint8_t len)
+{
+    filter_cxt.stats.reports++;
+
+    if(rssi < filter_cxt.rssi_min)
+    {
+        filter_cxt.stats.rssi_rejects++;
+        return false;
+    }
+
+    filter_cxt.stats.parsed++;
+    if(payload_wanted(data, len))
+    {
+        filter_cxt.stats.matches++;
+        return true;
+    }
+    return false;
+}
+
+void app_scan_filter_get_stats(app_scan_filter_stats_t *stats)
+{
+    if(stats == NULL)
+    {
+        return;
+    }
+    *stats = filter_cxt.stats;
+}
+
+void app_scan_filter_log_stats(void)
+{
+    app_scan_filter_stats_t *s = &filter_cxt.stats;
+
+    LOG_STATS("Scan filter: %lu reports, %lu below RSSI, %lu parsed, %lu matched",
+              (unsigned long)s->reports,
+              (unsigned long)s->rssi_rejects,
+              (unsigned long)s->parsed,
+              (unsigned long)s->matches);
+}
@@ -0,0 +1,82 @@
+/**
+ * @file app_scan_filter.h
+ * @brief Scanner front-end: RSSI gate and UUID match
+ *
+ * In a busy RF environment most advertising reports come from devices the
+ * Central will never connect to, and each of them advertises several times
+ * per second. `app_scan_filter_check()` decides whether a report announces
+ * one of the wanted services, cheapest test first:
+ * 1. RSSI below the threshold: rejected without looking at the payload.
+ * 2. The AD structures are parsed once, with bounds checks, and every UUID
+ *    of the 16-bit (0x02/0x03) and 128-bit (0x06/0x07) service lists is
+ *    compared against the wanted UUIDs. 128-bit UUIDs are compared on a
+ *    precomputed 32-bit key word first, the full compare only runs on a key
+ *    hit.
+ *
+ * No verdict is remembered: a legacy payload is at most 31 bytes, and a
+ * cache of rejected addresses cost more to look up than the walk it saved
+ * (`tools/scan_bench`).
+ *
+ * @note Not thread-safe: call from the Bluetooth event handler only.
+ */
+
+#ifndef APP_SCAN_FILTER_H
+#define APP_SCAN_FILTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Wanted UUIDs of each size
+#define APP_SCAN_FILTER_MAX_UUIDS       4
+
+typedef struct
+{
+    const uint8_t (*uuids128)[16];  // Wanted 128-bit UUIDs, little endian as advertised
+    size_t uuid128_count;
+    const uint16_t *uuids16;        // Wanted 16-bit UUIDs
+    size_t uuid16_count;
+    int8_t rssi_min;                // Reports below this RSSI (dBm) are rejected
+} app_scan_filter_config_t;
+
+// Counters since app_scan_filter_init()
+typedef struct
+{
+    uint32_t reports;           // Reports checked
+    uint32_t rssi_rejects;      // Rejected on RSSI
+    uint32_t parsed;            // Payloads parsed
+    uint32_t matches;           // Reports announcing a wanted UUID
+} app_scan_filter_stats_t;
+
+/**
+ * @brief Precompile the UUID comparator and clear the counters.
+ *
+ * @param[in] config Wanted UUIDs and RSSI threshold
+ * @return false if config is NULL or lists more than APP_SCAN_FILTER_MAX_UUIDS
+ *         UUIDs of one size
+ */
+bool app_scan_filter_init(const app_scan_filter_config_t *config);
+
+/**
+ * @brief Check an advertising report.
+ *
+ * @param[in] rssi RSSI of the report in dBm
+ * @param[in] data Advertising payload (AD structures)
+ * @param[in] len  Length of the payload in bytes
+ * @return true if the payload lists a wanted service UUID
+ */
+bool app_scan_filter_check(int8_t rssi, const uint8_t *data, uint8_t len);
+
+/**
+ * @brief Copy the filter counters.
+ *
+ * @param[out] stats Destination for the counters
+ */
+void app_scan_filter_get_stats(app_scan_filter_stats_t *stats);
+
+/**
+ * @brief Print the filter counters.
+ */
+void app_scan_filter_log_stats(void);
+
+#endif /* APP_SCAN_FILTER_H */
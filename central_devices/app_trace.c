@@ -0,0 +1,227 @@
+#include <stdbool.h>
+#include <string.h>
+#include "sl_core.h"
+#include "sl_sleeptimer.h"
+#include "app_trace.h"
+#include "app_cycle_stats.h"
+#include "app_uart_frame.h"
+#include "app_uart_egress.h"
+#include "log.h"
+
+#define APP_TRACE_FILE_ID   0       // Reserved: sync record and benchmark
+
+#if (APP_TRACE_BUFFER_WORDS & (APP_TRACE_BUFFER_WORDS - 1)) != 0 || APP_TRACE_BUFFER_WORDS > 0x8000
+#error "APP_TRACE_BUFFER_WORDS must be a power of two, at most 32768"
+#endif
+
+#if defined(APP_TRACE_BENCHMARK) && !APP_TRACE_ENABLE
+#error "APP_TRACE_BENCHMARK needs APP_TRACE_ENABLE"
+#endif
+
+#define TRACE_MASK              (APP_TRACE_BUFFER_WORDS - 1u)
+#define TRACE_SYNC_HEADER       APP_TRACE_HEADER(0, 0, 1)
+
+// Context of the trace ring
+typedef struct
+{
+    uint32_t ring[APP_TRACE_BUFFER_WORDS];
+    volatile uint32_t head;             // Next word to write, free running
+    volatile uint32_t tail;             // Oldest word not shipped, free running
+    uint32_t last_record;               // Timestamp of the newest record
+    uint8_t seq;                        // Sequence number of the next call
+    uint8_t frame[APP_UART_FRAME_ENCODED_SIZE(APP_UART_FRAME_MAX_PAYLOAD)];  // Borrowed by the egress
+    volatile bool frame_busy;
+    app_trace_stats_t stats;
+} trace_context_t;
+
+static trace_context_t trace_cxt;
+
+/*******************************************************************************
+ ***************************   LOCAL FUNCTIONS   *******************************
+ *******************************************************************************/
+
+#if APP_TRACE_ENABLE
+// Interrupt context: the egress has sent the frame
+static void trace_frame_sent(const uint8_t *data, size_t len)
+{
+    (void)data;
+    (void)len;
+
+    trace_cxt.frame_busy = false;
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static void record_sync(void)
+{
+    app_trace_record(TRACE_SYNC_HEADER, sl_sleeptimer_get_timer_frequency(), 0, 0, 0);
+}
+#endif
+
+/*******************************************************************************
+ ***************************   GLOBAL FUNCTIONS   ******************************
+ ******************************************************************************/
+
+void app_trace_init(void)
+{
+#if APP_TRACE_ENABLE
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+    trace_cxt.head = trace_cxt.tail;
+    trace_cxt.seq = 0;
+    memset(&trace_cxt.stats, 0, sizeof(trace_cxt.stats));
+    CORE_EXIT_CRITICAL();
+
+    record_sync();
+#endif
+}
+
+void app_trace_record(uint32_t header, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3)
+{
+    uint32_t now = sl_sleeptimer_get_tick_count();
+    uint32_t nargs = (header >> 20) & 0x7u;
+    uint32_t words = 2 + nargs;
+
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+    uint32_t head = trace_cxt.head;
+    uint32_t used = head - trace_cxt.tail;
+
+    header |= (uint32_t)trace_cxt.seq++ << 24;
+    if(APP_TRACE_BUFFER_WORDS - used < words)
+    {
+        trace_cxt.stats.dropped++;
+        CORE_EXIT_CRITICAL();
+        return;
+    }
+
+    trace_cxt.ring[head++ & TRACE_MASK] = header;
+    trace_cxt.ring[head++ & TRACE_MASK] = now;
+    switch(nargs)
+    {
+        case 4: trace_cxt.ring[(head + 3) & TRACE_MASK] = a3;   // Fall through
+        case 3: trace_cxt.ring[(head + 2) & TRACE_MASK] = a2;   // Fall through
+        case 2: trace_cxt.ring[(head + 1) & TRACE_MASK] = a1;   // Fall through
+        case 1: trace_cxt.ring[head & TRACE_MASK] = a0;         // Fall through
+        default: break;
+    }
+    trace_cxt.head = head + nargs;
+    trace_cxt.last_record = now;
+    trace_cxt.stats.records++;
+    if(used + words > trace_cxt.stats.high_water)
+    {
+        trace_cxt.stats.high_water = (uint16_t)(used + words);
+    }
+    CORE_EXIT_CRITICAL();
+}
+
+void app_trace_process(void)
+{
+#if APP_TRACE_ENABLE
+    uint8_t payload[APP_UART_FRAME_MAX_PAYLOAD];
+    size_t len = 0;
+    uint32_t records = 0;
+
+    // Keeps the host able to unwrap the tick count across quiet periods
+    if(sl_sleeptimer_get_tick_count() - trace_cxt.last_record >= APP_TRACE_SYNC_TICKS)
+    {
+        record_sync();
+    }
+
+    if(trace_cxt.frame_busy || trace_cxt.head == trace_cxt.tail || app_uart_egress_is_congested())
+    {
+        return;
+    }
+
+    // Whole records only; the writer never touches words between tail and head
+    uint32_t tail = trace_cxt.tail;
+    uint32_t head = trace_cxt.head;
+    payload[len++] = APP_TRACE_FRAME_TAG;
+    while(tail != head)
+    {
+        uint32_t header = trace_cxt.ring[tail & TRACE_MASK];
+        uint32_t words = 2 + ((header >> 20) & 0x7u);
+
+        if(len + words * sizeof(uint32_t) > sizeof(payload))
+        {
+            break;
+        }
+        for(uint32_t i = 0; i < words; i++)
+        {
+            put_u32(&payload[len], trace_cxt.ring[(tail + i) & TRACE_MASK]);
+            len += sizeof(uint32_t);
+        }
+        tail += words;
+        records++;
+    }
+    trace_cxt.tail = tail;
+
+    size_t frame_len = app_uart_frame_encode_control(payload, len, trace_cxt.frame, sizeof(trace_cxt.frame));
+    trace_cxt.frame_busy = true;
+    if(app_uart_egress_send_buffer(trace_cxt.frame, frame_len, trace_frame_sent) != SL_STATUS_OK)
+    {
+        // The records are already out of the ring: count them as lost
+        trace_cxt.frame_busy = false;
+        trace_cxt.stats.dropped += records;
+        return;
+    }
+    trace_cxt.stats.frames_sent++;
+#endif
+}
+
+void app_trace_get_stats(app_trace_stats_t *stats)
+{
+    if(stats == NULL)
+    {
+        return;
+    }
+
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+    *stats = trace_cxt.stats;
+    CORE_EXIT_CRITICAL();
+}
+
+void app_trace_log_stats(void)
+{
+#if APP_TRACE_ENABLE
+    app_trace_stats_t stats;
+    app_trace_get_stats(&stats);
+
+    LOG_STATS("Trace: %lu records, %lu dropped, %lu frames, high-water %u/%u words",
+              (unsigned long)stats.records,
+              (unsigned long)stats.dropped,
+              (unsigned long)stats.frames_sent,
+              stats.high_water,
+              (unsigned int)APP_TRACE_BUFFER_WORDS);
+#endif
+}
+
+#ifdef APP_TRACE_BENCHMARK
+void app_trace_log_benchmark(void)
+{
+    app_cycle_stats_t trace_cycles = APP_CYCLE_STATS_INIT("APP_TRACE, 2 args");
+    app_cycle_stats_t printf_cycles = APP_CYCLE_STATS_INIT("printf log, 2 args");
+
+    for(uint32_t i = 0; i < 32; i++)
+    {
+        uint32_t start = app_cycle_counter_now();
+        APP_TRACE("benchmark %lu of %u", (unsigned long)i, 32u);
+        app_cycle_stats_add(&trace_cycles, start);
+
+        start = app_cycle_counter_now();
+        LOG_DEBUG("benchmark %lu of %u", (unsigned long)i, 32u);
+        app_cycle_stats_add(&printf_cycles, start);
+    }
+
+    app_trace_init();   // Discard the benchmark records
+    app_cycle_stats_log(&trace_cycles);
+    app_cycle_stats_log(&printf_cycles);
+}
+#endif
@@ -0,0 +1,316 @@
+#include <string.h>
+#include "em_device.h"
+#include "sl_core.h"
+#include "dmadrv.h"
+#include "sl_iostream_usart_vcom_config.h"
+#include "app_uart_egress.h"
+#include "app_uart_frame.h"
+#include "app_pools.h"
+#include "log.h"
+#if APP_UART_EGRESS_SIM_BYTES_PER_SEC > 0
+#include "sl_sleeptimer.h"
+#endif
+
+#define HIGH_WATER_FRAMES   ((APP_UART_EGRESS_QUEUE_DEPTH * APP_UART_EGRESS_HIGH_WATERMARK) / 100)
+#define LOW_WATER_FRAMES    ((APP_UART_EGRESS_QUEUE_DEPTH * APP_UART_EGRESS_LOW_WATERMARK) / 100)
+
+#if APP_UART_FRAME_ENCODED_SIZE(APP_UART_FRAME_MAX_PAYLOAD) > APP_MESSAGE_BLOCK_SIZE
+#error "A full size frame must fit in a block of app_message_pool"
+#endif
+
+#if !defined(SL_IOSTREAM_USART_VCOM_PERIPHERAL) || !defined(SL_IOSTREAM_USART_VCOM_PERIPHERAL_NO)
+#error "The egress writes to the USART of the vcom iostream instance"
+#endif
+
+// Same USART as the vcom iostream, so the frames go out on its pins
+#define EGRESS_SIGNAL_(no)  dmadrvPeripheralSignal_USART##no##_TXBL
+#define EGRESS_SIGNAL(no)   EGRESS_SIGNAL_(no)
+#define EGRESS_DMA_SIGNAL   EGRESS_SIGNAL(SL_IOSTREAM_USART_VCOM_PERIPHERAL_NO)
+#define EGRESS_TX_REGISTER  (&SL_IOSTREAM_USART_VCOM_PERIPHERAL->TXDATA)
+
+// One queued transfer: a frame block of app_message_pool, or a caller buffer
+typedef struct
+{
+    const uint8_t *data;
+    uint16_t len;
+    app_uart_egress_done_t done;        // NULL for frame blocks (freed to the pool)
+} egress_entry_t;
+
+// Context of the egress channel
+typedef struct
+{
+    egress_entry_t entries[APP_UART_EGRESS_QUEUE_DEPTH];
+    volatile uint8_t head;              // Written by the main loop only
+    volatile uint8_t tail;              // Advanced by the LDMA callback only
+    volatile uint8_t count;             // Entries queued, including the one in flight
+    volatile bool dma_busy;
+    volatile bool held;                 // No new transfer starts while set
+    unsigned int dma_channel;
+    bool initialized;
+    bool reported_congested;            // Last congestion state reported on the log
+#if APP_UART_EGRESS_SIM_BYTES_PER_SEC > 0
+    uint32_t sim_next_start;            // Tick before which no frame may start
+#endif
+    app_uart_egress_stats_t stats;
+} egress_context_t;
+
+static egress_context_t egress_cxt = {0};
+
+/*******************************************************************************
+ ***************************   LOCAL FUNCTIONS   *******************************
+ *******************************************************************************/
+
+static uint8_t next_entry_index(uint8_t i)
+{
+    return (uint8_t)((i + 1) % APP_UART_EGRESS_QUEUE_DEPTH);
+}
+
+static bool dma_complete_callback(unsigned int channel, unsigned int sequence_no, void *user_param);
+
+// Start sending the oldest queued entry. Caller holds the critical section.
+static void start_dma_entry(void)
+{
+    if(egress_cxt.dma_busy || egress_cxt.held || egress_cxt.count == 0)
+    {
+        return;
+    }
+
+#if APP_UART_EGRESS_SIM_BYTES_PER_SEC > 0
+    // Slow consumer simulation: hold each entry for its share of the budget
+    uint32_t now = sl_sleeptimer_get_tick_count();
+    if((int32_t)(now - egress_cxt.sim_next_start) < 0)
+    {
+        return;
+    }
+    uint32_t hold_ticks = (uint32_t)(((uint64_t)egress_cxt.entries[egress_cxt.tail].len
+                                      * sl_sleeptimer_get_timer_frequency())
+                                     / APP_UART_EGRESS_SIM_BYTES_PER_SEC);
+    egress_cxt.sim_next_start = now + hold_ticks;
+#endif
+
+    egress_cxt.dma_busy = true;
+    Ecode_t ec = DMADRV_MemoryPeripheral(egress_cxt.dma_channel,
+                                         EGRESS_DMA_SIGNAL,
+                                         (void *)EGRESS_TX_REGISTER,
+                                         (void *)egress_cxt.entries[egress_cxt.tail].data,
+                                         true,
+                                         egress_cxt.entries[egress_cxt.tail].len,
+                                         dmadrvDataSize1,
+                                         dma_complete_callback,
+                                         NULL);
+    if(ec != ECODE_EMDRV_DMADRV_OK)
+    {
+        // Keep the entry queued, app_uart_egress_process() retries
+        egress_cxt.dma_busy = false;
+    }
+}
+
+// Interrupt context: release the finished entry and chain the next one
+static bool dma_complete_callback(unsigned int channel, unsigned int sequence_no, void *user_param)
+{
+    (void)channel;
+    (void)sequence_no;
+    (void)user_param;
+
+    egress_entry_t *entry = &egress_cxt.entries[egress_cxt.tail];
+    egress_cxt.stats.bytes_sent += entry->len;
+    if(entry->done != NULL)
+    {
+        entry->done(entry->data, entry->len);
+    }
+    else
+    {
+        block_pool_free(&app_message_pool, (void *)entry->data);
+    }
+    entry->data = NULL;
+
+    egress_cxt.tail = next_entry_index(egress_cxt.tail);
+    egress_cxt.count--;
+    egress_cxt.dma_busy = false;
+
+    start_dma_entry();
+    return true;
+}
+
+// Publish an entry at the head of the queue and kick the DMA. Main loop only.
+static void enqueue_entry(const uint8_t *data, size_t len, app_uart_egress_done_t done)
+{
+    egress_entry_t *entry = &egress_cxt.entries[egress_cxt.head];
+    entry->data = data;
+    entry->len = (uint16_t)len;
+    entry->done = done;
+    egress_cxt.head = next_entry_index(egress_cxt.head);
+
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+    egress_cxt.count++;
+    start_dma_entry();
+    CORE_EXIT_CRITICAL();
+}
+
+static void update_congestion(uint8_t used)
+{
+    if(used > egress_cxt.stats.queue_high_water)
+    {
+        egress_cxt.stats.queue_high_water = used;
+    }
+
+    if(!egress_cxt.stats.congested && used >= HIGH_WATER_FRAMES)
+    {
+        egress_cxt.stats.congested = true;
+    }
+    else if(egress_cxt.stats.congested && used <= LOW_WATER_FRAMES)
+    {
+        egress_cxt.stats.congested = false;
+    }
+}
+
+/*******************************************************************************
+ ***************************   GLOBAL FUNCTIONS   ******************************
+ ******************************************************************************/
+
+sl_status_t app_uart_egress_init(void)
+{
+    memset(&egress_cxt, 0, sizeof(egress_context_t));
+
+    // DMADRV may already be initialized by another driver, that is fine
+    DMADRV_Init();
+    if(DMADRV_AllocateChannel(&egress_cxt.dma_channel, NULL) != ECODE_EMDRV_DMADRV_OK)
+    {
+        LOG_ERROR("No LDMA channel for UART egress");
+        return SL_STATUS_FAIL;
+    }
+
+    egress_cxt.initialized = true;
+    LOG_INFO("UART egress ready, %u frames queue", (unsigned int)APP_UART_EGRESS_QUEUE_DEPTH);
+#if APP_UART_EGRESS_SIM_BYTES_PER_SEC > 0
+    LOG_INFO("UART egress SIMULATES a slow host: %u bytes/s", (unsigned int)APP_UART_EGRESS_SIM_BYTES_PER_SEC);
+#endif
+    return SL_STATUS_OK;
+}
+
+sl_status_t app_uart_egress_write(const uint8_t *payload, size_t len)
+{
+    if(!egress_cxt.initialized || payload == NULL || len == 0
+       || len > APP_UART_FRAME_MAX_PAYLOAD)
+    {
+        return SL_STATUS_INVALID_PARAMETER;
+    }
+
+    // Only the main loop enqueues, so count can only shrink until we publish
+    if(egress_cxt.count >= APP_UART_EGRESS_QUEUE_DEPTH)
+    {
+        egress_cxt.stats.frames_dropped++;
+        update_congestion(egress_cxt.count);
+        return SL_STATUS_NO_MORE_RESOURCE;
+    }
+
+    uint8_t *frame = block_pool_alloc(&app_message_pool);
+    if(frame == NULL)
+    {
+        egress_cxt.stats.frames_dropped++;
+        return SL_STATUS_NO_MORE_RESOURCE;
+    }
+
+    // Frame: [0x00 | COBS(len | payload | CRC-16) | 0x00], see app_uart_frame.h
+    size_t frame_len = app_uart_frame_encode(payload, len, frame, app_message_pool.block_size);
+
+    enqueue_entry(frame, frame_len, NULL);
+    egress_cxt.stats.frames_queued++;
+
+    update_congestion(egress_cxt.count);
+    return SL_STATUS_OK;
+}
+
+sl_status_t app_uart_egress_send_buffer(const uint8_t *data, size_t len, app_uart_egress_done_t done)
+{
+    if(!egress_cxt.initialized || data == NULL || len == 0 || len > APP_UART_EGRESS_MAX_BUFFER
+       || done == NULL)
+    {
+        return SL_STATUS_INVALID_PARAMETER;
+    }
+
+    if(egress_cxt.count >= APP_UART_EGRESS_QUEUE_DEPTH)
+    {
+        return SL_STATUS_NO_MORE_RESOURCE;
+    }
+
+    enqueue_entry(data, len, done);
+    update_congestion(egress_cxt.count);
+    return SL_STATUS_OK;
+}
+
+bool app_uart_egress_can_accept(size_t len)
+{
+    return egress_cxt.initialized
+           && len > 0 && len <= APP_UART_FRAME_MAX_PAYLOAD
+           && egress_cxt.count < APP_UART_EGRESS_QUEUE_DEPTH
+           && block_pool_available(&app_message_pool) > 0;
+}
+
+void app_uart_egress_set_hold(bool hold)
+{
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+    egress_cxt.held = hold;
+    if(!hold && egress_cxt.initialized)
+    {
+        start_dma_entry();
+    }
+    CORE_EXIT_CRITICAL();
+}
+
+bool app_uart_egress_is_congested(void)
+{
+    return egress_cxt.stats.congested;
+}
+
+bool app_uart_egress_is_idle(void)
+{
+    return !egress_cxt.dma_busy;
+}
+
+void app_uart_egress_get_stats(app_uart_egress_stats_t *stats)
+{
+    if(stats == NULL)
+    {
+        return;
+    }
+
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+    *stats = egress_cxt.stats;
+    stats->queue_used = egress_cxt.count;
+    CORE_EXIT_CRITICAL();
+}
+
+void app_uart_egress_process(void)
+{
+    if(!egress_cxt.initialized)
+    {
+        return;
+    }
+
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+    start_dma_entry();
+    CORE_EXIT_CRITICAL();
+
+    // The queue drains in interrupt context, re-evaluate the low watermark here
+    update_congestion(egress_cxt.count);
+
+    if(egress_cxt.stats.congested != egress_cxt.reported_congested)
+    {
+        egress_cxt.reported_congested = egress_cxt.stats.congested;
+        if(egress_cxt.stats.congested)
+        {
+            LOG_WARN("UART egress CONGESTED: host reads too slowly (queued %u, dropped %lu)",
+                     (unsigned int)egress_cxt.count,
+                     (unsigned long)egress_cxt.stats.frames_dropped);
+        }
+        else
+        {
+            LOG_INFO("UART egress recovered (queued %u)", (unsigned int)egress_cxt.count);
+        }
+    }
+}
@@ -0,0 +1,174 @@
+/**
+ * @file app_uart_egress.h
+ * @brief Asynchronous UART egress channel for payload frames and console text
+ *
+ * This module sends data to the host without blocking the BLE event loop.
+ * Each payload is framed into a block of `app_message_pool` and the block is
+ * queued for transmission; the queue is drained in the background by LDMA
+ * (through DMADRV) into the VCOM USART TX register. The console ring
+ * (`app_console.h`) queues its text through the same channel, so frames and
+ * log text never interleave inside a transfer.
+ *
+ * Implementation notes (see `app_uart_egress.c`):
+ * - Frame layout on the wire (see `app_uart_frame.h`):
+ *   [0x00 | COBS(length LSB | length MSB | payload | CRC-16) | 0x00]
+ *   0x00 never appears inside a frame, so the host can separate frames from
+ *   log text sent on the same UART and resynchronize on any delimiter.
+ * - A frame is either queued completely or rejected, it is never truncated.
+ * - One LDMA transfer sends one queue entry; the completion callback
+ *   (interrupt context) returns a frame block to the pool, or calls the
+ *   owner's `app_uart_egress_done_t` for a borrowed buffer, and chains the
+ *   next entry.
+ * - Backpressure: when the number of queued frames crosses the high
+ *   watermark the channel reports "congested" until it drops below the low
+ *   watermark. A host that reads too slowly therefore shows up as congestion
+ *   and then as rejected frames in `app_uart_egress_stats_t`.
+ */
+
+#ifndef APP_UART_EGRESS_H
+#define APP_UART_EGRESS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "sl_status.h"
+
+// Maximum number of frames waiting for the UART
+#ifndef APP_UART_EGRESS_QUEUE_DEPTH
+#define APP_UART_EGRESS_QUEUE_DEPTH     8
+#endif
+
+// Congestion hysteresis, in percent of the queue depth
+#ifndef APP_UART_EGRESS_HIGH_WATERMARK
+#define APP_UART_EGRESS_HIGH_WATERMARK  75
+#endif
+#ifndef APP_UART_EGRESS_LOW_WATERMARK
+#define APP_UART_EGRESS_LOW_WATERMARK   25
+#endif
+
+// Test hook: when non-zero the queue drains at most this many bytes per
+// second, simulating a host that reads slowly. Keep 0 in production builds.
+#ifndef APP_UART_EGRESS_SIM_BYTES_PER_SEC
+#define APP_UART_EGRESS_SIM_BYTES_PER_SEC  0
+#endif
+
+// Largest caller buffer accepted by app_uart_egress_send_buffer()
+#define APP_UART_EGRESS_MAX_BUFFER      1024
+
+/**
+ * @brief Called from interrupt context once a borrowed buffer has been sent.
+ *
+ * @param[in] data Buffer given to `app_uart_egress_send_buffer()`
+ * @param[in] len  Its length
+ */
+typedef void (*app_uart_egress_done_t)(const uint8_t *data, size_t len);
+
+// Counters describing the egress channel since app_uart_egress_init()
+typedef struct
+{
+    uint32_t frames_queued;     // Frames accepted into the queue
+    uint32_t frames_dropped;    // Frames rejected (queue full or pool empty)
+    uint32_t bytes_sent;        // Bytes handed to the USART by LDMA (frames and text)
+    uint16_t queue_used;        // Entries currently queued or in flight
+    uint16_t queue_high_water;  // Highest number of queued entries seen
+    bool congested;             // Above high watermark (hysteresis)
+} app_uart_egress_stats_t;
+
+/**
+ * @brief Initialize the egress queue and allocate the LDMA channel.
+ *
+ * Must be called after the iostream USART and `app_pools_init()`, typically
+ * from `app_init()` right after `app_iostream_usart_init()`.
+ *
+ * @return SL_STATUS_OK on success, SL_STATUS_FAIL if no DMA channel is available
+ */
+sl_status_t app_uart_egress_init(void);
+
+/**
+ * @brief Frame a payload and queue it for background transmission.
+ *
+ * The call copies the payload, so the caller may reuse its buffer as soon as
+ * the function returns. It never waits for the UART.
+ *
+ * @param[in] payload Pointer to the payload bytes
+ * @param[in] len     Length of the payload in bytes (1..APP_UART_FRAME_MAX_PAYLOAD)
+ * @return SL_STATUS_OK if queued,
+ *         SL_STATUS_INVALID_PARAMETER on bad arguments,
+ *         SL_STATUS_NO_MORE_RESOURCE if there is no room (frame dropped)
+ */
+sl_status_t app_uart_egress_write(const uint8_t *payload, size_t len);
+
+/**
+ * @brief Queue a caller buffer for transmission as is, without framing.
+ *
+ * The buffer is borrowed: it must stay unchanged until `done` is called
+ * from interrupt context. Used by the console to send log text.
+ *
+ * @param[in] data Pointer to the bytes
+ * @param[in] len  Number of bytes (1..APP_UART_EGRESS_MAX_BUFFER)
+ * @param[in] done Callback releasing the buffer, must not be NULL
+ * @return SL_STATUS_OK if queued,
+ *         SL_STATUS_INVALID_PARAMETER on bad arguments or before init,
+ *         SL_STATUS_NO_MORE_RESOURCE if the queue is full
+ */
+sl_status_t app_uart_egress_send_buffer(const uint8_t *data, size_t len, app_uart_egress_done_t done);
+
+/**
+ * @brief Check whether a payload of the given length can be queued now.
+ *
+ * Lets a producer keep its data and retry later instead of having the frame
+ * dropped by `app_uart_egress_write()`.
+ *
+ * @param[in] len Length of the payload in bytes
+ * @return true if a queue entry and a pool block are available
+ */
+bool app_uart_egress_can_accept(size_t len);
+
+/**
+ * @brief Stop or resume starting new transfers.
+ *
+ * The transfer in progress always completes. While held, entries are still
+ * queued and are sent after the hold is released. Safe to call from an
+ * `app_uart_egress_done_t` callback, which lets a producer stop the queue
+ * right after its own buffer (e.g. before a baud rate change).
+ *
+ * @param[in] hold true to hold, false to resume
+ */
+void app_uart_egress_set_hold(bool hold);
+
+/**
+ * @brief Check whether the egress queue is above its high watermark.
+ *
+ * Producers can use this as a backpressure signal and slow down before
+ * frames start being dropped.
+ *
+ * @return true while congested
+ */
+bool app_uart_egress_is_congested(void);
+
+/**
+ * @brief Check that no transfer is running.
+ *
+ * Together with `app_uart_egress_set_hold()`, tells when the USART can be
+ * reconfigured without cutting a transfer.
+ *
+ * @return true if the DMA is not sending anything
+ */
+bool app_uart_egress_is_idle(void);
+
+/**
+ * @brief Copy the current egress counters.
+ *
+ * @param[out] stats Destination for the counters
+ */
+void app_uart_egress_get_stats(app_uart_egress_stats_t *stats);
+
+/**
+ * @brief Housekeeping hook, call from `app_process_action()`.
+ *
+ * Restarts the LDMA drain if it is idle with data pending and reports
+ * congestion transitions on the log.
+ */
+void app_uart_egress_process(void);
+
+#endif /* APP_UART_EGRESS_H */
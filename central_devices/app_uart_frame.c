@@ -0,0 +1,179 @@
+#include <string.h>
+#include "app_uart_frame.h"
+
+// Incremental COBS encoder writing into a caller buffer
+typedef struct
+{
+    uint8_t *out;
+    size_t pos;             // Next byte to write
+    size_t code_pos;        // Position of the current block code byte
+    uint8_t code;           // Length of the current block + 1
+} cobs_encoder_t;
+
+/*******************************************************************************
+ ***************************   LOCAL FUNCTIONS   *******************************
+ *******************************************************************************/
+
+static void cobs_start_block(cobs_encoder_t *enc)
+{
+    enc->code_pos = enc->pos++;
+    enc->code = 1;
+}
+
+static void cobs_put(cobs_encoder_t *enc, uint8_t byte)
+{
+    if(byte == 0)
+    {
+        enc->out[enc->code_pos] = enc->code;
+        cobs_start_block(enc);
+        return;
+    }
+
+    enc->out[enc->pos++] = byte;
+    enc->code++;
+    if(enc->code == 0xFF)
+    {
+        // Longest block: 254 data bytes without an implicit zero
+        enc->out[enc->code_pos] = enc->code;
+        cobs_start_block(enc);
+    }
+}
+
+static void cobs_put_buffer(cobs_encoder_t *enc, const uint8_t *data, size_t len)
+{
+    for(size_t i = 0; i < len; i++)
+    {
+        cobs_put(enc, data[i]);
+    }
+}
+
+static void cobs_finish(cobs_encoder_t *enc)
+{
+    enc->out[enc->code_pos] = enc->code;
+}
+
+// Decode in place: the write position never passes the read position
+static size_t cobs_decode(uint8_t *buf, size_t len, bool *ok)
+{
+    size_t r = 0;
+    size_t w = 0;
+
+    *ok = false;
+    while(r < len)
+    {
+        uint8_t code = buf[r++];
+        if(code == 0 || (size_t)(code - 1) > len - r)
+        {
+            return 0;
+        }
+        for(uint8_t i = 1; i < code; i++)
+        {
+            buf[w++] = buf[r++];
+        }
+        // Every block but the last and the 254-byte ones ends with a zero
+        if(code != 0xFF && r < len)
+        {
+            buf[w++] = 0;
+        }
+    }
+
+    *ok = true;
+    return w;
+}
+
+// Common encoder of data and control frames
+static size_t encode_frame(const uint8_t *payload, size_t len, uint16_t flags,
+                           uint8_t *out, size_t out_size)
+{
+    if(payload == NULL || out == NULL || len == 0 || len > APP_UART_FRAME_MAX_PAYLOAD
+       || out_size < APP_UART_FRAME_ENCODED_SIZE(len))
+    {
+        return 0;
+    }
+
+    uint16_t length_field = (uint16_t)(len | flags);
+    uint8_t header[APP_UART_FRAME_HEADER_SIZE] = { (uint8_t)(length_field & 0xFF), (uint8_t)(length_field >> 8) };
+    uint16_t crc = app_uart_frame_crc16(0xFFFF, header, sizeof(header));
+    crc = app_uart_frame_crc16(crc, payload, len);
+    uint8_t trailer[APP_UART_FRAME_CRC_SIZE] = { (uint8_t)(crc & 0xFF), (uint8_t)(crc >> 8) };
+
+    cobs_encoder_t enc = { .out = out, .pos = 0 };
+    out[enc.pos++] = APP_UART_FRAME_DELIMITER;
+    cobs_start_block(&enc);
+    cobs_put_buffer(&enc, header, sizeof(header));
+    cobs_put_buffer(&enc, payload, len);
+    cobs_put_buffer(&enc, trailer, sizeof(trailer));
+    cobs_finish(&enc);
+    out[enc.pos++] = APP_UART_FRAME_DELIMITER;
+
+    return enc.pos;
+}
+
+/*******************************************************************************
+ ***************************   GLOBAL FUNCTIONS   ******************************
+ ******************************************************************************/
+
+uint16_t app_uart_frame_crc16(uint16_t crc, const uint8_t *data, size_t len)
+{
+    for(size_t i = 0; i < len; i++)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+        for(int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+
+    return crc;
+}
+
+size_t app_uart_frame_encode(const uint8_t *payload, size_t len,
+                             uint8_t *out, size_t out_size)
+{
+    return encode_frame(payload, len, 0, out, out_size);
+}
+
+size_t app_uart_frame_encode_control(const uint8_t *payload, size_t len,
+                                     uint8_t *out, size_t out_size)
+{
+    return encode_frame(payload, len, APP_UART_FRAME_CONTROL_FLAG, out, out_size);
+}
+
+bool app_uart_frame_decode(uint8_t *buf, size_t cobs_len, size_t *payload_len, bool *is_control)
+{
+    bool ok;
+
+    if(buf == NULL || payload_len == NULL)
+    {
+        return false;
+    }
+
+    size_t raw_len = cobs_decode(buf, cobs_len, &ok);
+    if(!ok || raw_len < APP_UART_FRAME_HEADER_SIZE + APP_UART_FRAME_CRC_SIZE + 1)
+    {
+        return false;
+    }
+
+    uint16_t length_field = (uint16_t)(buf[0] | (buf[1] << 8));
+    size_t len = length_field & (uint16_t)~APP_UART_FRAME_CONTROL_FLAG;
+    if(len > APP_UART_FRAME_MAX_PAYLOAD
+       || len != raw_len - APP_UART_FRAME_HEADER_SIZE - APP_UART_FRAME_CRC_SIZE)
+    {
+        return false;
+    }
+
+    uint16_t crc = app_uart_frame_crc16(0xFFFF, buf, APP_UART_FRAME_HEADER_SIZE + len);
+    uint16_t rx_crc = (uint16_t)buf[raw_len - 2] | (uint16_t)(buf[raw_len - 1] << 8);
+    if(crc != rx_crc)
+    {
+        return false;
+    }
+
+    memmove(buf, buf + APP_UART_FRAME_HEADER_SIZE, len);
+    *payload_len = len;
+    if(is_control)
+    {
+        *is_control = (length_field & APP_UART_FRAME_CONTROL_FLAG) != 0;
+    }
+    return true;
+}
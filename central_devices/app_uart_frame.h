@@ -0,0 +1,100 @@
+/**
+ * @file app_uart_frame.h
+ * @brief Binary UART framing: COBS, length field and CRC-16
+ *
+ * Lets the host and the boards exchange arbitrary binary payloads over the
+ * same UART that carries text logs. A frame on the wire is:
+ *
+ *   0x00 | COBS( length LSB | length MSB | payload | CRC LSB | CRC MSB ) | 0x00
+ *
+ * - COBS (Consistent Overhead Byte Stuffing) removes every 0x00 byte from the
+ *   encoded block, so 0x00 only appears as a frame delimiter. Text lines never
+ *   contain 0x00, which keeps frames and log text separable on one stream.
+ * - The length field is the payload length, little endian. Bit 15 marks a
+ *   control frame (UART link management, see `app_uart_link.h`); control
+ *   frames are consumed by the receiver and never forwarded over BLE.
+ * - The CRC is CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) over the length
+ *   field and the payload.
+ * - Both delimiters are always sent; a receiver that lost sync drops bytes
+ *   up to the next 0x00 and resumes with the following frame.
+ *
+ * @note This component is designed to be reusable across different projects,
+ *       the Central and the Peripheral use the same copy.
+ */
+
+#ifndef APP_UART_FRAME_H
+#define APP_UART_FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define APP_UART_FRAME_DELIMITER    0x00
+
+// Largest payload of a frame, same as the BLE message limit
+#ifndef APP_UART_FRAME_MAX_PAYLOAD
+#define APP_UART_FRAME_MAX_PAYLOAD  200
+#endif
+
+// Bit of the length field marking a control frame
+#define APP_UART_FRAME_CONTROL_FLAG 0x8000u
+
+// Length field + CRC around the payload, before COBS
+#define APP_UART_FRAME_HEADER_SIZE  2
+#define APP_UART_FRAME_CRC_SIZE     2
+
+// Bytes of the COBS block (no delimiters) for a payload of len bytes
+#define APP_UART_FRAME_COBS_SIZE(len) \
+    (((len) + APP_UART_FRAME_HEADER_SIZE + APP_UART_FRAME_CRC_SIZE) \
+     + (((len) + APP_UART_FRAME_HEADER_SIZE + APP_UART_FRAME_CRC_SIZE) / 254) + 1)
+
+// Bytes on the wire for a payload of len bytes, delimiters included
+#define APP_UART_FRAME_ENCODED_SIZE(len)    (APP_UART_FRAME_COBS_SIZE(len) + 2)
+
+/**
+ * @brief Compute the CRC-16/CCITT-FALSE of a buffer.
+ *
+ * @param[in] crc  Initial value, 0xFFFF for a new computation
+ * @param[in] data Pointer to the bytes
+ * @param[in] len  Number of bytes
+ * @return Updated CRC
+ */
+uint16_t app_uart_frame_crc16(uint16_t crc, const uint8_t *data, size_t len);
+
+/**
+ * @brief Build a complete frame, delimiters included.
+ *
+ * @param[in]  payload  Pointer to the payload bytes
+ * @param[in]  len      Payload length (1..APP_UART_FRAME_MAX_PAYLOAD)
+ * @param[out] out      Destination buffer, must not overlap the payload
+ * @param[in]  out_size Size of the destination buffer
+ * @return Number of bytes written, 0 if the arguments are invalid or the
+ *         frame does not fit (see `APP_UART_FRAME_ENCODED_SIZE()`)
+ */
+size_t app_uart_frame_encode(const uint8_t *payload, size_t len,
+                             uint8_t *out, size_t out_size);
+
+/**
+ * @brief Build a complete control frame, delimiters included.
+ *
+ * Same as `app_uart_frame_encode()` with the control flag set in the length
+ * field.
+ */
+size_t app_uart_frame_encode_control(const uint8_t *payload, size_t len,
+                                     uint8_t *out, size_t out_size);
+
+/**
+ * @brief Decode a received COBS block in place.
+ *
+ * The block is what was received between two delimiters. On success the
+ * payload is moved to the start of the buffer.
+ *
+ * @param[in,out] buf         COBS block on input, payload on output
+ * @param[in]     cobs_len    Number of bytes of the COBS block
+ * @param[out]    payload_len Pointer set to the payload length
+ * @param[out]    is_control  Pointer set to true for a control frame (may be NULL)
+ * @return true if the block is valid COBS and the length field and the CRC match
+ */
+bool app_uart_frame_decode(uint8_t *buf, size_t cobs_len, size_t *payload_len, bool *is_control);
+
+#endif /* APP_UART_FRAME_H */
@@ -0,0 +1,378 @@
+#include <string.h>
+#include "sl_iostream.h"
+#include "sl_iostream_uart.h"
+#include "sl_iostream_usart_vcom.h"
+#include "app_uart_ingress.h"
+#include "app_uart_frame.h"
+#include "app_pools.h"
+#include "log.h"
+
+#if APP_UART_INGRESS_MAX_LINE >= APP_MESSAGE_BLOCK_SIZE
+#error "APP_UART_INGRESS_MAX_LINE (plus NUL) must fit in a block of app_message_pool"
+#endif
+
+#define FRAME_MAX_COBS      APP_UART_FRAME_COBS_SIZE(APP_UART_FRAME_MAX_PAYLOAD)
+
+#if FRAME_MAX_COBS > APP_MESSAGE_BLOCK_SIZE
+#error "A full size binary frame must fit in a block of app_message_pool"
+#endif
+
+// Bytes taken from the iostream RX ring per read call
+#define INGRESS_READ_CHUNK  32
+
+typedef enum
+{
+    LINE_IDLE = 0,          // Between lines, terminators are skipped
+    LINE_COLLECTING,        // Appending bytes to the current line
+    LINE_DISCARDING,        // Line is dropped, wait for its terminator
+    FRAME_COLLECTING,       // Appending COBS bytes of a binary frame
+    FRAME_DISCARDING        // Frame is dropped, wait for its closing delimiter
+} line_state_t;
+
+// Context of the line framer
+typedef struct
+{
+    line_state_t state;
+    uint8_t *line;                                  // Block being assembled
+    size_t line_len;
+    uint8_t *ready[APP_UART_INGRESS_LINE_QUEUE];    // Complete lines, oldest at r_tail
+    size_t ready_len[APP_UART_INGRESS_LINE_QUEUE];
+    bool ready_is_frame[APP_UART_INGRESS_LINE_QUEUE];
+    uint8_t r_head;
+    uint8_t r_tail;
+    uint8_t r_count;
+    uint8_t held[INGRESS_READ_CHUNK];               // Bytes read but not framed yet, see app_uart_ingress_process()
+    uint8_t held_pos;
+    uint8_t held_len;
+    app_uart_ingress_control_cb_t on_control;
+    app_uart_ingress_stats_t stats;
+} ingress_context_t;
+
+static ingress_context_t ingress_cxt = {0};
+
+/*******************************************************************************
+ ***************************   LOCAL FUNCTIONS   *******************************
+ *******************************************************************************/
+
+static uint8_t next_line_index(uint8_t i)
+{
+    return (uint8_t)((i + 1) % APP_UART_INGRESS_LINE_QUEUE);
+}
+
+// Terminate the current line and move it to the ready queue
+static void publish_line(bool is_frame)
+{
+    ingress_cxt.line[ingress_cxt.line_len] = '\0';
+    ingress_cxt.ready[ingress_cxt.r_head] = ingress_cxt.line;
+    ingress_cxt.ready_len[ingress_cxt.r_head] = ingress_cxt.line_len;
+    ingress_cxt.ready_is_frame[ingress_cxt.r_head] = is_frame;
+    ingress_cxt.r_head = next_line_index(ingress_cxt.r_head);
+    ingress_cxt.r_count++;
+    if(is_frame)
+    {
+        ingress_cxt.stats.frames_published++;
+    }
+    else
+    {
+        ingress_cxt.stats.lines_published++;
+    }
+
+    ingress_cxt.line = NULL;
+    ingress_cxt.line_len = 0;
+}
+
+// Give up the current line or frame, keep discarding until its terminator
+static void discard_line(line_state_t discard_state)
+{
+    block_pool_free(&app_message_pool, ingress_cxt.line);
+    ingress_cxt.line = NULL;
+    ingress_cxt.line_len = 0;
+    ingress_cxt.state = discard_state;
+}
+
+// A new line or frame would get a block and a slot of the ready queue
+static bool can_start_line(void)
+{
+    return ingress_cxt.r_count < APP_UART_INGRESS_LINE_QUEUE
+           && block_pool_available(&app_message_pool) > 0;
+}
+
+// Claim a block for a new line or frame, only if it can be queued when complete
+static bool start_line(void)
+{
+    if(ingress_cxt.r_count < APP_UART_INGRESS_LINE_QUEUE)
+    {
+        ingress_cxt.line = block_pool_alloc(&app_message_pool);
+    }
+    if(ingress_cxt.line == NULL)
+    {
+        ingress_cxt.stats.lines_dropped++;
+        return false;
+    }
+
+    ingress_cxt.line_len = 0;
+    return true;
+}
+
+// Closing delimiter of a binary frame received: check it and publish the payload
+static void end_frame(void)
+{
+    size_t payload_len;
+    bool is_control;
+
+    if(!app_uart_frame_decode(ingress_cxt.line, ingress_cxt.line_len, &payload_len, &is_control))
+    {
+        ingress_cxt.stats.frames_bad++;
+        discard_line(LINE_IDLE);
+        return;
+    }
+
+    if(is_control)
+    {
+        // Link management, handled here and never forwarded over BLE
+        ingress_cxt.stats.frames_control++;
+        if(ingress_cxt.on_control != NULL)
+        {
+            ingress_cxt.on_control(ingress_cxt.line, payload_len);
+        }
+        discard_line(LINE_IDLE);
+        return;
+    }
+
+    ingress_cxt.line_len = payload_len;
+    publish_line(true);
+    ingress_cxt.state = LINE_IDLE;
+}
+
+// Framing state machine, one received byte per call. Returns false, with
+// the state unchanged, for a byte that opens a line or frame while
+// can_start_line() is false: the caller keeps it for a later call.
+static bool frame_byte(uint8_t c)
+{
+    bool terminator = (c == '\r' || c == '\n');
+    bool delimiter = (c == APP_UART_FRAME_DELIMITER);
+
+    // Text never contains 0x00: a delimiter always opens a binary frame
+    if(delimiter && (ingress_cxt.state == LINE_COLLECTING || ingress_cxt.state == LINE_DISCARDING))
+    {
+        if(ingress_cxt.state == LINE_COLLECTING)
+        {
+            ingress_cxt.stats.lines_dropped++;
+            discard_line(LINE_IDLE);
+        }
+        ingress_cxt.state = LINE_IDLE;
+    }
+
+    switch(ingress_cxt.state)
+    {
+        case LINE_IDLE:
+            if(!terminator && !can_start_line())
+            {
+                return false;
+            }
+            if(delimiter)
+            {
+                ingress_cxt.state = start_line() ? FRAME_COLLECTING : FRAME_DISCARDING;
+                break;
+            }
+            if(terminator)
+            {
+                break;      // Empty line or second half of CR/LF
+            }
+
+            if(!start_line())
+            {
+                ingress_cxt.state = LINE_DISCARDING;
+                break;
+            }
+            ingress_cxt.line[0] = c;
+            ingress_cxt.line_len = 1;
+            ingress_cxt.state = LINE_COLLECTING;
+            break;
+
+        case FRAME_COLLECTING:
+            if(!delimiter)
+            {
+                if(ingress_cxt.line_len < FRAME_MAX_COBS)
+                {
+                    ingress_cxt.line[ingress_cxt.line_len++] = c;
+                }
+                else
+                {
+                    ingress_cxt.stats.lines_overflowed++;
+                    discard_line(FRAME_DISCARDING);
+                }
+            }
+            else if(ingress_cxt.line_len > 0)
+            {
+                end_frame();
+            }
+            // else: back-to-back delimiters, keep waiting for the frame body
+            break;
+
+        case FRAME_DISCARDING:
+            if(delimiter)
+            {
+                ingress_cxt.state = LINE_IDLE;
+            }
+            break;
+
+        case LINE_COLLECTING:
+            if(terminator)
+            {
+                publish_line(false);
+                ingress_cxt.state = LINE_IDLE;
+            }
+            else if(ingress_cxt.line_len < APP_UART_INGRESS_MAX_LINE)
+            {
+                ingress_cxt.line[ingress_cxt.line_len++] = c;
+            }
+            else
+            {
+                ingress_cxt.stats.lines_overflowed++;
+                discard_line(LINE_DISCARDING);
+            }
+            break;
+
+        case LINE_DISCARDING:
+        default:
+            if(terminator)
+            {
+                ingress_cxt.state = LINE_IDLE;
+            }
+            break;
+    }
+    return true;
+}
+
+// Frame the held bytes, return true once they are all consumed
+static bool frame_held_bytes(void)
+{
+    while(ingress_cxt.held_pos < ingress_cxt.held_len)
+    {
+        if(!frame_byte(ingress_cxt.held[ingress_cxt.held_pos]))
+        {
+            return false;
+        }
+        ingress_cxt.held_pos++;
+    }
+    ingress_cxt.held_pos = 0;
+    ingress_cxt.held_len = 0;
+    return true;
+}
+
+/*******************************************************************************
+ ***************************   GLOBAL FUNCTIONS   ******************************
+ ******************************************************************************/
+
+sl_status_t app_uart_ingress_init(app_uart_ingress_control_cb_t on_control)
+{
+    // Release lines left from a previous run of the framer
+    while(ingress_cxt.r_count > 0)
+    {
+        app_uart_ingress_release_line();
+    }
+    block_pool_free(&app_message_pool, ingress_cxt.line);
+    memset(&ingress_cxt, 0, sizeof(ingress_context_t));
+    ingress_cxt.on_control = on_control;
+
+    // The USART RX interrupt keeps filling the driver ring buffer; reads only
+    // take what is already there and return SL_STATUS_EMPTY otherwise
+    sl_iostream_uart_set_read_block(sl_iostream_uart_vcom_handle, false);
+
+    LOG_INFO("UART ingress ready, lines up to %u bytes, frames up to %u bytes",
+             (unsigned int)APP_UART_INGRESS_MAX_LINE,
+             (unsigned int)APP_UART_FRAME_MAX_PAYLOAD);
+    return SL_STATUS_OK;
+}
+
+void app_uart_ingress_process(void)
+{
+    size_t bytes_read;
+
+    for(;;)
+    {
+        // A line that finds no free slot or block waits in the held bytes,
+        // and the ring is not read any further: it fills up and the driver
+        // deasserts RTS, so the host is throttled instead of losing lines
+        if(!frame_held_bytes())
+        {
+            ingress_cxt.stats.reads_paused++;
+            return;
+        }
+        if(ingress_cxt.state == LINE_IDLE && !can_start_line())
+        {
+            ingress_cxt.stats.reads_paused++;
+            return;
+        }
+
+        bytes_read = 0;
+        sl_status_t st = sl_iostream_read(sl_iostream_vcom_handle, ingress_cxt.held,
+                                          sizeof(ingress_cxt.held), &bytes_read);
+        if(st != SL_STATUS_OK || bytes_read == 0)
+        {
+            return;     // Ring is empty
+        }
+
+        ingress_cxt.stats.bytes_received += bytes_read;
+        ingress_cxt.held_len = (uint8_t)bytes_read;
+    }
+}
+
+bool app_uart_ingress_get_line(uint8_t **line, size_t *len, bool *is_frame)
+{
+    if(ingress_cxt.r_count == 0)
+    {
+        return false;
+    }
+
+    if(line)
+    {
+        *line = ingress_cxt.ready[ingress_cxt.r_tail];
+    }
+    if(len)
+    {
+        *len = ingress_cxt.ready_len[ingress_cxt.r_tail];
+    }
+    if(is_frame)
+    {
+        *is_frame = ingress_cxt.ready_is_frame[ingress_cxt.r_tail];
+    }
+    return true;
+}
+
+void app_uart_ingress_release_line(void)
+{
+    if(ingress_cxt.r_count == 0)
+    {
+        return;
+    }
+
+    block_pool_free(&app_message_pool, ingress_cxt.ready[ingress_cxt.r_tail]);
+    ingress_cxt.ready[ingress_cxt.r_tail] = NULL;
+    ingress_cxt.r_tail = next_line_index(ingress_cxt.r_tail);
+    ingress_cxt.r_count--;
+}
+
+size_t app_uart_ingress_queued_bytes(void)
+{
+    size_t bytes = 0;
+    uint8_t index = ingress_cxt.r_tail;
+
+    for(uint8_t n = 0; n < ingress_cxt.r_count; n++)
+    {
+        bytes += ingress_cxt.ready_len[index];
+        index = next_line_index(index);
+    }
+    return bytes;
+}
+
+void app_uart_ingress_get_stats(app_uart_ingress_stats_t *stats)
+{
+    if(stats == NULL)
+    {
+        return;
+    }
+
+    *stats = ingress_cxt.stats;
+}
@@ -0,0 +1,130 @@
+/**
+ * @file app_uart_ingress.h
+ * @brief Non-blocking UART line and binary frame input
+ *
+ * This module replaces the polling `read_line_from_iostream()` loop. Bytes
+ * are received by the USART RX interrupt of the VCOM iostream driver into its
+ * ring buffer; `app_uart_ingress_process()` drains that ring without waiting
+ * and runs an incremental framing state machine over the bytes. Two kinds of
+ * input share the stream:
+ * - text lines terminated by CR or LF
+ * - binary frames `0x00 | COBS block | 0x00` (see `app_uart_frame.h`),
+ *   carrying any byte values and up to `APP_UART_FRAME_MAX_PAYLOAD` bytes
+ *
+ * Implementation notes (see `app_uart_ingress.c`):
+ * - A line is assembled directly in a block of `app_message_pool`. When CR or
+ *   LF is received the block is published to a small queue of ready lines;
+ *   the terminator is not part of the line and empty lines are ignored.
+ * - Lines longer than `APP_UART_INGRESS_MAX_LINE` bytes are discarded up to
+ *   their terminator and counted as overflowed.
+ * - A 0x00 byte opens a binary frame (text never contains 0x00). The COBS
+ *   block is collected in a pool block and decoded in place at the closing
+ *   0x00; frames failing the COBS, length or CRC check are counted as bad.
+ * - Control frames (control flag in the length field) are passed to the
+ *   callback given to `app_uart_ingress_init()` (the Peripheral's
+ *   `app_uart_link_on_control()`) and freed; they never reach the ready
+ *   queue. Without a callback they are only counted.
+ * - If the ready queue or the pool is full, the next line or frame is not
+ *   started: its bytes stay unread in the iostream RX ring (at most one
+ *   read chunk is held by the framer) until the application releases a
+ *   line. The ring fills up and the driver deasserts RTS, so with hardware
+ *   flow control the host is throttled instead of losing lines.
+ * - The application takes the oldest line with `app_uart_ingress_get_line()`
+ *   and returns it with `app_uart_ingress_release_line()` once it has been
+ *   handed to the fragment queue.
+ *
+ * @note This component is designed to be reusable across different projects,
+ *       the Central and the Peripheral use the same copy.
+ */
+
+#ifndef APP_UART_INGRESS_H
+#define APP_UART_INGRESS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "sl_status.h"
+
+// Longest accepted line, terminator excluded
+#ifndef APP_UART_INGRESS_MAX_LINE
+#define APP_UART_INGRESS_MAX_LINE       80
+#endif
+
+// Complete lines waiting for the BLE transmit queue
+#ifndef APP_UART_INGRESS_LINE_QUEUE
+#define APP_UART_INGRESS_LINE_QUEUE     3
+#endif
+
+/**
+ * @brief Handler of the control frames.
+ *
+ * @param[in] payload Control frame payload
+ * @param[in] len     Its length
+ */
+typedef void (*app_uart_ingress_control_cb_t)(const uint8_t *payload, size_t len);
+
+// Counters describing the ingress since app_uart_ingress_init()
+typedef struct
+{
+    uint32_t bytes_received;    // Bytes taken from the iostream RX ring
+    uint32_t lines_published;   // Text lines put in the ready queue
+    uint32_t lines_dropped;     // Lines cut by a frame delimiter, or lost to a failed block allocation
+    uint32_t lines_overflowed;  // Lines or frames longer than the limits
+    uint32_t frames_published;  // Binary frames put in the ready queue
+    uint32_t frames_bad;        // Binary frames failing the COBS, length or CRC check
+    uint32_t frames_control;    // Control frames passed to the control callback
+    uint32_t reads_paused;      // Process calls that left the RX ring unread, the queue or the pool being full
+} app_uart_ingress_stats_t;
+
+/**
+ * @brief Switch the VCOM iostream to non-blocking reads and reset the framer.
+ *
+ * Must be called after `app_iostream_usart_init()` and `app_pools_init()`.
+ *
+ * @param[in] on_control Handler of the control frames, NULL to drop them
+ * @return SL_STATUS_OK on success
+ */
+sl_status_t app_uart_ingress_init(app_uart_ingress_control_cb_t on_control);
+
+/**
+ * @brief Drain received bytes and frame them into lines.
+ *
+ * Call from `app_process_action()`. Returns as soon as the iostream RX ring
+ * is empty, it never waits for input.
+ */
+void app_uart_ingress_process(void);
+
+/**
+ * @brief Get the oldest complete line or binary frame payload.
+ *
+ * The data stays valid and is returned again by further calls until
+ * `app_uart_ingress_release_line()` is called. It is NUL terminated, which
+ * is only meaningful for text lines.
+ *
+ * @param[out] line     Pointer set to the line or payload bytes
+ * @param[out] len      Pointer set to the length in bytes
+ * @param[out] is_frame Pointer set to true for a binary frame payload (may be NULL)
+ * @return true if a line or frame is available
+ */
+bool app_uart_ingress_get_line(uint8_t **line, size_t *len, bool *is_frame);
+
+/**
+ * @brief Release the line returned by `app_uart_ingress_get_line()`.
+ *
+ * Returns its block to `app_message_pool`.
+ */
+void app_uart_ingress_release_line(void);
+
+/**
+ * @brief Bytes of the complete lines and frames waiting in the ready queue.
+ */
+size_t app_uart_ingress_queued_bytes(void);
+
+/**
+ * @brief Copy the current ingress counters.
+ *
+ * @param[out] stats Destination for the counters
+ */
+void app_uart_ingress_get_stats(app_uart_ingress_stats_t *stats);
+
+#endif /* APP_UART_INGRESS_H */
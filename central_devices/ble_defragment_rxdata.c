@@ -1,7 +1,29 @@
 #include "ble_defragment_rxdata.h"
+#include "sl_sleeptimer.h"
 #include "app_iostream_usart.h"
+#include "app_checksum.h"
+#include "app_pools.h"
+#include "app_trace.h"
 #include "log.h"
 
+#define APP_TRACE_FILE_ID   3   // Trace site IDs of this file (app_trace.h)
+
+// Payload bytes shown in hex when a payload completes, the payloads may be binary
+#define LOG_PAYLOAD_PREFIX  16
+
+#if (QUEUE_SLOT_SIZE + 2) > APP_FRAGMENT_BLOCK_SIZE
+#error "APP_FRAGMENT_BLOCK_SIZE is too small for a queue slot"
+#endif
+
+#if (DEFRAG_MAX_PAYLOAD + 1) > APP_MESSAGE_BLOCK_SIZE
+#error "APP_MESSAGE_BLOCK_SIZE is too small for a reassembled payload"
+#endif
+
+// Every link may fill its ring at once without running the pool dry
+#if (DEFRAG_LINKS * DEFRAG_LINK_SLOTS) > APP_FRAGMENT_BLOCK_COUNT
+#error "APP_FRAGMENT_BLOCK_COUNT is too small for DEFRAG_LINKS rings of DEFRAG_LINK_SLOTS"
+#endif
+
 // Define a node of the queue
 typedef struct 
 {
@@ -12,7 +34,7 @@ typedef struct
 // Define the context of fragments in one transmission
 typedef struct 
 {
-    uint8_t complete_buffer[DEFRAG_MAX_PAYLOAD];
+    uint8_t *complete_buffer;                       // Block of app_message_pool, NULL when idle
     uint16_t expected_len;                          // [NOTE]: This length only contains length of real string (payload)
     uint16_t received_len;                          
     uint8_t received_checksum;                      // From last fragment
@@ -21,163 +43,253 @@ typedef struct
     bool is_complete;
 } defrag_context_t;
 
-static queue_slot_t queue[QUEUE_SLOT];
-static defrag_context_t defrag_cxt = {0};
-static volatile uint8_t q_head = 0;         // head: index to write
-static volatile uint8_t q_tail = 0;         // tail: index to read
+// Ingress queue, reassembly context and counters of one link
+typedef struct
+{
+    queue_slot_t *queue[DEFRAG_LINK_SLOTS];         // Pointers to app_fragment_pool blocks
+    uint32_t queued_at[DEFRAG_LINK_SLOTS];          // Sleeptimer tick of each push
+    uint8_t q_tail;                                 // oldest fragment
+    uint8_t q_count;
+    defrag_context_t cxt;
+    defrag_link_stats_t stats;
+} defrag_link_t;
+
+// A reassembled payload waiting to be consumed by the application
+typedef struct
+{
+    uint8_t *buffer;                                // Block of app_message_pool
+    uint16_t len;
+    uint8_t link;
+    bool checksum_valid;
+} completed_payload_t;
+
+static defrag_link_t links[DEFRAG_LINKS];
+
+// Completion buffers, shared by the links: reassembly swaps into the next
+// free one on completion
+static completed_payload_t completed[DEFRAG_COMPLETE_BUFFERS];
+static uint8_t c_head = 0;                  // next completion slot to fill
+static uint8_t c_tail = 0;                  // oldest completed payload
+static uint8_t c_count = 0;
 
 /*******************************************************************************
  ***************************   LOCAL FUNCTIONS   *******************************
  *******************************************************************************/
 
-// Return the next index of queue (ring buffer)
-static uint8_t next_queue_index(uint8_t i)
+// Return the ring index `offset` entries after `i`
+static uint8_t queue_index(uint8_t i, uint8_t offset)
+{
+    return (uint8_t)((i + offset) % DEFRAG_LINK_SLOTS);
+}
+
+// Log up to `max_shown` bytes of a fragment or payload as one hex line (a
+// single console write instead of one per byte), never as text: the data may
+// be binary
+static void log_bytes(const char *tag, uint8_t link, const uint8_t *data, uint16_t len, uint16_t max_shown)
+{
+    static const char hex_digits[] = "0123456789abcdef";
+    char hex[2 * QUEUE_SLOT_SIZE + 1];
+    uint16_t shown = (len < max_shown) ? len : max_shown;
+
+    if(!LOG_ENABLED(APP, LOG_LEVEL_DEBUG))
+    {
+        return;     // Skip the formatting too
+    }
+
+    if(shown > QUEUE_SLOT_SIZE)
+    {
+        shown = QUEUE_SLOT_SIZE;
+    }
+    for(uint16_t i = 0; i < shown; i++)
+    {
+        hex[2 * i] = hex_digits[data[i] >> 4];
+        hex[2 * i + 1] = hex_digits[data[i] & 0x0F];
+    }
+    hex[2 * shown] = '\0';
+
+    LOG_DEBUG("%s link %u data: %s%s, len: %d", tag, link, hex, (shown < len) ? "..." : "", len);
+}
+
+// Clear a reassembly context, its buffer has been freed or handed off
+static void context_clear(defrag_context_t *cxt)
+{
+    memset(cxt, 0, sizeof(defrag_context_t));
+    cxt->is_first_fragment = true;
+    cxt->is_complete = false;
+}
+
+// Give the queued fragments of a link back to the pool
+static void queue_drain(defrag_link_t *l)
+{
+    while(l->q_count > 0)
+    {
+        block_pool_free(&app_fragment_pool, l->queue[l->q_tail]);
+        l->queue[l->q_tail] = NULL;
+        l->q_tail = queue_index(l->q_tail, 1);
+        l->q_count--;
+    }
+    l->q_tail = 0;
+}
+
+// Move the finished reassembly buffer of a link to the completion slots and start over
+static void hand_off_completed_payload(uint8_t link)
 {
-    return (uint8_t)(i + 1)%QUEUE_SLOT;
+    defrag_context_t *cxt = &links[link].cxt;
+
+    completed[c_head].buffer = cxt->complete_buffer;
+    completed[c_head].len = cxt->received_len;
+    completed[c_head].link = link;
+    completed[c_head].checksum_valid = cxt->checksum_valid;
+    c_head = (uint8_t)((c_head + 1) % DEFRAG_COMPLETE_BUFFERS);
+    c_count++;
+    links[link].stats.messages++;
+    APP_TRACE("payload complete, link %u, %u bytes, checksum valid %u",
+              link, cxt->received_len, cxt->checksum_valid);
+    log_bytes("PAYLOAD", link, cxt->complete_buffer, cxt->received_len, LOG_PAYLOAD_PREFIX);
+
+    // The buffer now belongs to the completion slot, do not free it here
+    context_clear(cxt);
 }
 
-static defrag_enum_t process_first_fragment(uint8_t *data, uint16_t len)
+static defrag_enum_t process_first_fragment(defrag_context_t *cxt, uint8_t *data, uint16_t len)
 {
     if(len < 2)
     {
-        LOG_INFO("ERROR: First fragment too short");
+        LOG_ERROR("First fragment too short");
         return DEFRAG_ERROR;
     }
 
     // First byte is the payload length
-    defrag_cxt.expected_len = data[0];
+    cxt->expected_len = data[0];
 
-    LOG_INFO("-----Defragmentation Started-----");
-    LOG_INFO("Expected length: %u byte", defrag_cxt.expected_len);
+    APP_TRACE("first fragment, %u bytes expected", cxt->expected_len);
+
+    if(cxt->expected_len == 0 || cxt->expected_len > DEFRAG_MAX_PAYLOAD)
+    {
+        LOG_ERROR("Invalid length");
+        return DEFRAG_ERROR;
+    }
 
-    if(defrag_cxt.expected_len == 0 || defrag_cxt.expected_len > DEFRAG_MAX_PAYLOAD)
+    cxt->complete_buffer = block_pool_alloc(&app_message_pool);
+    if(cxt->complete_buffer == NULL)
     {
-        LOG_INFO("ERROR: Invalid length");
+        LOG_ERROR("No message buffer available");
         return DEFRAG_ERROR;
     }
 
     // Check length if it's a single fragment
-    if(len == 1 + defrag_cxt.expected_len + 1)
+    if(len == 1 + cxt->expected_len + 1)
     {
-        LOG_INFO("SINGLE FRAGMENT");
-        memcpy(defrag_cxt.complete_buffer, &data[1], defrag_cxt.expected_len);
-        defrag_cxt.received_len = defrag_cxt.expected_len;
-        defrag_cxt.received_checksum = data[len - 1];
+        LOG_DEBUG("SINGLE FRAGMENT");
+        memcpy(cxt->complete_buffer, &data[1], cxt->expected_len);
+        cxt->received_len = cxt->expected_len;
+        cxt->received_checksum = data[len - 1];
 
         // Validate checksum byte
-        uint8_t temporary_checksum = app_iostream_checksum(defrag_cxt.complete_buffer, 
-                                                           defrag_cxt.expected_len);
+        uint8_t temporary_checksum = app_checksum_compute(cxt->complete_buffer, 
+                                                          cxt->expected_len);
 
-        LOG_INFO("received checksum: %02x and cal_checksum: %02x", 
-                    defrag_cxt.received_checksum, 
-                    temporary_checksum);
-        if(temporary_checksum == defrag_cxt.received_checksum)
+        LOG_DEBUG("received checksum: %02x and cal_checksum: %02x", 
+                     cxt->received_checksum, 
+                     temporary_checksum);
+        if(temporary_checksum == cxt->received_checksum)
         {
-            LOG_INFO("CHECKSUM: Payload not LOST");
-            defrag_cxt.checksum_valid = true;
+            LOG_DEBUG("CHECKSUM: Payload not LOST");
+            cxt->checksum_valid = true;
         }
         else
         {
-            LOG_INFO("CHECKSUM: Payload LOST");
+            LOG_WARN("CHECKSUM: Payload LOST");
         }
 
-        defrag_cxt.complete_buffer[defrag_cxt.expected_len] = '\0'; 
-        LOG_INFO("RECEIVED: Data: %s, len %u", (char *)defrag_cxt.complete_buffer, 
-                                                defrag_cxt.expected_len);
-        defrag_cxt.is_complete = true;
+        cxt->complete_buffer[cxt->expected_len] = '\0'; 
+        cxt->is_complete = true;
         return DEFRAG_COMPLETE;
     }
 
-    // Multiple fragments [length | first_19_bytes]
+    // Multiple fragments [length | first_19_bytes], the first one cannot
+    // carry more than the announced payload
     uint16_t first_payload_len = len - 1;
-    memcpy(defrag_cxt.complete_buffer, &data[1], first_payload_len);
-    defrag_cxt.received_len = first_payload_len;
-    defrag_cxt.is_first_fragment = false;
-
-    defrag_cxt.complete_buffer[first_payload_len] = '\0'; 
-    LOG_INFO("[FRAGMENT 1] Data: %s, len: %u", (char *)defrag_cxt.complete_buffer, 
-                                                first_payload_len);
-    
+    if(first_payload_len > cxt->expected_len)
+    {
+        LOG_ERROR("First fragment longer than the payload");
+        return DEFRAG_ERROR;
+    }
+    memcpy(cxt->complete_buffer, &data[1], first_payload_len);
+    cxt->received_len = first_payload_len;
+    cxt->is_first_fragment = false;
+
     return DEFRAG_CONTINUE;
 }
 
-static defrag_enum_t process_subsequent_fragment(uint8_t *data, uint16_t len)
+static defrag_enum_t process_subsequent_fragment(defrag_context_t *cxt, uint8_t *data, uint16_t len)
 {
-    uint8_t buffer[20];         // Just is temporary buffer
-
     // Dealed with the first fragment
     if(len == 0)
     {
-        LOG_INFO("ERROR: Empty fragment");
+        LOG_ERROR("Empty fragment");
+        return DEFRAG_ERROR;
+    }
+
+    // Never write past the announced payload: at most the remaining bytes
+    // plus the checksum byte of the last fragment
+    if(cxt->received_len > cxt->expected_len
+       || cxt->received_len + len > cxt->expected_len + 1)
+    {
+        LOG_ERROR("Fragment past the end of the payload");
         return DEFRAG_ERROR;
     }
 
-    uint16_t remaining = defrag_cxt.expected_len - defrag_cxt.received_len;
-    LOG_INFO(" Remaining len: %u and fragment_len: %u", remaining, len);
+    uint16_t remaining = cxt->expected_len - cxt->received_len;
+    LOG_DEBUG(" Remaining len: %u and fragment_len: %u", remaining, len);
 
     // Check if last fragment: [remaining/checksum]
-    if(remaining + 1 <= 20)
+    if(remaining + 1 <= DEFRAG_FRAGMENT_LEN)
     {
         uint8_t temporary_checksum;
         uint16_t payload_len = len - 1;
 
         if(payload_len != remaining)
         {
-            LOG_INFO("ERROR: Last fragment size mismatch");
+            LOG_ERROR("Last fragment size mismatch");
             return DEFRAG_ERROR;
         }
 
         // Coppy remaining payload
-        memcpy(&defrag_cxt.complete_buffer[defrag_cxt.received_len], data, payload_len);
-        defrag_cxt.received_len += payload_len;
+        memcpy(&cxt->complete_buffer[cxt->received_len], data, payload_len);
+        cxt->received_len += payload_len;
 
         // Validate checksum byte
-        defrag_cxt.received_checksum = data[len-1];
-        temporary_checksum = app_iostream_checksum(defrag_cxt.complete_buffer, 
-                                                   defrag_cxt.expected_len);
-        if(temporary_checksum == defrag_cxt.received_checksum)
+        cxt->received_checksum = data[len-1];
+        temporary_checksum = app_checksum_compute(cxt->complete_buffer, 
+                                                  cxt->expected_len);
+        if(temporary_checksum == cxt->received_checksum)
         {
-            LOG_INFO("CHECKSUM: Payload NOT LOST , in subsequent fragment");
-            defrag_cxt.checksum_valid = true;
+            LOG_DEBUG("CHECKSUM: Payload NOT LOST , in subsequent fragment");
+            cxt->checksum_valid = true;
         }
         else
         {
-            LOG_INFO("CHECKSUM: Payload LOST, in subsequent fragment");
+            LOG_WARN("CHECKSUM: Payload LOST, in subsequent fragment");
         }
 
-        memcpy(buffer, data, payload_len);
-        buffer[payload_len] = '\0';
-        LOG_INFO("[LAST FRAGMENT] Data: %s, len: %u", (char *)buffer, 
-                                                       payload_len);
+        cxt->complete_buffer[cxt->received_len] = '\0';                                            
 
-        defrag_cxt.complete_buffer[defrag_cxt.received_len] = '\0';                                            
-        LOG_INFO("[TOTAL FRAGMENT] Data: %s, len: %u", (char *)defrag_cxt.complete_buffer, 
-                                                         defrag_cxt.received_len);
-
-        defrag_cxt.is_complete = true;
+        cxt->is_complete = true;
         return DEFRAG_COMPLETE;
     }
     else
     {
-        // Middle fragment: [payload_20_bytes]
+        // Middle fragment: [payload(DEFRAG_FRAGMENT_LEN)]
         if(len > remaining)
         {
-            LOG_INFO("Middle fragment too larger\r\n");
+            LOG_ERROR("Middle fragment too larger");
             return DEFRAG_ERROR;
         }
 
-        memcpy(&defrag_cxt.complete_buffer[defrag_cxt.received_len], data, len);
-        defrag_cxt.received_len += len;
-
-        memcpy(buffer, data, len);
-        buffer[len] = '\0';
-        LOG_INFO("[MID FRAGMENT] Data: %s, len: %u", (char *)buffer, 
-                                                      len);
-        
-        defrag_cxt.complete_buffer[defrag_cxt.received_len] = '\0';                                            
-        LOG_INFO("[CUR FRAGMENT] Data: %s, len: %u", (char *)defrag_cxt.complete_buffer, 
-                                                      defrag_cxt.received_len);     
-        
+        memcpy(&cxt->complete_buffer[cxt->received_len], data, len);
+        cxt->received_len += len;
+
         return DEFRAG_CONTINUE;
     }
 }
@@ -188,112 +300,265 @@ static defrag_enum_t process_subsequent_fragment(uint8_t *data, uint16_t len)
 
 void queue_init(void)
 {
-    memset(queue, 0, sizeof(queue));
+    // Give queued fragments back to the pool before forgetting them
+    for(uint8_t link = 0; link < DEFRAG_LINKS; link++)
+    {
+        queue_drain(&links[link]);
+        memset(links[link].queue, 0, sizeof(links[link].queue));
+    }
     LOG_INFO("Initialize queue");
 }
 
 void defrag_init(void)
 {
-    memset(&defrag_cxt, 0, sizeof(defrag_context_t));
-    defrag_cxt.is_first_fragment = true;
-    defrag_cxt.is_complete = false;
+    memset(links, 0, sizeof(links));
+    for(uint8_t link = 0; link < DEFRAG_LINKS; link++)
+    {
+        context_clear(&links[link].cxt);
+    }
+    memset(completed, 0, sizeof(completed));
+    c_head = 0;
+    c_tail = 0;
+    c_count = 0;
     LOG_INFO("Initialize context");
 }
 
-void defrag_reset(void)
+void defrag_reset(uint8_t link)
 {
-    memset(&defrag_cxt, 0, sizeof(defrag_context_t));
-    defrag_cxt.is_first_fragment = true;
-    defrag_cxt.is_complete = false;
-    LOG_INFO("[RESET] Initialize context");
+    if(link >= DEFRAG_LINKS)
+    {
+        return;
+    }
+    block_pool_free(&app_message_pool, links[link].cxt.complete_buffer);
+    context_clear(&links[link].cxt);
+    LOG_INFO("[RESET] Initialize context of link %u", link);
 }
 
+void defrag_flush_link(uint8_t link)
+{
+    if(link >= DEFRAG_LINKS)
+    {
+        return;
+    }
+    queue_drain(&links[link]);
+    block_pool_free(&app_message_pool, links[link].cxt.complete_buffer);
+    context_clear(&links[link].cxt);
+    memset(&links[link].stats, 0, sizeof(defrag_link_stats_t));
+}
 
-bool defrag_push_data(const uint8_t *data, uint16_t len)
+bool defrag_push_data(uint8_t link, const uint8_t *data, uint16_t len)
 {
-    if(data == NULL || len == 0 || len > QUEUE_SLOT_SIZE)
+    if(link >= DEFRAG_LINKS || data == NULL || len == 0 || len > QUEUE_SLOT_SIZE)
     {
-        LOG_INFO("ERROR: Failed to push data #1");
+        LOG_ERROR("Failed to push data #1");
         return false;
     }
 
-    uint8_t next_idx = next_queue_index(q_head);
-    if(next_idx == q_tail)
+    defrag_link_t *l = &links[link];
+    if(l->q_count >= DEFRAG_LINK_SLOTS)
     {
-        LOG_INFO("ERROR: QUEUE is FULL\r\n");
+        LOG_ERROR("QUEUE of link %u is FULL", link);
         return false;
     }
 
-    memcpy(queue[q_head].data, data, len);
-    queue[q_head].len = len;
+    queue_slot_t *slot = block_pool_alloc(&app_fragment_pool);
+    if(slot == NULL)
+    {
+        LOG_ERROR("Fragment pool is EMPTY");
+        return false;
+    }
 
-    LOG_INFO("PUSH data: ");
-    for (int i = 0; i < len; i++)
-        printf("%02x", queue[q_head].data[i]);
-    printf(", len: %d\r\n", queue[q_head].len);
+    uint8_t idx = queue_index(l->q_tail, l->q_count);
+    memcpy(slot->data, data, len);
+    slot->len = len;
+    l->queue[idx] = slot;
+    l->queued_at[idx] = sl_sleeptimer_get_tick_count();
+    l->q_count++;
 
-    // Move to the next index
-    q_head = next_idx;
+    log_bytes("PUSH", link, slot->data, slot->len, QUEUE_SLOT_SIZE);
+    APP_TRACE("fragment queued, link %u, %u bytes, %u waiting", link, len, l->q_count);
     return true;
 }
 
-defrag_enum_t defrag_process_fragment(void)
+bool defrag_can_push(uint8_t link)
+{
+    return link < DEFRAG_LINKS
+           && links[link].q_count < DEFRAG_LINK_SLOTS
+           && block_pool_available(&app_fragment_pool) > 0;
+}
+
+uint16_t defrag_head_len(uint8_t link)
 {
-    if(q_head == q_tail)
+    if(link >= DEFRAG_LINKS || links[link].q_count == 0)
+    {
+        return 0;
+    }
+    return links[link].queue[links[link].q_tail]->len;
+}
+
+defrag_enum_t defrag_process_fragment(uint8_t link)
+{
+    if(link >= DEFRAG_LINKS)
+    {
+        return DEFRAG_ERROR;
+    }
+
+    defrag_link_t *l = &links[link];
+    if(l->q_count == 0)
     {
         // This case occurs when server indicate slower then sl_bt_on_event occurs
         // so at that time, sl_bt_on_event() check evt and not see any events in its queue
-        printf("QUEUE is EMPTY\r\n");       
+        LOG_DEBUG("QUEUE is EMPTY");
         return DEFRAG_CONTINUE; 
     }
 
-    uint16_t len = queue[q_tail].len;
-    uint8_t *data = queue[q_tail].data;
+    // Both completion buffers are still held by the application: leave the
+    // fragment queued until one of them is released
+    if(c_count >= DEFRAG_COMPLETE_BUFFERS)
+    {
+        return DEFRAG_CONTINUE;
+    }
+
+    queue_slot_t *slot = l->queue[l->q_tail];
+    uint16_t len = slot->len;
+    uint8_t *data = slot->data;
+    uint32_t now = sl_sleeptimer_get_tick_count();
+    uint32_t delay = now - l->queued_at[l->q_tail];
+    defrag_enum_t result;
 
-    LOG_INFO("POP data: ");
-    for (int i = 0; i < len; i++)
-        printf("%02x", queue[q_tail].data[i]);
-    printf(", len: %d\r\n", queue[q_tail].len);
+    log_bytes("POP", link, data, len, QUEUE_SLOT_SIZE);
 
-    q_tail = next_queue_index(q_tail);
+    l->queue[l->q_tail] = NULL;
+    l->q_tail = queue_index(l->q_tail, 1);
+    l->q_count--;
 
-    if(data == NULL || len == 0)
+    // Queueing delay: from the push in the event handler to this pass
+    if(l->stats.fragments == 0)
+    {
+        l->stats.first_tick = now;
+    }
+    l->stats.last_tick = now;
+    l->stats.fragments++;
+    l->stats.bytes += len;
+    l->stats.delay_total_ticks += delay;
+    if(delay > l->stats.delay_max_ticks)
     {
-         LOG_INFO("ERROR: Invalid fragment");
+        l->stats.delay_max_ticks = delay;
+    }
+
+    if(len == 0)
+    {
+        LOG_ERROR("Invalid fragment");
+        block_pool_free(&app_fragment_pool, slot);
         return DEFRAG_ERROR;
     }
 
-    if(defrag_cxt.is_first_fragment)
+    if(l->cxt.is_first_fragment)
     {
-        return process_first_fragment(data, len);
+        result = process_first_fragment(&l->cxt, data, len);
     }
     else
     {
-        return process_subsequent_fragment(data, len);
+        result = process_subsequent_fragment(&l->cxt, data, len);
+    }
+
+    // Fragment content has been copied into the reassembly buffer
+    block_pool_free(&app_fragment_pool, slot);
+
+    if(result == DEFRAG_COMPLETE)
+    {
+        hand_off_completed_payload(link);
+    }
+    return result;
+}
+
+uint8_t defrag_link_queued_fragments(uint8_t link)
+{
+    return (link < DEFRAG_LINKS) ? links[link].q_count : 0;
+}
+
+uint8_t defrag_queued_fragments(void)
+{
+    uint8_t total = 0;
+
+    for(uint8_t link = 0; link < DEFRAG_LINKS; link++)
+    {
+        total += links[link].q_count;
     }
+    return total;
 }
 
-bool defrag_get_payload(uint8_t **payload, uint16_t *payload_len, bool *checksum_valid)
+bool defrag_get_payload(uint8_t **payload, uint16_t *payload_len, bool *checksum_valid, uint8_t *link)
 {
-  if (!defrag_cxt.is_complete)
+  if (c_count == 0)
   {
     return false;
   }
   
   if (payload != NULL)
   {
-    *payload = defrag_cxt.complete_buffer;
+    *payload = completed[c_tail].buffer;
   }
   
   if (payload_len != NULL)
   {
-    *payload_len = defrag_cxt.received_len;
+    *payload_len = completed[c_tail].len;
   }
   
   if (checksum_valid != NULL)
   {
-    *checksum_valid = defrag_cxt.checksum_valid;
+    *checksum_valid = completed[c_tail].checksum_valid;
+  }
+
+  if (link != NULL)
+  {
+    *link = completed[c_tail].link;
   }
   
   return true;
-}
\ No newline at end of file
+}
+
+void defrag_release_payload(void)
+{
+  if (c_count == 0)
+  {
+    return;
+  }
+
+  block_pool_free(&app_message_pool, completed[c_tail].buffer);
+  completed[c_tail].buffer = NULL;
+  c_tail = (uint8_t)((c_tail + 1) % DEFRAG_COMPLETE_BUFFERS);
+  c_count--;
+}
+
+void defrag_get_link_stats(uint8_t link, defrag_link_stats_t *stats)
+{
+    if(link >= DEFRAG_LINKS || stats == NULL)
+    {
+        return;
+    }
+    *stats = links[link].stats;
+}
+
+void defrag_log_link_stats(void)
+{
+    for(uint8_t link = 0; link < DEFRAG_LINKS; link++)
+    {
+        const defrag_link_stats_t *s = &links[link].stats;
+        uint32_t window_ms;
+
+        if(s->fragments == 0)
+        {
+            continue;
+        }
+        window_ms = sl_sleeptimer_tick_to_ms(s->last_tick - s->first_tick);
+        LOG_STATS("RX link %u: %lu fragments, %lu bytes, %lu messages, %lu B/s, queueing delay avg %lu ms, max %lu ms",
+                  link,
+                  (unsigned long)s->fragments,
+                  (unsigned long)s->bytes,
+                  (unsigned long)s->messages,
+                  (unsigned long)(window_ms ? (uint32_t)((uint64_t)s->bytes * 1000u / window_ms) : 0),
+                  (unsigned long)sl_sleeptimer_tick_to_ms(s->delay_total_ticks / s->fragments),
+                  (unsigned long)sl_sleeptimer_tick_to_ms(s->delay_max_ticks));
+    }
+}
@@ -0,0 +1,446 @@
+#include <string.h>
+#include "sl_bt_api.h"
+#include "sl_sleeptimer.h"
+#include "ble_fragment_txdata.h"
+#include "app_checksum.h"
+#include "app_pools.h"
+#include "app_trace.h"
+#include "log.h"
+
+#define APP_TRACE_FILE_ID   4   // Trace site IDs of this file (app_trace.h)
+
+// A fragment of a message, one block of app_fragment_pool. Built once and
+// read by every link the message is queued on.
+typedef struct tx_fragment
+{
+    struct tx_fragment *next;               // Next fragment of the message, NULL after the last
+    uint8_t length;
+    uint8_t data[FRAG_TX_VALUE_LEN];
+} tx_fragment_t;
+
+// A message shared by its links, one block of app_fragment_pool
+typedef struct
+{
+    tx_fragment_t *first;
+    uint16_t payload_len;
+    uint8_t fragments;
+    uint8_t refs;                           // Links that have not finished sending it
+} tx_message_t;
+
+#if APP_FRAGMENT_BLOCK_SIZE < 28
+#error "APP_FRAGMENT_BLOCK_SIZE is too small for a tx_fragment_t"
+#endif
+
+// Transmit queue and counters of one link
+typedef struct
+{
+    tx_message_t *message[FRAG_TX_LINK_MESSAGES];   // Ring of the messages to send, oldest at head
+    uint8_t head;
+    uint8_t count;
+    tx_fragment_t *cursor;                  // Next fragment of the head message to hand to the stack
+    uint8_t sent;                           // Fragments of the head message handed to the stack
+    uint8_t credits;                        // Messages the Peripheral can take, see ble_defragment_rxdata.h
+    bool waiting_credit;                    // The head message waits for a credit
+    uint16_t queued;                        // Fragments left in all queued messages
+    uint16_t characteristic;
+    uint8_t connection;
+    frag_tx_link_stats_t stats;
+} tx_link_t;
+
+static tx_link_t tx_links[FRAG_TX_LINKS];
+static uint8_t next_link = 0;               // Link served first by the next frag_tx_process()
+
+/*******************************************************************************
+ ***************************   LOCAL FUNCTIONS   *******************************
+ *******************************************************************************/
+
+// Number of fragments of a payload, see build_message()
+static uint8_t fragment_count(size_t payload_len)
+{
+    // One fragment up to 18 bytes, otherwise a 19-byte first fragment and
+    // 20-byte fragments for the rest + checksum
+    if(payload_len <= FRAG_TX_VALUE_LEN - 2)
+    {
+        return 1;
+    }
+    return (uint8_t)(1 + ((payload_len - (FRAG_TX_VALUE_LEN - 1)) + 1 + (FRAG_TX_VALUE_LEN - 1)) / FRAG_TX_VALUE_LEN);
+}
+
+// Return a message and its fragments to the pool
+static void free_message(tx_message_t *msg)
+{
+    tx_fragment_t *frag = msg->first;
+
+    while(frag != NULL)
+    {
+        tx_fragment_t *next = frag->next;
+        block_pool_free(&app_fragment_pool, frag);
+        frag = next;
+    }
+    block_pool_free(&app_fragment_pool, msg);
+}
+
+// Allocate a fragment from the pool and link it at the end of a message
+static tx_fragment_t *append_fragment(tx_message_t *msg, tx_fragment_t **last)
+{
+    tx_fragment_t *frag = block_pool_alloc(&app_fragment_pool);
+    if(frag == NULL)
+    {
+        return NULL;
+    }
+
+    frag->next = NULL;
+    frag->length = 0;
+    if(*last != NULL)
+    {
+        (*last)->next = frag;
+    }
+    else
+    {
+        msg->first = frag;
+    }
+    *last = frag;
+    msg->fragments++;
+
+    return frag;
+}
+
+// Split a payload the way the Peripheral's fragment queue does, NULL if the
+// pool ran out. The message has no reference yet.
+static tx_message_t *build_message(const uint8_t *payload, size_t payload_len)
+{
+    uint8_t checksum = app_checksum_compute(payload, payload_len);
+    tx_message_t *msg = block_pool_alloc(&app_fragment_pool);
+    tx_fragment_t *last = NULL;
+    tx_fragment_t *frag;
+    size_t offset;
+
+    if(msg == NULL)
+    {
+        return NULL;
+    }
+    msg->first = NULL;
+    msg->payload_len = (uint16_t)payload_len;
+    msg->fragments = 0;
+    msg->refs = 0;
+
+    // Single fragment: [length | payload | checksum]
+    if(payload_len <= FRAG_TX_VALUE_LEN - 2)
+    {
+        frag = append_fragment(msg, &last);
+        if(frag == NULL)
+        {
+            free_message(msg);
+            return NULL;
+        }
+        frag->data[0] = (uint8_t)payload_len;
+        memcpy(&frag->data[1], payload, payload_len);
+        frag->data[1 + payload_len] = checksum;
+        frag->length = (uint8_t)(payload_len + 2);
+        return msg;
+    }
+
+    // First fragment: [length | payload(19)]
+    frag = append_fragment(msg, &last);
+    if(frag == NULL)
+    {
+        free_message(msg);
+        return NULL;
+    }
+    frag->data[0] = (uint8_t)payload_len;
+    memcpy(&frag->data[1], payload, FRAG_TX_VALUE_LEN - 1);
+    frag->length = FRAG_TX_VALUE_LEN;
+    offset = FRAG_TX_VALUE_LEN - 1;
+
+    // Middle fragments [payload(20)], then [payload(remaining) | checksum]
+    for(;;)
+    {
+        size_t remaining = payload_len - offset;
+
+        frag = append_fragment(msg, &last);
+        if(frag == NULL)
+        {
+            free_message(msg);
+            return NULL;
+        }
+
+        if(remaining <= FRAG_TX_VALUE_LEN - 1)
+        {
+            memcpy(frag->data, payload + offset, remaining);
+            frag->data[remaining] = checksum;
+            frag->length = (uint8_t)(remaining + 1);
+            return msg;
+        }
+        memcpy(frag->data, payload + offset, FRAG_TX_VALUE_LEN);
+        frag->length = FRAG_TX_VALUE_LEN;
+        offset += FRAG_TX_VALUE_LEN;
+    }
+}
+
+// Queue a message behind the earlier ones of a link, the ring has room
+static void link_push(tx_link_t *l, tx_message_t *msg)
+{
+    l->message[(l->head + l->count) % FRAG_TX_LINK_MESSAGES] = msg;
+    if(l->count == 0)
+    {
+        l->cursor = msg->first;
+        l->sent = 0;
+    }
+    l->count++;
+    l->queued += msg->fragments;
+    msg->refs++;
+}
+
+// The link is done with its head message: drop its reference and move to
+// the next message. The last link to let go frees the message.
+static void link_pop(tx_link_t *l)
+{
+    tx_message_t *done = l->message[l->head];
+
+    l->head = (uint8_t)((l->head + 1) % FRAG_TX_LINK_MESSAGES);
+    l->count--;
+    l->cursor = (l->count > 0) ? l->message[l->head]->first : NULL;
+    l->sent = 0;
+
+    if(--done->refs == 0)
+    {
+        free_message(done);
+    }
+}
+
+// Drop what is left of the head message of a link
+static void drop_message(tx_link_t *l)
+{
+    l->queued -= (uint16_t)(l->message[l->head]->fragments - l->sent);
+    link_pop(l);
+    l->stats.dropped++;
+}
+
+/*******************************************************************************
+ ***************************   GLOBAL FUNCTIONS   ******************************
+ ******************************************************************************/
+
+void frag_tx_init(void)
+{
+    for(uint8_t link = 0; link < FRAG_TX_LINKS; link++)
+    {
+        frag_tx_flush_link(link);
+    }
+    next_link = 0;
+}
+
+bool frag_tx_can_accept(size_t payload_len)
+{
+    // The fragments and the message block, whatever the number of links
+    return block_pool_available(&app_fragment_pool) >= (size_t)fragment_count(payload_len) + 1;
+}
+
+sl_status_t frag_tx_prepare(uint8_t link, uint8_t connection, uint16_t characteristic,
+                            const uint8_t *payload, size_t payload_len)
+{
+    frag_tx_dest_t dest = { .link = link, .connection = connection, .characteristic = characteristic };
+
+    return frag_tx_prepare_broadcast(&dest, 1, payload, payload_len);
+}
+
+sl_status_t frag_tx_prepare_broadcast(const frag_tx_dest_t *dests, uint8_t dest_count,
+                                      const uint8_t *payload, size_t payload_len)
+{
+    tx_message_t *msg;
+    uint32_t links_seen = 0;
+
+    if(dests == NULL || dest_count == 0 || dest_count > FRAG_TX_LINKS || payload == NULL
+       || payload_len == 0 || payload_len > FRAG_TX_MAX_PAYLOAD)
+    {
+        LOG_ERROR("Invalid payload to send");
+        return SL_STATUS_INVALID_PARAMETER;
+    }
+
+    // All or nothing: every link must have room for one more message
+    for(uint8_t i = 0; i < dest_count; i++)
+    {
+        uint8_t link = dests[i].link;
+
+        if(link >= FRAG_TX_LINKS || (links_seen & (1UL << link)))
+        {
+            LOG_ERROR("Invalid link %u to send on", link);
+            return SL_STATUS_INVALID_PARAMETER;
+        }
+        links_seen |= 1UL << link;
+        if(tx_links[link].count >= FRAG_TX_LINK_MESSAGES)
+        {
+            return SL_STATUS_FULL;
+        }
+    }
+
+    // Fragmented and checksummed once, whatever the number of links
+    msg = build_message(payload, payload_len);
+    if(msg == NULL)
+    {
+        LOG_ERROR("Fragment pool is empty");
+        return SL_STATUS_NO_MORE_RESOURCE;
+    }
+
+    for(uint8_t i = 0; i < dest_count; i++)
+    {
+        tx_link_t *l = &tx_links[dests[i].link];
+
+        l->connection = dests[i].connection;
+        l->characteristic = dests[i].characteristic;
+        link_push(l, msg);
+    }
+
+    APP_TRACE("tx queued, %u bytes, %u fragments, %u links",
+              (unsigned int)payload_len, msg->fragments, dest_count);
+    return SL_STATUS_OK;
+}
+
+uint8_t frag_tx_process(void)
+{
+    uint8_t completed = 0;
+    bool progress = true;
+
+    // One fragment per link in turn, so a long message or a slow link does
+    // not hold back the other links
+    while(progress)
+    {
+        progress = false;
+        for(uint8_t n = 0; n < FRAG_TX_LINKS; n++)
+        {
+            uint8_t link = (uint8_t)((next_link + n) % FRAG_TX_LINKS);
+            tx_link_t *l = &tx_links[link];
+            tx_fragment_t *frag = l->cursor;
+            uint16_t sent_len;
+            sl_status_t sc;
+
+            if(frag == NULL)
+            {
+                continue;
+            }
+
+            // A message starts only on a credit: the Peripheral has a
+            // completion buffer for it and does not lose a fragment
+            if(l->sent == 0 && l->credits == 0)
+            {
+                if(!l->waiting_credit)
+                {
+                    l->waiting_credit = true;
+                    l->stats.credit_waits++;
+                }
+                continue;
+            }
+
+            sc = sl_bt_gatt_write_characteristic_value_without_response(l->connection,
+                                                                         l->characteristic,
+                                                                         frag->length,
+                                                                         frag->data,
+                                                                         &sent_len);
+            if(sc == SL_STATUS_NO_MORE_RESOURCE)
+            {
+                // Stack TX buffers are full for every link: resume here next time
+                l->stats.stalls++;
+                next_link = link;
+                return completed;
+            }
+            if(sc != SL_STATUS_OK)
+            {
+                LOG_ERROR("TX link %u: write failed 0x%04lx, message dropped", link, (unsigned long)sc);
+                drop_message(l);
+                progress = true;
+                continue;
+            }
+
+            uint32_t now = sl_sleeptimer_get_tick_count();
+            if(l->stats.fragments == 0)
+            {
+                l->stats.first_tick = now;
+            }
+            l->stats.last_tick = now;
+            l->stats.fragments++;
+            l->stats.bytes += frag->length;
+            if(l->sent == 0)
+            {
+                l->credits--;
+                l->waiting_credit = false;
+            }
+            l->queued--;
+            l->sent++;
+            l->cursor = frag->next;
+            APP_TRACE("tx fragment written, link %u, %u bytes, last %u", link, frag->length, frag->next == NULL);
+            if(l->cursor == NULL)
+            {
+                l->stats.messages++;
+                completed++;
+                link_pop(l);
+            }
+            progress = true;
+        }
+    }
+    return completed;
+}
+
+void frag_tx_add_credits(uint8_t link, uint8_t credits)
+{
+    if(link >= FRAG_TX_LINKS)
+    {
+        return;
+    }
+    tx_links[link].credits = (uint8_t)((tx_links[link].credits + credits > FRAG_TX_LINK_CREDITS)
+                                       ? FRAG_TX_LINK_CREDITS
+                                       : tx_links[link].credits + credits);
+    APP_TRACE("tx credits, link %u, %u granted, %u held", link, credits, tx_links[link].credits);
+}
+
+uint16_t frag_tx_queued_fragments(uint8_t link)
+{
+    return (link < FRAG_TX_LINKS) ? tx_links[link].queued : 0;
+}
+
+void frag_tx_flush_link(uint8_t link)
+{
+    if(link >= FRAG_TX_LINKS)
+    {
+        return;
+    }
+    // A message still queued on other links stays with them
+    while(tx_links[link].count > 0)
+    {
+        link_pop(&tx_links[link]);
+    }
+    memset(&tx_links[link], 0, sizeof(tx_link_t));
+    tx_links[link].credits = FRAG_TX_LINK_CREDITS;
+}
+
+void frag_tx_get_link_stats(uint8_t link, frag_tx_link_stats_t *stats)
+{
+    if(link >= FRAG_TX_LINKS || stats == NULL)
+    {
+        return;
+    }
+    *stats = tx_links[link].stats;
+}
+
+void frag_tx_log_link_stats(void)
+{
+    for(uint8_t link = 0; link < FRAG_TX_LINKS; link++)
+    {
+        const frag_tx_link_stats_t *s = &tx_links[link].stats;
+        uint32_t window_ms;
+
+        if(s->fragments == 0)
+        {
+            continue;
+        }
+        window_ms = sl_sleeptimer_tick_to_ms(s->last_tick - s->first_tick);
+        LOG_STATS("TX link %u: %lu fragments, %lu bytes, %lu messages, %lu B/s, %lu stalls, %lu credit waits, %lu dropped, %u queued",
+                  link,
+                  (unsigned long)s->fragments,
+                  (unsigned long)s->bytes,
+                  (unsigned long)s->messages,
+                  (unsigned long)(window_ms ? (uint32_t)((uint64_t)s->bytes * 1000u / window_ms) : 0),
+                  (unsigned long)s->stalls,
+                  (unsigned long)s->credit_waits,
+                  (unsigned long)s->dropped,
+                  tx_links[link].queued);
+    }
+}
@@ -0,0 +1,200 @@
+/**
+ * @file ble_fragment_txdata.h
+ * @brief APIs and documentation for sending payloads from the Central to the
+ *        Peripherals with write without response
+ *
+ * This module is the Central's side of the reverse direction: a payload
+ * (a UART line or binary frame from the host) is split into fragments and
+ * written to the Peripheral's `usart_packet` characteristic with
+ * `sl_bt_gatt_write_characteristic_value_without_response()`. The
+ * Peripheral reassembles them with its copy of `ble_defragment_rxdata`.
+ *
+ * Implementation notes (see `ble_fragment_txdata.c`):
+ * - The fragment format is the one the Peripheral uses for its
+ *   indications: [length(1) | payload(max 19)] [payload(max 20)] ...
+ *   [payload(remaining) | checksum(1)], or [length | payload | checksum]
+ *   for up to 18 bytes.
+ * - A payload is checksummed and fragmented once when it is queued, into
+ *   blocks of `app_fragment_pool` plus one block for the message itself.
+ *   `frag_tx_prepare_broadcast()` queues the same message on several links
+ *   (index 0..`FRAG_TX_LINKS - 1`, the Central uses its `conn_properties`
+ *   slot): the fragments are shared, read only, and reference counted, so
+ *   a broadcast costs the work and memory of one transfer plus a queue
+ *   entry per link. The last link to send the message frees it.
+ * - Every link has its own queue of up to `FRAG_TX_LINK_MESSAGES` messages
+ *   and its own position in the head message, so a slow or stalled link
+ *   does not hold back the others.
+ * - Write without response has no ATT confirmation: the pace is set by the
+ *   stack's TX buffers. `frag_tx_process()` hands fragments to the stack,
+ *   one per link in turn, until the stack refuses one with
+ *   SL_STATUS_NO_MORE_RESOURCE; that fragment stays queued and is retried
+ *   on the next call, once the link layer has sent some packets.
+ * - Nor can the Peripheral refuse a write, so a link only starts a message
+ *   on a credit of the Peripheral (see `ble_defragment_rxdata.h`): it holds
+ *   `FRAG_TX_LINK_CREDITS` when it is flushed, spends one per message and
+ *   gets them back with `frag_tx_add_credits()` as the Peripheral releases
+ *   the payloads. A link without credit waits and does not hold back the
+ *   others.
+ * - Per link, the module counts messages, fragments and bytes handed to the
+ *   stack, the refused writes (stalls), the fragments still to send and
+ *   the throughput (`frag_tx_log_link_stats()`).
+ */
+
+#ifndef BLE_FRAGMENT_TXDATA_H
+#define BLE_FRAGMENT_TXDATA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "sl_status.h"
+#include "ble_defragment_rxdata.h"
+
+// The Peripheral reassembles with its copy of ble_defragment_rxdata
+#define FRAG_TX_VALUE_LEN   DEFRAG_FRAGMENT_LEN         // usart_packet value length
+#define FRAG_TX_MAX_PAYLOAD DEFRAG_MAX_PAYLOAD
+#define FRAG_TX_LINK_CREDITS DEFRAG_COMPLETE_BUFFERS    // Messages ahead of the Peripheral's credits
+
+// Links with their own transmit queue, at least SL_BT_CONFIG_MAX_CONNECTIONS
+#ifndef FRAG_TX_LINKS
+#define FRAG_TX_LINKS       4
+#endif
+#if FRAG_TX_LINKS > 32
+#error "FRAG_TX_LINKS is limited to 32"
+#endif
+
+// Messages a link can have queued
+#ifndef FRAG_TX_LINK_MESSAGES
+#define FRAG_TX_LINK_MESSAGES   4
+#endif
+
+// A link to send a message on
+typedef struct
+{
+    uint8_t link;                   // 0..FRAG_TX_LINKS - 1
+    uint8_t connection;             // Connection handle of the link
+    uint16_t characteristic;        // Handle of the Peripheral's `usart_packet` characteristic
+} frag_tx_dest_t;
+
+// Counters of one link since it was last flushed
+typedef struct
+{
+    uint32_t messages;              // Messages whose last fragment was handed to the stack
+    uint32_t fragments;             // Fragments handed to the stack
+    uint32_t bytes;                 // Fragment bytes handed to the stack
+    uint32_t stalls;                // Writes refused for lack of stack TX buffers
+    uint32_t dropped;               // Messages lost on a write error
+    uint32_t credit_waits;          // Messages that waited for a credit of the Peripheral
+    uint32_t first_tick;            // First and last fragment handed to the stack
+    uint32_t last_tick;
+} frag_tx_link_stats_t;
+
+/**
+ * @brief Initialize the transmit queues.
+ *
+ * Returns every queued fragment to `app_fragment_pool` and clears the
+ * counters. Call once at startup.
+ */
+void frag_tx_init(void);
+
+/**
+ * @brief Check whether a payload can be queued now.
+ *
+ * Lets the caller keep its payload and retry later instead of getting
+ * SL_STATUS_NO_MORE_RESOURCE from `frag_tx_prepare()`.
+ *
+ * @param payload_len Length of the payload in bytes
+ * @return true if `app_fragment_pool` has a block for every fragment and
+ *         the message, for one link or a broadcast alike
+ */
+bool frag_tx_can_accept(size_t payload_len);
+
+/**
+ * @brief Fragment a payload and queue it behind the link's earlier messages.
+ *
+ * The payload is copied, the caller may reuse its buffer on return.
+ * Nothing is sent before `frag_tx_process()`.
+ *
+ * @param link           Link to send on
+ * @param connection     Connection handle of the link
+ * @param characteristic Handle of the Peripheral's `usart_packet` characteristic
+ * @param payload        Payload bytes
+ * @param payload_len    1..FRAG_TX_MAX_PAYLOAD bytes
+ * @return SL_STATUS_OK, SL_STATUS_INVALID_PARAMETER, SL_STATUS_FULL if
+ *         the link has `FRAG_TX_LINK_MESSAGES` messages queued, or
+ *         SL_STATUS_NO_MORE_RESOURCE if the fragment pool is exhausted
+ *         (nothing is queued in the last two cases)
+ */
+sl_status_t frag_tx_prepare(uint8_t link, uint8_t connection, uint16_t characteristic,
+                            const uint8_t *payload, size_t payload_len);
+
+/**
+ * @brief Fragment a payload once and queue it on several links.
+ *
+ * Every link sends the same fragments at its own pace; the counters of
+ * `frag_tx_get_link_stats()` and `frag_tx_queued_fragments()` follow each
+ * one separately. The message is queued on all links or on none.
+ *
+ * @param dests       Links to send on, each link at most once
+ * @param dest_count  1..FRAG_TX_LINKS entries
+ * @param payload     Payload bytes, copied
+ * @param payload_len 1..FRAG_TX_MAX_PAYLOAD bytes
+ * @return SL_STATUS_OK, SL_STATUS_INVALID_PARAMETER, SL_STATUS_FULL if one
+ *         of the links has `FRAG_TX_LINK_MESSAGES` messages queued, or
+ *         SL_STATUS_NO_MORE_RESOURCE if the fragment pool is exhausted
+ */
+sl_status_t frag_tx_prepare_broadcast(const frag_tx_dest_t *dests, uint8_t dest_count,
+                                      const uint8_t *payload, size_t payload_len);
+
+/**
+ * @brief Hand queued fragments to the stack while it has TX buffers.
+ *
+ * Call from `app_process_action()`. Never waits.
+ *
+ * @return Number of messages whose last fragment was handed to the stack
+ */
+uint8_t frag_tx_process(void);
+
+/**
+ * @brief Give back credits granted by the Peripheral of a link.
+ *
+ * Call with the count of a credit frame [`DEFRAG_CREDIT_TAG` | count]
+ * indicated by the Peripheral. A link never holds more than
+ * `FRAG_TX_LINK_CREDITS`.
+ *
+ * @param link    Link the frame came from
+ * @param credits Count of the frame
+ */
+void frag_tx_add_credits(uint8_t link, uint8_t credits);
+
+/**
+ * @brief Number of fragments the link has still to send, over all its
+ *        queued messages.
+ */
+uint16_t frag_tx_queued_fragments(uint8_t link);
+
+/**
+ * @brief Forget everything of a link, e.g. when its connection closes.
+ *
+ * Drops the link's queued messages, a message shared with other links
+ * stays queued there, clears the link's counters and gives it back
+ * `FRAG_TX_LINK_CREDITS` credits for its next connection.
+ *
+ * @param link Link to flush
+ */
+void frag_tx_flush_link(uint8_t link);
+
+/**
+ * @brief Copy the counters of a link.
+ *
+ * @param[in]  link  Link to look at
+ * @param[out] stats Destination for the counters
+ */
+void frag_tx_get_link_stats(uint8_t link, frag_tx_link_stats_t *stats);
+
+/**
+ * @brief Print throughput, stalls and credit waits of every link that sent
+ *        fragments.
+ */
+void frag_tx_log_link_stats(void);
+
+#endif /* BLE_FRAGMENT_TXDATA_H */
@@ -0,0 +1,22 @@
+#include "sl_sleeptimer.h"
+#include "log.h"
+
+volatile uint32_t log_category_mask = LOG_CAT_ALL;
+
+/*******************************************************************************
+ ***************************   GLOBAL FUNCTIONS   ******************************
+ ******************************************************************************/
+
+uint64_t log_timestamp_ms(void)
+{
+    uint64_t ms = 0;
+
+    // Only fails past ~2^64 ticks
+    (void)sl_sleeptimer_tick64_to_ms(sl_sleeptimer_get_tick_count64(), &ms);
+    return ms;
+}
+
+void log_set_category_mask(uint32_t mask)
+{
+    log_category_mask = mask & LOG_CAT_ALL;
+}
@@ -36,21 +36,52 @@
 #include "sl_sleeptimer.h"
 
 #include "burtc.h"
+#include "app_clock.h"
+#include "app_adv_status.h"
 #include "app_iostream_usart.h"
 #include "ble_fragment_queue.h"
+#include "ble_defragment_rxdata.h"
+#include "app_pools.h"
+#include "app_checksum.h"
+#include "app_cycle_stats.h"
+#include "app_trace.h"
+#include "app_uart_ingress.h"
+#include "app_uart_egress.h"
+#include "app_uart_link.h"
+#include "app_console.h"
 #include "app_button_pairing_complete.h"
+#include "app_bond_store.h"
 
 #include "sl_board_control.h"
 #include "dmd.h"
 #include "glib.h"
 
+// Trace site IDs of this file (app_trace.h)
+#define APP_TRACE_FILE_ID 1
+
+// Reassembly link of the Central's writes, the only one (DEFRAG_LINKS 1)
+#define RX_LINK           0
+
 #ifndef DELAY_MS
 #define DELAY_MS 2000
 #endif
 
-#ifndef BUFSIZE
-#define BUFSIZE    80
+// Current Time notifications: one every CURRENT_TIME_PERIOD_S seconds, sent
+// right after the BURTC second rolls over
+#ifndef CURRENT_TIME_PERIOD_S
+#define CURRENT_TIME_PERIOD_S   1
 #endif
+#define CURRENT_TIME_SIGNAL     (1UL << 8)  // External signal of the notification timer, above the pair_state_t values
+#define CURRENT_TIME_ALL_SUBSCRIBERS 0xFF   // Connection argument of a notification to every subscriber
+
+// The clock sees a BURTC wrap (every 36.4 h) only if it is read at least once
+// per wrap period: read it on this period whether a client is subscribed or not
+#define CLOCK_WRAP_CHECK_PERIOD_MS  (3600UL * 1000UL)
+#define CLOCK_WRAP_SIGNAL       (1UL << 9)  // External signal of the clock wrap check timer
+
+// ATT error codes of a user read response
+#define ATT_ERROR_READ_NOT_PERMITTED  0x02
+#define ATT_ERROR_INVALID_OFFSET      0x07
 
 #define DISPLAYONLY       0
 #define DISPLAYYESNO      1
@@ -110,33 +141,72 @@ uint8_t adv_payload[] = {
   // Flags (3 bytes)
   2, 0x01, 0x06,
   // Service UUIDs 
-  17, 0x07, 0x40, 0x30, 0x57, 0x13, 0x72, 0xd9, 0x62, 0x83, 0xdf, 0x4c, 0xb8, 0x80, 0xd9, 0x81, 0x7d, 0x46
+  17, 0x07, 0x40, 0x30, 0x57, 0x13, 0x72, 0xd9, 0x62, 0x83, 0xdf, 0x4c, 0xb8, 0x80, 0xd9, 0x81, 0x7d, 0x46,
+  // Manufacturer specific data: status (app_adv_status.h), filled in at run time
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+#define ADV_STATUS_OFFSET (sizeof(adv_payload) - APP_ADV_STATUS_AD_LEN)
+
+// Status advertised last; the battery is not measured on this board
+static app_adv_status_t adv_status = {
+  .version = APP_ADV_STATUS_VERSION,
+  .flags = 0,
+  .queued_bytes = 0,
+  .battery = APP_ADV_STATUS_BATTERY_UNKNOWN,
+  .sequence = 0
 };
 
 // The advertising set handle allocated from Bluetooth stack.
 static uint8_t advertising_set_handle = 0xff;
 static uint8_t connection_handle = 0xff;
 
-// Variables to hold BURTC count and converted time in seconds.
-static uint32_t count;
-static uint32_t time;
+// Security of the current connection (app_bond_store.h)
+static uint32_t connection_opened_at;             // Sleeptimer tick of the connection
+static uint8_t peer_bonding = SL_BT_INVALID_BONDING_HANDLE;   // Bonding handle at connection
+static bool link_secured = false;
+
+// Fragments written by the Central that found the RX ring full
+static uint32_t rx_writes_dropped = 0;
+
+// Messages of the Central released since the last credit frame
+// (ble_defragment_rxdata.h)
+static uint8_t rx_credits_owed = 0;
 
 // Variable for creating a non-blocking delay and state
 sl_sleeptimer_timer_handle_t timer_handle;
 volatile bool advertising = false;
-volatile bool notification = false;
+
+// Periodic read of the clock, to follow the BURTC wraps
+static sl_sleeptimer_timer_handle_t clock_wrap_timer;
+
+// Current Time notifications
+static sl_sleeptimer_timer_handle_t current_time_timer;
+static uint32_t current_time_subscribers = 0;     // Bit per connection handle with notifications enabled
+static uint32_t current_time_last_second = UINT32_MAX;    // BURTC second of the last periodic notification
+static uint32_t current_time_sent = 0;
+static uint32_t current_time_early_wakeups = 0;   // Timer expired before the rollover
 static ind_state_t ind_state = INDICATION_DISABLE;
 
 // Periodic timer callback
 static void timer_handler(sl_sleeptimer_timer_handle_t *handle, void *data);
 
-// Send data of notification.
-static sl_status_t send_current_time_notification(void);
+// Current Time notifications
+static void current_time_subscribe(uint8_t connection, bool enabled);
+static void current_time_schedule(uint32_t burtc_count);
+static void current_time_timer_cb(sl_sleeptimer_timer_handle_t *handle, void *data);
+static void current_time_on_timer(void);
+static void clock_wrap_timer_cb(sl_sleeptimer_timer_handle_t *handle, void *data);
+static sl_status_t send_current_time_notification(uint8_t connection);
+static void send_time_read_response(const sl_bt_evt_gatt_server_user_read_request_t *req);
 sl_status_t send_usart_packet_over_ble(uint8_t *payload, size_t payload_len);
 
-// Reading data fucntion
-size_t read_line_from_iostream(sl_iostream_t *handle, uint8_t *out_buf, 
-                               size_t max_len, uint32_t timeout);
+// Data written by the Central
+static void reassemble_central_data(void);
+static void forward_central_data(void);
+static void send_rx_credits(void);
+
+// Status in the advertising data
+static void update_advertised_status(void);
 
 // PASSKEY
 #if (IO_CAPABILITY != KEYBOARDONLY)
@@ -156,57 +226,93 @@ void button_event_handler(const button_event_t *evt);
 // Application Init.
 void app_init(void)
 {
+  app_console_init();
+  app_cycle_counter_init();
+  app_trace_init();
+#ifdef APP_TRACE_BENCHMARK
+  app_trace_log_benchmark();
+#endif
   app_iostream_usart_init();
   init_burtc();
+  app_pools_init();
+  app_uart_egress_init();
+  app_uart_link_init();
+  app_uart_ingress_init(app_uart_link_on_control);
+#ifdef APP_CHECKSUM_BENCHMARK
+  app_checksum_log_benchmark();
+#endif
   fragment_queue_init();
+  defrag_init();
+  app_adv_status_encode(&adv_status, &adv_payload[ADV_STATUS_OFFSET]);
   graphics_init();
   app_button_pairing_init(button_event_handler);
 
-  count = get_burtc_count();
-  LOG_INFO("BURTC Count: %lu", count);
-
-  time = convert_count_to_seconds(count, 32768);
-  LOG_INFO("Elapsed time (seconds): %lu", time);
+  app_clock_time_t now;
+  app_clock_init();
+  app_clock_now(&now);
+  LOG_INFO("Clock: %04u-%02u-%02u %02u:%02u:%02u, BURTC count %lu",
+           now.year, now.month, now.day, now.hour, now.minute, now.second,
+           (unsigned long)get_burtc_count());
+  sl_status_t sc = sl_sleeptimer_start_periodic_timer_ms(&clock_wrap_timer,
+                                                         CLOCK_WRAP_CHECK_PERIOD_MS,
+                                                         clock_wrap_timer_cb,
+                                                         NULL, 0, 0);
+  app_assert_status(sc);
 }
 
 // Application Process Action.
 void app_process_action(void)
 {
   sl_status_t sc;
-  
-  // Input buffer 
-  static char buffer[BUFSIZE];
 
-  // Notifiy
-  if(notification)
-  {
-    sc = send_current_time_notification();
-    if(sc == SL_STATUS_OK)
-    {
-      printf("send notification OK\r\n");
-    }
-    // sl_sleeptimer_delay_millisecond(DELAY_MS);
-  }
+  // Current Time is notified from the timer signal (sl_bt_on_event), not here:
+  // the main loop has nothing to do between two notifications and the MCU sleeps
 
   // Receive data and indication
-  memset(buffer, 0, sizeof(buffer)-1);
-  size_t len = read_line_from_iostream(sl_iostream_vcom_handle, (uint8_t *)buffer, BUFSIZE, 1000);
-  if(len > 0)
+  // Frame what the UART received since the last pass, never waits for input
+  app_uart_ingress_process();
+  app_uart_link_process();
+
+  uint8_t *line;
+  size_t len;
+  bool is_frame;
+  // A line waits in the ingress queue while no Central has enabled indications
+  // or the fragment pool is busy with earlier messages
+  if(ind_state != INDICATION_DISABLE
+     && app_uart_ingress_get_line(&line, &len, &is_frame) && fragment_queue_can_accept(len))
   {
-    // remove trailing CR/LF
-    while (len > 0 && (buffer[len - 1] == '\n' || buffer[len - 1] == '\r'))
+    if(is_frame)
+    {
+      LOG_INFO("Received: %u bytes binary frame", len);
+    }
+    else
     {
-      buffer[--len] = '\0';
+      LOG_INFO("Received: %u bytes: %s", len, (char *)line);
     }
-    LOG_INFO("Received: %u bytes: %s", len, (char *)buffer);
 
-    sc = send_usart_packet_over_ble((uint8_t *)buffer, len);
+    // The fragment queue copies the payload, the line can be released afterwards
+    sc = send_usart_packet_over_ble(line, len);
     if(sc == SL_STATUS_OK)
     {
       LOG_INFO("send Indication OK");
     }
+    app_uart_ingress_release_line();
   }
 
+  // Let a scanning Central know whether data waits for it
+  update_advertised_status();
+
+  // Data written by the Central, to the UART. Fragments left queued while the
+  // completion buffers were held are reassembled first.
+  reassemble_central_data();
+  forward_central_data();
+  send_rx_credits();
+
+  // Send buffered trace records and log text in the background
+  app_trace_process();
+  app_console_process();
+  app_uart_egress_process();
+
   if (app_is_process_required()) {
 
   }
@@ -224,6 +330,8 @@ void sl_bt_on_event(sl_bt_msg_t *evt)
   bd_addr address;
   uint8_t address_type;
 
+  APP_TRACE("bt event 0x%08lx", (unsigned long)SL_BT_MSG_ID(evt->header));
+
   switch (SL_BT_MSG_ID(evt->header)) 
   {
     // -------------------------------
@@ -269,9 +377,13 @@ void sl_bt_on_event(sl_bt_msg_t *evt)
       app_assert_status(sc);
       LOG_BOOT("Bondings allowed");
 
-      sc = sl_bt_sm_delete_bondings();
+      // Hold BTN1 during reset to revoke every trusted peer
+      if(button_service_get_button_state(BUTTON_ID_1) == SL_SIMPLE_BUTTON_PRESSED)
+      {
+        app_bond_store_revoke(APP_BOND_STORE_ALL);
+      }
+      sc = app_bond_store_init();
       app_assert_status(sc);
-      LOG_BOOT("Old bondings deleted");
 
       // Create an advertising set
       sc = sl_bt_advertiser_create_set(&advertising_set_handle);
@@ -324,6 +436,14 @@ void sl_bt_on_event(sl_bt_msg_t *evt)
       connection_handle = evt->data.evt_connection_opened.connection;
       LOG_CONN("Connected to central device %02x\r\n", connection_handle);
 
+      connection_opened_at = sl_sleeptimer_get_tick_count();
+      peer_bonding = evt->data.evt_connection_opened.bonding;
+      link_secured = false;
+      if(peer_bonding != SL_BT_INVALID_BONDING_HANDLE)
+      {
+        LOG_BONDING("Known peer, bonding 0x%02x: encrypting with the stored keys", peer_bonding);
+      }
+
       // // Enable encryption on an unencrypted device
       // sc = sl_bt_sm_increase_security(connection_handle);
       // app_assert_status(sc);
@@ -346,9 +466,7 @@ void sl_bt_on_event(sl_bt_msg_t *evt)
       app_assert_status(sc); 
       LOG_CONN("DISCONNECT: Generate data for advertising again");
 
-      sc = sl_bt_sm_delete_bondings();
-      app_assert_status(sc);
-      LOG_CONN("All bonding deleted");
+      app_bond_store_on_closed();
 
       // Restart advertising after client has disconnected.
       sc = sl_bt_legacy_advertiser_start(advertising_set_handle,
@@ -356,6 +474,12 @@ void sl_bt_on_event(sl_bt_msg_t *evt)
       app_assert_status(sc);
       LOG_CONN("Restart advertising");
       
+      // Drop fragments that can no longer be delivered and return them to the pool
+      fragment_queue_init();
+      defrag_flush_link(RX_LINK);
+      rx_credits_owed = 0;
+      current_time_subscribe(evt->data.evt_connection_closed.connection, false);
+
       connection_handle = 0xFF;
       ind_state = INDICATION_DISABLE;
       advertising = true;
@@ -383,6 +507,21 @@ void sl_bt_on_event(sl_bt_msg_t *evt)
         default:
           break;
       }
+
+      // First encrypted parameters of the connection: time to encryption
+      if(!link_secured
+         && evt->data.evt_connection_parameters.security_mode != sl_bt_connection_mode1_level1)
+      {
+        uint32_t ms = sl_sleeptimer_tick_to_ms(sl_sleeptimer_get_tick_count() - connection_opened_at);
+        bool resumed = (peer_bonding != SL_BT_INVALID_BONDING_HANDLE);
+
+        link_secured = true;
+        app_bond_store_record_secured(resumed, ms);
+        LOG_BONDING("Link %d encrypted %lu ms after connection (%s)",
+                    evt->data.evt_connection_parameters.connection, (unsigned long)ms,
+                    resumed ? "stored keys" : "pairing");
+        app_bond_store_log_stats();
+      }
       break;
 
     // -------------------------------
@@ -431,6 +570,13 @@ void sl_bt_on_event(sl_bt_msg_t *evt)
     case sl_bt_evt_sm_bonding_failed_id:
       LOG_BONDING("Bonding failed, reason 0x%2X\r\n",
                 evt->data.evt_sm_bonding_failed.reason);
+      // The Central lost or revoked its keys: forget ours, the next connection pairs again
+      if(peer_bonding != SL_BT_INVALID_BONDING_HANDLE
+         && evt->data.evt_sm_bonding_failed.reason == SL_STATUS_BT_CTRL_PIN_OR_KEY_MISSING)
+      {
+        app_bond_store_revoke(peer_bonding);
+        peer_bonding = SL_BT_INVALID_BONDING_HANDLE;
+      }
       sc = sl_bt_connection_close(evt->data.evt_sm_bonding_failed.connection);
       LOG_BONDING("CLOSE connection");
       state = BOND_FAILURE;
@@ -438,9 +584,21 @@ void sl_bt_on_event(sl_bt_msg_t *evt)
       break;
 
     // -------------------------------
+    // Raised from the button handler and from timer callbacks (interrupt
+    // context) to do the work here
     case sl_bt_evt_system_external_signal_id:
       // Handle external signals
-      if(evt->data.evt_system_external_signal.extsignals == PROMPT_CONFIRM_PASSKEY)
+      if(evt->data.evt_system_external_signal.extsignals & CURRENT_TIME_SIGNAL)
+      {
+        current_time_on_timer();
+      }
+      if(evt->data.evt_system_external_signal.extsignals & CLOCK_WRAP_SIGNAL)
+      {
+        // The read itself moves the epoch past a wrap
+        app_clock_now(NULL);
+      }
+      if((evt->data.evt_system_external_signal.extsignals & ~(CURRENT_TIME_SIGNAL | CLOCK_WRAP_SIGNAL))
+         == PROMPT_CONFIRM_PASSKEY)
       {
         // Disable button service after user input
         // app_button_pairing_disable();
@@ -460,27 +618,24 @@ void sl_bt_on_event(sl_bt_msg_t *evt)
     case sl_bt_evt_gatt_server_attribute_value_id:
       if(gattdb_usart_packet == evt->data.evt_gatt_server_attribute_value.attribute)
       {
-        uint8_t data_recv[20];
-        size_t data_recv_len;
-
-        // Read characteristic value
-        memset(data_recv, 0, sizeof(data_recv)-1);
-        sc = sl_bt_gatt_server_read_attribute_value(gattdb_usart_packet,
-                                                    0,
-                                                    20,
-                                                    &data_recv_len,
-                                                    data_recv);
-        (void)data_recv_len;   
-        app_assert_status(sc);
-        if (sc != SL_STATUS_OK) 
+        // A fragment written by the Central, usually without response. A write
+        // command cannot be held back, so the Central only starts a message on
+        // a credit (send_rx_credits()) and the ring has room; a fragment
+        // finding it full anyway is lost.
+        APP_TRACE("write %u bytes, opcode 0x%02x",
+                  evt->data.evt_gatt_server_attribute_value.value.len,
+                  evt->data.evt_gatt_server_attribute_value.att_opcode);
+        if(defrag_push_data(RX_LINK,
+                            evt->data.evt_gatt_server_attribute_value.value.data,
+                            evt->data.evt_gatt_server_attribute_value.value.len))
         {
-          LOG_CONN("ERROR: Client wrote error");
-          break;
+          reassemble_central_data();
+        }
+        else
+        {
+          rx_writes_dropped++;
+          LOG_WARN("Written fragment dropped (%lu so far)", (unsigned long)rx_writes_dropped);
         }
-
-        data_recv[data_recv_len] = '\0'; 
-        LOG_CONN("Written value by client: %s",data_recv);
-        // LOG_INFO("Last byte: %c", data_recv[data_recv_len-1]);
       }
       break;
 
@@ -500,19 +655,12 @@ void sl_bt_on_event(sl_bt_msg_t *evt)
         if(evt->data.evt_gatt_server_characteristic_status.client_config_flags & sl_bt_gatt_notification)
         {
           LOG_CONN("Notification enabled");
-          
-          // Send notification of the current time
-          sc = send_current_time_notification();
-          app_assert_status(sc);
-          printf("Sent current time\r\n");
-
-          notification = true;
+          current_time_subscribe(evt->data.evt_gatt_server_characteristic_status.connection, true);
         }
         else
         {
-          printf("Notification disabled\r\n");
-
-          notification = false;
+          LOG_CONN("Notification disabled");
+          current_time_subscribe(evt->data.evt_gatt_server_characteristic_status.connection, false);
         }
       }
 
@@ -562,6 +710,13 @@ void sl_bt_on_event(sl_bt_msg_t *evt)
       // } sl_bt_gatt_server_characteristic_status_flag_t;
       break;
 
+    // -------------------------------
+    // A client reads a user-type characteristic: the Current Time Service
+    // values are computed now, from the clock, nothing keeps them up to date
+    case sl_bt_evt_gatt_server_user_read_request_id:
+      send_time_read_response(&evt->data.evt_gatt_server_user_read_request);
+      break;
+
     // -------------------------------
     // Default event handler.
     default:
@@ -575,167 +730,222 @@ static void timer_handler(sl_sleeptimer_timer_handle_t *handle, void *data)
   (void)handle;
 
   if(advertising)
-    printf(".");
+    app_console_write(".", 1);
 }
 
+/*******************************************************************************
+ ************************   CURRENT TIME FUNCTIONS   ***************************
+ ******************************************************************************/
+
 /**
- * @brief Read a line from an iostream into a buffer with timeout.
+ * @brief Track the connections subscribed to Current Time notifications.
  *
- * Reads available bytes from the given iostream handle until a newline
- * ('\n' or '\r') is encountered, the buffer is full (leaving room for a
- * null terminator), or the timeout (in milliseconds) expires. The function
- * polls the iostream and sleeps briefly when no data is available.
+ * A new subscriber gets the current time at once, on its connection only.
+ * The timer runs while at least one connection is subscribed, whatever their
+ * number: the periodic notification goes to all of them at once.
  *
- * @param handle   iostream handle to read from (e.g., `sl_iostream_vcom_handle`)
- * @param out_buf  Output buffer where data will be copied and null-terminated
- * @param max_len  Maximum number of bytes to write to out_buf (including null terminator)
- * @param timeout  Timeout in milliseconds to wait for a complete line
- * @return Number of bytes copied into out_buf (excluding null terminator)
+ * @param[in] connection Connection handle
+ * @param[in] enabled    true when the client enabled notifications
  */
-size_t read_line_from_iostream(sl_iostream_t *handle, uint8_t *out_buf, size_t max_len, uint32_t timeout)
+static void current_time_subscribe(uint8_t connection, bool enabled)
 {
-  uint32_t waited = 0;
-  size_t total = 0;
-  uint8_t tempbuf[BUFSIZE];
-  size_t bytes_read = 0;
-
-  if(max_len == 0)
-    return 0;
-  
-  // CR/LF = \r and \n
-  // Clear output buffer to guarantee a valid C-string
-    out_buf[0] = '\0';
-
-    while (waited < timeout && total < (max_len - 1)) 
-    {
-        // read whatever data is available (up to tempbuf size)
-        sl_status_t st = sl_iostream_read(handle, tempbuf, sizeof(tempbuf), &bytes_read);
-        if (st == SL_STATUS_OK && bytes_read > 0) 
-        {
-            // Copy to output buffer
-            LOG_INFO("bytes_read: %u", bytes_read);
-            size_t copy = bytes_read;
-            if (total + copy > (max_len - 1)) 
-            {
-                // limit copy to remaining output buffer space
-                copy = (max_len - 1) - total;
-            }
-            memcpy(out_buf + total, tempbuf, copy);
-            total += copy;
-            out_buf[total] = '\0';
-
-            // return early if newline or CR present
-            if (memchr(out_buf, '\n', total) != NULL || memchr(out_buf, '\r', total) != NULL) 
-            {
-                return total;
-            }
-
-            // Data received; reset timeout (optional) to wait for remaining bytes
-            waited = 0;
-            // Continue immediately to aggregate more data without a long delay
-            continue;
-        }
-
-        // No data this iteration: sleep briefly to allow ISR/DMA to refill the buffer
-        sl_sleeptimer_delay_millisecond(20);
-        waited += 20;   // 10 is a poll interval
+  uint32_t bit = (connection < 32) ? (1UL << connection) : 0;
+  uint32_t before = current_time_subscribers;
+  uint32_t burtc_count;
+
+  if (!enabled) {
+    current_time_subscribers &= ~bit;
+    if (before != 0 && current_time_subscribers == 0) {
+      sl_sleeptimer_stop_timer(&current_time_timer);
+      LOG_CONN("Current Time: no subscriber left, %lu sent, %lu early wakeups",
+               (unsigned long)current_time_sent, (unsigned long)current_time_early_wakeups);
     }
+    return;
+  }
 
-    // On timeout, return any collected data; otherwise return 0
-    return total;
-} 
+  current_time_subscribers |= bit;
+  burtc_count = get_burtc_count();
+  send_current_time_notification(connection);
+  if (before == 0) {
+    current_time_last_second = UINT32_MAX;
+    current_time_schedule(burtc_count);
+  }
+}
 
 /**
- * @brief Assemble and send a Current Time notification to all connected clients.
+ * @brief Arm the timer for the next second rollover that is a multiple of
+ *        CURRENT_TIME_PERIOD_S.
  *
- * This helper reads the BURTC counter, converts it into elapsed seconds, and
- * constructs a 10-byte Current Time structure (year, month, day, hour, minute,
- * second, day_of_week, fractions256, adjust_reason) which is sent via
- * `sl_bt_gatt_server_notify_all()` on `gattdb_current_time`.
+ * The timer is a one-shot rearmed at each expiry from the BURTC count, so
+ * the sleeptimer and the BURTC cannot drift apart: an expiry that comes a
+ * little early only arms a short timer up to the rollover.
  *
- * @return SL_STATUS_OK on successful notification send, otherwise an error code
+ * @param[in] burtc_count BURTC count read just before
  */
-static sl_status_t send_current_time_notification(void)
+static void current_time_schedule(uint32_t burtc_count)
 {
+  uint64_t period = (uint64_t)CURRENT_TIME_PERIOD_S * APP_CLOCK_TICKS_PER_SECOND;
+  uint64_t next = ((uint64_t)burtc_count / period + 1) * period;
+  uint32_t wait_ms = (uint32_t)(((next - burtc_count) * 1000 + APP_CLOCK_TICKS_PER_SECOND - 1)
+                                / APP_CLOCK_TICKS_PER_SECOND);
   sl_status_t sc;
-  uint8_t current_time[10];     
-  size_t len = 0;
 
-  // Get current time from BURTC
-  count = get_burtc_count();
-  time = convert_count_to_seconds(count, 32768);
-  LOG_CONN("Get current time from BURTC: %lu seconds", (unsigned long)time);
-
-  // Timline (Milestone): 2025/11/07 03:40:10 (year=2025, month=11, day=7, hour=3, minute=40, second=10)
-  const uint16_t base_year  = 2025;
-  const uint8_t  base_month = 11;
-  const uint8_t  base_day   = 7;
-  const uint8_t  base_hour  = 3;
-  const uint8_t  base_min   = 40;
-  const uint8_t  base_sec   = 10;
-  const uint8_t  base_dow   = 5;  // 5 is Friday (1->7) 
-
-  // Get total seconds
-  uint32_t total_seconds = (uint32_t)base_hour * 3600
-                         + (uint32_t)base_min  * 60
-                         + (uint32_t)base_sec
-                         + time;
-
-  // Calculate the days elapsed, hour, minutes and seconds
-  uint32_t days_elapsed = total_seconds / 86400;
-  uint32_t sec_of_day   = total_seconds % 86400;
-
-  uint8_t hour   = sec_of_day / 3600;
-  uint8_t minute = (sec_of_day % 3600) / 60;
-  uint8_t second = (sec_of_day % 60);
-
-  uint8_t day_of_week = (uint8_t)((base_dow + (days_elapsed % 7)));
-  if (day_of_week > 7) 
-  {
-    day_of_week -= 7;
+  // One more ms to land after the rollover, not on it
+  sc = sl_sleeptimer_restart_timer_ms(&current_time_timer, wait_ms + 1,
+                                      current_time_timer_cb, NULL, 0, 0);
+  if (sc != SL_STATUS_OK) {
+    LOG_ERROR("Current Time timer failed 0x%04lx", (unsigned long)sc);
+  }
+}
+
+// Sleeptimer callback (interrupt context): notify from the event handler
+static void current_time_timer_cb(sl_sleeptimer_timer_handle_t *handle, void *data)
+{
+  (void)handle;
+  (void)data;
+  sl_bt_external_signal(CURRENT_TIME_SIGNAL);
+}
+
+// Sleeptimer callback (interrupt context): the clock is not reentrant, read
+// it from the event handler
+static void clock_wrap_timer_cb(sl_sleeptimer_timer_handle_t *handle, void *data)
+{
+  (void)handle;
+  (void)data;
+  sl_bt_external_signal(CLOCK_WRAP_SIGNAL);
+}
+
+/**
+ * @brief Send the periodic notification if the second rolled over, then
+ *        arm the timer for the next one.
+ */
+static void current_time_on_timer(void)
+{
+  uint32_t burtc_count;
+  uint32_t seconds;
+
+  if (current_time_subscribers == 0) {
+    return;
   }
 
-  // Assuming the year, month, day is not changed
-  uint16_t year  = base_year;
-  uint8_t  month = base_month;
-  uint8_t  day   = (uint8_t)(base_day + days_elapsed);
-  // if day > 31, 30 or 28 -> handle the logic later
+  burtc_count = get_burtc_count();
+  seconds = convert_count_to_seconds(burtc_count, APP_CLOCK_TICKS_PER_SECOND);
+  if (seconds % CURRENT_TIME_PERIOD_S == 0 && seconds != current_time_last_second) {
+    current_time_last_second = seconds;
+    send_current_time_notification(CURRENT_TIME_ALL_SUBSCRIBERS);
+  } else {
+    current_time_early_wakeups++;
+  }
+  current_time_schedule(burtc_count);
+}
 
-  // attach to data
-  current_time[0] = (uint8_t)(year & 0xFF);
-  current_time[1] = (uint8_t)((year >> 8) & 0xFF);
-  current_time[2] = month;
-  current_time[3] = day;
-  current_time[4] = hour;
-  current_time[5] = minute;
-  current_time[6] = second;
-  current_time[7] = day_of_week;
-  current_time[8] = 0;      // Fractions256 = 0 if sub-second resolution is not supported
-  current_time[9] = 0;      // Adjust Reason = 0 (no special reason)
+/**
+ * @brief Assemble and send a Current Time notification.
+ *
+ * The 10-byte Current Time value is computed from the clock
+ * (`app_clock_current_time()`) and sent on `gattdb_current_time`, either to
+ * one connection or with `sl_bt_gatt_server_notify_all()` to every
+ * subscribed client.
+ *
+ * @param[in] connection Connection handle, CURRENT_TIME_ALL_SUBSCRIBERS for every subscriber
+ * @return SL_STATUS_OK on successful notification send, otherwise an error code
+ */
+static sl_status_t send_current_time_notification(uint8_t connection)
+{
+  sl_status_t sc;
+  uint8_t current_time[APP_CLOCK_CURRENT_TIME_LEN];
+  size_t len = sizeof(current_time);
 
-  len = sizeof(current_time);
+  app_clock_current_time(current_time);
 
   // Send notification
-  sc = sl_bt_gatt_server_notify_all(gattdb_current_time,
-                                    len,
-                                    current_time);
+  if(connection == CURRENT_TIME_ALL_SUBSCRIBERS)
+  {
+    sc = sl_bt_gatt_server_notify_all(gattdb_current_time,
+                                      len,
+                                      current_time);
+  }
+  else
+  {
+    sc = sl_bt_gatt_server_send_notification(connection,
+                                             gattdb_current_time,
+                                             len,
+                                             current_time);
+  }
   if(sc == SL_STATUS_OK)
   {
-    LOG_INFO("Notification sent: ");
-    for(int i = 0; i < 10; i++)
-    {
-      printf("%02d : ", (int)current_time[i]);
-    }
-    printf("\r\n");
+    current_time_sent++;
+    LOG_INFO("Notification sent: %02d : %02d : %02d : %02d : %02d : %02d : %02d : %02d : %02d : %02d",
+             (int)current_time[0], (int)current_time[1], (int)current_time[2],
+             (int)current_time[3], (int)current_time[4], (int)current_time[5],
+             (int)current_time[6], (int)current_time[7], (int)current_time[8],
+             (int)current_time[9]);
   }
   else
   {
-    LOG_INFO("Notification sending failed");
+    LOG_WARN("Notification sending failed");
   }
 
   return sc;
 } 
 
+/**
+ * @brief Answer the read of a Current Time Service characteristic.
+ *
+ * These characteristics are user-type attributes: the stack asks for the
+ * value on every read, and it is computed from the clock for that read
+ * (`app_clock.h`). A read from an offset gets the rest of the value.
+ *
+ * @param[in] req User read request event
+ */
+static void send_time_read_response(const sl_bt_evt_gatt_server_user_read_request_t *req)
+{
+  uint8_t value[APP_CLOCK_CURRENT_TIME_LEN];
+  size_t len = 0;
+  uint8_t att_error = 0;
+  uint16_t sent_len;
+  sl_status_t sc;
+
+  switch (req->characteristic) {
+    case gattdb_current_time:
+      app_clock_current_time(value);
+      len = APP_CLOCK_CURRENT_TIME_LEN;
+      break;
+    case gattdb_local_time_information:
+      app_clock_local_time_information(value);
+      len = APP_CLOCK_LOCAL_TIME_INFO_LEN;
+      break;
+    case gattdb_reference_time_information:
+      app_clock_reference_time_information(value);
+      len = APP_CLOCK_REFERENCE_TIME_LEN;
+      break;
+    default:
+      att_error = ATT_ERROR_READ_NOT_PERMITTED;
+      break;
+  }
+  if (att_error == 0 && req->offset > len) {
+    att_error = ATT_ERROR_INVALID_OFFSET;
+  }
+  if (att_error != 0) {
+    len = 0;
+  } else {
+    len -= req->offset;
+  }
+
+  sc = sl_bt_gatt_server_send_user_read_response(req->connection,
+                                                 req->characteristic,
+                                                 att_error,
+                                                 len,
+                                                 value + (att_error ? 0 : req->offset),
+                                                 &sent_len);
+  if (sc != SL_STATUS_OK) {
+    LOG_WARN("Read response failed 0x%04lx", (unsigned long)sc);
+    return;
+  }
+  LOG_CONN("Read of characteristic %u answered, %u bytes, ATT error 0x%02x",
+           req->characteristic, sent_len, att_error);
+}
+
 /**
  * @brief Queue a USART payload for transmission over BLE using indications.
  *
@@ -759,7 +969,7 @@ sl_status_t send_usart_packet_over_ble(uint8_t *payload, size_t payload_len)
 
   if (payload_len == 0 || payload_len > 200) 
   {
-    LOG_INFO("ERROR: Invalid payload length %d (max 200)", (int)payload_len);
+    LOG_ERROR("Invalid payload length %d (max 200)", (int)payload_len);
     return SL_STATUS_INVALID_PARAMETER; // 40bytes for 2 fragments
   }
 
@@ -767,6 +977,121 @@ sl_status_t send_usart_packet_over_ble(uint8_t *payload, size_t payload_len)
                                 payload, payload_len);
 } 
 
+/**
+ * @brief Reassemble the fragments written by the Central.
+ *
+ * Fragments stay queued while every completion buffer is held by a payload
+ * waiting for the UART egress.
+ */
+static void reassemble_central_data(void)
+{
+  while (defrag_link_queued_fragments(RX_LINK) > 0) {
+    uint8_t queued = defrag_link_queued_fragments(RX_LINK);
+    defrag_enum_t result = defrag_process_fragment(RX_LINK);
+
+    if (defrag_link_queued_fragments(RX_LINK) == queued) {
+      return;
+    }
+    if (result == DEFRAG_ERROR) {
+      LOG_ERROR("Defragmentation error");
+      defrag_reset(RX_LINK);
+      // The message is lost, its credit is not
+      rx_credits_owed++;
+    }
+  }
+}
+
+/**
+ * @brief Forward the oldest payload written by the Central to the UART.
+ *
+ * The payload is sent as a binary frame (`app_uart_frame.h`), like the
+ * Central forwards the Peripherals' data to its host. It stays in its
+ * completion buffer until the egress accepts it.
+ */
+static void forward_central_data(void)
+{
+  uint8_t *payload;
+  uint16_t payload_len;
+  bool checksum_ok;
+
+  if (!defrag_get_payload(&payload, &payload_len, &checksum_ok, NULL)) {
+    return;
+  }
+  if (!checksum_ok) {
+    LOG_WARN("Checksum error in data from the Central");
+    defrag_release_payload();
+    rx_credits_owed++;
+    return;
+  }
+  if (!app_uart_egress_can_accept(payload_len)) {
+    return;
+  }
+
+  LOG_INFO("From Central: %u bytes", payload_len);
+  if (app_uart_egress_write(payload, payload_len) != SL_STATUS_OK) {
+    LOG_WARN("Egress FULL, payload dropped");
+  }
+  defrag_release_payload();
+  rx_credits_owed++;
+  defrag_log_link_stats();
+  LOG_STATS("RX writes: %lu dropped", (unsigned long)rx_writes_dropped);
+}
+
+/**
+ * @brief Give the Central back the credits of the released messages.
+ *
+ * The credit frame is queued behind the data indications; without a
+ * fragment block it is retried on the next pass.
+ */
+static void send_rx_credits(void)
+{
+  if (rx_credits_owed == 0 || ind_state == INDICATION_DISABLE) {
+    return;
+  }
+  if (fragment_queue_send_credit(connection_handle, gattdb_usart_packet, rx_credits_owed) == SL_STATUS_OK) {
+    rx_credits_owed = 0;
+  }
+}
+
+/**
+ * @brief Refresh the status in the advertising data when it changed.
+ *
+ * The status (`app_adv_status.h`) tells a scanning Central whether UART
+ * input waits for it, so it can connect to this Peripheral first. While
+ * advertising, the new data is handed to the stack at once; otherwise it
+ * is only encoded and goes out when advertising restarts.
+ */
+static void update_advertised_status(void)
+{
+  size_t queued = app_uart_ingress_queued_bytes();
+  uint16_t queued_bytes = (queued > 0xFFFF) ? 0xFFFF : (uint16_t)queued;
+  uint8_t flags = (queued > 0) ? APP_ADV_STATUS_FLAG_PENDING : 0;
+  sl_status_t sc;
+
+  if (queued_bytes == adv_status.queued_bytes && flags == adv_status.flags) {
+    return;
+  }
+
+  adv_status.queued_bytes = queued_bytes;
+  adv_status.flags = flags;
+  adv_status.sequence++;
+  app_adv_status_encode(&adv_status, &adv_payload[ADV_STATUS_OFFSET]);
+  if (!advertising) {
+    return;
+  }
+
+  sc = sl_bt_legacy_advertiser_set_data(advertising_set_handle,
+                                        sl_bt_advertiser_advertising_data_packet,
+                                        sizeof(adv_payload),
+                                        adv_payload);
+  if (sc != SL_STATUS_OK) {
+    LOG_WARN("Advertising data update failed 0x%04lx", (unsigned long)sc);
+    return;
+  }
+  LOG_CONN("Advertised status: %u bytes queued, flags 0x%02x, sequence %u",
+           adv_status.queued_bytes, adv_status.flags, adv_status.sequence);
+}
+
 /*******************************************************************************
  ***************************   PASSKEY FUNCTIONS   *****************************
  ******************************************************************************/
@@ -0,0 +1,58 @@
+#include "app_adv_status.h"
+
+#define AD_TYPE_MANUFACTURER_DATA   0xFF
+
+/*******************************************************************************
+ ***************************   GLOBAL FUNCTIONS   ******************************
+ ******************************************************************************/
+
+void app_adv_status_encode(const app_adv_status_t *status, uint8_t ad[APP_ADV_STATUS_AD_LEN])
+{
+    ad[0] = APP_ADV_STATUS_AD_LEN - 1;
+    ad[1] = AD_TYPE_MANUFACTURER_DATA;
+    ad[2] = (uint8_t)(APP_ADV_STATUS_COMPANY_ID & 0xFF);
+    ad[3] = (uint8_t)(APP_ADV_STATUS_COMPANY_ID >> 8);
+    ad[4] = status->version;
+    ad[5] = status->flags;
+    ad[6] = (uint8_t)(status->queued_bytes & 0xFF);
+    ad[7] = (uint8_t)(status->queued_bytes >> 8);
+    ad[8] = status->battery;
+    ad[9] = status->sequence;
+}
+
+bool app_adv_status_parse(const uint8_t *data, size_t len, app_adv_status_t *status)
+{
+    size_t i = 0;
+
+    if(data == NULL || status == NULL)
+    {
+        return false;
+    }
+
+    while(i < len)
+    {
+        uint8_t ad_len = data[i];
+        const uint8_t *ad = &data[i + 1];
+
+        // A zero length ends the significant part, a structure past the end is malformed
+        if(ad_len == 0 || i + 1 + ad_len > len)
+        {
+            return false;
+        }
+        if(ad_len == APP_ADV_STATUS_AD_LEN - 1
+           && ad[0] == AD_TYPE_MANUFACTURER_DATA
+           && ad[1] == (uint8_t)(APP_ADV_STATUS_COMPANY_ID & 0xFF)
+           && ad[2] == (uint8_t)(APP_ADV_STATUS_COMPANY_ID >> 8)
+           && ad[3] == APP_ADV_STATUS_VERSION)
+        {
+            status->version = ad[3];
+            status->flags = ad[4];
+            status->queued_bytes = (uint16_t)(ad[5] | (ad[6] << 8));
+            status->battery = ad[7];
+            status->sequence = ad[8];
+            return true;
+        }
+        i += 1 + ad_len;
+    }
+    return false;
+}
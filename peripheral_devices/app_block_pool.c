@@ -0,0 +1,152 @@
+#include <string.h>
+#include "sl_core.h"
+#include "app_block_pool.h"
+#include "log.h"
+
+/*******************************************************************************
+ ***************************   LOCAL FUNCTIONS   *******************************
+ *******************************************************************************/
+
+// Index of a block in the pool, block_count if the pointer is not the start
+// of one of its blocks
+static uint16_t block_index(const block_pool_t *pool, const void *block)
+{
+    const uint8_t *p = (const uint8_t *)block;
+    const uint8_t *end = pool->storage + (size_t)pool->block_size * pool->block_count;
+
+    if(p < pool->storage || p >= end || ((size_t)(p - pool->storage) % pool->block_size) != 0)
+    {
+        return pool->block_count;
+    }
+    return (uint16_t)((size_t)(p - pool->storage) / pool->block_size);
+}
+
+/*******************************************************************************
+ ***************************   GLOBAL FUNCTIONS   ******************************
+ ******************************************************************************/
+
+void block_pool_init(block_pool_t *pool, const char *name, void *storage,
+                     uint16_t block_size, uint16_t block_count)
+{
+    pool->name = name;
+    pool->storage = (uint8_t *)storage;
+    pool->block_size = (uint16_t)BLOCK_POOL_ALIGN(block_size);
+    if(block_count > BLOCK_POOL_MAX_BLOCKS)
+    {
+        LOG_ERROR("Pool %s: %u blocks, only %u used (BLOCK_POOL_MAX_BLOCKS)",
+                  name, block_count, BLOCK_POOL_MAX_BLOCKS);
+        block_count = BLOCK_POOL_MAX_BLOCKS;
+    }
+    pool->block_count = block_count;
+    pool->used = 0;
+    pool->high_water = 0;
+    pool->alloc_failures = 0;
+    pool->free_errors = 0;
+    memset(pool->in_use, 0, sizeof(pool->in_use));
+
+    // Thread every block into the free list: each free block stores the next one
+    pool->free_list = NULL;
+    for(int i = (int)block_count - 1; i >= 0; i--)
+    {
+        void **block = (void **)(pool->storage + (size_t)i * pool->block_size);
+        *block = pool->free_list;
+        pool->free_list = block;
+    }
+
+    LOG_INFO("Pool %s: %u blocks x %u bytes", name, block_count, pool->block_size);
+}
+
+void *block_pool_alloc(block_pool_t *pool)
+{
+    void **block;
+
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+    block = (void **)pool->free_list;
+    if(block != NULL)
+    {
+        uint16_t index = block_index(pool, block);
+
+        pool->free_list = *block;
+        pool->in_use[index / 32] |= 1UL << (index % 32);
+        pool->used++;
+        if(pool->used > pool->high_water)
+        {
+            pool->high_water = pool->used;
+        }
+    }
+    else
+    {
+        pool->alloc_failures++;
+    }
+    CORE_EXIT_CRITICAL();
+
+    return block;
+}
+
+void block_pool_free(block_pool_t *pool, void *block)
+{
+    if(block == NULL)
+    {
+        return;
+    }
+
+    // May run in interrupt context: errors are only counted here and shown
+    // by block_pool_log_stats()
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+    uint16_t index = block_index(pool, block);
+    if(index >= pool->block_count || (pool->in_use[index / 32] & (1UL << (index % 32))) == 0)
+    {
+        pool->free_errors++;
+        CORE_EXIT_CRITICAL();
+        return;
+    }
+    pool->in_use[index / 32] &= ~(1UL << (index % 32));
+    *(void **)block = pool->free_list;
+    pool->free_list = block;
+    pool->used--;
+    CORE_EXIT_CRITICAL();
+}
+
+uint16_t block_pool_available(const block_pool_t *pool)
+{
+    return (uint16_t)(pool->block_count - pool->used);
+}
+
+void block_pool_get_stats(const block_pool_t *pool, block_pool_stats_t *stats)
+{
+    if(stats == NULL)
+    {
+        return;
+    }
+
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+    stats->block_size = pool->block_size;
+    stats->block_count = pool->block_count;
+    stats->used = pool->used;
+    stats->high_water = pool->high_water;
+    stats->alloc_failures = pool->alloc_failures;
+    stats->free_errors = pool->free_errors;
+    CORE_EXIT_CRITICAL();
+}
+
+void block_pool_log_stats(const block_pool_t *pool)
+{
+    block_pool_stats_t stats;
+    block_pool_get_stats(pool, &stats);
+
+    LOG_STATS("Pool %s: used %u/%u, high-water %u, failures %lu, bad frees %lu",
+              pool->name,
+              stats.used,
+              stats.block_count,
+              stats.high_water,
+              (unsigned long)stats.alloc_failures,
+              (unsigned long)stats.free_errors);
+    if(stats.free_errors > 0)
+    {
+        LOG_ERROR("Pool %s: %lu frees of foreign or free blocks rejected",
+                  pool->name, (unsigned long)stats.free_errors);
+    }
+}
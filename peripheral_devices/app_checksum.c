@@ -0,0 +1,258 @@
+#include <string.h>
+#include "app_checksum.h"
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#include "em_device.h"              // CMSIS __USADA8
+#define CHECKSUM_HAVE_USADA8    1
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define CHECKSUM_HAVE_SSE2      1
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define CHECKSUM_HAVE_AVX2      1
+#endif
+
+#ifdef APP_CHECKSUM_BENCHMARK
+#include <stdio.h>
+#include "app_cycle_stats.h"
+#include "log.h"
+#endif
+
+// Words per SWAR round: each 16-bit lane gains at most 2 * 255 per word
+#define SWAR_FOLD_WORDS     128
+
+#define MAX_KERNELS         5
+
+/*******************************************************************************
+ ***************************   LOCAL FUNCTIONS   *******************************
+ *******************************************************************************/
+
+// Reference: one byte per iteration, as the original app_iostream_checksum()
+static uint32_t sum_bytewise(const uint8_t *data, size_t len)
+{
+    uint32_t sum = 0;
+
+    for(size_t i = 0; i < len; i++)
+    {
+        sum += data[i];
+    }
+    return sum;
+}
+
+// Bytes before the first word boundary
+static uint32_t sum_head(const uint8_t **data, size_t *len)
+{
+    uint32_t sum = 0;
+
+    while(*len > 0 && ((uintptr_t)*data & 3u) != 0)
+    {
+        sum += *(*data)++;
+        (*len)--;
+    }
+    return sum;
+}
+
+/* SIMD within a register: bytes 0/2 and 1/3 of every word are added into
+   two 16-bit lanes, which are folded into the sum before they can carry. */
+static uint32_t sum_swar(const uint8_t *data, size_t len)
+{
+    uint32_t sum = sum_head(&data, &len);
+
+    while(len >= sizeof(uint32_t))
+    {
+        size_t words = len / sizeof(uint32_t);
+        if(words > SWAR_FOLD_WORDS)
+        {
+            words = SWAR_FOLD_WORDS;
+        }
+
+        uint32_t lanes = 0;
+        for(size_t i = 0; i < words; i++)
+        {
+            uint32_t w;
+            memcpy(&w, data, sizeof(w));        // Aligned: a single load
+            lanes += (w & 0x00FF00FFu) + ((w >> 8) & 0x00FF00FFu);
+            data += sizeof(w);
+        }
+        len -= words * sizeof(uint32_t);
+        sum += (lanes & 0xFFFFu) + (lanes >> 16);
+    }
+
+    return sum + sum_bytewise(data, len);
+}
+
+#if CHECKSUM_HAVE_USADA8
+// Cortex-M33 DSP: USADA8 adds |b - 0| for the four bytes of a word
+static uint32_t sum_usada8(const uint8_t *data, size_t len)
+{
+    uint32_t sum = sum_head(&data, &len);
+    uint32_t w[4];
+
+    while(len >= sizeof(w))
+    {
+        memcpy(w, data, sizeof(w));
+        sum = __USADA8(w[0], 0, sum);
+        sum = __USADA8(w[1], 0, sum);
+        sum = __USADA8(w[2], 0, sum);
+        sum = __USADA8(w[3], 0, sum);
+        data += sizeof(w);
+        len -= sizeof(w);
+    }
+    while(len >= sizeof(uint32_t))
+    {
+        memcpy(w, data, sizeof(uint32_t));
+        sum = __USADA8(w[0], 0, sum);
+        data += sizeof(uint32_t);
+        len -= sizeof(uint32_t);
+    }
+
+    return sum + sum_bytewise(data, len);
+}
+#endif
+
+#if CHECKSUM_HAVE_SSE2
+// PSADBW sums each group of 8 bytes into a 64-bit lane
+static uint32_t sum_sse2(const uint8_t *data, size_t len)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+
+    while(len >= 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)data);
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(v, zero));
+        data += 16;
+        len -= 16;
+    }
+
+    uint32_t sum = (uint32_t)_mm_cvtsi128_si32(acc)
+                   + (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(acc, 8));
+    return sum + sum_bytewise(data, len);
+}
+#endif
+
+#if CHECKSUM_HAVE_AVX2
+// Built for AVX2 whatever the compiler flags, only listed when the CPU has it
+__attribute__((target("avx2")))
+static uint32_t sum_avx2(const uint8_t *data, size_t len)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc = zero;
+
+    while(len >= 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)data);
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(v, zero));
+        data += 32;
+        len -= 32;
+    }
+
+    uint32_t sum = (uint32_t)_mm256_extract_epi32(acc, 0) + (uint32_t)_mm256_extract_epi32(acc, 2)
+                   + (uint32_t)_mm256_extract_epi32(acc, 4) + (uint32_t)_mm256_extract_epi32(acc, 6);
+    return sum + sum_bytewise(data, len);
+}
+#endif
+
+/*******************************************************************************
+ ***************************   GLOBAL FUNCTIONS   ******************************
+ ******************************************************************************/
+
+uint32_t app_checksum_sum(const uint8_t *data, size_t len)
+{
+    if(data == NULL)
+    {
+        return 0;
+    }
+
+#if CHECKSUM_HAVE_USADA8
+    return sum_usada8(data, len);
+#elif CHECKSUM_HAVE_SSE2
+    return sum_sse2(data, len);
+#else
+    return sum_swar(data, len);
+#endif
+}
+
+uint8_t app_checksum_compute(const uint8_t *data, size_t len)
+{
+    return (uint8_t)(0u - app_checksum_sum(data, len));
+}
+
+size_t app_checksum_get_kernels(const app_checksum_kernel_info_t **kernels)
+{
+    static app_checksum_kernel_info_t table[MAX_KERNELS];
+    static size_t count;
+
+    if(count == 0)
+    {
+        table[count++] = (app_checksum_kernel_info_t){ "bytewise", sum_bytewise };
+        table[count++] = (app_checksum_kernel_info_t){ "swar", sum_swar };
+#if CHECKSUM_HAVE_USADA8
+        table[count++] = (app_checksum_kernel_info_t){ "usada8", sum_usada8 };
+#endif
+#if CHECKSUM_HAVE_SSE2
+        table[count++] = (app_checksum_kernel_info_t){ "sse2", sum_sse2 };
+#endif
+#if CHECKSUM_HAVE_AVX2
+        if(__builtin_cpu_supports("avx2"))
+        {
+            table[count++] = (app_checksum_kernel_info_t){ "avx2", sum_avx2 };
+        }
+#endif
+    }
+
+    if(kernels != NULL)
+    {
+        *kernels = table;
+    }
+    return count;
+}
+
+#ifdef APP_CHECKSUM_BENCHMARK
+void app_checksum_log_benchmark(void)
+{
+    static const uint16_t lengths[] = { 1, 4, 16, 64, 256, 1024, 4096 };
+    static uint8_t buffer[4096];
+    const app_checksum_kernel_info_t *kernels;
+    size_t count = app_checksum_get_kernels(&kernels);
+
+    for(size_t i = 0; i < sizeof(buffer); i++)
+    {
+        buffer[i] = (uint8_t)(i * 167u + 13u);
+    }
+
+    app_cycle_counter_init();
+
+    for(size_t k = 0; k < count; k++)
+    {
+        char line[APP_CONSOLE_MESSAGE_MAX - 16];
+        int pos = snprintf(line, sizeof(line), "checksum %-8s bytes/cycle x100:", kernels[k].name);
+
+        for(size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]) && (size_t)pos < sizeof(line); l++)
+        {
+            volatile uint32_t sink;
+            uint32_t cycles = 0xFFFFFFFFu;
+
+            // Best of three, the first run also warms the instruction cache
+            for(int run = 0; run < 3; run++)
+            {
+                uint32_t start = app_cycle_counter_now();
+                sink = kernels[k].sum(buffer, lengths[l]);
+                uint32_t elapsed = app_cycle_counter_now() - start;
+                if(elapsed < cycles)
+                {
+                    cycles = elapsed;
+                }
+            }
+            (void)sink;
+            pos += snprintf(&line[pos], sizeof(line) - (size_t)pos, " %u:%lu", lengths[l],
+                            (unsigned long)((lengths[l] * 100u) / (cycles ? cycles : 1)));
+        }
+        LOG_INFO("%s", line);
+    }
+}
+#endif
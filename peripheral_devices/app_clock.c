@@ -0,0 +1,147 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include "app_clock.h"
+#include "burtc.h"
+
+#define SECONDS_PER_DAY             86400UL
+#define DAYS_0000_03_01_TO_1970     719468UL    // Days from 0000-03-01 to 1970-01-01
+#define DAYS_PER_ERA                146097UL    // 400 Gregorian years
+
+// Seconds the BURTC counts before it wraps
+#define WRAP_SECONDS                ((uint32_t)(0x100000000ULL / APP_CLOCK_TICKS_PER_SECOND))
+
+// Current Time adjust reason and Reference Time Information values
+#define ADJUST_REASON_MANUAL        0x01
+#define TIME_SOURCE_MANUAL          4
+#define TIME_ACCURACY_UNKNOWN       255
+
+static uint32_t epoch;                      // Unix time at BURTC count 0
+static uint32_t last_count;                 // BURTC count of the last read, to detect a wrap
+static uint32_t updated_at;                 // Unix time of the last update
+static bool adjusted = false;               // Set since the last Current Time read
+
+/*******************************************************************************
+ ***************************   LOCAL FUNCTIONS   *******************************
+ *******************************************************************************/
+
+// Days since 1970-01-01 of a date from 1970 on
+static uint32_t days_from_civil(uint32_t year, uint32_t month, uint32_t day)
+{
+    // Years counted from March, the leap day is the last day of the year
+    uint32_t y = year - (month <= 2);
+    uint32_t era = y / 400;
+    uint32_t yoe = y - era * 400;                                   // Year of era, 0..399
+    uint32_t doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;           // Day of era, 0..146096
+
+    return era * DAYS_PER_ERA + doe - DAYS_0000_03_01_TO_1970;
+}
+
+// Date of a day count since 1970-01-01
+static void civil_from_days(uint32_t days, app_clock_time_t *t)
+{
+    uint32_t z = days + DAYS_0000_03_01_TO_1970;
+    uint32_t era = z / DAYS_PER_ERA;
+    uint32_t doe = z - era * DAYS_PER_ERA;
+    uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    uint32_t mp = (5 * doy + 2) / 153;                              // Month from March, 0..11
+
+    t->day = (uint8_t)(doy - (153 * mp + 2) / 5 + 1);
+    t->month = (uint8_t)(mp < 10 ? mp + 3 : mp - 9);
+    t->year = (uint16_t)(yoe + era * 400 + (t->month <= 2));
+    // 1970-01-01 was a Thursday
+    t->day_of_week = (uint8_t)((days + 3) % 7 + 1);
+}
+
+/*******************************************************************************
+ ***************************   GLOBAL FUNCTIONS   ******************************
+ ******************************************************************************/
+
+void app_clock_init(void)
+{
+    epoch = days_from_civil(APP_CLOCK_EPOCH_YEAR, APP_CLOCK_EPOCH_MONTH, APP_CLOCK_EPOCH_DAY)
+            * SECONDS_PER_DAY
+            + APP_CLOCK_EPOCH_HOUR * 3600UL
+            + APP_CLOCK_EPOCH_MINUTE * 60UL
+            + APP_CLOCK_EPOCH_SECOND;
+    updated_at = epoch;
+    last_count = get_burtc_count();
+    adjusted = false;
+}
+
+void app_clock_set(uint32_t unix_seconds)
+{
+    last_count = get_burtc_count();
+    epoch = unix_seconds - last_count / APP_CLOCK_TICKS_PER_SECOND;
+    updated_at = unix_seconds;
+    adjusted = true;
+}
+
+uint32_t app_clock_now(app_clock_time_t *now)
+{
+    uint32_t count = get_burtc_count();
+    uint32_t unix_seconds;
+    uint32_t second_of_day;
+
+    if(count < last_count)
+    {
+        epoch += WRAP_SECONDS;
+    }
+    last_count = count;
+    unix_seconds = epoch + count / APP_CLOCK_TICKS_PER_SECOND;
+
+    if(now != NULL)
+    {
+        second_of_day = unix_seconds % SECONDS_PER_DAY;
+        civil_from_days(unix_seconds / SECONDS_PER_DAY, now);
+        now->hour = (uint8_t)(second_of_day / 3600);
+        now->minute = (uint8_t)((second_of_day % 3600) / 60);
+        now->second = (uint8_t)(second_of_day % 60);
+        now->fractions256 = (uint8_t)((count % APP_CLOCK_TICKS_PER_SECOND) * 256 / APP_CLOCK_TICKS_PER_SECOND);
+    }
+    return unix_seconds;
+}
+
+void app_clock_current_time(uint8_t value[APP_CLOCK_CURRENT_TIME_LEN])
+{
+    app_clock_time_t now;
+
+    app_clock_now(&now);
+    value[0] = (uint8_t)(now.year & 0xFF);
+    value[1] = (uint8_t)(now.year >> 8);
+    value[2] = now.month;
+    value[3] = now.day;
+    value[4] = now.hour;
+    value[5] = now.minute;
+    value[6] = now.second;
+    value[7] = now.day_of_week;
+    value[8] = now.fractions256;
+    value[9] = adjusted ? ADJUST_REASON_MANUAL : 0;
+    adjusted = false;
+}
+
+void app_clock_local_time_information(uint8_t value[APP_CLOCK_LOCAL_TIME_INFO_LEN])
+{
+    value[0] = (uint8_t)(int8_t)APP_CLOCK_TIME_ZONE;
+    value[1] = APP_CLOCK_DST_OFFSET;
+}
+
+void app_clock_reference_time_information(uint8_t value[APP_CLOCK_REFERENCE_TIME_LEN])
+{
+    uint32_t elapsed = app_clock_now(NULL) - updated_at;
+    uint32_t days = elapsed / SECONDS_PER_DAY;
+
+    value[0] = TIME_SOURCE_MANUAL;
+    value[1] = TIME_ACCURACY_UNKNOWN;
+    if(days >= 255)
+    {
+        value[2] = 255;
+        value[3] = 255;
+    }
+    else
+    {
+        value[2] = (uint8_t)days;
+        value[3] = (uint8_t)((elapsed % SECONDS_PER_DAY) / 3600);
+    }
+}
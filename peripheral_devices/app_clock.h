@@ -0,0 +1,129 @@
+/**
+ * @file app_clock.h
+ * @brief Wall clock from a cached epoch and the BURTC, in the Current Time
+ *        Service formats
+ *
+ * The clock keeps no running date. It caches one value, the epoch: the Unix
+ * time at BURTC count 0 (`APP_CLOCK_EPOCH_*`, the milestone the firmware
+ * was built with, or `app_clock_set()`). Every read adds the BURTC ticks to
+ * it and converts the result to a civil date, so nothing has to run
+ * between two reads to keep them right.
+ *
+ * Implementation notes (see `app_clock.c`):
+ * - The conversion from days to year/month/day is the era based civil
+ *   algorithm (400-year eras of 146097 days): a few divisions by
+ *   constants, no loop and no month table, with real month, leap year and
+ *   year rollover.
+ * - Fractions256 of the Current Time come from the sub-second BURTC ticks.
+ * - The BURTC counter is 32 bits at `APP_CLOCK_TICKS_PER_SECOND`, it wraps
+ *   every 36.4 hours. A wrap is detected when a read sees a count below the
+ *   previous one, and moves the epoch forward: the clock has to be read at
+ *   least once per wrap period. The Current Time notifications only run
+ *   while a client is subscribed, so the application also reads it from an
+ *   always-on timer (hourly on the Peripheral, `CLOCK_WRAP_CHECK_PERIOD_MS`).
+ */
+
+#ifndef APP_CLOCK_H
+#define APP_CLOCK_H
+
+#include <stdint.h>
+
+// BURTC ticks per second (LFRCO/LFXO, no prescaler)
+#ifndef APP_CLOCK_TICKS_PER_SECOND
+#define APP_CLOCK_TICKS_PER_SECOND      32768
+#endif
+
+// Local time at BURTC count 0
+#ifndef APP_CLOCK_EPOCH_YEAR
+#define APP_CLOCK_EPOCH_YEAR            2025
+#define APP_CLOCK_EPOCH_MONTH           11
+#define APP_CLOCK_EPOCH_DAY             7
+#define APP_CLOCK_EPOCH_HOUR            3
+#define APP_CLOCK_EPOCH_MINUTE          40
+#define APP_CLOCK_EPOCH_SECOND          10
+#endif
+
+// Local Time Information: time zone in 15 minute steps, DST offset
+// (0 standard time, 4 daylight time, 255 unknown)
+#ifndef APP_CLOCK_TIME_ZONE
+#define APP_CLOCK_TIME_ZONE             0
+#endif
+#ifndef APP_CLOCK_DST_OFFSET
+#define APP_CLOCK_DST_OFFSET            0
+#endif
+
+// Characteristic value lengths
+#define APP_CLOCK_CURRENT_TIME_LEN      10
+#define APP_CLOCK_LOCAL_TIME_INFO_LEN   2
+#define APP_CLOCK_REFERENCE_TIME_LEN    4
+
+// A broken-down local time
+typedef struct
+{
+    uint16_t year;
+    uint8_t month;                      // 1..12
+    uint8_t day;                        // 1..31
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+    uint8_t day_of_week;                // 1 Monday .. 7 Sunday
+    uint8_t fractions256;               // 1/256 s
+} app_clock_time_t;
+
+/**
+ * @brief Cache the epoch of the build time milestone.
+ *
+ * Call once, after the BURTC is running.
+ */
+void app_clock_init(void);
+
+/**
+ * @brief Set the clock.
+ *
+ * Moves the epoch so that the current BURTC count reads as the given
+ * local time, and restarts the time since the last update.
+ *
+ * @param[in] unix_seconds Local time as seconds since 1970-01-01 00:00:00
+ */
+void app_clock_set(uint32_t unix_seconds);
+
+/**
+ * @brief Read the clock.
+ *
+ * @param[out] now Current local time
+ * @return Seconds since 1970-01-01 00:00:00 local time
+ */
+uint32_t app_clock_now(app_clock_time_t *now);
+
+/**
+ * @brief Encode the Current Time characteristic (0x2A2B).
+ *
+ * [year u16 LE | month | day | hours | minutes | seconds | day of week |
+ * fractions256 | adjust reason]. The adjust reason is 0x01 (manual time
+ * update) on the first read after `app_clock_set()`, 0 otherwise.
+ *
+ * @param[out] value APP_CLOCK_CURRENT_TIME_LEN bytes
+ */
+void app_clock_current_time(uint8_t value[APP_CLOCK_CURRENT_TIME_LEN]);
+
+/**
+ * @brief Encode the Local Time Information characteristic (0x2A0F).
+ *
+ * [time zone s8 | DST offset u8].
+ *
+ * @param[out] value APP_CLOCK_LOCAL_TIME_INFO_LEN bytes
+ */
+void app_clock_local_time_information(uint8_t value[APP_CLOCK_LOCAL_TIME_INFO_LEN]);
+
+/**
+ * @brief Encode the Reference Time Information characteristic (0x2A14).
+ *
+ * [time source | accuracy | days since update | hours since update]: a
+ * manually set clock of unknown accuracy, updated at the epoch or at the
+ * last `app_clock_set()`. Days saturate at 255, hours are then 255 too.
+ *
+ * @param[out] value APP_CLOCK_REFERENCE_TIME_LEN bytes
+ */
+void app_clock_reference_time_information(uint8_t value[APP_CLOCK_REFERENCE_TIME_LEN]);
+
+#endif /* APP_CLOCK_H */
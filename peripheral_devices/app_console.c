@@ -0,0 +1,171 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "sl_core.h"
+#include "app_console.h"
+#include "app_uart_egress.h"
+#include "log.h"
+
+// Largest part of the ring handed to the egress at once, so data frames
+// queued meanwhile do not wait behind a long burst of log text
+#define CONSOLE_SEGMENT_MAX     256
+
+#if APP_CONSOLE_BUFFER_SIZE > 0xFFFF
+#error "APP_CONSOLE_BUFFER_SIZE must fit in 16 bits"
+#endif
+
+// Context of the console ring
+typedef struct
+{
+    uint8_t ring[APP_CONSOLE_BUFFER_SIZE];
+    volatile uint16_t head;             // Next byte to write
+    volatile uint16_t tail;             // Oldest byte not sent yet
+    volatile uint16_t used;             // Bytes between tail and head
+    volatile uint16_t in_flight;        // Bytes handed to the egress, 0 if none
+    app_console_stats_t stats;
+} console_context_t;
+
+static console_context_t console_cxt;
+
+/*******************************************************************************
+ ***************************   LOCAL FUNCTIONS   *******************************
+ *******************************************************************************/
+
+// Interrupt context: the egress has sent the segment, free its ring space
+static void console_segment_sent(const uint8_t *data, size_t len)
+{
+    (void)data;
+
+    console_cxt.tail = (uint16_t)((console_cxt.tail + len) % APP_CONSOLE_BUFFER_SIZE);
+    console_cxt.used = (uint16_t)(console_cxt.used - len);
+    console_cxt.in_flight = 0;
+}
+
+/*******************************************************************************
+ ***************************   GLOBAL FUNCTIONS   ******************************
+ ******************************************************************************/
+
+void app_console_init(void)
+{
+    memset(&console_cxt, 0, sizeof(console_context_t));
+}
+
+size_t app_console_write(const void *data, size_t len)
+{
+    const uint8_t *src = (const uint8_t *)data;
+
+    if(data == NULL || len == 0)
+    {
+        return 0;
+    }
+
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+    if(len > (size_t)(APP_CONSOLE_BUFFER_SIZE - console_cxt.used))
+    {
+        // Drop the whole message, never a part of it
+        console_cxt.stats.bytes_dropped += len;
+        CORE_EXIT_CRITICAL();
+        return 0;
+    }
+
+    size_t first = APP_CONSOLE_BUFFER_SIZE - console_cxt.head;
+    if(first > len)
+    {
+        first = len;
+    }
+    memcpy(&console_cxt.ring[console_cxt.head], src, first);
+    memcpy(&console_cxt.ring[0], src + first, len - first);
+
+    console_cxt.head = (uint16_t)((console_cxt.head + len) % APP_CONSOLE_BUFFER_SIZE);
+    console_cxt.used = (uint16_t)(console_cxt.used + len);
+    console_cxt.stats.bytes_written += len;
+    if(console_cxt.used > console_cxt.stats.high_water)
+    {
+        console_cxt.stats.high_water = console_cxt.used;
+    }
+    CORE_EXIT_CRITICAL();
+
+    return len;
+}
+
+int app_console_printf(const char *fmt, ...)
+{
+    char msg[APP_CONSOLE_MESSAGE_MAX];
+    va_list args;
+
+    va_start(args, fmt);
+    int n = vsnprintf(msg, sizeof(msg), fmt, args);
+    va_end(args);
+
+    if(n <= 0)
+    {
+        return 0;
+    }
+    if((size_t)n >= sizeof(msg))
+    {
+        // Truncated: keep the line ending so the next message starts on a new line
+        n = sizeof(msg) - 1;
+        msg[n - 2] = '\r';
+        msg[n - 1] = '\n';
+    }
+
+    return (int)app_console_write(msg, (size_t)n);
+}
+
+void app_console_process(void)
+{
+    if(console_cxt.in_flight != 0 || console_cxt.used == 0 || app_uart_egress_is_congested())
+    {
+        return;
+    }
+
+    // Oldest contiguous part of the ring; a wrapped message goes out in two parts
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+    uint16_t start = console_cxt.tail;
+    uint16_t len = console_cxt.used;
+    CORE_EXIT_CRITICAL();
+
+    if(len > APP_CONSOLE_BUFFER_SIZE - start)
+    {
+        len = (uint16_t)(APP_CONSOLE_BUFFER_SIZE - start);
+    }
+    if(len > CONSOLE_SEGMENT_MAX)
+    {
+        len = CONSOLE_SEGMENT_MAX;
+    }
+
+    console_cxt.in_flight = len;
+    if(app_uart_egress_send_buffer(&console_cxt.ring[start], len, console_segment_sent) != SL_STATUS_OK)
+    {
+        // Egress not ready or full, keep the text and retry on the next pass
+        console_cxt.in_flight = 0;
+    }
+}
+
+void app_console_get_stats(app_console_stats_t *stats)
+{
+    if(stats == NULL)
+    {
+        return;
+    }
+
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+    *stats = console_cxt.stats;
+    stats->used = console_cxt.used;
+    CORE_EXIT_CRITICAL();
+}
+
+void app_console_log_stats(void)
+{
+    app_console_stats_t stats;
+    app_console_get_stats(&stats);
+
+    LOG_STATS("Console: used %u/%u, high-water %u, dropped %lu bytes",
+              stats.used,
+              (unsigned int)APP_CONSOLE_BUFFER_SIZE,
+              stats.high_water,
+              (unsigned long)stats.bytes_dropped);
+}
@@ -0,0 +1,66 @@
+/**
+ * @file app_cycle_stats.h
+ * @brief CPU cycle measurements with the Cortex-M33 DWT cycle counter
+ *
+ * Times a code section in core clock cycles and keeps count, min, max and
+ * total per measured section:
+ *
+ *   static app_cycle_stats_t frag_cycles = APP_CYCLE_STATS_INIT("fragment");
+ *   uint32_t start = app_cycle_counter_now();
+ *   ...work...
+ *   app_cycle_stats_add(&frag_cycles, start);
+ *
+ * The counter wraps every 2^32 cycles (~54 s at 78 MHz); a section must be
+ * shorter than that. Reading the counter costs a single load, so the
+ * measurement can stay in production builds.
+ *
+ * @note This component is designed to be reusable across different projects,
+ *       the Central and the Peripheral use the same copy.
+ */
+
+#ifndef APP_CYCLE_STATS_H
+#define APP_CYCLE_STATS_H
+
+#include <stdint.h>
+#include "em_device.h"
+
+typedef struct
+{
+    const char *name;
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+} app_cycle_stats_t;
+
+#define APP_CYCLE_STATS_INIT(section_name)  { .name = (section_name), .min = UINT32_MAX }
+
+/**
+ * @brief Start the DWT cycle counter. Call once at startup.
+ */
+void app_cycle_counter_init(void);
+
+/**
+ * @brief Current value of the cycle counter.
+ */
+static inline uint32_t app_cycle_counter_now(void)
+{
+    return DWT->CYCCNT;
+}
+
+/**
+ * @brief Add the cycles elapsed since start to the section statistics.
+ *
+ * @param[in,out] stats Section statistics
+ * @param[in]     start Value of `app_cycle_counter_now()` at section entry
+ */
+void app_cycle_stats_add(app_cycle_stats_t *stats, uint32_t start);
+
+/**
+ * @brief Print count, min, average and max cycles of a section.
+ *
+ * @param[in] stats Section statistics
+ */
+void app_cycle_stats_log(const app_cycle_stats_t *stats);
+
+#endif /* APP_CYCLE_STATS_H */
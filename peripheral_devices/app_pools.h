@@ -0,0 +1,57 @@
+/**
+ * @file app_pools.h
+ * @brief Memory pools shared by the UART RX and BLE TX (fragment queue) paths
+ *
+ * The Peripheral draws all message buffers from two fixed-block pools instead
+ * of per-module worst-case arrays:
+ * - `app_fragment_pool`: one block per BLE fragment waiting in the fragment
+ *   queue, or received from the Central and waiting for reassembly
+ * - `app_message_pool`: one block per UART input line being assembled or
+ *   waiting in the ingress queue (see `app_uart_ingress.h`), per payload
+ *   received from the Central (see `ble_defragment_rxdata.h`) or per UART
+ *   egress frame
+ *
+ * Several short messages or one long message can be queued in the same RAM.
+ * Usage and high-water marks are visible with `app_pools_log_stats()`.
+ */
+
+#ifndef APP_POOLS_H
+#define APP_POOLS_H
+
+#include "app_block_pool.h"
+
+// A fragment block holds one fragment_t (see ble_fragment_queue.h) or one
+// RX queue slot (see ble_defragment_rxdata.c)
+#ifndef APP_FRAGMENT_BLOCK_SIZE
+#define APP_FRAGMENT_BLOCK_SIZE     32
+#endif
+#ifndef APP_FRAGMENT_BLOCK_COUNT
+#define APP_FRAGMENT_BLOCK_COUNT    24
+#endif
+
+// A message block holds one UART input line (assembled or waiting for BLE),
+// one payload from the Central or one egress frame.
+// Worst case in flight: APP_UART_INGRESS_LINE_QUEUE + 1 lines, 1 reassembling
+// + DEFRAG_COMPLETE_BUFFERS held, 1 egress frame
+#ifndef APP_MESSAGE_BLOCK_SIZE
+#define APP_MESSAGE_BLOCK_SIZE      256
+#endif
+#ifndef APP_MESSAGE_BLOCK_COUNT
+#define APP_MESSAGE_BLOCK_COUNT     8
+#endif
+
+extern block_pool_t app_fragment_pool;
+extern block_pool_t app_message_pool;
+
+/**
+ * @brief Initialize all application pools. Call once, before any module
+ *        that allocates from them.
+ */
+void app_pools_init(void);
+
+/**
+ * @brief Print usage and high-water marks of all application pools.
+ */
+void app_pools_log_stats(void);
+
+#endif /* APP_POOLS_H */
@@ -0,0 +1,158 @@
+/**
+ * @file app_trace.h
+ * @brief Deferred binary trace: log sites record an ID and raw arguments
+ *
+ * `APP_TRACE(fmt, ...)` costs a function call and a copy of a few words: no
+ * formatting, no string in flash. The site is identified by its file and
+ * line, the arguments are stored as 32-bit words in a RAM ring together with
+ * a sleeptimer timestamp. `app_trace_process()` ships the ring to the host in
+ * the background, and `tools/trace_decode` rebuilds the text from a string
+ * table generated from the sources:
+ *
+ *   #define APP_TRACE_FILE_ID   2       // Unique in the project, 1..255
+ *   #include "app_trace.h"
+ *   ...
+ *   APP_TRACE("fragment %u/%u confirmed", index, total);
+ *
+ * Rules for a trace site:
+ * - The format is a string literal, the first argument of the macro, and
+ *   the file defines `APP_TRACE_FILE_ID`. The decoder finds both by scanning
+ *   the .c files, so the table matches the build as long as it is generated
+ *   from the same sources.
+ * - At most `APP_TRACE_MAX_ARGS` integer or pointer arguments; each one is
+ *   sent as 32 bits, so %s, %f and 64-bit conversions cannot be decoded.
+ * - Safe from interrupt context.
+ *
+ * Records on the wire: control frames (`app_uart_frame.h`) with payload
+ * [APP_TRACE_FRAME_TAG | record...], each record little endian 32-bit words
+ * [header | timestamp | args...]:
+ * - header bits 0..11 line, 12..19 file ID, 20..22 argument count,
+ *   24..31 sequence number. The sequence counts every call, so the decoder
+ *   sees records dropped on a full ring as gaps.
+ * - timestamp: low 32 bits of the sleeptimer tick count, the time base of
+ *   the log lines (`log.h`). Unlike the DWT cycle counter it keeps counting
+ *   in EM2 sleep. A sync record (file 0, line 0, argument: timer frequency
+ *   in Hz) is sent at init and when nothing was traced for
+ *   `APP_TRACE_SYNC_TICKS`, so the decoder can convert ticks to time and
+ *   unwrap the counter.
+ *
+ * Tracing is off unless `APP_TRACE_ENABLE` is defined to 1: trace frames are
+ * binary and would clutter a terminal reading the console. When off, the
+ * macro keeps only the format check and compiles to nothing.
+ *
+ * @note This component is designed to be reusable across different projects,
+ *       the Central and the Peripheral use the same copy.
+ */
+
+#ifndef APP_TRACE_H
+#define APP_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef APP_TRACE_ENABLE
+#define APP_TRACE_ENABLE            0
+#endif
+
+// Size of the trace ring in 32-bit words, power of two
+#ifndef APP_TRACE_BUFFER_WORDS
+#define APP_TRACE_BUFFER_WORDS      512
+#endif
+
+// Ticks without any record before a sync record is added (~9 h at 32768 Hz)
+#ifndef APP_TRACE_SYNC_TICKS
+#define APP_TRACE_SYNC_TICKS        0x40000000u
+#endif
+
+#define APP_TRACE_MAX_ARGS          4
+
+// First payload byte of a trace control frame
+#define APP_TRACE_FRAME_TAG         0xF0
+
+#define APP_TRACE_HEADER(file, line, nargs) \
+    ((uint32_t)(line) | ((uint32_t)(file) << 12) | ((uint32_t)(nargs) << 20))
+
+// Number of macro arguments, APP_TRACE_MAX_ARGS + 1 for too many
+#define APP_TRACE_NARGS(...)        APP_TRACE_NARGS_(_, ##__VA_ARGS__, 5, 4, 3, 2, 1, 0)
+#define APP_TRACE_NARGS_(_x, _1, _2, _3, _4, _5, n, ...)    n
+
+// The arguments as 32-bit words, padded with zeros
+#define APP_TRACE_U32(a)            ((uint32_t)(uintptr_t)(a))
+#define APP_TRACE_ARGS(...)         APP_TRACE_ARGS_(_, ##__VA_ARGS__, 0, 0, 0, 0)
+#define APP_TRACE_ARGS_(_x, a, b, c, d, ...) \
+    APP_TRACE_U32(a), APP_TRACE_U32(b), APP_TRACE_U32(c), APP_TRACE_U32(d)
+
+// Never called: lets the compiler check the format against the arguments
+static inline __attribute__((format(printf, 1, 2))) void app_trace_format_check(const char *fmt, ...)
+{
+    (void)fmt;
+}
+
+#if APP_TRACE_ENABLE
+#define APP_TRACE(fmt, ...) \
+    do { \
+        _Static_assert(APP_TRACE_NARGS(__VA_ARGS__) <= APP_TRACE_MAX_ARGS, "too many trace arguments"); \
+        _Static_assert(__LINE__ < 4096, "trace site beyond line 4095"); \
+        if(0) { app_trace_format_check(fmt, ##__VA_ARGS__); } \
+        app_trace_record(APP_TRACE_HEADER(APP_TRACE_FILE_ID, __LINE__, APP_TRACE_NARGS(__VA_ARGS__)), \
+                         APP_TRACE_ARGS(__VA_ARGS__)); \
+    } while(0)
+#else
+#define APP_TRACE(fmt, ...) \
+    do { if(0) { app_trace_format_check(fmt, ##__VA_ARGS__); } } while(0)
+#endif
+
+// Counters describing the trace since app_trace_init()
+typedef struct
+{
+    uint32_t records;           // Records written into the ring
+    uint32_t dropped;           // Records lost because the ring was full
+    uint32_t frames_sent;       // Trace frames handed to the UART egress
+    uint16_t high_water;        // Highest number of ring words used
+} app_trace_stats_t;
+
+/**
+ * @brief Reset the ring and record a sync record.
+ *
+ * Call from `app_init()` after `app_cycle_counter_init()`.
+ */
+void app_trace_init(void);
+
+/**
+ * @brief Store a record, used by APP_TRACE().
+ *
+ * @param[in] header APP_TRACE_HEADER() of the site
+ * @param[in] a0..a3 Arguments, only the first (header bits 20..22) are kept
+ */
+void app_trace_record(uint32_t header, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3);
+
+/**
+ * @brief Ship buffered records to the UART egress as one control frame.
+ *
+ * Call from `app_process_action()`. Never waits for the UART, and yields
+ * to data frames while the egress is congested.
+ */
+void app_trace_process(void);
+
+/**
+ * @brief Copy the current trace counters.
+ *
+ * @param[out] stats Destination for the counters
+ */
+void app_trace_get_stats(app_trace_stats_t *stats);
+
+/**
+ * @brief Print the trace counters.
+ */
+void app_trace_log_stats(void);
+
+#ifdef APP_TRACE_BENCHMARK
+/**
+ * @brief Compare the cost of APP_TRACE() and of a formatted LOG_DEBUG line.
+ *
+ * Call once from `app_init()`; the benchmark records are discarded.
+ */
+void app_trace_log_benchmark(void);
+#endif
+
+#endif /* APP_TRACE_H */
@@ -0,0 +1,359 @@
+#include <string.h>
+#include "em_cmu.h"
+#include "em_usart.h"
+#include "sl_sleeptimer.h"
+#include "sl_iostream_usart_vcom_config.h"
+#include "app_uart_link.h"
+#include "app_uart_frame.h"
+#include "app_uart_egress.h"
+#include "app_bond_store.h"
+#include "log.h"
+
+#if !defined(SL_IOSTREAM_USART_VCOM_PERIPHERAL) || !defined(SL_IOSTREAM_USART_VCOM_PERIPHERAL_NO)
+#error "The link reconfigures the USART of the vcom iostream instance"
+#endif
+
+// Same USART as the vcom iostream and the egress (app_uart_egress.c)
+#define LINK_CLOCK_(no)             cmuClock_USART##no
+#define LINK_CLOCK(no)              LINK_CLOCK_(no)
+#define LINK_USART                  SL_IOSTREAM_USART_VCOM_PERIPHERAL
+#define LINK_USART_CLOCK            LINK_CLOCK(SL_IOSTREAM_USART_VCOM_PERIPHERAL_NO)
+#define LINK_RX_ERROR_FLAGS         (USART_IF_RXOF | USART_IF_FERR | USART_IF_PERR)
+
+// Accept a baud rate only if the divider gets within this error of it
+#define LINK_BAUD_TOLERANCE_PERMILLE    25
+
+// Longest reply: GET_STATS
+#define LINK_REPLY_MAX              (2 + 4 * sizeof(uint32_t))
+
+typedef enum
+{
+    LINK_IDLE = 0,
+    LINK_SWITCH_PENDING,        // SET_BAUD reply queued at the old rate
+    LINK_SWITCH_READY,          // Reply sent, egress held, waiting for the TX shifter
+    LINK_CONFIRM_WAIT           // New rate applied, waiting for CONFIRM
+} link_state_t;
+
+// Oversampling modes tried from the most robust to the fastest
+static const struct
+{
+    USART_OVS_TypeDef ovs;
+    uint32_t factor;
+} link_ovs[] = {
+    { usartOVS16, 16 },
+    { usartOVS8, 8 },
+    { usartOVS6, 6 },
+    { usartOVS4, 4 },
+};
+
+// Context of the UART link
+typedef struct
+{
+    volatile link_state_t state;
+    uint32_t old_baud;
+    USART_OVS_TypeDef old_ovs;
+    USART_OVS_TypeDef new_ovs;
+    uint32_t requested_baud;
+    USART_OVS_TypeDef current_ovs;
+    uint32_t confirm_deadline;          // Sleeptimer tick
+    uint8_t reply[APP_UART_FRAME_ENCODED_SIZE(LINK_REPLY_MAX)];    // Borrowed by the egress
+    volatile bool reply_busy;
+    app_uart_link_stats_t stats;
+} link_context_t;
+
+static link_context_t link_cxt = {0};
+
+/*******************************************************************************
+ ***************************   LOCAL FUNCTIONS   *******************************
+ *******************************************************************************/
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Find the oversampling mode and the rate the USART divider actually gives
+   for a requested baud rate, with the same divider rounding as
+   USART_BaudrateAsyncSet(). */
+static bool plan_baudrate(uint32_t baud, USART_OVS_TypeDef *ovs, uint32_t *actual)
+{
+    uint32_t ref_freq = CMU_ClockFreqGet(LINK_USART_CLOCK);
+
+    for(size_t i = 0; i < sizeof(link_ovs) / sizeof(link_ovs[0]); i++)
+    {
+        uint32_t step = link_ovs[i].factor * baud;
+        if(ref_freq < step)
+        {
+            continue;       // Divider would be below 1
+        }
+
+        uint32_t clkdiv = (32 * ref_freq + step / 2) / step;
+        clkdiv = ((clkdiv - 32) * 8) & _USART_CLKDIV_DIV_MASK;
+        uint32_t rate = USART_BaudrateCalc(ref_freq, clkdiv, false, link_ovs[i].ovs);
+
+        uint32_t diff = (rate > baud) ? rate - baud : baud - rate;
+        if((uint64_t)diff * 1000 <= (uint64_t)baud * LINK_BAUD_TOLERANCE_PERMILLE)
+        {
+            *ovs = link_ovs[i].ovs;
+            *actual = rate;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void apply_baudrate(uint32_t baud, USART_OVS_TypeDef ovs)
+{
+    USART_BaudrateAsyncSet(LINK_USART, 0, baud, ovs);
+    link_cxt.current_ovs = ovs;
+    link_cxt.stats.baudrate = USART_BaudrateGet(LINK_USART);
+}
+
+// Interrupt context: the reply has left the egress queue
+static void reply_sent(const uint8_t *data, size_t len)
+{
+    (void)data;
+    (void)len;
+
+    if(link_cxt.state == LINK_SWITCH_PENDING)
+    {
+        // Nothing else may start at the old rate, the switch happens in process()
+        app_uart_egress_set_hold(true);
+        link_cxt.state = LINK_SWITCH_READY;
+    }
+    link_cxt.reply_busy = false;
+}
+
+static void send_reply(uint8_t command, uint8_t status, const uint8_t *args, size_t args_len)
+{
+    uint8_t payload[LINK_REPLY_MAX];
+
+    if(link_cxt.reply_busy)
+    {
+        LOG_WARN("UART link: previous reply still pending, reply 0x%02x dropped", command);
+        return;
+    }
+
+    payload[0] = command | APP_UART_LINK_REPLY;
+    payload[1] = status;
+    if(args_len > 0)
+    {
+        memcpy(&payload[2], args, args_len);
+    }
+
+    size_t frame_len = app_uart_frame_encode_control(payload, 2 + args_len,
+                                                     link_cxt.reply, sizeof(link_cxt.reply));
+    link_cxt.reply_busy = true;
+    if(app_uart_egress_send_buffer(link_cxt.reply, frame_len, reply_sent) != SL_STATUS_OK)
+    {
+        link_cxt.reply_busy = false;
+        if(link_cxt.state == LINK_SWITCH_PENDING)
+        {
+            link_cxt.state = LINK_IDLE;     // The host never saw the reply, stay at the old rate
+        }
+        LOG_WARN("UART link: egress full, reply 0x%02x dropped", command);
+    }
+}
+
+static void handle_set_baud(const uint8_t *args, size_t len)
+{
+    uint8_t reply_args[4];
+    uint32_t actual;
+    USART_OVS_TypeDef ovs;
+
+    if(link_cxt.state != LINK_IDLE)
+    {
+        put_u32(reply_args, link_cxt.stats.baudrate);
+        send_reply(APP_UART_LINK_CMD_SET_BAUD, APP_UART_LINK_STATUS_BUSY, reply_args, 4);
+        return;
+    }
+
+    uint32_t baud = (len >= 4) ? get_u32(args) : 0;
+    if(baud < APP_UART_LINK_MIN_BAUD || baud > APP_UART_LINK_MAX_BAUD
+       || !plan_baudrate(baud, &ovs, &actual))
+    {
+        put_u32(reply_args, link_cxt.stats.baudrate);
+        send_reply(APP_UART_LINK_CMD_SET_BAUD, APP_UART_LINK_STATUS_INVALID, reply_args, 4);
+        LOG_INFO("UART link: %lu baud rejected", (unsigned long)baud);
+        return;
+    }
+
+    link_cxt.requested_baud = baud;
+    link_cxt.new_ovs = ovs;
+    link_cxt.state = LINK_SWITCH_PENDING;
+    LOG_INFO("UART link: switching to %lu baud (actual %lu)", (unsigned long)baud, (unsigned long)actual);
+
+    put_u32(reply_args, actual);
+    send_reply(APP_UART_LINK_CMD_SET_BAUD, APP_UART_LINK_STATUS_OK, reply_args, 4);
+}
+
+/*******************************************************************************
+ ***************************   GLOBAL FUNCTIONS   ******************************
+ ******************************************************************************/
+
+sl_status_t app_uart_link_init(void)
+{
+    memset(&link_cxt, 0, sizeof(link_context_t));
+
+    link_cxt.stats.baudrate = USART_BaudrateGet(LINK_USART);
+    link_cxt.current_ovs = (USART_OVS_TypeDef)(LINK_USART->CTRL & _USART_CTRL_OVS_MASK);
+    USART_IntClear(LINK_USART, LINK_RX_ERROR_FLAGS);
+
+    LOG_INFO("UART link: %lu baud, RTS/CTS flow control",
+             (unsigned long)link_cxt.stats.baudrate);
+    return SL_STATUS_OK;
+}
+
+void app_uart_link_on_control(const uint8_t *payload, size_t len)
+{
+    uint8_t reply_args[16];
+
+    if(payload == NULL || len == 0)
+    {
+        return;
+    }
+
+    switch(payload[0])
+    {
+        case APP_UART_LINK_CMD_SET_BAUD:
+            handle_set_baud(&payload[1], len - 1);
+            break;
+
+        case APP_UART_LINK_CMD_CONFIRM:
+            if(link_cxt.state != LINK_CONFIRM_WAIT)
+            {
+                send_reply(APP_UART_LINK_CMD_CONFIRM, APP_UART_LINK_STATUS_INVALID, NULL, 0);
+                break;
+            }
+            link_cxt.state = LINK_IDLE;
+            link_cxt.stats.baud_switches++;
+            LOG_INFO("UART link: %lu baud confirmed", (unsigned long)link_cxt.stats.baudrate);
+            send_reply(APP_UART_LINK_CMD_CONFIRM, APP_UART_LINK_STATUS_OK, NULL, 0);
+            break;
+
+        case APP_UART_LINK_CMD_GET_STATS:
+            put_u32(&reply_args[0], link_cxt.stats.baudrate);
+            put_u32(&reply_args[4], link_cxt.stats.rx_overruns);
+            put_u32(&reply_args[8], link_cxt.stats.rx_framing_errors);
+            put_u32(&reply_args[12], link_cxt.stats.rx_parity_errors);
+            send_reply(APP_UART_LINK_CMD_GET_STATS, APP_UART_LINK_STATUS_OK, reply_args, 16);
+            break;
+
+        case APP_UART_LINK_CMD_SET_LOG_MASK:
+            if(len < 5)
+            {
+                put_u32(reply_args, log_category_mask);
+                send_reply(APP_UART_LINK_CMD_SET_LOG_MASK, APP_UART_LINK_STATUS_INVALID, reply_args, 4);
+                break;
+            }
+            log_set_category_mask(get_u32(&payload[1]));
+            put_u32(reply_args, log_category_mask);
+            send_reply(APP_UART_LINK_CMD_SET_LOG_MASK, APP_UART_LINK_STATUS_OK, reply_args, 4);
+            break;
+
+        case APP_UART_LINK_CMD_REVOKE_BONDING:
+            if(len < 2 || app_bond_store_revoke(payload[1]) != SL_STATUS_OK)
+            {
+                send_reply(APP_UART_LINK_CMD_REVOKE_BONDING, APP_UART_LINK_STATUS_INVALID, NULL, 0);
+                break;
+            }
+            send_reply(APP_UART_LINK_CMD_REVOKE_BONDING, APP_UART_LINK_STATUS_OK, NULL, 0);
+            break;
+
+        default:
+            send_reply(payload[0], APP_UART_LINK_STATUS_INVALID, NULL, 0);
+            break;
+    }
+}
+
+void app_uart_link_process(void)
+{
+    // Receive errors: the flags stay set until cleared, whether or not the
+    // interrupt is enabled
+    uint32_t flags = USART_IntGet(LINK_USART) & LINK_RX_ERROR_FLAGS;
+    if(flags != 0)
+    {
+        USART_IntClear(LINK_USART, flags);
+        if(flags & USART_IF_RXOF)
+        {
+            link_cxt.stats.rx_overruns++;
+        }
+        if(flags & USART_IF_FERR)
+        {
+            link_cxt.stats.rx_framing_errors++;
+        }
+        if(flags & USART_IF_PERR)
+        {
+            link_cxt.stats.rx_parity_errors++;
+        }
+    }
+
+    switch(link_cxt.state)
+    {
+        case LINK_SWITCH_READY:
+            // Last reply byte must have left the shift register
+            if(!app_uart_egress_is_idle() || !(USART_StatusGet(LINK_USART) & USART_STATUS_TXC))
+            {
+                break;
+            }
+            link_cxt.old_baud = link_cxt.stats.baudrate;
+            link_cxt.old_ovs = link_cxt.current_ovs;
+            apply_baudrate(link_cxt.requested_baud, link_cxt.new_ovs);
+            link_cxt.confirm_deadline = sl_sleeptimer_get_tick_count()
+                                        + sl_sleeptimer_ms_to_tick(APP_UART_LINK_CONFIRM_TIMEOUT_MS);
+            link_cxt.state = LINK_CONFIRM_WAIT;
+            app_uart_egress_set_hold(false);
+            break;
+
+        case LINK_CONFIRM_WAIT:
+            if((int32_t)(sl_sleeptimer_get_tick_count() - link_cxt.confirm_deadline) < 0)
+            {
+                break;
+            }
+            // The host did not follow: go back to the rate it still uses
+            app_uart_egress_set_hold(true);
+            if(app_uart_egress_is_idle() && (USART_StatusGet(LINK_USART) & USART_STATUS_TXC))
+            {
+                apply_baudrate(link_cxt.old_baud, link_cxt.old_ovs);
+                link_cxt.stats.baud_reverts++;
+                link_cxt.state = LINK_IDLE;
+                app_uart_egress_set_hold(false);
+                LOG_INFO("UART link: no confirmation, back to %lu baud",
+                         (unsigned long)link_cxt.stats.baudrate);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+void app_uart_link_get_stats(app_uart_link_stats_t *stats)
+{
+    if(stats == NULL)
+    {
+        return;
+    }
+
+    *stats = link_cxt.stats;
+}
+
+void app_uart_link_log_stats(void)
+{
+    LOG_STATS("UART link: %lu baud, overruns %lu, framing errors %lu, parity errors %lu, switches %u, reverts %u",
+              (unsigned long)link_cxt.stats.baudrate,
+              (unsigned long)link_cxt.stats.rx_overruns,
+              (unsigned long)link_cxt.stats.rx_framing_errors,
+              (unsigned long)link_cxt.stats.rx_parity_errors,
+              link_cxt.stats.baud_switches,
+              link_cxt.stats.baud_reverts);
+}
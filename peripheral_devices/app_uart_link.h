@@ -0,0 +1,116 @@
+/**
+ * @file app_uart_link.h
+ * @brief UART link configuration: live baud rate switching and error counters
+ *
+ * The VCOM USART starts at `SL_IOSTREAM_USART_VCOM_BAUDRATE` with RTS/CTS
+ * hardware flow control (configured in the .slcp file). The host can then
+ * negotiate a higher baud rate at runtime with control frames
+ * (see `app_uart_frame.h`, control flag set in the length field).
+ *
+ * Control frame payloads are [command(1) | arguments]; every command is
+ * answered by a control frame [command | 0x80, status(1) | arguments]:
+ * - APP_UART_LINK_CMD_SET_BAUD [baud u32 LE]:
+ *   the reply [status | actual baud u32] is sent at the current baud rate,
+ *   then the USART switches. The host must switch too and send
+ *   APP_UART_LINK_CMD_CONFIRM at the new rate within
+ *   APP_UART_LINK_CONFIRM_TIMEOUT_MS, otherwise the previous rate is restored.
+ * - APP_UART_LINK_CMD_CONFIRM: ends a switch, replied at the new rate.
+ * - APP_UART_LINK_CMD_GET_STATS:
+ *   reply [status | baud u32 | rx_overruns u32 | rx_framing_errors u32 |
+ *   rx_parity_errors u32], all little endian.
+ * - APP_UART_LINK_CMD_SET_LOG_MASK [mask u32 LE]: enables the log categories
+ *   of the mask (LOG_CAT_* in `log.h`), reply [status | applied mask u32].
+ * - APP_UART_LINK_CMD_REVOKE_BONDING [bonding u8]: deletes one bonding, or
+ *   all of them with 0xFF (`app_bond_store_revoke()`), reply [status].
+ *
+ * Implementation notes (see `app_uart_link.c`):
+ * - The reply to SET_BAUD holds the UART egress when it has been sent, so
+ *   no byte goes out while the baud rate changes; log text waits in the
+ *   console ring meanwhile.
+ * - The receive error counters poll the USART RXOF, FERR and PERR flags in
+ *   `app_uart_link_process()`. Several errors between two polls count as
+ *   one, so the counters are lower bounds.
+ */
+
+#ifndef APP_UART_LINK_H
+#define APP_UART_LINK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "sl_status.h"
+
+// Baud rates accepted by APP_UART_LINK_CMD_SET_BAUD
+#ifndef APP_UART_LINK_MIN_BAUD
+#define APP_UART_LINK_MIN_BAUD              9600
+#endif
+#ifndef APP_UART_LINK_MAX_BAUD
+#define APP_UART_LINK_MAX_BAUD              3000000
+#endif
+
+// Time the host has to confirm a new baud rate
+#ifndef APP_UART_LINK_CONFIRM_TIMEOUT_MS
+#define APP_UART_LINK_CONFIRM_TIMEOUT_MS    1000
+#endif
+
+// Control commands, the reply carries command | APP_UART_LINK_REPLY
+#define APP_UART_LINK_CMD_SET_BAUD          0x01
+#define APP_UART_LINK_CMD_CONFIRM           0x02
+#define APP_UART_LINK_CMD_GET_STATS         0x03
+#define APP_UART_LINK_CMD_SET_LOG_MASK      0x04
+#define APP_UART_LINK_CMD_REVOKE_BONDING    0x05
+#define APP_UART_LINK_REPLY                 0x80
+
+// Reply status
+#define APP_UART_LINK_STATUS_OK             0x00
+#define APP_UART_LINK_STATUS_INVALID        0x01    // Unknown command or bad argument
+#define APP_UART_LINK_STATUS_BUSY           0x02    // A switch is in progress
+
+// Counters describing the UART link since app_uart_link_init()
+typedef struct
+{
+    uint32_t baudrate;              // Current USART baud rate
+    uint32_t rx_overruns;           // Polls that found RXOF (receive overflow)
+    uint32_t rx_framing_errors;     // Polls that found FERR
+    uint32_t rx_parity_errors;      // Polls that found PERR
+    uint16_t baud_switches;         // Confirmed baud rate changes
+    uint16_t baud_reverts;          // Changes undone for lack of confirmation
+} app_uart_link_stats_t;
+
+/**
+ * @brief Read the configured baud rate and clear the counters.
+ *
+ * Call after `app_iostream_usart_init()` and `app_uart_egress_init()`.
+ *
+ * @return SL_STATUS_OK
+ */
+sl_status_t app_uart_link_init(void);
+
+/**
+ * @brief Handle a control frame payload received by the UART ingress.
+ *
+ * @param[in] payload Control frame payload
+ * @param[in] len     Its length
+ */
+void app_uart_link_on_control(const uint8_t *payload, size_t len);
+
+/**
+ * @brief Poll the error flags and run a pending baud rate switch.
+ *
+ * Call from `app_process_action()`. Never waits.
+ */
+void app_uart_link_process(void);
+
+/**
+ * @brief Copy the current link counters.
+ *
+ * @param[out] stats Destination for the counters
+ */
+void app_uart_link_get_stats(app_uart_link_stats_t *stats);
+
+/**
+ * @brief Print the link counters.
+ */
+void app_uart_link_log_stats(void);
+
+#endif /* APP_UART_LINK_H */
@@ -43,9 +43,6 @@ extern const sli_bt_gattdb_t gattdb;
 #define gattdb_usart_service_0_len            16
 #define gattdb_usart_packet_len               20
 #define gattdb_current_time_0_len             2
-#define gattdb_current_time_len               10
-#define gattdb_local_time_information_len     2
-#define gattdb_reference_time_information_len 4
 #define gattdb_ota_len                        16
 
 
@@ -0,0 +1,244 @@
+/**
+ * @file ble_defragment_rxdata.h
+ * @brief APIs and documentation for receiving and reassembling BLE packets
+ *
+ * This module provides functionality for the receiving end of a link to
+ * queue packets (fragments) and reassemble them into the original payload:
+ * the Central for the indications of the Peripherals, the Peripheral for the
+ * writes without response of the Central (`ble_fragment_txdata.h`). It also
+ * validates payload integrity using the checksum provided by the sender.
+ *
+ * Implementation notes (see `ble_defragment_rxdata.c`):
+ * - Every link (index 0..`DEFRAG_LINKS - 1`, the Central uses its
+ *   `conn_properties` slot) has its own ingress ring of up to
+ *   `DEFRAG_LINK_SLOTS` fragments of at most `QUEUE_SLOT_SIZE` bytes, and its
+ *   own reassembly context, so fragments of several Peripherals may arrive
+ *   interleaved and a chatty link only fills its own ring. The application
+ *   picks which link to serve next (the Central with `app_drr.h`). The
+ *   fragment storage is drawn from `app_fragment_pool` and the reassembly
+ *   buffers from `app_message_pool` (see `app_pools.h`), so RAM is only used
+ *   by the fragments and payloads actually in flight.
+ * - The first fragment contains the expected payload length in byte 0.
+ * - Middle fragments carry up to `DEFRAG_FRAGMENT_LEN` (20) bytes of
+ *   payload; the last fragment includes the final payload bytes followed by
+ *   a checksum byte.
+ * - The module exposes a small state machine: when processing fragments,
+ *   the caller receives `DEFRAG_CONTINUE`, `DEFRAG_COMPLETE`, or
+ *   `DEFRAG_ERROR` to indicate progress or failure.
+ * - Completed payloads are handed off to one of `DEFRAG_COMPLETE_BUFFERS`
+ *   completion buffers, shared by the links, so a new message starts
+ *   reassembling while the previous one is still being processed or
+ *   forwarded. The application releases a payload with
+ *   `defrag_release_payload()` when it is done.
+ * - Writes without response cannot be held back, so a sender that does not
+ *   wait would overrun the ring while the completion buffers are held. The
+ *   receiver grants credits instead: every released payload (or message
+ *   lost to an error) is worth one message, sent back as a credit frame
+ *   [`DEFRAG_CREDIT_TAG` | count] in place of a first fragment. A sender
+ *   starts at most `DEFRAG_COMPLETE_BUFFERS` messages ahead of the credits
+ *   it got, so every message finds a completion buffer and the ring drains
+ *   as fast as it fills.
+ * - Per link, the module counts fragments, bytes and completed messages, and
+ *   the queueing delay of each fragment from `defrag_push_data()` to
+ *   `defrag_process_fragment()` (`defrag_log_link_stats()`).
+ *
+ * @note This component is designed to be reusable across different projects,
+ *       the Central and the Peripheral use the same copy. The Peripheral has
+ *       a single link and builds it with `DEFRAG_LINKS` 1.
+ */
+
+#ifndef BLE_DEFRAGMENT_H
+#define BLE_DEFRAGMENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define DEFRAG_MAX_PAYLOAD  200
+#define DEFRAG_FRAGMENT_LEN 20      // usart_packet value length, the longest fragment
+#define QUEUE_SLOT_SIZE     30
+#define DEFRAG_LINK_SLOTS   4       // Ring entries per link (pointers to pool blocks)
+#define DEFRAG_COMPLETE_BUFFERS 2   // Completed payloads the application may hold
+
+// Credit frame: a length byte of 0 never starts a message, so the frame is
+// told apart from data where a first fragment is expected
+#define DEFRAG_CREDIT_TAG   0x00
+#define DEFRAG_CREDIT_LEN   2
+
+// Links with their own ring and reassembly context, at least
+// SL_BT_CONFIG_MAX_CONNECTIONS
+#ifndef DEFRAG_LINKS
+#define DEFRAG_LINKS        4
+#endif
+
+typedef enum    
+{
+    DEFRAG_CONTINUE = 0,    // Waiting for more fragments
+    DEFRAG_COMPLETE,        // All fragemnts received
+    DEFRAG_ERROR            // Error occurred
+} defrag_enum_t;
+
+// Counters of one link since it was last flushed
+typedef struct
+{
+    uint32_t fragments;             // Fragments processed
+    uint32_t bytes;                 // Fragment bytes processed
+    uint32_t messages;              // Payloads completed
+    uint32_t delay_total_ticks;     // Queueing delay of the fragments, summed
+    uint32_t delay_max_ticks;
+    uint32_t first_tick;            // First and last fragment processed
+    uint32_t last_tick;
+} defrag_link_stats_t;
+
+void queue_init(void);
+
+/**
+ * @brief Initialize the defragmentation contexts.
+ *
+ * Resets the reassembly state of every link (expected length, received
+ * length, checksum flags, and first-fragment indicator), the completion
+ * buffers and the counters. Call this once at startup.
+ */
+void defrag_init(void);
+
+/**
+ * @brief Push a received fragment into the ring queue of its link.
+ *
+ * The function will copy the provided fragment into the next free queue
+ * slot. Typical reasons for failure include:
+ *  - `link >= DEFRAG_LINKS` or `data == NULL`
+ *  - `len == 0` or `len > QUEUE_SLOT_SIZE`
+ *  - The ring queue of the link is full
+ *  - `app_fragment_pool` has no free block
+ *
+ * @param link Link the fragment was received on
+ * @param data Pointer to the fragment bytes received from the peer
+ * @param len  Number of bytes in the fragment
+ * @return true on success (fragment queued), false on error
+ */
+bool defrag_push_data(uint8_t link, const uint8_t *data, uint16_t len);
+
+/**
+ * @brief Check whether `defrag_push_data()` can accept one more fragment
+ *        of a link.
+ *
+ * Lets the caller keep an incoming fragment (and withhold its indication
+ * confirmation) instead of pushing it into a full ring and losing it.
+ *
+ * @param link Link the fragment was received on
+ * @return true if an entry of the link's ring and an `app_fragment_pool`
+ *         block are free
+ */
+bool defrag_can_push(uint8_t link);
+
+/**
+ * @brief Length of the oldest fragment queued for a link.
+ *
+ * @param link Link to look at
+ * @return Length in bytes, 0 if nothing is queued
+ */
+uint16_t defrag_head_len(uint8_t link);
+
+/**
+ * @brief Pop the next queued fragment of a link and advance its
+ *        defragmentation state.
+ *
+ * This function reads the oldest fragment of the link's queue and
+ * integrates it into the link's assembled payload. It implements the state
+ * transitions described in the module header:
+ *  - process first fragment (extract expected length)
+ *  - append middle fragments
+ *  - handle last fragment and checksum validation
+ *
+ * If every completion buffer is still held by the application, the fragment
+ * stays queued and `DEFRAG_CONTINUE` is returned.
+ *
+ * It returns:
+ *  - `DEFRAG_CONTINUE` when waiting for more fragments
+ *  - `DEFRAG_COMPLETE` when the full payload has been reassembled and
+ *    handed off to a completion buffer
+ *  - `DEFRAG_ERROR` on protocol or processing error (length mismatch,
+ *    queue underflow, empty fragment, etc.)
+ *
+ * @note Callers should check for `DEFRAG_COMPLETE` and then use
+ *       `defrag_get_payload()` to retrieve the assembled payload and
+ *       checksum validity.
+ */
+defrag_enum_t defrag_process_fragment(uint8_t link);
+
+/**
+ * @brief Number of fragments waiting in the ring queue of a link.
+ */
+uint8_t defrag_link_queued_fragments(uint8_t link);
+
+/**
+ * @brief Number of fragments waiting in all ring queues.
+ */
+uint8_t defrag_queued_fragments(void);
+
+/**
+ * @brief Retrieve the oldest assembled payload after completion.
+ *
+ * If a payload has been successfully assembled, this function writes the
+ * pointer to its completion buffer, its length, and a boolean flag
+ * indicating whether the checksum validation passed.
+ *
+ * The returned payload pointer stays valid until `defrag_release_payload()`
+ * is called, independently of `defrag_reset()` and of further fragments
+ * being reassembled. Calling it again without releasing returns the same
+ * payload.
+ *
+ * @param[out] payload       Pointer to be set to the assembled payload buffer
+ * @param[out] payload_len   Pointer set to payload length in bytes
+ * @param[out] checksum_valid Pointer set to true if checksum matched
+ * @param[out] link          Pointer set to the link the payload came from
+ * @return true if a complete payload is available, false otherwise
+ */
+bool defrag_get_payload(uint8_t **payload, uint16_t *payload_len, bool *checksum_valid, uint8_t *link);
+
+/**
+ * @brief Release the payload returned by `defrag_get_payload()`.
+ *
+ * Returns its completion buffer to `app_message_pool` so the next completed
+ * message can be handed off.
+ */
+void defrag_release_payload(void);
+
+/**
+ * @brief Reset the defragmentation state of a link in preparation for its
+ *        next reception.
+ *
+ * Releases the link's reassembly buffer back to `app_message_pool` and
+ * clears its state so the module is ready to accept a new transmission
+ * from the start. Queued fragments, other links and completed payloads that
+ * are still held are not affected.
+ *
+ * @param link Link to reset
+ */
+void defrag_reset(uint8_t link);
+
+/**
+ * @brief Forget everything of a link, e.g. when its connection closes.
+ *
+ * Frees the queued fragments and the reassembly buffer and clears the
+ * link's counters. Completed payloads that are still held are not affected.
+ *
+ * @param link Link to flush
+ */
+void defrag_flush_link(uint8_t link);
+
+/**
+ * @brief Copy the counters of a link.
+ *
+ * @param[in]  link  Link to look at
+ * @param[out] stats Destination for the counters
+ */
+void defrag_get_link_stats(uint8_t link, defrag_link_stats_t *stats);
+
+/**
+ * @brief Print throughput and queueing delay of every link that received
+ *        fragments.
+ */
+void defrag_log_link_stats(void);
+
+#endif /* BLE_DEFRAGMENT_H */
\ No newline at end of file
@@ -3,114 +3,242 @@
 #include "sl_sleeptimer.h"
 #include "ble_fragment_queue.h"
 #include "app_iostream_usart.h"
+#include "app_checksum.h"
+#include "app_pools.h"
+#include "app_cycle_stats.h"
+#include "app_trace.h"
 #include "log.h"
 
+#define APP_TRACE_FILE_ID   2   // Trace site IDs of this file (app_trace.h)
+
+#if APP_FRAGMENT_BLOCK_SIZE < 28
+#error "APP_FRAGMENT_BLOCK_SIZE is too small for a fragment_t"
+#endif
+
 // Global fragment queue
 static fragment_queue_t frag_queue = {0};
 
+// CPU time from a confirmation to the next fragment handed to the stack
+static app_cycle_stats_t fragment_cycles = APP_CYCLE_STATS_INIT("per fragment");
+
+/*******************************************************************************
+ ***************************   LOCAL FUNCTIONS   *******************************
+ *******************************************************************************/
+
+// Allocate a fragment from the pool and link it at the end of a chain
+static fragment_t *append_fragment(fragment_t **first, fragment_t **last)
+{
+    fragment_t *frag = block_pool_alloc(&app_fragment_pool);
+    if(frag == NULL)
+    {
+        return NULL;
+    }
+
+    frag->next = NULL;
+    frag->length = 0;
+    if(*last != NULL)
+    {
+        (*last)->next = frag;
+    }
+    else
+    {
+        *first = frag;
+    }
+    *last = frag;
+
+    return frag;
+}
+
+// Return a whole chain of fragments to the pool
+static void free_chain(fragment_t *frag)
+{
+    while(frag != NULL)
+    {
+        fragment_t *next = frag->next;
+        block_pool_free(&app_fragment_pool, frag);
+        frag = next;
+    }
+}
+
+// Append a message behind anything still queued, and send its first
+// fragment if the queue was idle
+static sl_status_t queue_message(uint8_t connection, uint16_t characteristic,
+                                 fragment_t *first, fragment_t *last, uint8_t total)
+{
+    if(frag_queue.tail != NULL)
+    {
+        frag_queue.tail->next = first;
+    }
+    else
+    {
+        frag_queue.head = first;
+    }
+    frag_queue.tail = last;
+    frag_queue.queued_fragments += total;
+    frag_queue.queued_messages++;
+
+    if(frag_queue.is_sending)
+    {
+        APP_TRACE("message behind %u queued", frag_queue.queued_messages - 1);
+        return SL_STATUS_OK;
+    }
+
+    // Send first fragment
+    frag_queue.is_sending = true;
+    return fragment_queue_send_next(connection, characteristic);
+}
+
+/*******************************************************************************
+ ***************************   GLOBAL FUNCTIONS   ******************************
+ ******************************************************************************/
+
 // Init and reset the fragment queue
 void fragment_queue_init(void)
 {
+    free_chain(frag_queue.head);
     memset(&frag_queue, 0, sizeof(fragment_queue_t));
     frag_queue.is_sending = false;
-    frag_queue.total_fragments = 0;
-    frag_queue.current_fragment = 0;
 }
 
 // Prepare data for all fragments from payload and will send the first fragment
 sl_status_t fragment_queue_prepare(uint8_t connection, uint16_t characteristic,
                                         uint8_t *payload, size_t payload_len)
 {
-    if(frag_queue.is_sending)
-    {
-        LOG_INFO("ERROR: Queue is busy");
-        return SL_STATUS_BUSY;
-    }
+    fragment_t *first = NULL;
+    fragment_t *last = NULL;
+    fragment_t *frag;
+    uint8_t total = 0;
 
-    if(payload_len == 0)
+    if(payload_len == 0 || payload_len > 0xFF)
     {
-        LOG_INFO("ERROR: Empty payload");
+        LOG_ERROR("Invalid payload length");
         return SL_STATUS_INVALID_PARAMETER;
     }
 
     // Calculate checksum byte
-    uint8_t checksum = app_iostream_checksum(payload, payload_len);
+    uint8_t checksum = app_checksum_compute(payload, payload_len);
 
     // This case indicates the payload <= max value length of characteristic - 2
     if(payload_len <= 18)
     {
-        frag_queue.fragments[0].data[0] = payload_len;
-        memcpy(&frag_queue.fragments[0].data[1], payload, payload_len);
-        frag_queue.fragments[0].data[1+payload_len] = checksum;
-        frag_queue.fragments[0].length = 1 + payload_len + 1;
-        frag_queue.total_fragments = 1;
-        frag_queue.is_sending = true;
-
-        LOG_INFO("CHECKSUM: %02x", frag_queue.fragments[0].data[1+payload_len]);
-        return fragment_queue_send_next(connection, characteristic);
-    }
-
-    // First fragment : [length(1) | payload(max 19)]
-    // Middle fragment : [payload(max 20)]
-    // Last fragment : [payload(remaining) | checksum(1)]
-    uint8_t frag_idx = 0;
-    uint8_t offset = 0;
+        frag = append_fragment(&first, &last);
+        if(frag == NULL)
+        {
+            LOG_ERROR("Fragment pool is empty");
+            return SL_STATUS_NO_MORE_RESOURCE;
+        }
 
-    // First fragments
-    frag_queue.fragments[frag_idx].data[0] = payload_len;
-    size_t  first_payload_size = (payload_len >= 19) ? 19 : payload_len;
-    memcpy(&frag_queue.fragments[frag_idx].data[1], payload, first_payload_size);
-    frag_queue.fragments[frag_idx].length = 1 + first_payload_size;
-    offset += first_payload_size;
-    frag_idx++;
+        frag->data[0] = payload_len;
+        memcpy(&frag->data[1], payload, payload_len);
+        frag->data[1+payload_len] = checksum;
+        frag->length = 1 + payload_len + 1;
+        total = 1;
 
-    // Middle fragments and end fragment
-    while (offset <= payload_len)
+        LOG_DEBUG("CHECKSUM: %02x", frag->data[1+payload_len]);
+    }
+    else
     {
-        if(frag_idx >= MAX_FRAGMENTS)
+        // First fragment : [length(1) | payload(max 19)]
+        // Middle fragment : [payload(max 20)]
+        // Last fragment : [payload(remaining) | checksum(1)]
+        size_t offset = 0;
+
+        // First fragments
+        frag = append_fragment(&first, &last);
+        if(frag == NULL)
         {
-            LOG_INFO("ERROR: Too many fragments needed (max %d)", MAX_FRAGMENTS);
-            fragment_queue_init();
+            LOG_ERROR("Fragment pool is empty");
             return SL_STATUS_NO_MORE_RESOURCE;
         }
-        
-        // Case remaining = 0 -> just pack the checksum
-        size_t remaining = payload_len - offset;
-        
-        // If last fragment is under <= 19 bytes
-        if(remaining <= 19)
-        {
-            // Fragment cuối: [remaining_payload | checksum]
-            memcpy(&frag_queue.fragments[frag_idx].data[0], payload + offset, remaining);
-            frag_queue.fragments[frag_idx].data[remaining] = checksum;
-            frag_queue.fragments[frag_idx].length = remaining + 1;
-            offset += remaining;
-            frag_idx++;
-            break;
-        }
-        else
+        frag->data[0] = payload_len;
+        size_t  first_payload_size = (payload_len >= 19) ? 19 : payload_len;
+        memcpy(&frag->data[1], payload, first_payload_size);
+        frag->length = 1 + first_payload_size;
+        offset += first_payload_size;
+        total++;
+
+        // Middle fragments and end fragment
+        while (offset <= payload_len)
         {
-            // Middle fragment
-            memcpy(&frag_queue.fragments[frag_idx].data[0], payload + offset, 20);
-            frag_queue.fragments[frag_idx].length = 20;
-            offset += 20;
-            frag_idx++;
+            frag = append_fragment(&first, &last);
+            if(frag == NULL)
+            {
+                LOG_ERROR("Fragment pool is empty (%u fragments needed so far)", total + 1);
+                free_chain(first);
+                return SL_STATUS_NO_MORE_RESOURCE;
+            }
+
+            // Case remaining = 0 -> just pack the checksum
+            size_t remaining = payload_len - offset;
+
+            // If last fragment is under <= 19 bytes
+            if(remaining <= 19)
+            {
+                // Fragment cuối: [remaining_payload | checksum]
+                memcpy(&frag->data[0], payload + offset, remaining);
+                frag->data[remaining] = checksum;
+                frag->length = remaining + 1;
+                offset += remaining;
+                total++;
+                break;
+            }
+            else
+            {
+                // Middle fragment
+                memcpy(&frag->data[0], payload + offset, 20);
+                frag->length = 20;
+                offset += 20;
+                total++;
+            }
         }
     }
-        
-    frag_queue.total_fragments = frag_idx;
-    frag_queue.current_fragment = 0;
-    frag_queue.is_sending = true;
 
-    LOG_INFO("Total payload: %lu bytes", payload_len);
-    LOG_INFO("Total fragments: %u", frag_queue.total_fragments);
-    for(int i = 0; i < frag_queue.total_fragments; i++)
+    // Number the fragments so progress can be reported per message
+    uint8_t idx = 0;
+    for(frag = first; frag != NULL; frag = frag->next)
     {
-        LOG_INFO("  Fragment %d: %d bytes", i+1, frag_queue.fragments[i].length);
+        frag->index = idx++;
+        frag->total = total;
     }
-    
-    // Send first fragment
-    return fragment_queue_send_next(connection, characteristic);
+
+    APP_TRACE("message queued, %lu bytes, %u fragments", (unsigned long)payload_len, total);
+    for(frag = first; frag != NULL; frag = frag->next)
+    {
+        LOG_DEBUG("  Fragment %d: %d bytes", frag->index + 1, frag->length);
+    }
+
+    return queue_message(connection, characteristic, first, last, total);
+}
+
+sl_status_t fragment_queue_send_credit(uint8_t connection, uint16_t characteristic, uint8_t credits)
+{
+    fragment_t *first = NULL;
+    fragment_t *last = NULL;
+    fragment_t *frag = append_fragment(&first, &last);
+
+    if(frag == NULL)
+    {
+        return SL_STATUS_NO_MORE_RESOURCE;
+    }
+
+    // A message of its own, so it never splits the fragments of another
+    frag->data[0] = DEFRAG_CREDIT_TAG;
+    frag->data[1] = credits;
+    frag->length = DEFRAG_CREDIT_LEN;
+    frag->index = 0;
+    frag->total = 1;
+
+    APP_TRACE("credit queued, %u messages", credits);
+    return queue_message(connection, characteristic, first, last, 1);
+}
+
+bool fragment_queue_can_accept(size_t payload_len)
+{
+    // Same split as fragment_queue_prepare(): one fragment up to 18 bytes,
+    // otherwise a 19-byte first fragment and 20-byte fragments for the rest + checksum
+    size_t needed = (payload_len <= 18) ? 1 : 1 + ((payload_len - 19) + 1 + 19) / 20;
+
+    return block_pool_available(&app_fragment_pool) >= needed;
 }
 
 // Send the next fragment in queue until completing
@@ -118,38 +246,40 @@ sl_status_t fragment_queue_send_next(uint8_t connection, uint16_t characteristic
 {
     if(!frag_queue.is_sending)
     {
-        LOG_INFO("ERROR: Queue is not in sending state");
+        LOG_ERROR("Queue is not in sending state");
         return SL_STATUS_INVALID_STATE;
     }
 
-    if(frag_queue.current_fragment >= frag_queue.total_fragments)
+    if(frag_queue.head == NULL)
     {
-        LOG_INFO("ERROR: NO more fragments to send");
+        LOG_ERROR("NO more fragments to send");
         return SL_STATUS_INVALID_STATE;
     }
 
-    // Current_fragment will be increased after confirming
-    uint8_t idx = frag_queue.current_fragment;
-    
-    LOG_INFO("Sending fragment %d/%d (%d bytes)...",
-            idx + 1,
-            frag_queue.total_fragments,
-            frag_queue.fragments[idx].length);
-    
+    // The head fragment will be released after confirming
+    fragment_t *frag = frag_queue.head;
+
+    LOG_DEBUG("Sending fragment %d/%d (%d bytes)...",
+             frag->index + 1,
+             frag->total,
+             frag->length);
+
     sl_status_t sc = sl_bt_gatt_server_send_indication(
                         connection,
                         characteristic,
-                        frag_queue.fragments[idx].length,
-                        frag_queue.fragments[idx].data);
-    
+                        frag->length,
+                        frag->data);
+
+    APP_TRACE("fragment %u/%u indicated, %u bytes, status 0x%04lx",
+              frag->index + 1, frag->total, frag->length, (unsigned long)sc);
     if(sc != SL_STATUS_OK)
     {
-        LOG_INFO("ERROR: Failed to send fragment %u: 0x%04lx", idx + 1, sc);
+        LOG_ERROR("Failed to send fragment %u: 0x%04lx", frag->index + 1, sc);
         fragment_queue_init();  // Reset queue on error
         return sc;
     }
-    
-    printf("Fragment %u sent successfully, waiting for confirmation...\r\n", idx + 1);
+
+    LOG_DEBUG("Fragment %u sent successfully, waiting for confirmation...", frag->index + 1);
     return SL_STATUS_OK;
 }
 
@@ -158,28 +288,48 @@ sl_status_t fragment_queue_send_next(uint8_t connection, uint16_t characteristic
    Will be called in main loop, event change_status_id. */
 void fragment_queue_on_confirmation(uint8_t connection, uint16_t characteristic)
 {
-    if(!frag_queue.is_sending)
+    uint32_t start = app_cycle_counter_now();
+
+    if(!frag_queue.is_sending || frag_queue.head == NULL)
     {
-        LOG_INFO("Received unexpected confirmation (not sending)");
+        LOG_WARN("Received unexpected confirmation (not sending)");
         return;
     }
 
-    frag_queue.current_fragment++;
+    // The confirmed fragment goes back to the pool
+    fragment_t *done = frag_queue.head;
+    frag_queue.head = done->next;
+    if(frag_queue.head == NULL)
+    {
+        frag_queue.tail = NULL;
+    }
+    frag_queue.queued_fragments--;
+    APP_TRACE("fragment %u/%u confirmed", done->index + 1, done->total);
+
+    if(done->index + 1 == done->total)
+    {
+        APP_TRACE("message sent, %u fragments", done->total);
+        frag_queue.queued_messages--;
+        app_pools_log_stats();
+        app_console_log_stats();
+        app_cycle_stats_log(&fragment_cycles);
+        app_trace_log_stats();
+    }
+    block_pool_free(&app_fragment_pool, done);
 
-    if(frag_queue.current_fragment < frag_queue.total_fragments)
+    if(frag_queue.head != NULL)
     {
-        LOG_INFO("  Proceeding to next fragment...");
+        LOG_DEBUG("  Proceeding to next fragment...");
         sl_status_t sc = fragment_queue_send_next(connection, characteristic);
         if(sc != SL_STATUS_OK)
         {
-            LOG_INFO("ERROR: Failed to continue sending");
+            LOG_ERROR("Failed to continue sending");
             fragment_queue_init();
         }
     }
     else
     {
-        LOG_INFO("\r\nALL FRAGMENTS SENT SUCCESSFULLY");
-        LOG_INFO("Total: %u fragments transmitted", frag_queue.total_fragments);
-        fragment_queue_init();  // Reset queue for next turn
+        frag_queue.is_sending = false;  // Idle until the next message
     }
+    app_cycle_stats_add(&fragment_cycles, start);
 }
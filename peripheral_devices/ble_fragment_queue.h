@@ -4,6 +4,8 @@
  * - Confirmation-based transmission (waits for each fragment acknowledgment)
  * - Inter-fragment delay to prevent client buffer overflow
  * - Non-blocking state machine design
+ * - Fragments are blocks of `app_fragment_pool`, several messages can be
+ *   queued back to back as long as the pool has free blocks
  */
 
 #ifndef BLE_FRAGMENT_QUEUE_H
@@ -11,31 +13,36 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "sl_status.h"
+#include "ble_defragment_rxdata.h"
 
-#define CHARAC_VALUE_LEN 20
-#define MAX_FRAGMENTS    10
+#define CHARAC_VALUE_LEN DEFRAG_FRAGMENT_LEN
 
-typedef struct 
+typedef struct fragment
 {
-    uint8_t data[CHARAC_VALUE_LEN];
+    struct fragment *next;                  // Next queued fragment (same or next message)
     uint8_t length;
+    uint8_t index;                          // Position of the fragment in its message
+    uint8_t total;                          // Number of fragments of its message
+    uint8_t data[CHARAC_VALUE_LEN];
 } fragment_t;
 
 typedef struct
 {
-    fragment_t fragments[MAX_FRAGMENTS];    // Gather fragments
-    uint8_t total_fragments;                // Total of fragments will be sent
-    uint8_t current_fragment;               // Index of current fragment during sending
-    bool is_sending;                        // Flag
+    fragment_t *head;                       // Fragment being sent (oldest)
+    fragment_t *tail;                       // Last queued fragment
+    uint16_t queued_fragments;              // Fragments waiting or in flight
+    uint8_t queued_messages;                // Messages waiting or in flight
+    bool is_sending;                        // An indication waits for its confirmation
 } fragment_queue_t;
 
 /**
  * @brief Initialize the fragment queue.
  * 
- * Clears all buffered data, reset ths status to 'not sending', resets the fragment
- * counters. Use this during initialization or to flush/delete the queue before a new
- * transmission.
+ * Returns all queued fragments to `app_fragment_pool`, reset ths status to 'not sending',
+ * resets the fragment counters. Use this during initialization or to flush/delete the
+ * queue, e.g. when the connection is closed.
  */
 void fragment_queue_init(void);
 
@@ -43,19 +50,47 @@ void fragment_queue_init(void);
  * @brief To prepare the fragment queue and start sending process.
  * 
  * Splits/divides the payload into fragments of 20bytes max, adds length to the beginning
- * and addpends checksum at the end. After preparing, the function will start sending 
- * the first fragment.
+ * and addpends checksum at the end. The fragments are appended behind any message that
+ * is still being sent; if the queue was idle the first fragment is sent right away.
  * Structure of fragments: [length(1) | payload(max 19)] [payload(max 20)] ... [payload(remaining) | checksum(1)]
  *
  * @param[in] connection Connection handle that presents the link to the client
  * @param[in] characteristic Characteristic handle to specify where to send the fragments
  * @param[in] payload Pointer to the payload buffer 
  * @param[in] payload_len Length of the payload in bytes
- * @return sl_status_t 
+ * @return SL_STATUS_OK, or SL_STATUS_NO_MORE_RESOURCE if the fragment pool is exhausted
+ *         (nothing is queued in that case)
  */
 sl_status_t fragment_queue_prepare(uint8_t connection, uint16_t characteristic,
                                    uint8_t *payload, size_t payload_len);
 
+/**
+ * @brief Queue a credit frame for the Central.
+ *
+ * Tells the Central how many more messages it may write
+ * (`ble_defragment_rxdata.h`). The frame is a one-fragment message
+ * [`DEFRAG_CREDIT_TAG` | credits] queued behind the messages already
+ * queued, so it never lands between the fragments of a message.
+ *
+ * @param[in] connection Connection handle that presents the link to the client
+ * @param[in] characteristic Characteristic handle to specify where to send the frame
+ * @param[in] credits Messages the Central may write on top of its credits
+ * @return SL_STATUS_OK, or SL_STATUS_NO_MORE_RESOURCE if the fragment pool is
+ *         exhausted (retry later)
+ */
+sl_status_t fragment_queue_send_credit(uint8_t connection, uint16_t characteristic, uint8_t credits);
+
+/**
+ * @brief Check whether a payload can be queued now.
+ *
+ * Lets the caller keep its payload and retry later instead of getting
+ * SL_STATUS_NO_MORE_RESOURCE from `fragment_queue_prepare()`.
+ *
+ * @param[in] payload_len Length of the payload in bytes
+ * @return true if `app_fragment_pool` has a block for every fragment
+ */
+bool fragment_queue_can_accept(size_t payload_len);
+
 /**
  * @brief Send the next fragment in queue until completing.
  * 
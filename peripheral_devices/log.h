@@ -1,11 +1,32 @@
 /***************************************************************************//**
  * @file log.h
  * @brief Generic logging marco service component for my personal project
- * @version 1.0.0
- * @details 
+ * @version 1.1.0
+ * @details
  * Provides a reusable logging framework suitable for embedded and desktop
  * projects.
  * Log out the information, warnings and errors by stage/phase
+ *
+ * Filtering happens at two points:
+ * - Compile time: every category has a level (`LOG_LEVEL_<CATEGORY>`,
+ *   default `LOG_LEVEL`). A macro above that level expands to a dead
+ *   `if(0)` branch: no code, no format string in flash, and its arguments
+ *   are never evaluated (they are still type-checked).
+ * - Run time: `log_category_mask` holds one `LOG_CAT_<CATEGORY>` bit per
+ *   category; a cleared bit silences a compiled-in category. LOG_ERROR and
+ *   LOG_WARN ignore the mask.
+ *
+ * Every line starts with the time since boot, "[seconds.milliseconds] ",
+ * from the sleeptimer (`sl_sleeptimer_get_tick_count64()`), which keeps
+ * counting in sleep modes. The binary trace (`app_trace.h`) uses the same
+ * time base, so host tools can measure phases across both. Define
+ * `LOG_TIMESTAMP` to 0 to leave it out.
+ *
+ * Profiles (define one for the whole project, e.g. in the .slcp `define:`):
+ * - default (verbose): every category at LOG_LEVEL_DEBUG, same output as
+ *   before the levels existed.
+ * - `LOG_PROFILE_PRODUCTION`: LOG_LEVEL_WARN, except the STATS category that
+ *   keeps its per-message counters at LOG_LEVEL_INFO.
  * @note This component is designed to be reusable across different projects
 *******************************************************************************/
 
@@ -13,11 +34,87 @@
 #define LOG_H
 
 #include <stdio.h>
+#include <stdint.h>
 
-#ifndef PRINTF_LOG_NL   
+#ifndef PRINTF_LOG_NL
 #define PRINTF_LOG_NL   "\r\n"
 #endif
 
+// Every log macro writes through LOG_PRINTF. The applications route it to the
+// buffered console (app_console.h) so logging never waits for the UART;
+// define LOG_PRINTF before including this file to log elsewhere (e.g. printf).
+#ifndef LOG_PRINTF
+#include "app_console.h"
+#define LOG_PRINTF      app_console_printf
+#endif
+
+#define LOG_LEVEL_NONE          0
+#define LOG_LEVEL_ERROR         1
+#define LOG_LEVEL_WARN          2
+#define LOG_LEVEL_INFO          3
+#define LOG_LEVEL_DEBUG         4
+
+#ifndef LOG_LEVEL
+#ifdef LOG_PROFILE_PRODUCTION
+#define LOG_LEVEL               LOG_LEVEL_WARN
+#else
+#define LOG_LEVEL               LOG_LEVEL_DEBUG
+#endif
+#endif
+
+// Compile-time level of every category
+#ifndef LOG_LEVEL_BUTTON
+#define LOG_LEVEL_BUTTON        LOG_LEVEL
+#endif
+#ifndef LOG_LEVEL_BOOT
+#define LOG_LEVEL_BOOT          LOG_LEVEL
+#endif
+#ifndef LOG_LEVEL_SCAN
+#define LOG_LEVEL_SCAN          LOG_LEVEL
+#endif
+#ifndef LOG_LEVEL_DISC
+#define LOG_LEVEL_DISC          LOG_LEVEL
+#endif
+#ifndef LOG_LEVEL_ADVER
+#define LOG_LEVEL_ADVER         LOG_LEVEL
+#endif
+#ifndef LOG_LEVEL_CONN
+#define LOG_LEVEL_CONN          LOG_LEVEL
+#endif
+#ifndef LOG_LEVEL_PAIRING
+#define LOG_LEVEL_PAIRING       LOG_LEVEL
+#endif
+#ifndef LOG_LEVEL_BONDING
+#define LOG_LEVEL_BONDING       LOG_LEVEL
+#endif
+#ifndef LOG_LEVEL_APP
+#define LOG_LEVEL_APP           LOG_LEVEL
+#endif
+#ifndef LOG_LEVEL_STATS
+#ifdef LOG_PROFILE_PRODUCTION
+#define LOG_LEVEL_STATS         LOG_LEVEL_INFO
+#else
+#define LOG_LEVEL_STATS         LOG_LEVEL
+#endif
+#endif
+
+// Run-time category bits of log_category_mask
+#define LOG_CAT_BUTTON          (1u << 0)
+#define LOG_CAT_BOOT            (1u << 1)
+#define LOG_CAT_SCAN            (1u << 2)
+#define LOG_CAT_DISC            (1u << 3)
+#define LOG_CAT_ADVER           (1u << 4)
+#define LOG_CAT_CONN            (1u << 5)
+#define LOG_CAT_PAIRING         (1u << 6)
+#define LOG_CAT_BONDING         (1u << 7)
+#define LOG_CAT_APP             (1u << 8)
+#define LOG_CAT_STATS           (1u << 9)
+#define LOG_CAT_ALL             0x3FFu
+
+#ifndef LOG_TIMESTAMP
+#define LOG_TIMESTAMP           1
+#endif
+
 #define BUTTON_SERVICE_PREFIX    "[BUTTON] "
 #define SYSTEMBOOT_PREFIX        "[BOOT] "
 #define ADVERTISING_PREFIX       "[ADVER] "
@@ -27,15 +124,127 @@
 #define PAIRING_PREFIX           "[PAIRING] "
 #define BONDING_PREFIX           "[BOND] "
 #define INFO_PREFIX              "[I] "
+#define DEBUG_PREFIX             "[D] "
+#define WARN_PREFIX              "[W] "
+#define ERROR_PREFIX             "[E] "
+#define STATS_PREFIX             "[STATS] "
+
+// Categories enabled at run time, LOG_CAT_ALL after reset (see log.c)
+extern volatile uint32_t log_category_mask;
+
+// True if a message of this level and category would be printed, e.g.
+// LOG_ENABLED(APP, LOG_LEVEL_DEBUG) to skip formatting work for LOG_DEBUG
+#define LOG_ENABLED(cat, level) \
+    ((level) <= LOG_LEVEL_##cat && (log_category_mask & LOG_CAT_##cat) != 0)
+
+#if LOG_TIMESTAMP
+#define LOG_EMIT_ALWAYS(prefix, fmt, ...) \
+    do { \
+        uint64_t log_ms_ = log_timestamp_ms(); \
+        LOG_PRINTF("[%lu.%03u] " prefix fmt PRINTF_LOG_NL, \
+                   (unsigned long)(log_ms_ / 1000u), (unsigned int)(log_ms_ % 1000u), ##__VA_ARGS__); \
+    } while(0)
+#else
+#define LOG_EMIT_ALWAYS(prefix, fmt, ...) \
+    do { LOG_PRINTF(prefix fmt PRINTF_LOG_NL, ##__VA_ARGS__); } while(0)
+#endif
+#define LOG_EMIT(cat, prefix, fmt, ...) \
+    do { if(log_category_mask & LOG_CAT_##cat) { LOG_EMIT_ALWAYS(prefix, fmt, ##__VA_ARGS__); } } while(0)
+#define LOG_DISCARD(fmt, ...) \
+    do { if(0) { LOG_PRINTF(fmt, ##__VA_ARGS__); } } while(0)
+
+#if LOG_LEVEL_BUTTON >= LOG_LEVEL_INFO
+#define LOG_BUTTON(fmt, ...)    LOG_EMIT(BUTTON, BUTTON_SERVICE_PREFIX, fmt, ##__VA_ARGS__)
+#else
+#define LOG_BUTTON(fmt, ...)    LOG_DISCARD(fmt, ##__VA_ARGS__)
+#endif
 
-#define LOG_BUTTON(fmt, ...)    printf(BUTTON_SERVICE_PREFIX fmt PRINTF_LOG_NL, ##__VA_ARGS__)
-#define LOG_BOOT(fmt, ...)      printf(SYSTEMBOOT_PREFIX fmt PRINTF_LOG_NL, ##__VA_ARGS__)
-#define LOG_SCANN(fmt, ...)     printf(SCANNING_PREFIX fmt PRINTF_LOG_NL, ##__VA_ARGS__)
-#define LOG_DISC(fmt, ...)      printf(DISCOVERING_PREFIX fmt PRINTF_LOG_NL, ##__VA_ARGS__)
-#define LOG_ADVER(fmt, ...)     printf(ADVERTISING_PREFIX fmt PRINTF_LOG_NL, ##__VA_ARGS__)
-#define LOG_CONN(fmt, ...)      printf(CONNECTION_PREFIX fmt PRINTF_LOG_NL, ##__VA_ARGS__)
-#define LOG_PAIRING(fmt, ...)   printf(PAIRING_PREFIX fmt PRINTF_LOG_NL, ##__VA_ARGS__)
-#define LOG_BONDING(fmt, ...)   printf(BONDING_PREFIX fmt PRINTF_LOG_NL, ##__VA_ARGS__)
-#define LOG_INFO(fmt, ...)      printf(INFO_PREFIX fmt PRINTF_LOG_NL, ##__VA_ARGS__)
-
-#endif
\ No newline at end of file
+#if LOG_LEVEL_BOOT >= LOG_LEVEL_INFO
+#define LOG_BOOT(fmt, ...)      LOG_EMIT(BOOT, SYSTEMBOOT_PREFIX, fmt, ##__VA_ARGS__)
+#else
+#define LOG_BOOT(fmt, ...)      LOG_DISCARD(fmt, ##__VA_ARGS__)
+#endif
+
+#if LOG_LEVEL_SCAN >= LOG_LEVEL_INFO
+#define LOG_SCANN(fmt, ...)     LOG_EMIT(SCAN, SCANNING_PREFIX, fmt, ##__VA_ARGS__)
+#else
+#define LOG_SCANN(fmt, ...)     LOG_DISCARD(fmt, ##__VA_ARGS__)
+#endif
+
+#if LOG_LEVEL_DISC >= LOG_LEVEL_INFO
+#define LOG_DISC(fmt, ...)      LOG_EMIT(DISC, DISCOVERING_PREFIX, fmt, ##__VA_ARGS__)
+#else
+#define LOG_DISC(fmt, ...)      LOG_DISCARD(fmt, ##__VA_ARGS__)
+#endif
+
+#if LOG_LEVEL_ADVER >= LOG_LEVEL_INFO
+#define LOG_ADVER(fmt, ...)     LOG_EMIT(ADVER, ADVERTISING_PREFIX, fmt, ##__VA_ARGS__)
+#else
+#define LOG_ADVER(fmt, ...)     LOG_DISCARD(fmt, ##__VA_ARGS__)
+#endif
+
+#if LOG_LEVEL_CONN >= LOG_LEVEL_INFO
+#define LOG_CONN(fmt, ...)      LOG_EMIT(CONN, CONNECTION_PREFIX, fmt, ##__VA_ARGS__)
+#else
+#define LOG_CONN(fmt, ...)      LOG_DISCARD(fmt, ##__VA_ARGS__)
+#endif
+
+#if LOG_LEVEL_PAIRING >= LOG_LEVEL_INFO
+#define LOG_PAIRING(fmt, ...)   LOG_EMIT(PAIRING, PAIRING_PREFIX, fmt, ##__VA_ARGS__)
+#else
+#define LOG_PAIRING(fmt, ...)   LOG_DISCARD(fmt, ##__VA_ARGS__)
+#endif
+
+#if LOG_LEVEL_BONDING >= LOG_LEVEL_INFO
+#define LOG_BONDING(fmt, ...)   LOG_EMIT(BONDING, BONDING_PREFIX, fmt, ##__VA_ARGS__)
+#else
+#define LOG_BONDING(fmt, ...)   LOG_DISCARD(fmt, ##__VA_ARGS__)
+#endif
+
+#if LOG_LEVEL_STATS >= LOG_LEVEL_INFO
+#define LOG_STATS(fmt, ...)     LOG_EMIT(STATS, STATS_PREFIX, fmt, ##__VA_ARGS__)
+#else
+#define LOG_STATS(fmt, ...)     LOG_DISCARD(fmt, ##__VA_ARGS__)
+#endif
+
+// Application messages: one category, four levels
+#if LOG_LEVEL_APP >= LOG_LEVEL_ERROR
+#define LOG_ERROR(fmt, ...)     LOG_EMIT_ALWAYS(ERROR_PREFIX, fmt, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(fmt, ...)     LOG_DISCARD(fmt, ##__VA_ARGS__)
+#endif
+
+#if LOG_LEVEL_APP >= LOG_LEVEL_WARN
+#define LOG_WARN(fmt, ...)      LOG_EMIT_ALWAYS(WARN_PREFIX, fmt, ##__VA_ARGS__)
+#else
+#define LOG_WARN(fmt, ...)      LOG_DISCARD(fmt, ##__VA_ARGS__)
+#endif
+
+#if LOG_LEVEL_APP >= LOG_LEVEL_INFO
+#define LOG_INFO(fmt, ...)      LOG_EMIT(APP, INFO_PREFIX, fmt, ##__VA_ARGS__)
+#else
+#define LOG_INFO(fmt, ...)      LOG_DISCARD(fmt, ##__VA_ARGS__)
+#endif
+
+// Hot-path detail (every fragment), compiled out of production builds
+#if LOG_LEVEL_APP >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(fmt, ...)     LOG_EMIT(APP, DEBUG_PREFIX, fmt, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(fmt, ...)     LOG_DISCARD(fmt, ##__VA_ARGS__)
+#endif
+
+/**
+ * @brief Milliseconds since boot, the time stamp of every log line.
+ *
+ * @return Sleeptimer time in milliseconds
+ */
+uint64_t log_timestamp_ms(void);
+
+/**
+ * @brief Set the categories enabled at run time.
+ *
+ * @param[in] mask OR of LOG_CAT_* bits
+ */
+void log_set_category_mask(uint32_t mask);
+
+#endif
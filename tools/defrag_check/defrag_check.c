@@ -0,0 +1,252 @@
+/**
+ * @file defrag_check.c
+ * @brief Host check of the bounds of the reassembly (ble_defragment_rxdata.c)
+ *
+ * A connected peer controls the length byte and the size of every fragment
+ * it writes or indicates. The check feeds well-formed and malformed
+ * sequences through defrag_push_data() / defrag_process_fragment() the way
+ * the applications do (defrag_reset() after DEFRAG_ERROR) and verifies:
+ *
+ * - single and multi-fragment payloads complete with a valid checksum
+ * - a first fragment carrying more than its announced length (byte 0 = 5
+ *   and 29 data bytes) is rejected, and the 20-byte fragments that follow
+ *   never write past a reassembly buffer
+ * - a middle or last fragment past the announced length is rejected
+ * - the credit window holds: while the application holds every completion
+ *   buffer, DEFRAG_COMPLETE_BUFFERS messages of DEFRAG_MAX_PAYLOAD bytes
+ *   still complete without a refused fragment, and one more message is
+ *   what overruns the ring
+ * - every pool block is back once the payloads are released
+ *
+ * The bytes of app_message_pool blocks beyond DEFRAG_MAX_PAYLOAD + 1 (the
+ * terminator) are filled with a canary before each case and checked after.
+ * Exit status 0 when every case passes.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "ble_defragment_rxdata.h"
+#include "app_checksum.h"
+#include "app_pools.h"
+
+#define CANARY      0xA5
+#define LINK        0
+
+volatile uint32_t log_category_mask = 0xFFFFFFFFu;
+
+static unsigned failures = 0;
+
+uint32_t sl_sleeptimer_get_tick_count(void)
+{
+    return 0;
+}
+
+uint32_t sl_sleeptimer_tick_to_ms(uint32_t tick)
+{
+    return tick;
+}
+
+static void expect(bool ok, const char *what)
+{
+    printf("  %-60s %s\n", what, ok ? "ok" : "FAILED");
+    if(!ok)
+    {
+        failures++;
+    }
+}
+
+// Fill the bytes no payload may reach in every message block
+static void canary_fill(void)
+{
+    uint8_t *block[APP_MESSAGE_BLOCK_COUNT];
+    uint16_t n = 0;
+
+    while(n < APP_MESSAGE_BLOCK_COUNT && (block[n] = block_pool_alloc(&app_message_pool)) != NULL)
+    {
+        memset(&block[n][DEFRAG_MAX_PAYLOAD + 1], CANARY, APP_MESSAGE_BLOCK_SIZE - DEFRAG_MAX_PAYLOAD - 1);
+        n++;
+    }
+    while(n > 0)
+    {
+        block_pool_free(&app_message_pool, block[--n]);
+    }
+}
+
+static bool canary_intact(void)
+{
+    uint8_t *block[APP_MESSAGE_BLOCK_COUNT];
+    uint16_t n = 0;
+    bool intact = true;
+
+    while(n < APP_MESSAGE_BLOCK_COUNT && (block[n] = block_pool_alloc(&app_message_pool)) != NULL)
+    {
+        for(uint16_t i = DEFRAG_MAX_PAYLOAD + 1; i < APP_MESSAGE_BLOCK_SIZE; i++)
+        {
+            intact = intact && block[n][i] == CANARY;
+        }
+        n++;
+    }
+    while(n > 0)
+    {
+        block_pool_free(&app_message_pool, block[--n]);
+    }
+    return intact;
+}
+
+// Push and process one fragment as the applications do
+static defrag_enum_t feed(const uint8_t *data, uint16_t len)
+{
+    defrag_enum_t result;
+
+    if(!defrag_push_data(LINK, data, len))
+    {
+        return DEFRAG_ERROR;
+    }
+    result = defrag_process_fragment(LINK);
+    if(result == DEFRAG_ERROR)
+    {
+        defrag_reset(LINK);
+    }
+    return result;
+}
+
+// Send a payload in the firmware's fragment format, return the last result
+static defrag_enum_t feed_payload(const uint8_t *payload, uint8_t len)
+{
+    uint8_t fragment[21];
+    uint8_t checksum = app_checksum_compute(payload, len);
+    uint16_t sent;
+
+    if(len <= 18)
+    {
+        fragment[0] = len;
+        memcpy(&fragment[1], payload, len);
+        fragment[1 + len] = checksum;
+        return feed(fragment, (uint16_t)(len + 2));
+    }
+
+    fragment[0] = len;
+    memcpy(&fragment[1], payload, 19);
+    if(feed(fragment, 20) != DEFRAG_CONTINUE)
+    {
+        return DEFRAG_ERROR;
+    }
+    for(sent = 19; len - sent >= 20; sent += 20)
+    {
+        if(feed(&payload[sent], 20) != DEFRAG_CONTINUE)
+        {
+            return DEFRAG_ERROR;
+        }
+    }
+    memcpy(fragment, &payload[sent], len - sent);
+    fragment[len - sent] = checksum;
+    return feed(fragment, (uint16_t)(len - sent + 1));
+}
+
+// Take the completed payload, if any, and compare it
+static bool take_payload(const uint8_t *expected, uint16_t expected_len)
+{
+    uint8_t *payload;
+    uint16_t len;
+    bool valid;
+    bool ok;
+
+    if(!defrag_get_payload(&payload, &len, &valid, NULL))
+    {
+        return false;
+    }
+    ok = valid && len == expected_len && memcmp(payload, expected, len) == 0;
+    defrag_release_payload();
+    return ok;
+}
+
+static void start_case(const char *name)
+{
+    printf("%s\n", name);
+    defrag_flush_link(LINK);
+    canary_fill();
+}
+
+int main(void)
+{
+    uint8_t payload[DEFRAG_MAX_PAYLOAD];
+    uint8_t fragment[QUEUE_SLOT_SIZE];
+    uint16_t fragments_free;
+    uint16_t messages_free;
+    bool any_complete;
+
+    app_pools_init();
+    queue_init();
+    defrag_init();
+    fragments_free = block_pool_available(&app_fragment_pool);
+    messages_free = block_pool_available(&app_message_pool);
+
+    for(uint16_t i = 0; i < sizeof(payload); i++)
+    {
+        payload[i] = (uint8_t)('a' + i % 26);
+    }
+
+    start_case("well-formed payloads");
+    expect(feed_payload(payload, 11) == DEFRAG_COMPLETE && take_payload(payload, 11),
+           "11 bytes, single fragment");
+    expect(feed_payload(payload, 45) == DEFRAG_COMPLETE && take_payload(payload, 45),
+           "45 bytes, three fragments");
+    expect(feed_payload(payload, DEFRAG_MAX_PAYLOAD) == DEFRAG_COMPLETE
+           && take_payload(payload, DEFRAG_MAX_PAYLOAD),
+           "DEFRAG_MAX_PAYLOAD bytes");
+    expect(canary_intact(), "no write past the payloads");
+
+    start_case("oversized first fragment");
+    fragment[0] = 5;
+    memset(&fragment[1], 'X', 29);
+    expect(feed(fragment, 30) == DEFRAG_ERROR, "length 5 with 29 data bytes rejected");
+    any_complete = false;
+    memset(fragment, 'Y', 20);
+    for(int i = 0; i < 20; i++)
+    {
+        any_complete = feed(fragment, 20) == DEFRAG_COMPLETE || any_complete;
+    }
+    expect(!any_complete, "20 following 20-byte fragments complete nothing");
+    defrag_reset(LINK);
+    expect(canary_intact(), "no write past a reassembly buffer");
+    expect(feed_payload(payload, 45) == DEFRAG_COMPLETE && take_payload(payload, 45),
+           "next well-formed payload still completes");
+
+    start_case("oversized middle and last fragments");
+    fragment[0] = 30;
+    memcpy(&fragment[1], payload, 19);
+    expect(feed(fragment, 20) == DEFRAG_CONTINUE, "first fragment of a 30-byte payload");
+    expect(feed(payload, QUEUE_SLOT_SIZE) == DEFRAG_ERROR, "30-byte fragment with 11 bytes left rejected");
+    fragment[0] = 60;
+    memcpy(&fragment[1], payload, 19);
+    expect(feed(fragment, 20) == DEFRAG_CONTINUE, "first fragment of a 60-byte payload");
+    expect(feed(payload, QUEUE_SLOT_SIZE) == DEFRAG_CONTINUE, "30-byte middle fragment within the payload");
+    expect(feed(payload, 13) == DEFRAG_ERROR, "last fragment one byte too long rejected");
+    expect(canary_intact(), "no write past a reassembly buffer");
+
+    start_case("credit window");
+    any_complete = true;
+    for(uint8_t i = 0; i < DEFRAG_COMPLETE_BUFFERS; i++)
+    {
+        any_complete = feed_payload(payload, DEFRAG_MAX_PAYLOAD) == DEFRAG_COMPLETE && any_complete;
+    }
+    expect(any_complete, "DEFRAG_COMPLETE_BUFFERS messages, none released");
+    expect(feed_payload(payload, DEFRAG_MAX_PAYLOAD) == DEFRAG_ERROR,
+           "one message past the credits is refused");
+    any_complete = true;
+    for(uint8_t i = 0; i < DEFRAG_COMPLETE_BUFFERS; i++)
+    {
+        any_complete = take_payload(payload, DEFRAG_MAX_PAYLOAD) && any_complete;
+    }
+    expect(any_complete, "the held messages are intact");
+
+    defrag_flush_link(LINK);
+    expect(block_pool_available(&app_fragment_pool) == fragments_free
+           && block_pool_available(&app_message_pool) == messages_free,
+           "every pool block returned");
+
+    printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,9 @@
+// Host stand-in for the Simplicity SDK header: the check is single threaded
+#ifndef SL_CORE_H
+#define SL_CORE_H
+
+#define CORE_DECLARE_IRQ_STATE
+#define CORE_ENTER_CRITICAL()
+#define CORE_EXIT_CRITICAL()
+
+#endif /* SL_CORE_H */
@@ -0,0 +1,10 @@
+// Host stand-in for the Simplicity SDK header, only what the checked modules use
+#ifndef SL_IOSTREAM_H
+#define SL_IOSTREAM_H
+
+#include <stddef.h>
+#include "sl_status.h"
+
+typedef struct sl_iostream sl_iostream_t;
+
+#endif /* SL_IOSTREAM_H */
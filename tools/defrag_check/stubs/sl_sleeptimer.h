@@ -0,0 +1,12 @@
+// Host stand-in for the Simplicity SDK header, only what the checked modules use
+#ifndef SL_SLEEPTIMER_H
+#define SL_SLEEPTIMER_H
+
+#include <stdint.h>
+
+uint32_t sl_sleeptimer_get_tick_count(void);
+uint32_t sl_sleeptimer_tick_to_ms(uint32_t tick);
+uint64_t sl_sleeptimer_get_tick_count64(void);
+int sl_sleeptimer_tick64_to_ms(uint64_t tick, uint64_t *ms);
+
+#endif /* SL_SLEEPTIMER_H */
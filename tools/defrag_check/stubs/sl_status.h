@@ -0,0 +1,11 @@
+// Host stand-in for the Simplicity SDK header, only what the checked modules use
+#ifndef SL_STATUS_H
+#define SL_STATUS_H
+
+#include <stdint.h>
+
+typedef uint32_t sl_status_t;
+
+#define SL_STATUS_OK    0
+
+#endif /* SL_STATUS_H */
@@ -0,0 +1,456 @@
+/**
+ * @file log_phases.c
+ * @brief Per-phase durations from captured, time-stamped board logs
+ *
+ * Every log line of the boards starts with the sleeptimer time since boot,
+ * "[seconds.milliseconds] ", and `tools/trace_decode` prints trace records
+ * on the same time base. This tool reads such a capture and measures the
+ * time between pairs of lines:
+ *
+ *   trace_decode decode --src peripheral_devices /dev/ttyACM0 | tee run.log
+ *   log_phases run.log
+ *
+ * A phase is a name, a start pattern and an end pattern (POSIX extended
+ * regular expressions). An end line closes the latest start line seen
+ * since the previous end; a second start before the end replaces the first
+ * (e.g. scanning restarted). Time going backwards means the board was reset
+ * and drops the open starts.
+ *
+ * The built-in phases match the messages of both boards; `--list` prints
+ * them in the format of `--phases FILE`, one phase per line:
+ *
+ *   name<TAB>start regex<TAB>end regex
+ *
+ * Phases are tracked as one sequence per capture, so with several
+ * connections in parallel on the Central, durations mix connections.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <getopt.h>
+#include <math.h>
+#include <regex.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_PHASES              32
+#define LINE_MAX_LEN            4096
+
+typedef struct
+{
+    char *name;
+    char *start_src;
+    char *end_src;
+    regex_t start;
+    regex_t end;
+
+    bool open;                  // A start is waiting for its end
+    double open_time;
+    double *samples;            // Durations in seconds
+    size_t count;
+    size_t capacity;
+    size_t restarted;           // Starts replaced before their end
+    size_t unended;             // Starts without end at reset or end of input
+} phase_t;
+
+typedef struct
+{
+    const char *name;
+    const char *start;
+    const char *end;
+} phase_def_t;
+
+// Messages of app.c, ble_fragment_queue.c and their trace sites, both boards
+static const phase_def_t default_phases[] = {
+    {
+        "scan/advertise to connect",
+        "\\[SCAN\\] Started scanning|RESTART scanning|Start scanning other devices"
+        "|\\[BOOT\\] Advertising|Restart advertising",
+        "Connected with that device|Connected to central device",
+    },
+    {
+        "connect to bonded",
+        "Connected with that device|Connected to central device",
+        "\\[BOND\\] Bond success|\\[BOND\\] Bonding process, bonding handle",
+    },
+    {
+        "connect to encrypted",
+        "Connected with that device|Connected to central device",
+        "\\[BOND\\] Link [0-9]+ encrypted",
+    },
+    {
+        "bonded to indication enabled",
+        "\\[BOND\\] Bond success|\\[BOND\\] Bonding process, bonding handle",
+        "Set indication configuration flag|\\[CONN\\] Indication enabled",
+    },
+    {
+        "fragment to confirmation",
+        "Sending fragment [0-9]+/|fragment [0-9]+/[0-9]+ indicated|DONE PUSH data",
+        "Client confirmed indication|fragment [0-9]+/[0-9]+ confirmed"
+        "|Send an? (withheld )?indication confirmation",
+    },
+};
+
+typedef struct
+{
+    phase_t phases[MAX_PHASES];
+    size_t count;
+    double last_time;
+    bool show_events;
+    size_t lines;
+    size_t stamped;
+    size_t resets;
+} analyzer_t;
+
+/*******************************************************************************
+ ***************************   PHASES   ****************************************
+ *******************************************************************************/
+
+static bool phase_add(analyzer_t *a, const char *name, const char *start, const char *end)
+{
+    phase_t *p;
+    char err[256];
+    int rc;
+
+    if(a->count == MAX_PHASES)
+    {
+        fprintf(stderr, "too many phases (max %d)\n", MAX_PHASES);
+        return false;
+    }
+    p = &a->phases[a->count];
+    memset(p, 0, sizeof(*p));
+
+    if((rc = regcomp(&p->start, start, REG_EXTENDED | REG_NOSUB)) != 0)
+    {
+        regerror(rc, &p->start, err, sizeof(err));
+        fprintf(stderr, "%s: start pattern: %s\n", name, err);
+        return false;
+    }
+    if((rc = regcomp(&p->end, end, REG_EXTENDED | REG_NOSUB)) != 0)
+    {
+        regerror(rc, &p->end, err, sizeof(err));
+        fprintf(stderr, "%s: end pattern: %s\n", name, err);
+        regfree(&p->start);
+        return false;
+    }
+    p->name = strdup(name);
+    p->start_src = strdup(start);
+    p->end_src = strdup(end);
+    a->count++;
+    return true;
+}
+
+static bool phases_read(analyzer_t *a, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char line[LINE_MAX_LEN];
+    unsigned n = 0;
+
+    if(f == NULL)
+    {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return false;
+    }
+    while(fgets(line, sizeof(line), f) != NULL)
+    {
+        char *start, *end;
+
+        n++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if(line[0] == '#' || line[0] == '\0')
+        {
+            continue;
+        }
+        if((start = strchr(line, '\t')) == NULL || (end = strchr(start + 1, '\t')) == NULL)
+        {
+            fprintf(stderr, "%s:%u: expected name<TAB>start<TAB>end\n", path, n);
+            fclose(f);
+            return false;
+        }
+        *start++ = '\0';
+        *end++ = '\0';
+        if(!phase_add(a, line, start, end))
+        {
+            fclose(f);
+            return false;
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+static void add_sample(phase_t *p, double seconds)
+{
+    if(p->count == p->capacity)
+    {
+        p->capacity = p->capacity ? p->capacity * 2 : 64;
+        p->samples = realloc(p->samples, p->capacity * sizeof(double));
+        if(p->samples == NULL)
+        {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    p->samples[p->count++] = seconds;
+}
+
+/*******************************************************************************
+ ***************************   INPUT   *****************************************
+ *******************************************************************************/
+
+// Time stamp "[ 12.345]" anywhere in the line (frame bytes may precede it)
+static bool find_stamp(const char *line, double *seconds, const char **text)
+{
+    for(const char *p = strchr(line, '['); p != NULL; p = strchr(p + 1, '['))
+    {
+        const char *q = p + 1;
+        char *end;
+
+        while(*q == ' ')
+        {
+            q++;
+        }
+        if(*q < '0' || *q > '9')
+        {
+            continue;
+        }
+        double value = strtod(q, &end);
+        if(*end == ']' && memchr(q, '.', (size_t)(end - q)) != NULL)
+        {
+            *seconds = value;
+            *text = end + 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void analyze_line(analyzer_t *a, const char *line)
+{
+    double t;
+    const char *text;
+
+    a->lines++;
+    if(!find_stamp(line, &t, &text))
+    {
+        return;
+    }
+    a->stamped++;
+
+    // Time went backwards: the board was reset, open phases never end
+    if(t + 0.0005 < a->last_time)
+    {
+        a->resets++;
+        for(size_t i = 0; i < a->count; i++)
+        {
+            a->phases[i].unended += a->phases[i].open;
+            a->phases[i].open = false;
+        }
+        if(a->show_events)
+        {
+            printf("[%12.3f] --- reset ---\n", t);
+        }
+    }
+    a->last_time = t;
+
+    for(size_t i = 0; i < a->count; i++)
+    {
+        phase_t *p = &a->phases[i];
+
+        // End first: one line may end a phase and start the next one
+        if(p->open && regexec(&p->end, text, 0, NULL, 0) == 0)
+        {
+            add_sample(p, t - p->open_time);
+            p->open = false;
+            if(a->show_events)
+            {
+                printf("[%12.3f] %-30s %10.3f ms\n", p->open_time, p->name, (t - p->open_time) * 1000.0);
+            }
+        }
+        if(regexec(&p->start, text, 0, NULL, 0) == 0)
+        {
+            p->restarted += p->open;
+            p->open = true;
+            p->open_time = t;
+        }
+    }
+}
+
+/*******************************************************************************
+ ***************************   REPORT   ****************************************
+ *******************************************************************************/
+
+static int compare_double(const void *x, const void *y)
+{
+    double a = *(const double *)x;
+    double b = *(const double *)y;
+    return (a > b) - (a < b);
+}
+
+// Nearest-rank percentile of sorted samples
+static double percentile(const double *sorted, size_t n, double pct)
+{
+    size_t rank = (size_t)ceil(pct / 100.0 * (double)n);
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static void report(analyzer_t *a)
+{
+    printf("%zu lines, %zu time-stamped, %zu resets\n", a->lines, a->stamped, a->resets);
+    printf("%-30s %6s %10s %10s %10s %10s %10s %9s\n",
+           "phase", "count", "min ms", "p50 ms", "p90 ms", "max ms", "avg ms", "unended");
+
+    for(size_t i = 0; i < a->count; i++)
+    {
+        phase_t *p = &a->phases[i];
+        size_t unended = p->unended + p->restarted + p->open;
+
+        if(p->count == 0)
+        {
+            printf("%-30s %6d %10s %10s %10s %10s %10s %9zu\n", p->name, 0, "-", "-", "-", "-", "-", unended);
+            continue;
+        }
+
+        double sum = 0;
+        qsort(p->samples, p->count, sizeof(double), compare_double);
+        for(size_t k = 0; k < p->count; k++)
+        {
+            sum += p->samples[k];
+        }
+        printf("%-30s %6zu %10.3f %10.3f %10.3f %10.3f %10.3f %9zu\n",
+               p->name, p->count,
+               p->samples[0] * 1000.0,
+               percentile(p->samples, p->count, 50) * 1000.0,
+               percentile(p->samples, p->count, 90) * 1000.0,
+               p->samples[p->count - 1] * 1000.0,
+               sum / (double)p->count * 1000.0,
+               unended);
+    }
+}
+
+/*******************************************************************************
+ ***************************   MAIN   ******************************************
+ *******************************************************************************/
+
+static void usage(void)
+{
+    fprintf(stderr,
+        "usage: log_phases [options] [capture...]\n"
+        "\n"
+        "Reads time-stamped board logs (stdin without capture) and prints\n"
+        "the duration of each phase.\n"
+        "  --phases FILE  phases to measure instead of the built-in ones\n"
+        "  --list         print the built-in phases in --phases format\n"
+        "  --events       print every measured duration\n");
+}
+
+static bool analyze_file(analyzer_t *a, FILE *f)
+{
+    char line[LINE_MAX_LEN];
+    size_t len = 0;
+    int c;
+
+    // Byte by byte: binary frames in a raw capture may contain anything
+    while((c = fgetc(f)) != EOF)
+    {
+        if(c == '\n' || len == sizeof(line) - 1)
+        {
+            line[len] = '\0';
+            analyze_line(a, line);
+            len = 0;
+        }
+        if(c != '\n' && c != '\r' && c != '\0')
+        {
+            line[len++] = (char)c;
+        }
+    }
+    if(len > 0)
+    {
+        line[len] = '\0';
+        analyze_line(a, line);
+    }
+    return !ferror(f);
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option options[] = {
+        { "phases", required_argument, NULL, 'p' },
+        { "list", no_argument, NULL, 'l' },
+        { "events", no_argument, NULL, 'e' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 },
+    };
+    static analyzer_t a;
+    const char *phases_file = NULL;
+    int opt;
+
+    while((opt = getopt_long(argc, argv, "", options, NULL)) != -1)
+    {
+        switch(opt)
+        {
+            case 'p':
+                phases_file = optarg;
+                break;
+            case 'l':
+                for(size_t i = 0; i < sizeof(default_phases) / sizeof(default_phases[0]); i++)
+                {
+                    printf("%s\t%s\t%s\n", default_phases[i].name, default_phases[i].start, default_phases[i].end);
+                }
+                return 0;
+            case 'e':
+                a.show_events = true;
+                break;
+            default:
+                usage();
+                return 2;
+        }
+    }
+
+    if(phases_file != NULL)
+    {
+        if(!phases_read(&a, phases_file))
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        for(size_t i = 0; i < sizeof(default_phases) / sizeof(default_phases[0]); i++)
+        {
+            if(!phase_add(&a, default_phases[i].name, default_phases[i].start, default_phases[i].end))
+            {
+                return 1;
+            }
+        }
+    }
+
+    if(optind == argc)
+    {
+        analyze_file(&a, stdin);
+    }
+    for(int i = optind; i < argc; i++)
+    {
+        FILE *f = fopen(argv[i], "rb");
+        if(f == NULL)
+        {
+            fprintf(stderr, "%s: %s\n", argv[i], strerror(errno));
+            return 1;
+        }
+        if(!analyze_file(&a, f))
+        {
+            fprintf(stderr, "%s: read error\n", argv[i]);
+        }
+        fclose(f);
+    }
+
+    if(a.show_events)
+    {
+        printf("\n");
+    }
+    report(&a);
+    return 0;
+}
@@ -0,0 +1,155 @@
+/**
+ * @file log_size.c
+ * @brief Host CPU cost of the log profiles on the reassembly path
+ *
+ * Built twice by the Makefile, against objects of the Central's modules
+ * compiled with the verbose (default) and the `LOG_PROFILE_PRODUCTION`
+ * profile. Feeds DEFRAG_MAX_PAYLOAD-byte messages through
+ * defrag_push_data() / defrag_process_fragment() the way the applications
+ * do, with every log category enabled (log.c's default mask), and prints the time per fragment and
+ * the console bytes formatted per fragment. The log lines go through the
+ * firmware's own console ring (app_console.c); the egress stand-in below
+ * sends every segment at once, so only the formatting and the ring copies
+ * are timed, not the UART.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "ble_defragment_rxdata.h"
+#include "app_checksum.h"
+#include "app_console.h"
+#include "app_pools.h"
+#include "app_uart_egress.h"
+
+#define LINK        0
+#define MESSAGES    20000u
+
+#ifdef LOG_PROFILE_PRODUCTION
+#define PROFILE     "production"
+#else
+#define PROFILE     "verbose"
+#endif
+
+uint32_t sl_sleeptimer_get_tick_count(void)
+{
+    return 0;
+}
+
+uint32_t sl_sleeptimer_tick_to_ms(uint32_t tick)
+{
+    return tick;
+}
+
+uint64_t sl_sleeptimer_get_tick_count64(void)
+{
+    return 0;
+}
+
+int sl_sleeptimer_tick64_to_ms(uint64_t tick, uint64_t *ms)
+{
+    *ms = tick;
+    return 0;
+}
+
+// Egress stand-in: a segment is sent as soon as it is handed over
+bool app_uart_egress_is_congested(void)
+{
+    return false;
+}
+
+sl_status_t app_uart_egress_send_buffer(const uint8_t *data, size_t len, app_uart_egress_done_t done)
+{
+    done(data, len);
+    return SL_STATUS_OK;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Split a payload in the firmware's fragment format, return the count
+static uint8_t make_fragments(const uint8_t *payload, uint8_t len,
+                              uint8_t fragments[][DEFRAG_FRAGMENT_LEN], uint8_t *lengths)
+{
+    uint8_t checksum = app_checksum_compute(payload, len);
+    uint8_t count = 0;
+    uint16_t sent = DEFRAG_FRAGMENT_LEN - 1;
+
+    fragments[0][0] = len;
+    memcpy(&fragments[0][1], payload, sent);
+    lengths[count++] = DEFRAG_FRAGMENT_LEN;
+    for(; len - sent >= DEFRAG_FRAGMENT_LEN; sent += DEFRAG_FRAGMENT_LEN)
+    {
+        memcpy(fragments[count], &payload[sent], DEFRAG_FRAGMENT_LEN);
+        lengths[count++] = DEFRAG_FRAGMENT_LEN;
+    }
+    memcpy(fragments[count], &payload[sent], len - sent);
+    fragments[count][len - sent] = checksum;
+    lengths[count++] = (uint8_t)(len - sent + 1);
+    return count;
+}
+
+int main(void)
+{
+    uint8_t payload[DEFRAG_MAX_PAYLOAD];
+    uint8_t fragments[DEFRAG_MAX_PAYLOAD / DEFRAG_FRAGMENT_LEN + 2][DEFRAG_FRAGMENT_LEN];
+    uint8_t lengths[DEFRAG_MAX_PAYLOAD / DEFRAG_FRAGMENT_LEN + 2];
+    app_console_stats_t console;
+    uint64_t best = UINT64_MAX;
+    uint8_t count;
+    unsigned completed = 0;
+
+    for(uint16_t i = 0; i < sizeof(payload); i++)
+    {
+        payload[i] = (uint8_t)i;
+    }
+    count = make_fragments(payload, DEFRAG_MAX_PAYLOAD, fragments, lengths);
+
+    app_console_init();
+    app_pools_init();
+    queue_init();
+    defrag_init();
+
+    for(int batch = 0; batch < 5; batch++)
+    {
+        uint64_t start = now_ns();
+
+        for(unsigned m = 0; m < MESSAGES; m++)
+        {
+            for(uint8_t f = 0; f < count; f++)
+            {
+                uint8_t *data;
+                uint16_t len;
+                bool valid;
+
+                defrag_push_data(LINK, fragments[f], lengths[f]);
+                if(defrag_process_fragment(LINK) == DEFRAG_COMPLETE
+                   && defrag_get_payload(&data, &len, &valid, NULL))
+                {
+                    completed += valid;
+                    defrag_release_payload();
+                }
+                app_console_process();
+            }
+        }
+        uint64_t elapsed = now_ns() - start;
+        if(elapsed < best)
+        {
+            best = elapsed;
+        }
+    }
+
+    app_console_get_stats(&console);
+    printf("%-10s %8.1f ns/fragment %8.1f console bytes/fragment  (%u messages of %u fragments, %u valid)\n",
+           PROFILE,
+           (double)best / ((double)MESSAGES * count),
+           (double)(console.bytes_written + console.bytes_dropped) / (5.0 * MESSAGES * count),
+           MESSAGES, count, completed);
+    return completed == 5 * MESSAGES ? 0 : 1;
+}
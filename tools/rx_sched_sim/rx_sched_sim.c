@@ -0,0 +1,356 @@
+/**
+ * @file rx_sched_sim.c
+ * @brief Host simulation of the Central's RX scheduling with skewed producers
+ *
+ * Several Peripherals stream fragments to the Central at different rates,
+ * and the Central can reassemble fewer fragments per main loop pass than
+ * they offer together. The simulation runs the same offered load through
+ * two receive paths:
+ *
+ *   fifo   the former path: one ring of 31 fragments shared by every link,
+ *          served in arrival order
+ *   drr    the current path: a ring of DEFRAG_LINK_SLOTS fragments per link,
+ *          served by app_drr_pass() (the firmware's own app_drr.c) with a
+ *          quantum of one full indication
+ *
+ * In both, a fragment that finds no room stays with its link and blocks the
+ * link's next one, like a withheld indication confirmation. One tick is one
+ * main loop pass. Per link, the simulation prints the fragments per tick the
+ * Peripheral would send without flow control (demand) and those
+ * reassembled, the max-min fair share of the capacity, and the delay from
+ * reception to reassembly; Jain's index of served / fair share sums up
+ * fairness (1.0 is perfectly fair).
+ *
+ *   rx_sched_sim                               4 links, rates 1 0.5 0.25 0.1
+ *   rx_sched_sim --rates 1,1,0.05 --capacity 1 --ticks 100000 --seed 7
+ */
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "app_drr.h"
+
+#define MAX_LINKS           APP_DRR_MAX_FLOWS
+#define FIFO_SLOTS          31      // Former QUEUE_SLOT - 1
+#define LINK_SLOTS          4       // DEFRAG_LINK_SLOTS
+#define FRAGMENT_LEN        20      // A full indication
+#define QUANTUM             20      // RX_DRR_QUANTUM
+#define DELAY_BUCKETS       4096
+
+typedef struct
+{
+    uint8_t link;
+    uint32_t arrival;
+} fragment_t;
+
+// Ring of fragments
+typedef struct
+{
+    fragment_t entry[FIFO_SLOTS];
+    uint16_t capacity;
+    uint16_t tail;
+    uint16_t count;
+} ring_t;
+
+typedef struct
+{
+    double rate;                    // Fragments offered per tick
+    bool pending;                   // A received fragment waits for room
+    uint32_t pending_arrival;
+    uint64_t served;
+    uint64_t delay_total;
+    uint32_t delay_max;
+    uint32_t delay_hist[DELAY_BUCKETS];
+} link_t;
+
+// State of one run, the context of the DRR callbacks
+typedef struct
+{
+    link_t link[MAX_LINKS];
+    uint8_t links;
+    ring_t fifo;
+    ring_t queue[MAX_LINKS];
+    uint32_t now;
+    uint32_t budget;                // Fragments the consumer may still take this tick
+} sim_t;
+
+static uint64_t rng_state;
+
+static double rng_uniform(void)
+{
+    // xorshift64*
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (double)((rng_state * 2685821657736338717ULL) >> 11) / (double)(1ULL << 53);
+}
+
+static bool ring_push(ring_t *r, fragment_t f)
+{
+    if(r->count >= r->capacity)
+    {
+        return false;
+    }
+    r->entry[(r->tail + r->count) % r->capacity] = f;
+    r->count++;
+    return true;
+}
+
+static fragment_t ring_pop(ring_t *r)
+{
+    fragment_t f = r->entry[r->tail];
+
+    r->tail = (uint16_t)((r->tail + 1) % r->capacity);
+    r->count--;
+    return f;
+}
+
+static void record_service(sim_t *s, fragment_t f)
+{
+    link_t *l = &s->link[f.link];
+    uint32_t delay = s->now - f.arrival;
+
+    l->served++;
+    l->delay_total += delay;
+    if(delay > l->delay_max)
+    {
+        l->delay_max = delay;
+    }
+    l->delay_hist[delay < DELAY_BUCKETS ? delay : DELAY_BUCKETS - 1]++;
+}
+
+static uint32_t delay_percentile(const link_t *l, double p)
+{
+    uint64_t target = (uint64_t)(p * (double)l->served);
+    uint64_t seen = 0;
+
+    for(uint32_t d = 0; d < DELAY_BUCKETS; d++)
+    {
+        seen += l->delay_hist[d];
+        if(seen > target)
+        {
+            return d;
+        }
+    }
+    return DELAY_BUCKETS - 1;
+}
+
+// Receive: new fragments, then retry the ones waiting for room. The start
+// link rotates so no link is always first in the shared ring.
+static void produce(sim_t *s, bool fifo)
+{
+    for(uint8_t n = 0; n < s->links; n++)
+    {
+        uint8_t i = (uint8_t)((s->now + n) % s->links);
+        link_t *l = &s->link[i];
+
+        if(!l->pending && rng_uniform() < l->rate)
+        {
+            l->pending = true;
+            l->pending_arrival = s->now;
+        }
+        if(l->pending)
+        {
+            fragment_t f = { i, l->pending_arrival };
+            if(ring_push(fifo ? &s->fifo : &s->queue[i], f))
+            {
+                l->pending = false;
+            }
+        }
+    }
+}
+
+static uint16_t drr_head(void *ctx, uint8_t flow)
+{
+    sim_t *s = ctx;
+    return s->queue[flow].count ? FRAGMENT_LEN : 0;
+}
+
+static bool drr_serve(void *ctx, uint8_t flow)
+{
+    sim_t *s = ctx;
+
+    if(s->budget == 0)
+    {
+        return false;
+    }
+    s->budget--;
+    record_service(s, ring_pop(&s->queue[flow]));
+    return true;
+}
+
+static void run(sim_t *s, bool fifo, uint32_t ticks, uint32_t capacity)
+{
+    app_drr_t drr;
+
+    s->fifo.capacity = FIFO_SLOTS;
+    for(uint8_t i = 0; i < s->links; i++)
+    {
+        s->queue[i].capacity = LINK_SLOTS;
+    }
+    app_drr_init(&drr, s->links, QUANTUM);
+
+    for(s->now = 0; s->now < ticks; s->now++)
+    {
+        produce(s, fifo);
+        if(fifo)
+        {
+            for(uint32_t n = 0; n < capacity && s->fifo.count > 0; n++)
+            {
+                record_service(s, ring_pop(&s->fifo));
+            }
+        }
+        else
+        {
+            s->budget = capacity;
+            app_drr_pass(&drr, drr_head, drr_serve, s);
+        }
+    }
+}
+
+// Max-min fair share of the capacity (water filling over the offered rates)
+static void fair_shares(const sim_t *s, double capacity, double *fair)
+{
+    bool fixed[MAX_LINKS] = { false };
+    uint8_t left = s->links;
+
+    while(left > 0)
+    {
+        double share = capacity / left;
+        bool changed = false;
+
+        for(uint8_t i = 0; i < s->links; i++)
+        {
+            if(!fixed[i] && s->link[i].rate <= share)
+            {
+                fair[i] = s->link[i].rate;
+                capacity -= fair[i];
+                fixed[i] = true;
+                left--;
+                changed = true;
+            }
+        }
+        if(!changed)
+        {
+            for(uint8_t i = 0; i < s->links; i++)
+            {
+                if(!fixed[i])
+                {
+                    fair[i] = share;
+                }
+            }
+            break;
+        }
+    }
+}
+
+static void report(const char *title, const sim_t *s, uint32_t ticks, uint32_t capacity)
+{
+    double fair[MAX_LINKS];
+    double sum = 0, sum_sq = 0;
+
+    fair_shares(s, capacity, fair);
+    printf("%s\n", title);
+    printf("  link   demand/tick  served/tick  fair share  delay avg   p99   max (ticks)\n");
+    for(uint8_t i = 0; i < s->links; i++)
+    {
+        const link_t *l = &s->link[i];
+        double served = (double)l->served / ticks;
+        double x = (fair[i] > 0) ? served / fair[i] : 1.0;
+
+        sum += x;
+        sum_sq += x * x;
+        printf("  %4u  %12.3f  %11.3f  %10.3f  %9.1f  %4u  %4u\n",
+               i, l->rate, served, fair[i],
+               l->served ? (double)l->delay_total / l->served : 0.0,
+               delay_percentile(l, 0.99), l->delay_max);
+    }
+    printf("  Jain's fairness index %.3f\n\n", (sum * sum) / (s->links * sum_sq));
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [--rates r0,r1,...] [--capacity n] [--ticks n] [--seed n]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option options[] = {
+        { "rates", required_argument, NULL, 'r' },
+        { "capacity", required_argument, NULL, 'c' },
+        { "ticks", required_argument, NULL, 't' },
+        { "seed", required_argument, NULL, 's' },
+        { NULL, 0, NULL, 0 }
+    };
+    static sim_t fifo_sim, drr_sim;
+    double rates[MAX_LINKS] = { 1.0, 0.5, 0.25, 0.1 };
+    uint8_t links = 4;
+    uint32_t capacity = 1;
+    uint32_t ticks = 200000;
+    uint64_t seed = 1;
+    char title[128];
+    int opt;
+
+    while((opt = getopt_long(argc, argv, "", options, NULL)) != -1)
+    {
+        switch(opt)
+        {
+            case 'r':
+            {
+                char *p = optarg;
+                links = 0;
+                while(*p != '\0' && links < MAX_LINKS)
+                {
+                    rates[links++] = strtod(p, &p);
+                    if(*p == ',')
+                    {
+                        p++;
+                    }
+                }
+                break;
+            }
+            case 'c':
+                capacity = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 't':
+                ticks = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if(links == 0 || capacity == 0 || ticks == 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    fifo_sim.links = links;
+    for(uint8_t i = 0; i < links; i++)
+    {
+        fifo_sim.link[i].rate = rates[i];
+    }
+    drr_sim = fifo_sim;
+
+    // Same arrivals for both paths as long as no link is blocked
+    rng_state = seed ? seed : 1;
+    run(&fifo_sim, true, ticks, capacity);
+    rng_state = seed ? seed : 1;
+    run(&drr_sim, false, ticks, capacity);
+
+    printf("%u links, %u fragments reassembled per tick, %u ticks\n\n",
+           links, capacity, ticks);
+    snprintf(title, sizeof(title), "fifo: one ring of %u fragments shared by the links", FIFO_SLOTS);
+    report(title, &fifo_sim, ticks, capacity);
+    snprintf(title, sizeof(title), "drr: a ring of %u fragments per link, quantum %u bytes",
+             LINK_SLOTS, QUANTUM);
+    report(title, &drr_sim, ticks, capacity);
+    return 0;
+}
@@ -0,0 +1,452 @@
+/**
+ * @file scan_bench.c
+ * @brief Host benchmark of the Central's scanner front-end (app_scan_filter.c)
+ *
+ * Replays an advertising trace through the former
+ * find_service_in_advertisement() and through app_scan_filter_check(), and
+ * prints the time per report and per second of trace:
+ *
+ *   scan_bench                         synthetic dense trace (300 devices, 10 s)
+ *   scan_bench --devices 800 --save t  same, and save it
+ *   scan_bench --trace t               replay a saved or captured trace
+ *
+ * Trace format, one report per line:
+ *
+ *   <ms> <address, 12 hex digits> <address type> <rssi> <payload hex>
+ *
+ * Before timing, both paths are checked to agree on every report above the
+ * RSSI threshold. On x86 the time unit is TSC ticks, elsewhere nanoseconds.
+ * A legacy payload is at most 31 bytes, so on an out-of-order host with an
+ * inlined memcmp the original loop is already cheap and the times mostly
+ * show branch prediction; the "parsed" column (payloads walked) is the
+ * portable figure. The on-target cost is the `[STATS] Cycles per scan
+ * report` line of the Central.
+ */
+
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "app_scan_filter.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TIME_UNIT   "cycles"
+static uint64_t ticks(void)
+{
+    return __rdtsc();
+}
+#else
+#define TIME_UNIT   "ns"
+static uint64_t ticks(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+// Firmware symbol used by app_scan_filter_log_stats()
+volatile uint32_t log_category_mask = 0xFFFFFFFFu;
+
+#define RSSI_MIN            (-90)
+
+typedef struct
+{
+    uint32_t ms;
+    uint8_t address[6];
+    uint8_t address_type;
+    int8_t rssi;
+    uint8_t len;
+    uint8_t data[31 + 16];          // The original parser reads past the payload
+} report_t;
+
+typedef struct
+{
+    report_t *items;
+    size_t count;
+    size_t capacity;
+} trace_t;
+
+static const uint8_t usart_service[16] = { 0x40, 0x30, 0x57, 0x13, 0x72, 0xd9, 0x62, 0x83,
+                                           0xdf, 0x4c, 0xb8, 0x80, 0xd9, 0x81, 0x7d, 0x46 };
+
+/*******************************************************************************
+ ***************************   REFERENCE   *************************************
+ *******************************************************************************/
+
+static const uint8_t current_time_service[2] = { 0x05, 0x18 };
+
+// The former find_service_in_advertisement() of app.c, logging removed
+static bool original_find_service(const uint8_t *data, uint8_t len)
+{
+    uint8_t ad_field_length;
+    uint8_t ad_field_type;
+    uint8_t i = 0;
+
+    while (i < len)
+    {
+        ad_field_length = data[i];
+        ad_field_type = data[i + 1];
+
+        if(ad_field_type == 0x06 || ad_field_type == 0x07)
+        {
+            if(memcmp(&data[i+2], current_time_service, 2) == 0)
+            {
+                return true;
+            }
+            else if (memcmp(&data[i+2], usart_service, 16) == 0)
+            {
+                return true;
+            }
+        }
+        i = i + ad_field_length + 1;
+    }
+    return false;
+}
+
+/*******************************************************************************
+ ***************************   TRACE   *****************************************
+ *******************************************************************************/
+
+static report_t *trace_add(trace_t *t)
+{
+    if(t->count == t->capacity)
+    {
+        t->capacity = t->capacity ? t->capacity * 2 : 4096;
+        t->items = realloc(t->items, t->capacity * sizeof(report_t));
+        if(t->items == NULL)
+        {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    memset(&t->items[t->count], 0, sizeof(report_t));
+    return &t->items[t->count++];
+}
+
+static int compare_time(const void *a, const void *b)
+{
+    const report_t *x = a;
+    const report_t *y = b;
+    return (x->ms > y->ms) - (x->ms < y->ms);
+}
+
+static uint32_t rnd(uint32_t n)
+{
+    return (uint32_t)rand() % n;
+}
+
+static void put(report_t *r, const uint8_t *bytes, size_t n)
+{
+    memcpy(&r->data[r->len], bytes, n);
+    r->len = (uint8_t)(r->len + n);
+}
+
+// Payload of one device kind, flags first like most advertisers
+static void make_payload(report_t *r, unsigned kind)
+{
+    static const uint8_t flags[] = { 2, 0x01, 0x06 };
+    uint8_t field[31];
+
+    put(r, flags, sizeof(flags));
+    switch(kind)
+    {
+        case 0:     // Wanted: the Peripheral's advertising data
+            field[0] = 17;
+            field[1] = 0x07;
+            memcpy(&field[2], usart_service, 16);
+            put(r, field, 18);
+            break;
+        case 1:     // Beacon: manufacturer specific data
+            field[0] = 26;
+            field[1] = 0xFF;
+            for(int i = 2; i < 27; i++)
+            {
+                field[i] = (uint8_t)rand();
+            }
+            put(r, field, 27);
+            break;
+        case 2:     // Wearable: 16-bit service list and a short name
+            field[0] = 5;
+            field[1] = 0x03;
+            field[2] = 0x0F; field[3] = 0x18;      // Battery
+            field[4] = 0x9F; field[5] = 0xFE;
+            field[6] = 7;
+            field[7] = 0x09;
+            memcpy(&field[8], "band-42", 6);
+            put(r, field, 14);
+            break;
+        case 3:     // Other 128-bit service, same first bytes as the wanted one
+            field[0] = 17;
+            field[1] = 0x07;
+            memcpy(&field[2], usart_service, 16);
+            field[2 + 4 + rnd(12)] ^= (uint8_t)(1 + rnd(255));
+            put(r, field, 18);
+            break;
+        default:    // Phone: name and TX power
+            field[0] = 10;
+            field[1] = 0x09;
+            memcpy(&field[2], "Galaxy S9", 9);
+            field[11] = 2;
+            field[12] = 0x0A;
+            field[13] = (uint8_t)(rnd(20));
+            put(r, field, 14);
+            break;
+    }
+}
+
+// Dense environment: devices with intervals from 20 ms to 1 s, RSSI from -100 to -40 dBm
+static void trace_generate(trace_t *t, unsigned devices, unsigned seconds)
+{
+    for(unsigned d = 0; d < devices; d++)
+    {
+        report_t proto;
+        unsigned kind = d < 2 ? 0 : 1 + rnd(5);
+        uint32_t interval = 20 + rnd(980);
+        int rssi_mean = d < 2 ? -60 : -100 + (int)rnd(61);
+
+        memset(&proto, 0, sizeof(proto));
+        for(int i = 0; i < 6; i++)
+        {
+            proto.address[i] = (uint8_t)rand();
+        }
+        proto.address_type = (uint8_t)rnd(2);
+        make_payload(&proto, kind);
+
+        for(uint32_t ms = rnd(interval); ms < seconds * 1000u; ms += interval + rnd(10))
+        {
+            report_t *r = trace_add(t);
+            *r = proto;
+            r->ms = ms;
+            r->rssi = (int8_t)(rssi_mean - 4 + (int)rnd(9));
+        }
+    }
+    qsort(t->items, t->count, sizeof(report_t), compare_time);
+}
+
+static bool trace_load(trace_t *t, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char line[256];
+    char addr[16], hex[128];
+    unsigned ms, type;
+    int rssi;
+
+    if(f == NULL)
+    {
+        perror(path);
+        return false;
+    }
+    while(fgets(line, sizeof(line), f) != NULL)
+    {
+        if(sscanf(line, "%u %12s %u %d %127s", &ms, addr, &type, &rssi, hex) != 5)
+        {
+            continue;
+        }
+        report_t *r = trace_add(t);
+        r->ms = ms;
+        r->address_type = (uint8_t)type;
+        r->rssi = (int8_t)rssi;
+        for(int i = 0; i < 6; i++)
+        {
+            sscanf(&addr[2 * i], "%2hhx", &r->address[5 - i]);
+        }
+        for(size_t i = 0; hex[2 * i] != '\0' && hex[2 * i + 1] != '\0' && i < 31; i++)
+        {
+            sscanf(&hex[2 * i], "%2hhx", &r->data[i]);
+            r->len = (uint8_t)(i + 1);
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+static void trace_save(const trace_t *t, const char *path)
+{
+    FILE *f = fopen(path, "w");
+
+    if(f == NULL)
+    {
+        perror(path);
+        exit(1);
+    }
+    for(size_t k = 0; k < t->count; k++)
+    {
+        const report_t *r = &t->items[k];
+        fprintf(f, "%u ", r->ms);
+        for(int i = 5; i >= 0; i--)
+        {
+            fprintf(f, "%02x", r->address[i]);
+        }
+        fprintf(f, " %u %d ", r->address_type, r->rssi);
+        for(int i = 0; i < r->len; i++)
+        {
+            fprintf(f, "%02x", r->data[i]);
+        }
+        fprintf(f, "\n");
+    }
+    fclose(f);
+}
+
+/*******************************************************************************
+ ***************************   BENCHMARK   *************************************
+ *******************************************************************************/
+
+static void filter_setup(int8_t rssi_min)
+{
+    app_scan_filter_config_t config = {
+        .uuids128 = &usart_service,
+        .uuid128_count = 1,
+        .rssi_min = rssi_min,
+    };
+    if(!app_scan_filter_init(&config))
+    {
+        fprintf(stderr, "app_scan_filter_init failed\n");
+        exit(1);
+    }
+}
+
+static size_t run_original(const trace_t *t)
+{
+    size_t matches = 0;
+    for(size_t k = 0; k < t->count; k++)
+    {
+        matches += original_find_service(t->items[k].data, t->items[k].len);
+        __asm__ volatile("" ::: "memory");
+    }
+    return matches;
+}
+
+static size_t run_filter(const trace_t *t, int8_t rssi_min)
+{
+    size_t matches = 0;
+    filter_setup(rssi_min);
+    for(size_t k = 0; k < t->count; k++)
+    {
+        const report_t *r = &t->items[k];
+        matches += app_scan_filter_check(r->rssi, r->data, r->len);
+        __asm__ volatile("" ::: "memory");
+    }
+    return matches;
+}
+
+// Every report the filter lets through must match as the original did
+static size_t check(const trace_t *t)
+{
+    size_t errors = 0;
+
+    filter_setup(RSSI_MIN);
+    for(size_t k = 0; k < t->count; k++)
+    {
+        const report_t *r = &t->items[k];
+        bool expected = original_find_service(r->data, r->len) && r->rssi >= RSSI_MIN;
+        bool got = app_scan_filter_check(r->rssi, r->data, r->len);
+        if(got != expected)
+        {
+            errors++;
+        }
+    }
+    return errors;
+}
+
+static void row(const char *name, const trace_t *t, double seconds, uint64_t best, size_t parsed, size_t matches)
+{
+    printf("%-30s %12.1f %16.0f %9zu %9zu\n", name,
+           (double)best / (double)t->count,
+           (double)best / seconds,
+           parsed,
+           matches);
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option options[] = {
+        { "devices", required_argument, NULL, 'd' },
+        { "seconds", required_argument, NULL, 's' },
+        { "trace", required_argument, NULL, 't' },
+        { "save", required_argument, NULL, 'w' },
+        { NULL, 0, NULL, 0 },
+    };
+    unsigned devices = 300;
+    unsigned seconds = 10;
+    const char *load_path = NULL;
+    const char *save_path = NULL;
+    trace_t trace = { 0 };
+    int opt;
+
+    while((opt = getopt_long(argc, argv, "", options, NULL)) != -1)
+    {
+        switch(opt)
+        {
+            case 'd': devices = (unsigned)atoi(optarg); break;
+            case 's': seconds = (unsigned)atoi(optarg); break;
+            case 't': load_path = optarg; break;
+            case 'w': save_path = optarg; break;
+            default:
+                fprintf(stderr, "usage: scan_bench [--devices N] [--seconds S] [--save FILE] [--trace FILE]\n");
+                return 2;
+        }
+    }
+
+    srand(1);
+    if(load_path != NULL ? !trace_load(&trace, load_path) : (trace_generate(&trace, devices, seconds), false))
+    {
+        return 1;
+    }
+    if(trace.count == 0)
+    {
+        fprintf(stderr, "empty trace\n");
+        return 1;
+    }
+    if(save_path != NULL)
+    {
+        trace_save(&trace, save_path);
+    }
+
+    double span = (double)(trace.items[trace.count - 1].ms - trace.items[0].ms) / 1000.0;
+    if(span <= 0)
+    {
+        span = 1;
+    }
+    printf("trace: %zu reports over %.1f s (%.0f reports/s)\n", trace.count, span, (double)trace.count / span);
+
+    size_t errors = check(&trace);
+    if(errors != 0)
+    {
+        fprintf(stderr, "%zu reports where the filter disagrees with the original parser\n", errors);
+        return 1;
+    }
+    printf("check: filter agrees with the original parser on every report at or above %d dBm\n\n", RSSI_MIN);
+
+    printf("%-30s %12s %16s %9s %9s\n", "path", TIME_UNIT "/report", TIME_UNIT "/s of trace", "parsed", "matches");
+    for(int path = 0; path < 3; path++)
+    {
+        static const char *names[] = { "original parser", "filter, walk only", "filter, RSSI gate + walk" };
+        uint64_t best = UINT64_MAX;
+        size_t matches = 0;
+
+        for(int batch = 0; batch < 20; batch++)
+        {
+            uint64_t start = ticks();
+            matches = path == 0 ? run_original(&trace)
+                    : run_filter(&trace, path == 1 ? INT8_MIN : RSSI_MIN);
+            uint64_t elapsed = ticks() - start;
+            if(elapsed < best)
+            {
+                best = elapsed;
+            }
+        }
+        app_scan_filter_stats_t stats;
+        app_scan_filter_get_stats(&stats);
+        row(names[path], &trace, span, best, path == 0 ? trace.count : stats.parsed, matches);
+    }
+
+    printf("\n");
+    app_scan_filter_log_stats();
+    return 0;
+}
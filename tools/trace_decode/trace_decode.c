@@ -0,0 +1,1002 @@
+/**
+ * @file trace_decode.c
+ * @brief Host decoder for the firmware's binary trace (`app_trace.h`)
+ *
+ * The boards record `APP_TRACE(fmt, ...)` sites as [file ID, line, raw
+ * arguments] and send them as trace control frames, mixed with log text and
+ * other frames on the VCOM UART. This tool rebuilds readable lines:
+ *
+ *   trace_decode table <project dir>...                 print the string table
+ *   trace_decode decode --src <project dir> [input]     decode a capture or a tty
+ *
+ * The string table is generated from the sources: every .c file of a
+ * project directory that defines `APP_TRACE_FILE_ID` contributes its
+ * `APP_TRACE("literal", ...)` sites, keyed by file ID and the line of the
+ * macro name (the `__LINE__` the compiler records). Generate it from the
+ * sources the image was built from, or save it next to the image with
+ * `table` and decode with `--table`.
+ *
+ * Log text is passed through line by line; trace lines are printed with the
+ * time since boot, converted with the timer frequency announced by the sync
+ * records. Log lines carry the same sleeptimer time ("[s.ms] "), so both
+ * can be read on one time line (see `tools/log_phases`). Gaps in the record
+ * sequence numbers are reported.
+ *
+ * The frame codec is the firmware's own `app_uart_frame.c`.
+ */
+
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include "app_uart_frame.h"
+#include "app_trace.h"
+
+#define FRAME_MAX_COBS          APP_UART_FRAME_COBS_SIZE(APP_UART_FRAME_MAX_PAYLOAD)
+#define TEXT_MAX_LINE           512
+#define DEFAULT_TIMER_HZ        32768u
+
+#define TRACE_LINE(header)      ((header) & 0xFFFu)
+#define TRACE_FILE(header)      (((header) >> 12) & 0xFFu)
+#define TRACE_NARGS(header)     (((header) >> 20) & 0x7u)
+#define TRACE_SEQ(header)       ((header) >> 24)
+#define TRACE_ID(header)        ((header) & 0xFFFFFu)
+
+// One trace site of the string table
+typedef struct
+{
+    uint32_t id;                // File ID << 12 | line
+    char *where;                // "file.c:line"
+    char *fmt;
+} trace_site_t;
+
+typedef struct
+{
+    trace_site_t *sites;
+    size_t count;
+    size_t capacity;
+} trace_table_t;
+
+typedef enum
+{
+    RX_TEXT,
+    RX_FRAME,
+    RX_FRAME_SKIP,
+} rx_state_t;
+
+// Decoder state across reads
+typedef struct
+{
+    rx_state_t state;
+    uint8_t buf[FRAME_MAX_COBS];
+    size_t len;
+    char text[TEXT_MAX_LINE];
+    size_t text_len;
+    bool show_text;
+    bool show_frames;
+
+    const trace_table_t *table;
+    uint32_t timer_hz;
+    bool started;
+    uint8_t next_seq;
+    uint32_t last_stamp;
+    uint64_t ticks;             // Unwrapped time of the last record
+    uint64_t records;
+    uint64_t lost;
+    uint64_t unknown;
+    uint64_t frames_bad;
+} decoder_t;
+
+/*******************************************************************************
+ ***************************   STRING TABLE   **********************************
+ *******************************************************************************/
+
+static void table_add(trace_table_t *table, uint32_t id, const char *where, const char *fmt)
+{
+    for(size_t i = 0; i < table->count; i++)
+    {
+        if(table->sites[i].id == id)
+        {
+            fprintf(stderr, "warning: trace ID 0x%05x used by %s and %s, keeping the first\n",
+                    id, table->sites[i].where, where);
+            return;
+        }
+    }
+    if(table->count == table->capacity)
+    {
+        table->capacity = table->capacity ? table->capacity * 2 : 64;
+        table->sites = realloc(table->sites, table->capacity * sizeof(trace_site_t));
+        if(table->sites == NULL)
+        {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    table->sites[table->count++] = (trace_site_t){ id, strdup(where), strdup(fmt) };
+}
+
+static const trace_site_t *table_find(const trace_table_t *table, uint32_t id)
+{
+    for(size_t i = 0; i < table->count; i++)
+    {
+        if(table->sites[i].id == id)
+        {
+            return &table->sites[i];
+        }
+    }
+    return NULL;
+}
+
+// Skip blanks and comments, counting lines
+static const char *skip_space(const char *p, unsigned *line)
+{
+    for(;;)
+    {
+        if(*p == '\n')
+        {
+            (*line)++;
+            p++;
+        }
+        else if(*p == ' ' || *p == '\t' || *p == '\r' || *p == '\f' || *p == '\v')
+        {
+            p++;
+        }
+        else if(p[0] == '\\' && p[1] == '\n')
+        {
+            (*line)++;
+            p += 2;
+        }
+        else if(p[0] == '/' && p[1] == '/')
+        {
+            while(*p != '\0' && *p != '\n')
+            {
+                p++;
+            }
+        }
+        else if(p[0] == '/' && p[1] == '*')
+        {
+            p += 2;
+            while(*p != '\0' && !(p[0] == '*' && p[1] == '/'))
+            {
+                *line += (*p == '\n');
+                p++;
+            }
+            p += (*p != '\0') ? 2 : 0;
+        }
+        else
+        {
+            return p;
+        }
+    }
+}
+
+// Append one string literal (p at the opening quote) to out, return the end
+static const char *read_literal(const char *p, char *out, size_t *out_len, size_t out_size)
+{
+    p++;
+    while(*p != '\0' && *p != '"' && *p != '\n')
+    {
+        int c = (unsigned char)*p++;
+
+        if(c == '\\')
+        {
+            c = (unsigned char)*p++;
+            switch(c)
+            {
+                case 'n': c = '\n'; break;
+                case 'r': c = '\r'; break;
+                case 't': c = '\t'; break;
+                case 'a': c = '\a'; break;
+                case 'b': c = '\b'; break;
+                case 'f': c = '\f'; break;
+                case 'v': c = '\v'; break;
+                case 'x':
+                    c = (int)strtoul(p, (char **)&p, 16);
+                    break;
+                default:
+                    if(c >= '0' && c <= '7')
+                    {
+                        c -= '0';
+                        for(int i = 0; i < 2 && *p >= '0' && *p <= '7'; i++)
+                        {
+                            c = c * 8 + (*p++ - '0');
+                        }
+                    }
+                    break;  // \\ \" \' \? map to themselves
+            }
+        }
+        if(*out_len + 1 < out_size)
+        {
+            out[(*out_len)++] = (char)c;
+        }
+    }
+    out[*out_len] = '\0';
+    return (*p == '"') ? p + 1 : p;
+}
+
+static bool is_ident(int c)
+{
+    return c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+}
+
+static char *read_file(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    char *data = NULL;
+    size_t len = 0;
+    size_t cap = 0;
+
+    if(f == NULL)
+    {
+        return NULL;
+    }
+    for(;;)
+    {
+        if(cap - len < 4096)
+        {
+            cap = cap ? cap * 2 : 65536;
+            data = realloc(data, cap);
+            if(data == NULL)
+            {
+                perror("realloc");
+                exit(1);
+            }
+        }
+        size_t n = fread(data + len, 1, cap - len - 1, f);
+        len += n;
+        if(n == 0)
+        {
+            break;
+        }
+    }
+    fclose(f);
+    data[len] = '\0';
+    return data;
+}
+
+/* One pass over a source file. The first pass (table NULL) only looks for
+   APP_TRACE_FILE_ID, which may be defined below the first trace site. */
+static void scan_pass(trace_table_t *table, const char *src, const char *name, long *file_id)
+{
+    const char *p = src;
+    unsigned line = 1;
+    bool line_start = true;
+
+    while(*p != '\0')
+    {
+        unsigned before = line;
+        const char *q = skip_space(p, &line);
+        line_start = line_start || (line != before);
+        p = q;
+        if(*p == '\0')
+        {
+            break;
+        }
+
+        if(*p == '#' && line_start)
+        {
+            // Directive: only the file ID matters, the rest is skipped with its continuations
+            unsigned dline = line;
+            const char *d = skip_space(p + 1, &dline);
+            if(strncmp(d, "define", 6) == 0)
+            {
+                d = skip_space(d + 6, &dline);
+                if(table == NULL && strncmp(d, "APP_TRACE_FILE_ID", 17) == 0 && !is_ident(d[17]))
+                {
+                    *file_id = strtol(d + 17, NULL, 0);
+                }
+            }
+            while(*p != '\0' && *p != '\n')
+            {
+                if(p[0] == '\\' && p[1] == '\n')
+                {
+                    line++;
+                    p++;
+                }
+                p++;
+            }
+            continue;
+        }
+        line_start = false;
+
+        if(*p == '"' || *p == '\'')
+        {
+            char quote = *p++;
+            while(*p != '\0' && *p != quote && *p != '\n')
+            {
+                p += (p[0] == '\\' && p[1] != '\0') ? 2 : 1;
+            }
+            p += (*p == quote);
+            continue;
+        }
+        if(!is_ident((unsigned char)*p))
+        {
+            p++;
+            continue;
+        }
+
+        const char *ident = p;
+        while(is_ident((unsigned char)*p))
+        {
+            p++;
+        }
+        if(table == NULL || p - ident != 9 || strncmp(ident, "APP_TRACE", 9) != 0)
+        {
+            continue;
+        }
+
+        unsigned site_line = line;
+        unsigned arg_line = line;
+        const char *a = skip_space(p, &arg_line);
+        if(*a != '(')
+        {
+            continue;
+        }
+        a = skip_space(a + 1, &arg_line);
+        if(*a != '"')
+        {
+            fprintf(stderr, "%s:%u: format is not a string literal, site skipped\n", name, site_line);
+            continue;
+        }
+
+        char fmt[1024];
+        size_t fmt_len = 0;
+        while(*a == '"')
+        {
+            a = read_literal(a, fmt, &fmt_len, sizeof(fmt));
+            a = skip_space(a, &arg_line);
+        }
+        p = a;
+        line = arg_line;
+
+        if(*file_id < 0 || *file_id > 255)
+        {
+            fprintf(stderr, "%s:%u: no valid APP_TRACE_FILE_ID, site skipped\n", name, site_line);
+            continue;
+        }
+        if(site_line > 0xFFF)
+        {
+            fprintf(stderr, "%s:%u: beyond line 4095, site skipped\n", name, site_line);
+            continue;
+        }
+
+        char where[512];
+        snprintf(where, sizeof(where), "%s:%u", name, site_line);
+        table_add(table, ((uint32_t)*file_id << 12) | site_line, where, fmt);
+    }
+}
+
+// Collect the APP_TRACE sites of one source file
+static void scan_source(trace_table_t *table, const char *path, const char *name)
+{
+    char *src = read_file(path);
+    long file_id = -1;
+
+    if(src == NULL)
+    {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return;
+    }
+    scan_pass(NULL, src, name, &file_id);
+    scan_pass(table, src, name, &file_id);
+    free(src);
+}
+
+static int compare_names(const struct dirent **a, const struct dirent **b)
+{
+    return strcmp((*a)->d_name, (*b)->d_name);
+}
+
+static bool scan_directory(trace_table_t *table, const char *dir)
+{
+    struct dirent **entries;
+    int n = scandir(dir, &entries, NULL, compare_names);
+
+    if(n < 0)
+    {
+        fprintf(stderr, "%s: %s\n", dir, strerror(errno));
+        return false;
+    }
+    for(int i = 0; i < n; i++)
+    {
+        size_t len = strlen(entries[i]->d_name);
+        if(len > 2 && strcmp(&entries[i]->d_name[len - 2], ".c") == 0)
+        {
+            char path[4096];
+            snprintf(path, sizeof(path), "%s/%s", dir, entries[i]->d_name);
+            scan_source(table, path, entries[i]->d_name);
+        }
+        free(entries[i]);
+    }
+    free(entries);
+    return true;
+}
+
+static void print_escaped(FILE *out, const char *s)
+{
+    for(; *s != '\0'; s++)
+    {
+        switch(*s)
+        {
+            case '\n': fputs("\\n", out); break;
+            case '\r': fputs("\\r", out); break;
+            case '\t': fputs("\\t", out); break;
+            case '\\': fputs("\\\\", out); break;
+            default: fputc(*s, out); break;
+        }
+    }
+}
+
+static void table_write(const trace_table_t *table, FILE *out)
+{
+    fprintf(out, "# id\tsite\tformat\n");
+    for(size_t i = 0; i < table->count; i++)
+    {
+        fprintf(out, "0x%05x\t%s\t", table->sites[i].id, table->sites[i].where);
+        print_escaped(out, table->sites[i].fmt);
+        fputc('\n', out);
+    }
+}
+
+static bool table_read(trace_table_t *table, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char line[2048];
+
+    if(f == NULL)
+    {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return false;
+    }
+    while(fgets(line, sizeof(line), f) != NULL)
+    {
+        char *where, *fmt, *end;
+
+        line[strcspn(line, "\n")] = '\0';
+        if(line[0] == '#' || line[0] == '\0'
+           || (where = strchr(line, '\t')) == NULL || (fmt = strchr(where + 1, '\t')) == NULL)
+        {
+            continue;
+        }
+        *where++ = '\0';
+        *fmt++ = '\0';
+
+        // Undo print_escaped()
+        char *w = fmt;
+        for(char *r = fmt; *r != '\0'; r++)
+        {
+            if(r[0] == '\\' && r[1] != '\0')
+            {
+                r++;
+                *w++ = (*r == 'n') ? '\n' : (*r == 'r') ? '\r' : (*r == 't') ? '\t' : *r;
+            }
+            else
+            {
+                *w++ = *r;
+            }
+        }
+        *w = '\0';
+        table_add(table, (uint32_t)strtoul(line, &end, 0), where, fmt);
+    }
+    fclose(f);
+    return true;
+}
+
+/*******************************************************************************
+ ***************************   FORMATTING   ************************************
+ *******************************************************************************/
+
+// printf() with 32-bit raw arguments, as the device recorded them
+static void render(const char *fmt, const uint32_t *args, unsigned nargs, char *out, size_t out_size)
+{
+    size_t pos = 0;
+    unsigned next = 0;
+
+#define OUT_LEFT    (pos < out_size ? out_size - pos : 0)
+#define NEXT_ARG    (next < nargs ? args[next++] : 0)
+
+    while(*fmt != '\0' && pos + 1 < out_size)
+    {
+        if(*fmt != '%')
+        {
+            out[pos++] = *fmt++;
+            continue;
+        }
+        if(fmt[1] == '%')
+        {
+            out[pos++] = '%';
+            fmt += 2;
+            continue;
+        }
+
+        // Rebuild the conversion without its length modifier
+        char spec[32];
+        size_t s = 0;
+        int star[2];
+        int stars = 0;
+
+        spec[s++] = *fmt++;
+        while(strchr("-+ #0", *fmt) != NULL && *fmt != '\0' && s < 8)
+        {
+            spec[s++] = *fmt++;
+        }
+        for(int part = 0; part < 2; part++)
+        {
+            if(part == 1)
+            {
+                if(*fmt != '.')
+                {
+                    break;
+                }
+                spec[s++] = *fmt++;
+            }
+            if(*fmt == '*')
+            {
+                star[stars++] = (int32_t)NEXT_ARG;
+                spec[s++] = *fmt++;
+            }
+            while(*fmt >= '0' && *fmt <= '9' && s < sizeof(spec) - 4)
+            {
+                spec[s++] = *fmt++;
+            }
+        }
+
+        int longs = 0;
+        int shorts = 0;
+        while(strchr("hlLjzt", *fmt) != NULL && *fmt != '\0')
+        {
+            longs += (*fmt == 'l' || *fmt == 'j' || *fmt == 'L');
+            shorts += (*fmt == 'h');
+            fmt++;
+        }
+        char conv = *fmt;
+        if(conv == '\0')
+        {
+            break;
+        }
+        fmt++;
+
+        uint32_t v = NEXT_ARG;
+        int n = 0;
+        spec[s++] = conv;
+        spec[s] = '\0';
+
+        if(longs >= 2)
+        {
+            n = snprintf(out + pos, OUT_LEFT, "<64-bit 0x%08" PRIx32 ">", v);
+        }
+        else if(conv == 'd' || conv == 'i')
+        {
+            int value = (shorts == 2) ? (signed char)v : (shorts == 1) ? (short)v : (int32_t)v;
+            n = (stars == 2) ? snprintf(out + pos, OUT_LEFT, spec, star[0], star[1], value)
+              : (stars == 1) ? snprintf(out + pos, OUT_LEFT, spec, star[0], value)
+              : snprintf(out + pos, OUT_LEFT, spec, value);
+        }
+        else if(conv == 'u' || conv == 'x' || conv == 'X' || conv == 'o' || conv == 'c')
+        {
+            unsigned value = (shorts == 2) ? (uint8_t)v : (shorts == 1) ? (uint16_t)v : v;
+            n = (stars == 2) ? snprintf(out + pos, OUT_LEFT, spec, star[0], star[1], value)
+              : (stars == 1) ? snprintf(out + pos, OUT_LEFT, spec, star[0], value)
+              : snprintf(out + pos, OUT_LEFT, spec, value);
+        }
+        else if(conv == 'p')
+        {
+            n = snprintf(out + pos, OUT_LEFT, "0x%08" PRIx32, v);
+        }
+        else if(conv == 's')
+        {
+            n = snprintf(out + pos, OUT_LEFT, "<string at 0x%08" PRIx32 ">", v);
+        }
+        else
+        {
+            n = snprintf(out + pos, OUT_LEFT, "<%%%c 0x%08" PRIx32 ">", conv, v);
+        }
+        pos += (n > 0) ? (size_t)n : 0;
+    }
+    if(pos >= out_size)
+    {
+        pos = out_size - 1;
+    }
+    out[pos] = '\0';
+
+#undef OUT_LEFT
+#undef NEXT_ARG
+}
+
+/*******************************************************************************
+ ***************************   STREAM DECODER   ********************************
+ *******************************************************************************/
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void flush_text(decoder_t *d)
+{
+    if(d->text_len > 0)
+    {
+        if(d->show_text)
+        {
+            fwrite(d->text, 1, d->text_len, stdout);
+        }
+        d->text_len = 0;
+    }
+}
+
+static void emit(decoder_t *d, const char *where, const char *msg)
+{
+    double seconds = (double)d->ticks / (double)d->timer_hz;
+
+    printf("[%12.6f] %-28s %s\n", seconds, where, msg);
+}
+
+static void decode_record(decoder_t *d, uint32_t header, uint32_t stamp, const uint32_t *args)
+{
+    unsigned nargs = TRACE_NARGS(header);
+    uint8_t seq = (uint8_t)TRACE_SEQ(header);
+    bool sync = (TRACE_ID(header) == 0);
+    char msg[1024];
+
+    // A sync record with sequence 0 follows app_trace_init(), maybe a reset
+    if(sync && seq == 0)
+    {
+        d->started = false;
+    }
+    if(!d->started)
+    {
+        d->started = true;
+        d->ticks = stamp;       // Time since boot, unless 32 bits already wrapped
+    }
+    else
+    {
+        uint8_t gap = (uint8_t)(seq - d->next_seq);
+        if(gap != 0)
+        {
+            d->lost += gap;
+            snprintf(msg, sizeof(msg), "*** %u trace records lost ***", gap);
+            emit(d, "", msg);
+        }
+        d->ticks += (uint32_t)(stamp - d->last_stamp);
+    }
+    d->next_seq = (uint8_t)(seq + 1);
+    d->last_stamp = stamp;
+    d->records++;
+
+    if(sync)
+    {
+        if(nargs >= 1 && args[0] != 0 && args[0] != d->timer_hz)
+        {
+            d->timer_hz = args[0];
+            snprintf(msg, sizeof(msg), "trace sync, timer %" PRIu32 " Hz", d->timer_hz);
+            emit(d, "", msg);
+        }
+        return;
+    }
+
+    const trace_site_t *site = table_find(d->table, TRACE_ID(header));
+    if(site == NULL)
+    {
+        char where[32];
+        size_t n = 0;
+
+        d->unknown++;
+        snprintf(where, sizeof(where), "file %u line %u", TRACE_FILE(header), TRACE_LINE(header));
+        n += (size_t)snprintf(msg, sizeof(msg), "<unknown site>");
+        for(unsigned i = 0; i < nargs; i++)
+        {
+            n += (size_t)snprintf(msg + n, sizeof(msg) - n, " 0x%08" PRIx32, args[i]);
+        }
+        emit(d, where, msg);
+        return;
+    }
+    render(site->fmt, args, nargs, msg, sizeof(msg));
+    emit(d, site->where, msg);
+}
+
+static void decode_frame(decoder_t *d, const uint8_t *payload, size_t len, bool is_control)
+{
+    if(!is_control || len == 0 || payload[0] != APP_TRACE_FRAME_TAG)
+    {
+        if(d->show_frames)
+        {
+            char msg[64];
+            snprintf(msg, sizeof(msg), "<%s frame, %zu bytes>", is_control ? "control" : "data", len);
+            emit(d, "", msg);
+        }
+        return;
+    }
+
+    size_t pos = 1;
+    while(pos + 8 <= len)
+    {
+        uint32_t header = get_u32(&payload[pos]);
+        unsigned nargs = TRACE_NARGS(header);
+        uint32_t args[APP_TRACE_MAX_ARGS + 3] = {0};
+
+        if(nargs > APP_TRACE_MAX_ARGS || pos + 8 + 4 * nargs > len)
+        {
+            d->frames_bad++;
+            return;
+        }
+        for(unsigned i = 0; i < nargs; i++)
+        {
+            args[i] = get_u32(&payload[pos + 8 + 4 * i]);
+        }
+        decode_record(d, header, get_u32(&payload[pos + 4]), args);
+        pos += 8 + 4 * nargs;
+    }
+}
+
+static void decode_bytes(decoder_t *d, const uint8_t *data, size_t n)
+{
+    for(size_t i = 0; i < n; i++)
+    {
+        uint8_t c = data[i];
+
+        switch(d->state)
+        {
+            case RX_TEXT:
+                if(c == APP_UART_FRAME_DELIMITER)
+                {
+                    d->state = RX_FRAME;
+                    d->len = 0;
+                    break;
+                }
+                d->text[d->text_len++] = (char)c;
+                if(c == '\n' || d->text_len == sizeof(d->text))
+                {
+                    flush_text(d);
+                }
+                break;
+
+            case RX_FRAME:
+                if(c != APP_UART_FRAME_DELIMITER)
+                {
+                    if(d->len < sizeof(d->buf))
+                    {
+                        d->buf[d->len++] = c;
+                    }
+                    else
+                    {
+                        d->frames_bad++;
+                        d->state = RX_FRAME_SKIP;
+                    }
+                    break;
+                }
+                if(d->len == 0)
+                {
+                    break;      // Back-to-back delimiters
+                }
+
+                size_t payload_len;
+                bool is_control;
+                if(app_uart_frame_decode(d->buf, d->len, &payload_len, &is_control))
+                {
+                    decode_frame(d, d->buf, payload_len, is_control);
+                }
+                else
+                {
+                    d->frames_bad++;
+                }
+                d->state = RX_TEXT;
+                break;
+
+            case RX_FRAME_SKIP:
+                if(c == APP_UART_FRAME_DELIMITER)
+                {
+                    d->state = RX_TEXT;
+                }
+                break;
+        }
+    }
+    fflush(stdout);
+}
+
+/*******************************************************************************
+ ***************************   INPUT   *****************************************
+ *******************************************************************************/
+
+static bool baud_to_speed(unsigned baud, speed_t *speed)
+{
+    static const struct
+    {
+        unsigned baud;
+        speed_t speed;
+    } table[] = {
+        { 9600, B9600 }, { 19200, B19200 }, { 38400, B38400 }, { 57600, B57600 },
+        { 115200, B115200 }, { 230400, B230400 }, { 460800, B460800 },
+        { 921600, B921600 }, { 1000000, B1000000 }, { 1500000, B1500000 },
+        { 2000000, B2000000 }, { 3000000, B3000000 },
+    };
+
+    for(size_t i = 0; i < sizeof(table) / sizeof(table[0]); i++)
+    {
+        if(table[i].baud == baud)
+        {
+            *speed = table[i].speed;
+            return true;
+        }
+    }
+    return false;
+}
+
+// A tty is switched to raw mode; files and pipes are read as they are
+static int open_input(const char *path, unsigned baud, bool rtscts)
+{
+    struct termios t;
+    speed_t speed;
+    int fd = (strcmp(path, "-") == 0) ? STDIN_FILENO : open(path, O_RDONLY | O_NOCTTY);
+
+    if(fd < 0)
+    {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if(!isatty(fd) || fd == STDIN_FILENO)
+    {
+        return fd;
+    }
+    if(tcgetattr(fd, &t) != 0 || !baud_to_speed(baud, &speed))
+    {
+        fprintf(stderr, "%s: cannot configure %u baud\n", path, baud);
+        close(fd);
+        return -1;
+    }
+    cfmakeraw(&t);
+    t.c_cflag |= CLOCAL | CREAD;
+    if(rtscts)
+    {
+        t.c_cflag |= CRTSCTS;
+    }
+    else
+    {
+        t.c_cflag &= ~CRTSCTS;
+    }
+    cfsetispeed(&t, speed);
+    cfsetospeed(&t, speed);
+    if(tcsetattr(fd, TCSANOW, &t) != 0)
+    {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*******************************************************************************
+ ***************************   MAIN   ******************************************
+ *******************************************************************************/
+
+static void usage(void)
+{
+    fprintf(stderr,
+        "usage: trace_decode table <project dir>...\n"
+        "       trace_decode decode (--src <project dir> | --table <file>)... [options] [input]\n"
+        "\n"
+        "input is a capture file, a tty or - for stdin (default)\n"
+        "  --baud N       tty baud rate (default 115200)\n"
+        "  --rtscts       enable RTS/CTS flow control on the tty\n"
+        "  --hz N         timer frequency until a sync record arrives (default 32768)\n"
+        "  --no-text      hide the log text between frames\n"
+        "  --frames       show other frames as one line each\n");
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option options[] = {
+        { "src", required_argument, NULL, 's' },
+        { "table", required_argument, NULL, 't' },
+        { "baud", required_argument, NULL, 'b' },
+        { "rtscts", no_argument, NULL, 'r' },
+        { "hz", required_argument, NULL, 'h' },
+        { "no-text", no_argument, NULL, 'n' },
+        { "frames", no_argument, NULL, 'f' },
+        { NULL, 0, NULL, 0 },
+    };
+    trace_table_t table = {0};
+    static decoder_t d;
+    unsigned baud = 115200;
+    bool rtscts = false;
+    int opt;
+
+    if(argc < 2)
+    {
+        usage();
+        return 2;
+    }
+
+    if(strcmp(argv[1], "table") == 0)
+    {
+        if(argc < 3)
+        {
+            usage();
+            return 2;
+        }
+        for(int i = 2; i < argc; i++)
+        {
+            if(!scan_directory(&table, argv[i]))
+            {
+                return 1;
+            }
+        }
+        table_write(&table, stdout);
+        return 0;
+    }
+    if(strcmp(argv[1], "decode") != 0)
+    {
+        usage();
+        return 2;
+    }
+
+    d.timer_hz = DEFAULT_TIMER_HZ;
+    d.show_text = true;
+    optind = 2;
+    while((opt = getopt_long(argc, argv, "", options, NULL)) != -1)
+    {
+        switch(opt)
+        {
+            case 's':
+                if(!scan_directory(&table, optarg))
+                {
+                    return 1;
+                }
+                break;
+            case 't':
+                if(!table_read(&table, optarg))
+                {
+                    return 1;
+                }
+                break;
+            case 'b': baud = (unsigned)strtoul(optarg, NULL, 10); break;
+            case 'r': rtscts = true; break;
+            case 'h': d.timer_hz = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'n': d.show_text = false; break;
+            case 'f': d.show_frames = true; break;
+            default:
+                usage();
+                return 2;
+        }
+    }
+    if(table.count == 0 || d.timer_hz == 0)
+    {
+        fprintf(stderr, "no trace sites: give --src or --table\n");
+        return 2;
+    }
+
+    int fd = open_input(optind < argc ? argv[optind] : "-", baud, rtscts);
+    if(fd < 0)
+    {
+        return 1;
+    }
+
+    d.table = &table;
+    for(;;)
+    {
+        uint8_t buf[4096];
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if(n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if(n <= 0)
+        {
+            break;
+        }
+        decode_bytes(&d, buf, (size_t)n);
+    }
+    flush_text(&d);
+
+    fprintf(stderr, "%" PRIu64 " records, %" PRIu64 " lost, %" PRIu64 " unknown sites, %" PRIu64 " bad frames\n",
+            d.records, d.lost, d.unknown, d.frames_bad);
+    return 0;
+}
@@ -0,0 +1,1217 @@
+/**
+ * @file uart_loadgen.c
+ * @brief Host UART load generator and goodput meter for the USART to BLE link
+ *
+ * Drives the Peripheral's UART input at a controlled rate and measures what
+ * comes out of the Central's UART:
+ *
+ *   uart_loadgen run --tx <peripheral tty> --rx <central tty> [options]
+ *
+ * Every message carries its sequence number ("<seq>:" followed by padding or
+ * a recorded line), sent as a text line or as a binary frame
+ * (`app_uart_frame.h`). The Central forwards each payload as a binary frame;
+ * the receiver decodes them, ignores the log text around them and reports
+ * goodput, loss, duplicates, reordering, corruption and latency percentiles.
+ *
+ * Without boards, `bridge` stands in for the Peripheral, the BLE hop and the
+ * Central on two pseudo-terminals:
+ *
+ *   uart_loadgen bridge [hop options]       prints the two pty paths
+ *   uart_loadgen run --loopback [options]   runs a bridge in a child process
+ *
+ * The bridge frames its input like the Peripheral ingress (lines up to 80
+ * bytes, COBS frames), holds at most --hop-queue messages (it stops reading
+ * when full, as the Peripheral does through RTS), delays them by the hop
+ * rate and latency, optionally loses some, and writes them out like the
+ * Central: a log line followed by a binary frame.
+ *
+ * The frame codec is the firmware's own `app_uart_frame.c`.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
+#include <poll.h>
+#include <pty.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "app_uart_frame.h"
+
+// Same limit as APP_UART_INGRESS_MAX_LINE on the Peripheral
+#define TEXT_MAX_LINE           80
+#define FRAME_MAX_COBS          APP_UART_FRAME_COBS_SIZE(APP_UART_FRAME_MAX_PAYLOAD)
+#define MESSAGE_MAX             APP_UART_FRAME_MAX_PAYLOAD
+#define WIRE_MAX                (APP_UART_FRAME_ENCODED_SIZE(MESSAGE_MAX) + 64)
+
+#define MAX_SIZE_CLASSES        8
+#define HOP_QUEUE_MAX           32
+#define BRIDGE_OUT_SIZE         4096
+
+#define NS_PER_SEC              1000000000LL
+#define NS_PER_MS               1000000LL
+
+typedef enum
+{
+    MODE_TEXT = 0,
+    MODE_FRAME
+} send_mode_t;
+
+// Message sizes: "N", "A-B" (uniform), optionally "@weight", comma separated
+typedef struct
+{
+    struct
+    {
+        size_t min;
+        size_t max;
+        unsigned weight;
+    } cls[MAX_SIZE_CLASSES];
+    size_t count;
+    unsigned total_weight;
+} size_dist_t;
+
+// Recorded lines replayed after the sequence prefix
+typedef struct
+{
+    char **lines;
+    size_t count;
+} replay_t;
+
+// Simulated BLE hop of the bridge
+typedef struct
+{
+    unsigned rate;              // Payload bytes per second, 0 = unlimited
+    unsigned delay_ms;          // Added latency per message
+    double loss;                // Probability of losing a message
+    unsigned queue;             // Messages held between input and output
+    bool log_text;              // Emit a log line before every frame
+} hop_params_t;
+
+typedef struct
+{
+    const char *tx_path;
+    const char *rx_path;
+    unsigned baud;
+    bool rtscts;
+    send_mode_t mode;
+    double rate;                // Messages per second, 0 = as fast as the link takes them
+    bool poisson;
+    size_dist_t sizes;
+    replay_t replay;
+    uint32_t count;             // Messages to send, 0 = until the duration ends
+    double duration;            // Seconds, 0 = no limit
+    unsigned drain_ms;
+    uint64_t seed;
+    bool loopback;
+    bool verbose;
+    hop_params_t hop;
+} options_t;
+
+// What happened to one message
+typedef struct
+{
+    int64_t sent_ns;            // Last byte written, 0 if never sent
+    int64_t recv_ns;            // First copy received, 0 if lost
+    uint16_t size;
+    uint16_t copies;
+} record_t;
+
+// Incremental parser of a stream mixing text and binary frames
+typedef enum
+{
+    RX_TEXT = 0,
+    RX_FRAME,
+    RX_FRAME_SKIP
+} rx_state_t;
+
+typedef struct
+{
+    rx_state_t state;
+    uint8_t buf[FRAME_MAX_COBS + 1];
+    size_t len;
+} rx_parser_t;
+
+typedef struct
+{
+    uint64_t bytes_in;
+    uint64_t text_bytes;
+    uint64_t frames_bad;
+    uint64_t frames_control;
+    uint64_t payloads;
+    uint64_t unique;            // Messages received intact at least once
+    uint64_t unknown;           // Valid frames without a known sequence number
+    uint64_t duplicates;
+    uint64_t reordered;
+    uint64_t corrupted;
+    uint64_t good_bytes;
+    int64_t highest_seq;
+    int64_t last_recv_ns;
+} rx_stats_t;
+
+static volatile sig_atomic_t stop_requested;
+static uint64_t rng_state = 1;
+
+/*******************************************************************************
+ ***************************   LOCAL FUNCTIONS   *******************************
+ *******************************************************************************/
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stop_requested = 1;
+}
+
+// xorshift64*: reproducible across runs with the same --seed
+static uint64_t rng_next(void)
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+static double rng_unit(void)
+{
+    return (double)(rng_next() >> 11) / (double)(1ULL << 53);
+}
+
+static bool baud_to_speed(unsigned baud, speed_t *speed)
+{
+    static const struct
+    {
+        unsigned baud;
+        speed_t speed;
+    } table[] = {
+        { 9600, B9600 }, { 19200, B19200 }, { 38400, B38400 }, { 57600, B57600 },
+        { 115200, B115200 }, { 230400, B230400 }, { 460800, B460800 },
+        { 921600, B921600 }, { 1000000, B1000000 }, { 1500000, B1500000 },
+        { 2000000, B2000000 }, { 3000000, B3000000 },
+    };
+
+    for(size_t i = 0; i < sizeof(table) / sizeof(table[0]); i++)
+    {
+        if(table[i].baud == baud)
+        {
+            *speed = table[i].speed;
+            return true;
+        }
+    }
+    return false;
+}
+
+static int set_raw(int fd, unsigned baud, bool rtscts)
+{
+    struct termios t;
+    speed_t speed;
+
+    if(tcgetattr(fd, &t) != 0)
+    {
+        return -1;
+    }
+    cfmakeraw(&t);
+    t.c_cflag |= CLOCAL | CREAD;
+    if(rtscts)
+    {
+        t.c_cflag |= CRTSCTS;
+    }
+    else
+    {
+        t.c_cflag &= ~CRTSCTS;
+    }
+    if(baud != 0)
+    {
+        if(!baud_to_speed(baud, &speed))
+        {
+            errno = EINVAL;
+            return -1;
+        }
+        cfsetispeed(&t, speed);
+        cfsetospeed(&t, speed);
+    }
+    return tcsetattr(fd, TCSANOW, &t);
+}
+
+static int open_serial(const char *path, unsigned baud, bool rtscts)
+{
+    int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if(fd < 0)
+    {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if(set_raw(fd, baud, rtscts) != 0)
+    {
+        fprintf(stderr, "%s: cannot configure: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    tcflush(fd, TCIOFLUSH);
+    return fd;
+}
+
+static bool parse_size_dist(const char *spec, size_dist_t *dist)
+{
+    char *copy = strdup(spec);
+    char *save = NULL;
+    bool ok = true;
+
+    memset(dist, 0, sizeof(*dist));
+    for(char *tok = strtok_r(copy, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save))
+    {
+        unsigned long min, max, weight = 1;
+        char *end;
+
+        if(dist->count == MAX_SIZE_CLASSES)
+        {
+            ok = false;
+            break;
+        }
+        min = strtoul(tok, &end, 10);
+        max = min;
+        if(*end == '-')
+        {
+            max = strtoul(end + 1, &end, 10);
+        }
+        if(*end == '@')
+        {
+            weight = strtoul(end + 1, &end, 10);
+        }
+        if(*end != '\0' || min == 0 || max < min || max > MESSAGE_MAX || weight == 0)
+        {
+            ok = false;
+            break;
+        }
+        dist->cls[dist->count].min = min;
+        dist->cls[dist->count].max = max;
+        dist->cls[dist->count].weight = (unsigned)weight;
+        dist->total_weight += (unsigned)weight;
+        dist->count++;
+    }
+
+    free(copy);
+    return ok && dist->count > 0;
+}
+
+static size_t pick_size(const size_dist_t *dist)
+{
+    unsigned w = (unsigned)(rng_next() % dist->total_weight);
+    size_t i = 0;
+
+    while(w >= dist->cls[i].weight)
+    {
+        w -= dist->cls[i].weight;
+        i++;
+    }
+    return dist->cls[i].min + (size_t)(rng_next() % (dist->cls[i].max - dist->cls[i].min + 1));
+}
+
+static bool load_replay(const char *path, replay_t *replay)
+{
+    FILE *f = fopen(path, "r");
+    char line[512];
+    size_t cap = 0;
+
+    if(f == NULL)
+    {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return false;
+    }
+    while(fgets(line, sizeof(line), f) != NULL)
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        if(line[0] == '\0')
+        {
+            continue;
+        }
+        if(replay->count == cap)
+        {
+            cap = cap ? cap * 2 : 64;
+            replay->lines = realloc(replay->lines, cap * sizeof(char *));
+        }
+        replay->lines[replay->count++] = strdup(line);
+    }
+    fclose(f);
+
+    if(replay->count == 0)
+    {
+        fprintf(stderr, "%s: no lines to replay\n", path);
+        return false;
+    }
+    return true;
+}
+
+/* Payload of message seq: "<seq>:" then padding or a recorded line. The
+   receiver rebuilds it from seq and size to detect corruption. */
+static size_t make_payload(const options_t *opt, uint32_t seq, size_t size, uint8_t *out)
+{
+    size_t max = (opt->mode == MODE_TEXT) ? TEXT_MAX_LINE : MESSAGE_MAX;
+    int n = snprintf((char *)out, max + 1, "%" PRIu32 ":", seq);
+    size_t len = (size_t)n;
+
+    if(opt->replay.count > 0)
+    {
+        const char *line = opt->replay.lines[seq % opt->replay.count];
+        size_t line_len = strlen(line);
+        if(len + line_len > max)
+        {
+            line_len = max - len;
+        }
+        memcpy(out + len, line, line_len);
+        return len + line_len;
+    }
+
+    if(size > max)
+    {
+        size = max;
+    }
+    for(; len < size; len++)
+    {
+        // Frames also carry 0x00 and CR/LF to exercise COBS
+        out[len] = (opt->mode == MODE_TEXT) ? (uint8_t)('a' + (seq + len) % 26)
+                                           : (uint8_t)(seq * 31u + len * 7u);
+    }
+    return len;
+}
+
+// Message as written on the wire, returns its length
+static size_t make_wire(const options_t *opt, const uint8_t *payload, size_t len, uint8_t *out)
+{
+    if(opt->mode == MODE_TEXT)
+    {
+        memcpy(out, payload, len);
+        out[len] = '\n';
+        return len + 1;
+    }
+    return app_uart_frame_encode(payload, len, out, WIRE_MAX);
+}
+
+// Write as much as the fd takes, returns false on a fatal error
+static bool flush_out(int fd, const uint8_t *buf, size_t len, size_t *off)
+{
+    while(*off < len)
+    {
+        ssize_t n = write(fd, buf + *off, len - *off);
+        if(n < 0)
+        {
+            if(errno == EAGAIN || errno == EINTR)
+            {
+                return true;
+            }
+            perror("write");
+            return false;
+        }
+        *off += (size_t)n;
+    }
+    return true;
+}
+
+/* Feed received bytes, calls on_frame(payload, len, ctx) for every valid data
+   frame. Returns the number of text bytes seen. */
+typedef void (*frame_handler_t)(const uint8_t *payload, size_t len, void *ctx);
+
+static size_t rx_feed(rx_parser_t *p, const uint8_t *data, size_t n, rx_stats_t *stats,
+                      frame_handler_t on_frame, void *ctx, FILE *text_out)
+{
+    size_t text = 0;
+
+    for(size_t i = 0; i < n; i++)
+    {
+        uint8_t c = data[i];
+
+        switch(p->state)
+        {
+            case RX_TEXT:
+                if(c == APP_UART_FRAME_DELIMITER)
+                {
+                    p->state = RX_FRAME;
+                    p->len = 0;
+                }
+                else
+                {
+                    text++;
+                    if(text_out != NULL)
+                    {
+                        fputc(c, text_out);
+                    }
+                }
+                break;
+
+            case RX_FRAME:
+                if(c != APP_UART_FRAME_DELIMITER)
+                {
+                    if(p->len < FRAME_MAX_COBS)
+                    {
+                        p->buf[p->len++] = c;
+                    }
+                    else
+                    {
+                        stats->frames_bad++;
+                        p->state = RX_FRAME_SKIP;
+                    }
+                    break;
+                }
+                if(p->len == 0)
+                {
+                    break;      // Back-to-back delimiters
+                }
+
+                size_t payload_len;
+                bool is_control;
+                if(!app_uart_frame_decode(p->buf, p->len, &payload_len, &is_control))
+                {
+                    stats->frames_bad++;
+                }
+                else if(is_control)
+                {
+                    stats->frames_control++;
+                }
+                else
+                {
+                    on_frame(p->buf, payload_len, ctx);
+                }
+                p->state = RX_TEXT;
+                break;
+
+            case RX_FRAME_SKIP:
+                if(c == APP_UART_FRAME_DELIMITER)
+                {
+                    p->state = RX_TEXT;
+                }
+                break;
+        }
+    }
+
+    return text;
+}
+
+/*******************************************************************************
+ ******************************   BRIDGE   *************************************
+ *******************************************************************************/
+
+typedef struct
+{
+    uint8_t data[MESSAGE_MAX];
+    size_t len;
+    int64_t release_ns;
+} hop_entry_t;
+
+typedef struct
+{
+    hop_entry_t q[HOP_QUEUE_MAX];
+    size_t head;
+    size_t count;
+    int64_t link_free_ns;
+    // Peripheral-like ingress
+    uint8_t line[FRAME_MAX_COBS + 1];
+    size_t line_len;
+    enum { IN_IDLE, IN_TEXT, IN_TEXT_SKIP, IN_FRAME, IN_FRAME_SKIP } in_state;
+    // Central-like egress
+    uint8_t out[BRIDGE_OUT_SIZE];
+    size_t out_len;
+    size_t out_off;
+    uint64_t messages;
+    uint64_t lost;
+    uint64_t bad_input;
+} bridge_t;
+
+static void bridge_push(bridge_t *b, const hop_params_t *hop, const uint8_t *data, size_t len)
+{
+    int64_t now = now_ns();
+    hop_entry_t *e = &b->q[(b->head + b->count) % HOP_QUEUE_MAX];
+
+    memcpy(e->data, data, len);
+    e->len = len;
+    if(b->link_free_ns < now)
+    {
+        b->link_free_ns = now;
+    }
+    if(hop->rate > 0)
+    {
+        b->link_free_ns += (int64_t)len * NS_PER_SEC / hop->rate;
+    }
+    e->release_ns = b->link_free_ns + (int64_t)hop->delay_ms * NS_PER_MS;
+    b->count++;
+    b->messages++;
+}
+
+// One input byte through the Peripheral's framing rules
+static void bridge_input(bridge_t *b, const hop_params_t *hop, uint8_t c)
+{
+    bool delim = (c == APP_UART_FRAME_DELIMITER);
+    bool term = (c == '\r' || c == '\n');
+
+    if(delim && (b->in_state == IN_TEXT || b->in_state == IN_TEXT_SKIP))
+    {
+        b->bad_input += (b->in_state == IN_TEXT);
+        b->in_state = IN_IDLE;
+    }
+
+    switch(b->in_state)
+    {
+        case IN_IDLE:
+            b->line_len = 0;
+            if(delim)
+            {
+                b->in_state = IN_FRAME;
+            }
+            else if(!term)
+            {
+                b->line[b->line_len++] = c;
+                b->in_state = IN_TEXT;
+            }
+            break;
+
+        case IN_TEXT:
+            if(term)
+            {
+                bridge_push(b, hop, b->line, b->line_len);
+                b->in_state = IN_IDLE;
+            }
+            else if(b->line_len < TEXT_MAX_LINE)
+            {
+                b->line[b->line_len++] = c;
+            }
+            else
+            {
+                b->bad_input++;
+                b->in_state = IN_TEXT_SKIP;
+            }
+            break;
+
+        case IN_TEXT_SKIP:
+            if(term)
+            {
+                b->in_state = IN_IDLE;
+            }
+            break;
+
+        case IN_FRAME:
+            if(!delim)
+            {
+                if(b->line_len < FRAME_MAX_COBS)
+                {
+                    b->line[b->line_len++] = c;
+                }
+                else
+                {
+                    b->bad_input++;
+                    b->in_state = IN_FRAME_SKIP;
+                }
+            }
+            else if(b->line_len > 0)
+            {
+                size_t len;
+                bool is_control;
+                if(app_uart_frame_decode(b->line, b->line_len, &len, &is_control) && !is_control)
+                {
+                    bridge_push(b, hop, b->line, len);
+                }
+                else
+                {
+                    b->bad_input++;
+                }
+                b->in_state = IN_IDLE;
+            }
+            break;
+
+        case IN_FRAME_SKIP:
+            if(delim)
+            {
+                b->in_state = IN_IDLE;
+            }
+            break;
+    }
+}
+
+// Move released messages to the output buffer, Central style
+static void bridge_release(bridge_t *b, const hop_params_t *hop)
+{
+    int64_t now = now_ns();
+
+    while(b->count > 0 && b->q[b->head].release_ns <= now)
+    {
+        hop_entry_t *e = &b->q[b->head];
+
+        if(b->out_len - b->out_off + WIRE_MAX > BRIDGE_OUT_SIZE)
+        {
+            break;
+        }
+        if(b->out_off > 0)
+        {
+            memmove(b->out, b->out + b->out_off, b->out_len - b->out_off);
+            b->out_len -= b->out_off;
+            b->out_off = 0;
+        }
+
+        if(hop->loss > 0 && rng_unit() < hop->loss)
+        {
+            b->lost++;
+        }
+        else
+        {
+            if(hop->log_text)
+            {
+                b->out_len += (size_t)snprintf((char *)b->out + b->out_len, 64,
+                                               "[I] Payload: %zu bytes\r\n", e->len);
+            }
+            b->out_len += app_uart_frame_encode(e->data, e->len, b->out + b->out_len,
+                                                BRIDGE_OUT_SIZE - b->out_len);
+        }
+        b->head = (b->head + 1) % HOP_QUEUE_MAX;
+        b->count--;
+    }
+}
+
+static int run_bridge(int fd_in, int fd_out, const hop_params_t *hop)
+{
+    static bridge_t b;
+    uint8_t in[256];
+    size_t in_len = 0;
+    size_t in_pos = 0;
+
+    memset(&b, 0, sizeof(b));
+    while(!stop_requested)
+    {
+        // Stop reading while the hop is full: the writer sees back-pressure
+        while(in_pos < in_len && b.count < hop->queue)
+        {
+            bridge_input(&b, hop, in[in_pos++]);
+        }
+        bridge_release(&b, hop);
+        if(!flush_out(fd_out, b.out, b.out_len, &b.out_off))
+        {
+            return 1;
+        }
+
+        struct pollfd pfd[2] = {
+            { .fd = fd_in, .events = (in_pos == in_len && b.count < hop->queue) ? POLLIN : 0 },
+            { .fd = fd_out, .events = (b.out_off < b.out_len) ? POLLOUT : 0 },
+        };
+        int timeout = -1;
+        if(b.count > 0)
+        {
+            int64_t wait = b.q[b.head].release_ns - now_ns();
+            timeout = (wait <= 0) ? 0 : (int)(wait / NS_PER_MS) + 1;
+        }
+        if(b.count > 0 && b.out_off < b.out_len)
+        {
+            timeout = (timeout < 0 || timeout > 10) ? 10 : timeout;
+        }
+
+        if(poll(pfd, 2, timeout) < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            perror("poll");
+            return 1;
+        }
+        if(pfd[0].revents & POLLIN)
+        {
+            ssize_t n = read(fd_in, in, sizeof(in));
+            if(n > 0)
+            {
+                in_len = (size_t)n;
+                in_pos = 0;
+            }
+        }
+    }
+
+    fprintf(stderr, "bridge: %" PRIu64 " messages, %" PRIu64 " lost on the hop, %" PRIu64 " bad input\n",
+            b.messages, b.lost, b.bad_input);
+    return 0;
+}
+
+// Two pty pairs: the bridge keeps the masters, the tool opens the slaves
+static bool open_bridge_ptys(int *master_tx, int *master_rx, char *tx_name, char *rx_name,
+                             int *slave_tx, int *slave_rx)
+{
+    if(openpty(master_tx, slave_tx, tx_name, NULL, NULL) != 0
+       || openpty(master_rx, slave_rx, rx_name, NULL, NULL) != 0)
+    {
+        perror("openpty");
+        return false;
+    }
+    set_raw(*slave_tx, 0, false);
+    set_raw(*slave_rx, 0, false);
+    fcntl(*master_tx, F_SETFL, O_NONBLOCK);
+    fcntl(*master_rx, F_SETFL, O_NONBLOCK);
+    return true;
+}
+
+/*******************************************************************************
+ ******************************   MEASURE   ************************************
+ *******************************************************************************/
+
+typedef struct
+{
+    const options_t *opt;
+    record_t *records;
+    size_t sent;
+    rx_stats_t *stats;
+} measure_ctx_t;
+
+static void on_payload(const uint8_t *payload, size_t len, void *arg)
+{
+    measure_ctx_t *m = arg;
+    rx_stats_t *stats = m->stats;
+    uint8_t expected[MESSAGE_MAX + 16];
+    char *end;
+    char prefix[16];
+    size_t plen = len < sizeof(prefix) - 1 ? len : sizeof(prefix) - 1;
+
+    memcpy(prefix, payload, plen);
+    prefix[plen] = '\0';
+    unsigned long seq = strtoul(prefix, &end, 10);
+    if(end == prefix || *end != ':' || seq >= m->sent)
+    {
+        stats->unknown++;
+        return;
+    }
+
+    record_t *r = &m->records[seq];
+    size_t exp_len = make_payload(m->opt, (uint32_t)seq, r->size, expected);
+    stats->payloads++;
+    if(exp_len != len || memcmp(expected, payload, len) != 0)
+    {
+        stats->corrupted++;
+        return;
+    }
+
+    if(r->copies++ > 0)
+    {
+        stats->duplicates++;
+        return;
+    }
+    stats->unique++;
+    r->recv_ns = now_ns();
+    stats->last_recv_ns = r->recv_ns;
+    stats->good_bytes += len;
+    if((int64_t)seq < stats->highest_seq)
+    {
+        stats->reordered++;
+    }
+    else
+    {
+        stats->highest_seq = (int64_t)seq;
+    }
+}
+
+static int compare_i64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile_ms(const int64_t *sorted, size_t n, double p)
+{
+    size_t i = (size_t)ceil(p / 100.0 * (double)n);
+    i = (i == 0) ? 0 : i - 1;
+    return (double)sorted[i] / (double)NS_PER_MS;
+}
+
+static void report(const options_t *opt, const record_t *records, size_t sent,
+                   uint64_t sent_bytes, int64_t start_ns, int64_t end_send_ns,
+                   const rx_stats_t *stats)
+{
+    int64_t *lat = malloc((sent ? sent : 1) * sizeof(int64_t));
+    size_t received = 0;
+
+    for(size_t i = 0; i < sent; i++)
+    {
+        if(records[i].recv_ns != 0)
+        {
+            lat[received++] = records[i].recv_ns - records[i].sent_ns;
+        }
+    }
+    qsort(lat, received, sizeof(int64_t), compare_i64);
+
+    double send_s = (double)(end_send_ns - start_ns) / NS_PER_SEC;
+    int64_t last = stats->last_recv_ns > end_send_ns ? stats->last_recv_ns : end_send_ns;
+    double total_s = (double)(last - start_ns) / NS_PER_SEC;
+    size_t lost = sent - received;
+
+    printf("mode       %s, %s arrivals, %.1f msg/s requested\n",
+           opt->mode == MODE_TEXT ? "text" : "frame",
+           opt->poisson ? "poisson" : "fixed", opt->rate);
+    printf("offered    %zu messages, %" PRIu64 " payload bytes in %.3f s (%.1f msg/s, %.0f B/s)\n",
+           sent, sent_bytes, send_s,
+           send_s > 0 ? (double)sent / send_s : 0.0,
+           send_s > 0 ? (double)sent_bytes / send_s : 0.0);
+    printf("received   %zu messages, %" PRIu64 " payload bytes\n", received, stats->good_bytes);
+    printf("goodput    %.0f B/s (%.1f msg/s) over %.3f s\n",
+           total_s > 0 ? (double)stats->good_bytes / total_s : 0.0,
+           total_s > 0 ? (double)received / total_s : 0.0, total_s);
+    printf("lost       %zu (%.2f%%)\n", lost, sent ? 100.0 * (double)lost / (double)sent : 0.0);
+    printf("duplicates %" PRIu64 ", reordered %" PRIu64 ", corrupted %" PRIu64 ", unknown %" PRIu64 "\n",
+           stats->duplicates, stats->reordered, stats->corrupted, stats->unknown);
+    printf("rx stream  %" PRIu64 " bytes, %" PRIu64 " log text bytes, %" PRIu64 " bad frames, %" PRIu64 " control frames\n",
+           stats->bytes_in, stats->text_bytes, stats->frames_bad, stats->frames_control);
+    if(received > 0)
+    {
+        printf("latency ms min %.2f  p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n",
+               (double)lat[0] / NS_PER_MS,
+               percentile_ms(lat, received, 50), percentile_ms(lat, received, 90),
+               percentile_ms(lat, received, 99), (double)lat[received - 1] / NS_PER_MS);
+    }
+    free(lat);
+}
+
+static int run_measure(const options_t *opt, int fd_tx, int fd_rx)
+{
+    rx_parser_t parser = {0};
+    rx_stats_t stats = { .highest_seq = -1 };
+    size_t cap = opt->count ? opt->count : 1024;
+    record_t *records = calloc(cap, sizeof(record_t));
+    measure_ctx_t m = { .opt = opt, .records = records, .stats = &stats };
+    uint8_t payload[MESSAGE_MAX + 16];
+    uint8_t wire[WIRE_MAX];
+    size_t wire_len = 0;
+    size_t wire_off = 0;
+    uint64_t sent_bytes = 0;
+    int64_t start = now_ns();
+    int64_t next_send = start;
+    int64_t end_send = start;
+    bool sending = true;
+
+    while(!stop_requested)
+    {
+        int64_t now = now_ns();
+
+        // Next message once the previous one is fully written and its time has come
+        if(sending && wire_off == wire_len)
+        {
+            bool more = (opt->count == 0 || m.sent < opt->count)
+                        && (opt->duration <= 0 || now - start < (int64_t)(opt->duration * NS_PER_SEC));
+            if(!more)
+            {
+                sending = false;
+                end_send = now;
+            }
+            else if(now >= next_send)
+            {
+                if(m.sent == cap)
+                {
+                    cap *= 2;
+                    records = realloc(records, cap * sizeof(record_t));
+                    memset(&records[m.sent], 0, (cap - m.sent) * sizeof(record_t));
+                    m.records = records;
+                }
+                size_t size = pick_size(&opt->sizes);
+                size_t len = make_payload(opt, (uint32_t)m.sent, size, payload);
+                records[m.sent].size = (uint16_t)size;
+                wire_len = make_wire(opt, payload, len, wire);
+                wire_off = 0;
+                sent_bytes += len;
+                m.sent++;
+
+                if(opt->rate > 0)
+                {
+                    double gap = opt->poisson ? -log(1.0 - rng_unit()) / opt->rate : 1.0 / opt->rate;
+                    next_send += (int64_t)(gap * NS_PER_SEC);
+                }
+            }
+        }
+        if(wire_off < wire_len)
+        {
+            if(!flush_out(fd_tx, wire, wire_len, &wire_off))
+            {
+                break;
+            }
+            if(wire_off == wire_len)
+            {
+                records[m.sent - 1].sent_ns = now_ns();
+            }
+        }
+
+        // Wait for input, output room or the next send time
+        int timeout = 100;
+        if(sending && wire_off == wire_len)
+        {
+            int64_t wait = next_send - now_ns();
+            timeout = (wait <= 0) ? 0 : (int)(wait / NS_PER_MS);
+        }
+        else if(!sending)
+        {
+            // Wait until nothing has arrived for drain_ms
+            int64_t idle_from = (stats.last_recv_ns > end_send) ? stats.last_recv_ns : end_send;
+            int64_t wait = idle_from + (int64_t)opt->drain_ms * NS_PER_MS - now_ns();
+            if(wait <= 0 || stats.unique == m.sent)
+            {
+                break;
+            }
+            timeout = (int)(wait / NS_PER_MS) + 1;
+        }
+
+        struct pollfd pfd[2] = {
+            { .fd = fd_rx, .events = POLLIN },
+            { .fd = fd_tx, .events = (wire_off < wire_len) ? POLLOUT : 0 },
+        };
+        if(poll(pfd, 2, timeout) < 0 && errno != EINTR)
+        {
+            perror("poll");
+            break;
+        }
+        if(pfd[0].revents & POLLIN)
+        {
+            uint8_t buf[1024];
+            ssize_t n = read(fd_rx, buf, sizeof(buf));
+            if(n > 0)
+            {
+                stats.bytes_in += (uint64_t)n;
+                stats.text_bytes += rx_feed(&parser, buf, (size_t)n, &stats, on_payload, &m,
+                                            opt->verbose ? stderr : NULL);
+            }
+        }
+    }
+
+    if(sending)
+    {
+        end_send = now_ns();
+    }
+    report(opt, records, m.sent, sent_bytes, start, end_send, &stats);
+    free(records);
+    return 0;
+}
+
+static void usage(FILE *f)
+{
+    fprintf(f,
+        "usage: uart_loadgen run --tx DEV --rx DEV [options]\n"
+        "       uart_loadgen run --loopback [options] [hop options]\n"
+        "       uart_loadgen bridge [hop options]\n"
+        "\n"
+        "load options:\n"
+        "  --mode text|frame     text lines (<= %d bytes) or binary frames (<= %d bytes), default text\n"
+        "  --rate MSG_PER_S      offered message rate, 0 = as fast as the link takes them (default 10)\n"
+        "  --arrival fixed|poisson  inter-message gaps (default fixed)\n"
+        "  --size SPEC           sizes: N, A-B, with @weight, comma separated (default 1-60)\n"
+        "  --replay FILE         send the lines of FILE (after the sequence prefix) instead of padding\n"
+        "  --count N             messages to send, 0 = until --duration ends (default 100)\n"
+        "  --duration S          stop sending after S seconds\n"
+        "  --drain-ms MS         stop once nothing arrived for MS after the last send (default 3000)\n"
+        "  --seed N              random seed (default 1)\n"
+        "  --baud N              serial baud rate (default 115200)\n"
+        "  --rtscts              enable RTS/CTS flow control\n"
+        "  --verbose             copy the received log text to stderr\n"
+        "hop options (bridge):\n"
+        "  --hop-rate B_PER_S    payload throughput of the simulated BLE hop, 0 = unlimited (default 0)\n"
+        "  --hop-delay-ms MS     latency added to every message (default 0)\n"
+        "  --hop-loss PERCENT    messages lost on the hop (default 0)\n"
+        "  --hop-queue N         messages held before reading stops (default 3, max %d)\n"
+        "  --hop-no-log          do not emit log text around the frames\n",
+        TEXT_MAX_LINE, MESSAGE_MAX, HOP_QUEUE_MAX);
+}
+
+static bool parse_options(int argc, char **argv, options_t *opt)
+{
+    enum {
+        OPT_TX = 1, OPT_RX, OPT_BAUD, OPT_RTSCTS, OPT_MODE, OPT_RATE, OPT_ARRIVAL, OPT_SIZE,
+        OPT_REPLAY, OPT_COUNT, OPT_DURATION, OPT_DRAIN, OPT_SEED, OPT_LOOPBACK, OPT_VERBOSE,
+        OPT_HOP_RATE, OPT_HOP_DELAY, OPT_HOP_LOSS, OPT_HOP_QUEUE, OPT_HOP_NO_LOG, OPT_HELP
+    };
+    static const struct option longopts[] = {
+        { "tx", required_argument, NULL, OPT_TX },
+        { "rx", required_argument, NULL, OPT_RX },
+        { "baud", required_argument, NULL, OPT_BAUD },
+        { "rtscts", no_argument, NULL, OPT_RTSCTS },
+        { "mode", required_argument, NULL, OPT_MODE },
+        { "rate", required_argument, NULL, OPT_RATE },
+        { "arrival", required_argument, NULL, OPT_ARRIVAL },
+        { "size", required_argument, NULL, OPT_SIZE },
+        { "replay", required_argument, NULL, OPT_REPLAY },
+        { "count", required_argument, NULL, OPT_COUNT },
+        { "duration", required_argument, NULL, OPT_DURATION },
+        { "drain-ms", required_argument, NULL, OPT_DRAIN },
+        { "seed", required_argument, NULL, OPT_SEED },
+        { "loopback", no_argument, NULL, OPT_LOOPBACK },
+        { "verbose", no_argument, NULL, OPT_VERBOSE },
+        { "hop-rate", required_argument, NULL, OPT_HOP_RATE },
+        { "hop-delay-ms", required_argument, NULL, OPT_HOP_DELAY },
+        { "hop-loss", required_argument, NULL, OPT_HOP_LOSS },
+        { "hop-queue", required_argument, NULL, OPT_HOP_QUEUE },
+        { "hop-no-log", no_argument, NULL, OPT_HOP_NO_LOG },
+        { "help", no_argument, NULL, OPT_HELP },
+        { NULL, 0, NULL, 0 },
+    };
+    int c;
+
+    while((c = getopt_long(argc, argv, "", longopts, NULL)) != -1)
+    {
+        switch(c)
+        {
+            case OPT_TX: opt->tx_path = optarg; break;
+            case OPT_RX: opt->rx_path = optarg; break;
+            case OPT_BAUD: opt->baud = (unsigned)strtoul(optarg, NULL, 10); break;
+            case OPT_RTSCTS: opt->rtscts = true; break;
+            case OPT_MODE:
+                if(strcmp(optarg, "text") == 0)
+                {
+                    opt->mode = MODE_TEXT;
+                }
+                else if(strcmp(optarg, "frame") == 0)
+                {
+                    opt->mode = MODE_FRAME;
+                }
+                else
+                {
+                    fprintf(stderr, "bad --mode: %s\n", optarg);
+                    return false;
+                }
+                break;
+            case OPT_RATE: opt->rate = strtod(optarg, NULL); break;
+            case OPT_ARRIVAL: opt->poisson = (strcmp(optarg, "poisson") == 0); break;
+            case OPT_SIZE:
+                if(!parse_size_dist(optarg, &opt->sizes))
+                {
+                    fprintf(stderr, "bad --size: %s (sizes 1..%d)\n", optarg, MESSAGE_MAX);
+                    return false;
+                }
+                break;
+            case OPT_REPLAY:
+                if(!load_replay(optarg, &opt->replay))
+                {
+                    return false;
+                }
+                break;
+            case OPT_COUNT: opt->count = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case OPT_DURATION: opt->duration = strtod(optarg, NULL); break;
+            case OPT_DRAIN: opt->drain_ms = (unsigned)strtoul(optarg, NULL, 10); break;
+            case OPT_SEED: opt->seed = strtoull(optarg, NULL, 10); break;
+            case OPT_LOOPBACK: opt->loopback = true; break;
+            case OPT_VERBOSE: opt->verbose = true; break;
+            case OPT_HOP_RATE: opt->hop.rate = (unsigned)strtoul(optarg, NULL, 10); break;
+            case OPT_HOP_DELAY: opt->hop.delay_ms = (unsigned)strtoul(optarg, NULL, 10); break;
+            case OPT_HOP_LOSS: opt->hop.loss = strtod(optarg, NULL) / 100.0; break;
+            case OPT_HOP_QUEUE: opt->hop.queue = (unsigned)strtoul(optarg, NULL, 10); break;
+            case OPT_HOP_NO_LOG: opt->hop.log_text = false; break;
+            case OPT_HELP: usage(stdout); exit(0);
+            default: return false;
+        }
+    }
+
+    if(opt->hop.queue == 0 || opt->hop.queue > HOP_QUEUE_MAX)
+    {
+        fprintf(stderr, "--hop-queue must be 1..%d\n", HOP_QUEUE_MAX);
+        return false;
+    }
+    if(opt->count == 0 && opt->duration <= 0)
+    {
+        fprintf(stderr, "--count 0 needs --duration\n");
+        return false;
+    }
+    if(opt->mode == MODE_TEXT)
+    {
+        for(size_t i = 0; i < opt->sizes.count; i++)
+        {
+            if(opt->sizes.cls[i].max > TEXT_MAX_LINE)
+            {
+                fprintf(stderr, "text lines are limited to %d bytes, use --mode frame\n", TEXT_MAX_LINE);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/*******************************************************************************
+ ***************************   GLOBAL FUNCTIONS   ******************************
+ ******************************************************************************/
+
+int main(int argc, char **argv)
+{
+    options_t opt = {
+        .baud = 115200,
+        .mode = MODE_TEXT,
+        .rate = 10,
+        .count = 100,
+        .drain_ms = 3000,
+        .seed = 1,
+        .hop = { .queue = 3, .log_text = true },
+    };
+
+    if(argc < 2 || (strcmp(argv[1], "run") != 0 && strcmp(argv[1], "bridge") != 0))
+    {
+        usage(stderr);
+        return 2;
+    }
+    bool bridge_only = (strcmp(argv[1], "bridge") == 0);
+    parse_size_dist("1-60", &opt.sizes);
+    if(!parse_options(argc - 1, argv + 1, &opt))
+    {
+        usage(stderr);
+        return 2;
+    }
+    rng_state = opt.seed ? opt.seed : 1;
+
+    struct sigaction sa = { .sa_handler = on_signal };
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    if(bridge_only || opt.loopback)
+    {
+        int master_tx, master_rx, slave_tx, slave_rx;
+        char tx_name[128], rx_name[128];
+
+        if(!open_bridge_ptys(&master_tx, &master_rx, tx_name, rx_name, &slave_tx, &slave_rx))
+        {
+            return 1;
+        }
+        if(bridge_only)
+        {
+            printf("write to (Peripheral side): %s\nread from (Central side):  %s\n", tx_name, rx_name);
+            fflush(stdout);
+            return run_bridge(master_tx, master_rx, &opt.hop);
+        }
+
+        pid_t pid = fork();
+        if(pid == 0)
+        {
+            close(slave_tx);
+            close(slave_rx);
+            _exit(run_bridge(master_tx, master_rx, &opt.hop));
+        }
+        close(master_tx);
+        close(master_rx);
+        fcntl(slave_tx, F_SETFL, O_NONBLOCK);
+        fcntl(slave_rx, F_SETFL, O_NONBLOCK);
+
+        int rc = run_measure(&opt, slave_tx, slave_rx);
+        kill(pid, SIGTERM);
+        waitpid(pid, NULL, 0);
+        return rc;
+    }
+
+    if(opt.tx_path == NULL || opt.rx_path == NULL)
+    {
+        fprintf(stderr, "run needs --tx and --rx, or --loopback\n");
+        return 2;
+    }
+    int fd_tx = open_serial(opt.tx_path, opt.baud, opt.rtscts);
+    int fd_rx = (strcmp(opt.tx_path, opt.rx_path) == 0) ? fd_tx : open_serial(opt.rx_path, opt.baud, opt.rtscts);
+    if(fd_tx < 0 || fd_rx < 0)
+    {
+        return 1;
+    }
+    return run_measure(&opt, fd_tx, fd_rx);
+}